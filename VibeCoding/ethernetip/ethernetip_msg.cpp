@@ -41,6 +41,8 @@
 #include "CapacityApi.h"
 #include "algoutils.h"
 #include "industrial_protocol_debug.h"
+#include "industrial_protocol_event.h"
+#include "industrial_protocol_pipeline.h"
 
 #ifndef min
 #define min(a, b) ((a)<(b)) ? (a) : (b)
@@ -170,6 +172,12 @@ static uint8_t g_result_raw_buffer[EIP_RESULT_INPUT_BUFFER_SIZE];
 static uint16_t g_result_raw_len = 0;
 static int last_command_excuted = 1;
 
+/* 流水线握手: 隐式(I/O)与显式报文各自一套在途触发与待发布结果 */
+static ind_proto_pipeline_t g_eip_pipeline;
+static ind_proto_pipeline_t g_eip_explicit_pipeline;
+static int g_eip_pipeline_inited = 0;
+static int g_eip_pipeline_depth = 0;
+
 static ind_proto_debug_ctx_t g_eip_debug_ctx;
 static int g_eip_debug_inited = 0;
 
@@ -210,6 +218,8 @@ static int m_nLogId = 0;
 static int m_nFrame = 0;
 static int m_nTrigger = 0;
 
+static int eip_send_classic_result(char *result_ptr, int result_len);
+
 int set_procedure_name(IN const char* szProcedureName)
 {
 	snprintf(m_szProcedureName, sizeof(m_szProcedureName), "%s", szProcedureName);
@@ -512,6 +522,103 @@ static int32_t get_data_from_application_for_eip(uint32_t instance_number)
 	return 0;
 }
 
+static void eip_pipeline_init_once(void)
+{
+	if (g_eip_pipeline_inited)
+	{
+		return;
+	}
+	if ((ind_proto_pipeline_init(&g_eip_pipeline) == 0)
+		&& (ind_proto_pipeline_init(&g_eip_explicit_pipeline) == 0))
+	{
+		g_eip_pipeline_inited = 1;
+	}
+}
+
+/* 发布的结果写入原始结果缓冲, 与经典握手的结果共用同一份数据 */
+static void eip_pipeline_load_result(const ind_proto_pipeline_result_t *result)
+{
+	uint16_t result_len = result->len;
+
+	if (result_len > g_input_size - EIP_RESULT_DATA_OFFSET - EIP_RESULT_DATA_LEN_BYTES)
+	{
+		result_len = g_input_size - EIP_RESULT_DATA_OFFSET - EIP_RESULT_DATA_LEN_BYTES;
+	}
+	if (result_len > sizeof(g_result_raw_buffer))
+	{
+		result_len = sizeof(g_result_raw_buffer);
+	}
+	g_result_raw_len = result_len;
+	memset(g_result_raw_buffer, 0, sizeof(g_result_raw_buffer));
+	if (result_len > 0)
+	{
+		memcpy(g_result_raw_buffer, result->data, result_len);
+	}
+}
+
+/*
+ * 隐式报文的流水线握手: 输出组件到达时处理一次, trigger_id/result_id直接放在输入组件的id字段
+ */
+static void eip_pipeline_process_implicit(void)
+{
+	static ind_proto_pipeline_result_t result;	// 单条结果较大, 不放在协议栈线程栈上
+	uint16_t status = (uint16_t)g_assembly_input.input_event;
+	uint16_t trigger_id = (uint16_t)g_assembly_input.trigger_id;
+	uint16_t result_id = (uint16_t)g_assembly_input.result_id;
+	int flags = 0;
+
+	flags = ind_proto_pipeline_step(&g_eip_pipeline, (uint16_t)g_assembly_output.output_event, &status,
+		&trigger_id, &result_id, &result, ind_proto_monotonic_ms(), EIP_RESULT_TIMEOUT);
+	g_assembly_input.input_event = (g_assembly_input.input_event & ~0xFFFF) | status;
+	g_assembly_input.trigger_id = (int16_t)trigger_id;
+	g_assembly_input.result_id = (int16_t)result_id;
+
+	if (flags & IND_PROTO_PIPELINE_TRIGGERED)
+	{
+		eip_trigger_once();
+		eip_debug_record(EIP_DEBUG_WORK_MODE_IMPLICIT, g_trigger_step, g_waiting_result,
+			(uint16_t)g_assembly_output.output_event, status, 0, "pipeline_trigger", 0);
+	}
+	if (flags & IND_PROTO_PIPELINE_PUBLISH)
+	{
+		eip_pipeline_load_result(&result);
+		eip_update_input_data();
+		eip_debug_record(EIP_DEBUG_WORK_MODE_IMPLICIT, g_trigger_step, g_waiting_result,
+			(uint16_t)g_assembly_output.output_event, status, 0,
+			(result.len > 0) ? "pipeline_result_ok" : "pipeline_result_ng", (result.len == 0));
+	}
+}
+
+/*
+ * 显式报文的流水线握手: 由显式触发线程周期处理, id经custom_data.trigger_id/result_id读出
+ */
+static void eip_pipeline_process_explicit(void)
+{
+	static ind_proto_pipeline_result_t result;
+	uint16_t status = g_explicit_input_status;
+	int flags = 0;
+
+	flags = ind_proto_pipeline_step(&g_eip_explicit_pipeline, g_explicit_output_status, &status,
+		&g_explicit_trigger_id, &g_explicit_result_id, &result, ind_proto_monotonic_ms(), EIP_RESULT_TIMEOUT);
+
+	if (flags & IND_PROTO_PIPELINE_TRIGGERED)
+	{
+		eip_trigger_once();
+	}
+	if (flags & IND_PROTO_PIPELINE_PUBLISH)
+	{
+		eip_pipeline_load_result(&result);
+		eip_update_explicit_input_data();
+	}
+	g_explicit_input_status = status;	// 结果数据就绪后再更新状态
+	if (flags & IND_PROTO_PIPELINE_PUBLISH)
+	{
+		eip_debug_record(EIP_DEBUG_WORK_MODE_EXPLICIT, g_explicit_trigger_step, g_explicit_waiting_result,
+			g_explicit_output_status, g_explicit_input_status, 0,
+			(result.len > 0) ? "pipeline_result_ok" : "pipeline_result_ng", (result.len == 0));
+	}
+}
+
 int32_t application_data_handle_for_eip(uint32_t instance_number)
 {
 	uint8_t *output_data = assembly_output_data;
@@ -571,6 +678,11 @@ int32_t application_data_handle_for_eip(uint32_t instance_number)
 					
 					case 2 :
 					{
+						if (ind_proto_pipeline_enabled(&g_eip_pipeline))
+						{
+							eip_pipeline_process_implicit();
+							break;
+						}
 						if (EIP_CHK_BIT(g_assembly_output.output_event, EIPC_TRIGGER_BIT)
 							&& EIP_CHK_BIT(g_assembly_input.input_event, EIPS_TRIGGER_READY_BIT))
 						{
@@ -661,10 +773,10 @@ int32_t application_data_handle_for_eip(uint32_t instance_number)
 									"cmd_ng", 1);
 							}
 
-							ret = ethernetip_send_result(const_cast<char*>(result.c_str()), result.length());
+							ret = eip_send_classic_result(const_cast<char*>(result.c_str()), result.length());
 							if (0 != ret)
 							{
-								LOGE("ethernetip_send_result error %d\r\n", ret);
+								LOGE("eip_send_classic_result error %d\r\n", ret);
 							}	
 						}
 						else
@@ -696,6 +808,7 @@ int32_t application_data_handle_for_eip(uint32_t instance_number)
 						g_assembly_input.input_event = 0;
 						g_trigger_step = 1;
 						g_waiting_result = 0;
+						ind_proto_pipeline_reset(&g_eip_pipeline);
 						eip_debug_record(EIP_DEBUG_WORK_MODE_IMPLICIT, g_trigger_step, g_waiting_result,
 							(uint16_t)g_assembly_output.output_event, (uint16_t)g_assembly_input.input_event, 0,
 							"clear_error", 1);
@@ -825,6 +938,11 @@ static void *eip_explicit_trigger_process(void *args)
 			
 			case 2 :
 			{
+				if (ind_proto_pipeline_enabled(&g_eip_explicit_pipeline))
+				{
+					eip_pipeline_process_explicit();
+					break;
+				}
 				if (EIP_CHK_BIT(g_explicit_output_status, EIPC_TRIGGER_BIT)
 					&& EIP_CHK_BIT(g_explicit_input_status, EIPS_TRIGGER_READY_BIT))
 				{
@@ -900,6 +1018,7 @@ static void *eip_explicit_trigger_process(void *args)
 				g_explicit_input_status = 0;
 				g_explicit_trigger_step = 1;
 				g_explicit_waiting_result = 0;
+				ind_proto_pipeline_reset(&g_eip_explicit_pipeline);
 				eip_debug_record(EIP_DEBUG_WORK_MODE_EXPLICIT, g_explicit_trigger_step, g_explicit_waiting_result,
 					g_explicit_output_status, g_explicit_input_status, explicit_elapsed_ms, "clear_error", 1);
 			}
@@ -1030,6 +1149,9 @@ static int32_t eip_stack_param_init(void)
 	g_trigger_step = 1;
 	g_explicit_trigger_step = 1;
 	last_command_excuted = 1;
+	eip_pipeline_init_once();
+	ind_proto_pipeline_reset(&g_eip_pipeline);
+	ind_proto_pipeline_reset(&g_eip_explicit_pipeline);
 	
 	return configure_eip_para(&cfg_data);
 }
@@ -1093,9 +1215,35 @@ int ethernetip_msg_deinit(void)
 
 int ethernetip_send_result(char *result_ptr, int result_len)
 {	
+	int result_ok = (result_ptr != NULL) && (result_len > 0);
+	int implicit_id = -1;
+	int explicit_id = -1;
+
 	LOGI("frame_cnt:%d trigger_cnt:%d send msg is %s\n", m_nFrame, m_nTrigger, result_ptr);
 	eip_debug_init_once();
 	
+	// 流水线模式: 结果按触发顺序进入对应通道的FIFO, 由握手处理按序发布
+	if (result_ok || (result_len == 0))
+	{
+		implicit_id = ind_proto_pipeline_complete(&g_eip_pipeline, result_ptr, result_ok ? result_len : 0,
+			ind_proto_monotonic_ms());
+		explicit_id = ind_proto_pipeline_complete(&g_eip_explicit_pipeline, result_ptr, result_ok ? result_len : 0,
+			ind_proto_monotonic_ms());
+		if ((implicit_id >= 0) || (explicit_id >= 0))
+		{
+			return 0;
+		}
+	}
+	
+	return eip_send_classic_result(result_ptr, result_len);
+}
+
+/*
+ * 经典握手发布结果: 更新隐式与显式两路的结果数据, 等待中的触发随之完成(RESULT_OK/NG).
+ * 指令应答直接走这里, 不进入流水线; 流水线只接收ethernetip_send_result送来的视觉结果
+ */
+static int eip_send_classic_result(char *result_ptr, int result_len)
+{
 	if (result_ptr != NULL && result_len > 0)
 	{
 		if (result_len > g_input_size - EIP_RESULT_DATA_OFFSET - EIP_RESULT_DATA_LEN_BYTES)
@@ -1234,6 +1382,25 @@ int ethernetip_get_debug_level(void)
 	return ind_proto_debug_get_level(&g_eip_debug_ctx);
 }
 
+int ethernetip_set_pipeline_depth(int depth)
+{
+	eip_pipeline_init_once();
+	if (!g_eip_pipeline_inited)
+	{
+		return -1;
+	}
+	ind_proto_pipeline_set_depth(&g_eip_pipeline, depth);
+	ind_proto_pipeline_set_depth(&g_eip_explicit_pipeline, depth);
+	g_eip_pipeline_depth = depth;
+	LOGI("ethernetip pipeline depth set to %d\r\n", depth);
+	return 0;
+}
+
+int ethernetip_get_pipeline_depth(void)
+{
+	return g_eip_pipeline_depth;
+}
+
 int ethernetip_get_debug_info(char *buff, int buff_size, int *data_len)
 {
 	eip_debug_init_once();
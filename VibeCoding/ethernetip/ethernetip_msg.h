@@ -36,6 +36,8 @@ int ethernetip_set_module_enable(int enable);
 int ethernetip_set_debug_level(int level);
 int ethernetip_get_debug_level(void);
 int ethernetip_get_debug_info(char *buff, int buff_size, int *data_len);
+int ethernetip_set_pipeline_depth(int depth);
+int ethernetip_get_pipeline_depth(void);
 int ethernetip_send_result(char *result_ptr, int result_len);
 
 void set_frame_and_trigger(int nFrame, int nTrigger, int nLogId);
@@ -16,6 +16,7 @@
 #define ETHERNETIP_INPUT_SIZE "EthernetIpInputAssemblySize"
 #define ETHERNETIP_OUTPUT_SIZE "EthernetIpOutputAssemblySize"
 #define ETHERNETIP_RESULT_BYTE_SWAP "EthernetIpResultByteSwapEnable"
+#define ETHERNETIP_PIPELINE_DEPTH "EthernetIpPipelineDepth"
 #define INDUSTRIAL_DEBUG_LEVEL "IndustrialDebugLevel"
 
 void *ThreadProcessScheduledTrans(IN void* argv)
@@ -234,6 +235,12 @@ int CEthernetipTransModule::GetmoduParaHandle(IN const char* szParamName, OUT ch
 		*pDataLen = strlen(pBuff);
 		return IMVS_EC_OK;
 	}
+	if (0 == strcmp(szParamName, ETHERNETIP_PIPELINE_DEPTH))
+	{
+		snprintf(pBuff, nBuffSize, "%d", ethernetip_get_pipeline_depth());
+		*pDataLen = strlen(pBuff);
+		return IMVS_EC_OK;
+	}
 	return IMVS_EC_ALGO_PARAM_NOT_FOUND;	
 }
 
@@ -298,6 +305,14 @@ int CEthernetipTransModule::SetmoduParaHandle(IN const char* szParamName, IN con
 			nErrCode = IMVS_EC_ALGO_PARAM_NOT_VALID;
 		}
 	}
+	else if (0 == strcmp(szParamName, ETHERNETIP_PIPELINE_DEPTH))
+	{
+		nErrCode = ethernetip_set_pipeline_depth(atoi(pData));
+		if (nErrCode < 0)
+		{
+			nErrCode = IMVS_EC_SYSTEM_INNER_ERR;
+		}
+	}
 	else if (0 == strcmp(szParamName, ETHERNETIP_MOUDLE_ENABLE))
 	{
 		auto trigInstance = mvsc_idr_app::ITriggerSource::getComponent();
@@ -27,10 +27,10 @@
 #include <net/if.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
-#include <semaphore.h>
 
 #include "fins_msg.h"
-#include "fins.h"
+#include "fins_net.h"
+#include "fins_poll.h"
 #include "utils.h"
 #include "thread/ThreadApi.h"
 #include "dsp_isp.h"
@@ -47,6 +47,9 @@
 #include "IImageProcess.h"
 #include "algoutils.h"
 #include "industrial_protocol_debug.h"
+#include "industrial_protocol_event.h"
+#include "industrial_protocol_payload.h"
+#include "industrial_protocol_pipeline.h"
 #ifndef min
 #define min(a, b) ((a)<(b)) ? (a) : (b)
 #endif
@@ -80,26 +83,49 @@ typedef enum
 #define MAX_BUF_SIZE       (2000)
 #define MAX_COMMAND_LEN    (128)
 #define FINS_DEBUG_HEARTBEAT_MS (2000)
+#define FINS_STATUS_WINDOW_REGS (3)	// 流水线模式的状态窗口: 状态寄存器、trigger_id、result_id
+#define FINS_CONNECT_TIMEOUT_MS (3000)
+#define FINS_DM_AREA (0x82)
+#define FINS_RESULT_MERGE_GAP (16)			// 脏区间隔不超过这么多字时合并成一次写, 比多一次往返便宜
+#define FINS_RESULT_FULL_REFRESH (100)		// 每写这么多条结果整区重写一次, 0为不做整区刷新
+#define FINS_RESULT_MAX_WRITES (32)
+
+typedef enum
+{
+	FINS_POLL_AREA_CONTROL = 0,
+	FINS_POLL_AREA_INSTRUCTION = 1,
+} fins_poll_area_id;
 
 struct fins_ctrl_t
 {
-	sem_t result_sem;
-	pthread_mutex_t mutex_lock;
-	struct fins_t *ctx;    
+	fins_net_t net;						// 非阻塞FINS连接, 读写请求可同时在途
 	int need_recreate;    
 	int fins_process;    
 	int waiting_result;
+	int result_ready;					// 经典握手: 等待中的结果已写入结果区
 	int result_ng;
+	uint64_t result_deadline_ms;		// 经典握手: 结果超时时刻
 	int trigger_step;    
 	int trigger_process_running;
 	int trigger_process_end;    
 	int message_timeout;
 	fins_param_opt *config_param;    
+	pthread_mutex_t result_lock;		// 视觉线程与触发线程都会写结果, 互斥result_buf、影子和结果区的写
 	char result_buf[MAX_BUF_SIZE];    
+	uint16_t result_shadow[MAX_BUF_SIZE / 2];	// PLC结果区的当前内容, 结果只写与之不同的字
+	int result_shadow_valid;
+	int result_shadow_offset;			// 影子对应的结果区位置和大小, 配置改变后整区重写
+	int result_shadow_size;
+	int result_writes;					// 上次整区写之后写过的结果数
 	short command_buf[MAX_COMMAND_LEN];
+	fins_poll_plan_t poll;				// 每周期合并读取控制字和指令区
+	ind_proto_pipeline_t pipeline;		// 流水线握手: 在途触发与待发布结果
+	uint16_t trigger_id;				// 状态窗口中显示给PLC的id
+	uint16_t result_id;
 };
 
 static struct fins_ctrl_t fins_ctrl;
+static ind_proto_event_t g_fins_wakeup = IND_PROTO_EVENT_INITIALIZER;	// 结果到达时唤醒触发线程
 static ind_proto_debug_ctx_t g_fins_debug_ctx;
 static int g_fins_debug_inited = 0;
 
@@ -288,30 +314,13 @@ int fins_get_debug_info(char *buff, int buff_size, int *data_len)
 	return ind_proto_debug_dump(&g_fins_debug_ctx, buff, buff_size, data_len, IND_PROTO_DEBUG_DUMP_MAX_DEFAULT);
 }
 
-static int sem_timedwait_millsecs(sem_t *sem, long msecs)
-{
-	struct timespec ts;
-	
-	clock_gettime(CLOCK_REALTIME, &ts);	
-	long secs = msecs / 1000;
-	msecs = msecs % 1000;
-	long add = 0;
-	msecs = msecs * 1000 * 1000 + ts.tv_nsec;
-	add = msecs / (1000 * 1000 * 1000);
-	ts.tv_sec += (add + secs);
-	ts.tv_nsec = msecs % (1000 * 1000 * 1000);
-	return sem_timedwait(sem, &ts);
-}
-
 static int fins_write_registers(int reg_space, int reg_offset, int reg_num, short* buffer, int timeout_ms)
 {
 	struct fins_ctrl_t *fins_c = &fins_ctrl;
 	const int type = 0x82;	// DM registers
 	int ret = 0;
 	
-	pthread_mutex_lock(&fins_c->mutex_lock);
-	ret = fins_write(fins_c->ctx, type, reg_offset, reg_num, (const unsigned short *)buffer);
-	pthread_mutex_unlock(&fins_c->mutex_lock);
+	ret = fins_net_write(&fins_c->net, type, reg_offset, reg_num, (const uint16_t *)buffer, timeout_ms);
 	if (ret != reg_num)
 	{
 		return -1;
@@ -326,9 +335,7 @@ static int fins_read_registers(int reg_space, int reg_offset, int reg_num, short
 	const int type = 0x82;	// D M registers
 	int ret = 0;
 
-	pthread_mutex_lock(&fins_c->mutex_lock);
-	ret = fins_read(fins_c->ctx, type, reg_offset, reg_num, (unsigned short *)buffer);
-	pthread_mutex_unlock(&fins_c->mutex_lock);
+	ret = fins_net_read(&fins_c->net, type, reg_offset, reg_num, (uint16_t *)buffer, timeout_ms);
 	if (ret != reg_num)
 	{
 		return -1;
@@ -337,84 +344,339 @@ static int fins_read_registers(int reg_space, int reg_offset, int reg_num, short
 	return 0;
 }
 
-int fins_send_result(const char *result_ptr, unsigned int result_len)
+/*
+ * 每周期的轮询: 控制字和(配置了的)指令区按规划在一次往返内读出.
+ * 返回相对上一周期变化的区域掩码, -1表示读失败
+ */
+static int fins_poll_cycle(short *control_reg)
 {
 	struct fins_ctrl_t *fins_c = &fins_ctrl;
-	unsigned short* result_buf_addr = 0;
-	int ret = 0;
-	int i = 0;
+	fins_poll_area_t areas[2];
+	int count = 1;
+	int changed = 0;
 	
-//	printf("%s %d %s\r\n", __func__, result_len, result_ptr);
+	areas[FINS_POLL_AREA_CONTROL].area = FINS_DM_AREA;
+	areas[FINS_POLL_AREA_CONTROL].offset = fins_c->config_param->control_offset;
+	areas[FINS_POLL_AREA_CONTROL].size = 1;
+	if (fins_c->config_param->ins_size > 0)
+	{
+		areas[FINS_POLL_AREA_INSTRUCTION].area = FINS_DM_AREA;
+		areas[FINS_POLL_AREA_INSTRUCTION].offset = fins_c->config_param->ins_offset;
+		areas[FINS_POLL_AREA_INSTRUCTION].size = min(fins_c->config_param->ins_size, MAX_COMMAND_LEN);
+		count = 2;
+	}
 	
-	if ((fins_c->fins_process == 0) || (fins_c->ctx == NULL))
+	if (fins_poll_configure(&fins_c->poll, areas, count) < 0)
+	{
+		return -1;
+	}
+	changed = fins_poll_read(&fins_c->poll, &fins_c->net, fins_c->message_timeout);
+	if (changed < 0)
 	{
 		return -1;
 	}
 	
-	memset(fins_c->result_buf, 0x0, fins_c->config_param->result_size * 2);
+	*control_reg = (short)fins_poll_data(&fins_c->poll, FINS_POLL_AREA_CONTROL)[0];
+	return changed;
+}
+
+/* 取本周期和控制字一起读到的指令区, 未轮询指令区时单独读取 */
+static int fins_read_instruction(short *buffer, int num)
+{
+	struct fins_ctrl_t *fins_c = &fins_ctrl;
+	int size = 0;
+	
+	memset(buffer, 0, num * sizeof(short));
+	if (fins_c->poll.count <= FINS_POLL_AREA_INSTRUCTION)
+	{
+		return fins_read_registers(fins_c->config_param->ins_space, fins_c->config_param->ins_offset, 
+			fins_c->config_param->ins_size, buffer, fins_c->message_timeout);
+	}
+	
+	size = min(fins_c->poll.areas[FINS_POLL_AREA_INSTRUCTION].size, num);
+	memcpy(buffer, fins_poll_data(&fins_c->poll, FINS_POLL_AREA_INSTRUCTION), size * sizeof(short));
+	return 0;
+}
+
+static int fins_trigger_once(void) 
+{
+	return CAlgoUtils::IndustrialProtocolTriggerOnce();
+}
+
+/*
+ * 写结果区: 长度字加结果数据, 其余字清0. 只写与result_shadow不同的字,
+ * 相近的脏区合并, 长度字所在的写最后发出. 影子无效、结果区配置改变或到了整区刷新周期时整区重写.
+ * 调用方持有result_lock
+ */
+static int fins_write_result_locked(const char *result_ptr, unsigned int result_len)
+{
+	struct fins_ctrl_t *fins_c = &fins_ctrl;
+	int offset = fins_c->config_param->result_offset;
+	uint16_t *image = (uint16_t *)fins_c->result_buf;
+	uint8_t dirty[MAX_BUF_SIZE / 2];
+	ind_proto_write_chunk_t chunks[FINS_RESULT_MAX_WRITES];
+	int size = min(fins_c->config_param->result_size, MAX_BUF_SIZE / 2);
+	int refresh = 0;
+	int count = 0;
+	int ret = 0;
+	int i = 0;
+	
+	if (size <= 0)
+	{
+		return 0;
+	}
+	
+	memset(fins_c->result_buf, 0x0, size * 2);
 	if ((result_ptr != NULL) && (result_len > 0))
 	{
-		if ((result_len + 2) > (unsigned int)(fins_c->config_param->result_size * 2))
+		if ((result_len + 2) > (unsigned int)(size * 2))
 		{
-			result_len = fins_c->config_param->result_size * 2 - 2;
+			result_len = size * 2 - 2;
 		}
 		
 		if (result_len > 0)
 		{
 			memcpy(fins_c->result_buf, &result_len, 2);
-			result_buf_addr = (unsigned short *)&fins_c->result_buf[2];
-			for (i = 0; i < (int)result_len; i += 2)
-			{
-				if (fins_c->config_param->result_byte_swap)
-				{
-					*result_buf_addr = (result_ptr[i] << 8) | result_ptr[i + 1];
-				}
-				else
-				{
-					*result_buf_addr = result_ptr[i] | (result_ptr[i + 1] << 8);
-				}
-				result_buf_addr++;
-			}
-			
-			ret = fins_write_registers(fins_c->config_param->result_space, fins_c->config_param->result_offset, 
-				fins_c->config_param->result_size, (short int *)fins_c->result_buf, fins_c->message_timeout);
-			if (ret < 0)
-			{
-				fins_c->need_recreate = 1;
-				return -1;
-			}
+			ind_proto_pack_words(result_ptr, result_len, fins_c->config_param->result_byte_swap,
+				(uint16_t *)&fins_c->result_buf[2]);
 		}
-		
-		fins_c->result_ng = 0;
 	}
-	else if (result_len == 0)
+	
+	refresh = !fins_c->result_shadow_valid
+		|| (fins_c->result_shadow_offset != offset) || (fins_c->result_shadow_size != size)
+		|| ((FINS_RESULT_FULL_REFRESH > 0) && (fins_c->result_writes + 1 >= FINS_RESULT_FULL_REFRESH));
+	ind_proto_mark_dirty(image, refresh ? NULL : fins_c->result_shadow, size, dirty);
+	count = ind_proto_plan_dirty_writes(dirty, size, FINS_NET_MAX_WORDS, FINS_RESULT_MERGE_GAP, 0,
+		chunks, FINS_RESULT_MAX_WRITES);
+	if (count < 0)
 	{
-		ret = fins_write_registers(fins_c->config_param->result_space, fins_c->config_param->result_offset, 
-			fins_c->config_param->result_size, (short int *)fins_c->result_buf, fins_c->message_timeout);
+		count = ind_proto_plan_writes(size, FINS_NET_MAX_WORDS, 0, chunks, FINS_RESULT_MAX_WRITES);
+	}
+	
+	for (i = 0; i < count; i++)
+	{
+		ret = fins_write_registers(fins_c->config_param->result_space, offset + chunks[i].offset, 
+			chunks[i].count, (short int *)&image[chunks[i].offset], fins_c->message_timeout);
 		if (ret < 0)
 		{
+			// 已发出的写使PLC中的内容不再确定, 下一次整区重写
+			fins_c->result_shadow_valid = 0;
 			fins_c->need_recreate = 1;
 			return -1;
 		}
-		
-		fins_c->result_ng = 1;
 	}
-	else
+	
+	memcpy(fins_c->result_shadow, image, size * sizeof(uint16_t));
+	fins_c->result_shadow_valid = 1;
+	fins_c->result_shadow_offset = offset;
+	fins_c->result_shadow_size = size;
+	fins_c->result_writes = refresh ? 0 : (fins_c->result_writes + 1);
+	
+	return 0;
+}
+
+static int fins_write_result(const char *result_ptr, unsigned int result_len)
+{
+	struct fins_ctrl_t *fins_c = &fins_ctrl;
+	int ret = 0;
+	
+	pthread_mutex_lock(&fins_c->result_lock);
+	ret = fins_write_result_locked(result_ptr, result_len);
+	pthread_mutex_unlock(&fins_c->result_lock);
+	
+	return ret;
+}
+
+/*
+ * 经典握手发布结果: 写结果区, 等待中的触发由触发线程随之写RESULT_OK/NG.
+ * 指令应答直接走这里, 不进入流水线; 流水线只接收fins_send_result送来的视觉结果
+ */
+static int fins_send_classic_result(const char *result_ptr, unsigned int result_len)
+{
+	struct fins_ctrl_t *fins_c = &fins_ctrl;
+	int result_ok = (result_ptr != NULL) && (result_len > 0);
+	
+	if (fins_write_result(result_ptr, result_len) < 0)
 	{
 		return -1;
 	}
+	fins_c->result_ng = !result_ok;
 	
+	// 结果区已写好, 触发线程被唤醒后立即写RESULT_OK/NG, 不等下一个轮询周期
 	if (fins_c->waiting_result)
 	{
-		sem_post(&fins_c->result_sem);
+		fins_c->result_ready = 1;
+		ind_proto_event_signal(&g_fins_wakeup);
 	}
 	
 	return 0; 
 }
 
-static int fins_trigger_once(void) 
+int fins_send_result(const char *result_ptr, unsigned int result_len)
 {
-	return CAlgoUtils::IndustrialProtocolTriggerOnce();
+	struct fins_ctrl_t *fins_c = &fins_ctrl;
+	int result_ok = (result_ptr != NULL) && (result_len > 0);
+	
+//	printf("%s %d %s\r\n", __func__, result_len, result_ptr);
+	
+	if ((fins_c->fins_process == 0) || !fins_net_connected(&fins_c->net))
+	{
+		return -1;
+	}
+	
+	if (!result_ok && (result_len != 0))
+	{
+		return -1;
+	}
+	
+	// 流水线模式: 结果按触发顺序进入FIFO, 由触发线程按序写出
+	if (ind_proto_pipeline_complete(&fins_c->pipeline, result_ptr, result_ok ? result_len : 0,
+		ind_proto_monotonic_ms()) >= 0)
+	{
+		ind_proto_event_signal(&g_fins_wakeup);
+		return 0;
+	}
+	
+	return fins_send_classic_result(result_ptr, result_len);
+}
+
+/*
+ * 经典握手的结果等待: 结果已写入或超时后写出RESULT_OK/NG, 进入结果应答步骤.
+ * 返回0表示仍在等待, 1表示结果已发布, 2表示超时, -1表示写寄存器失败
+ */
+static int fins_poll_result(short *status_reg)
+{
+	struct fins_ctrl_t *fins_c = &fins_ctrl;
+	int timeout = 0;
+	
+	if (!fins_c->waiting_result)
+	{
+		return 0;
+	}
+	if (!fins_c->result_ready)
+	{
+		if (ind_proto_monotonic_ms() < fins_c->result_deadline_ms)
+		{
+			return 0;
+		}
+		timeout = 1;
+	}
+	
+	fins_c->waiting_result = 0;
+	//FN_CLR_BIT(*status_reg, FNS_TRIGGER_ACK_BIT);
+	FN_CLR_BIT(*status_reg, FNS_ACQUIRING_BIT);
+	FN_CLR_BIT(*status_reg, FNS_DECODING_BIT);
+	if (timeout || fins_c->result_ng)
+	{
+		FN_SET_BIT(*status_reg, FNS_RESULT_NG_BIT);
+	}
+	else
+	{
+		FN_SET_BIT(*status_reg, FNS_RESULT_OK_BIT);
+	}
+	if (fins_write_registers(fins_c->config_param->status_space, fins_c->config_param->status_offset, 
+		1, status_reg, fins_c->message_timeout) < 0)
+	{
+		return -1;
+	}
+	
+	fins_c->trigger_step = 3;
+	return timeout ? 2 : 1;
+}
+
+static int fins_words_overlap(int offset_a, int num_a, int offset_b, int num_b)
+{
+	return (offset_a < offset_b + num_b) && (offset_b < offset_a + num_a);
+}
+
+/*
+ * 流水线深度: 状态窗口占状态区的前FINS_STATUS_WINDOW_REGS个字(状态、trigger_id、result_id),
+ * 状态区不够大或窗口与控制区、结果区重叠时按经典握手运行
+ */
+static int fins_pipeline_depth(void)
+{
+	static int logged_depth = 0;
+	fins_param_opt *param = fins_ctrl.config_param;
+	int control_size = (param->control_size > 1) ? param->control_size : 1;
+	int result_size = (param->result_size > 1) ? param->result_size : 1;
+	
+	if (param->pipeline_depth <= 1)
+	{
+		logged_depth = 0;
+		return param->pipeline_depth;
+	}
+	if ((param->status_size >= FINS_STATUS_WINDOW_REGS)
+		&& !fins_words_overlap(param->status_offset, FINS_STATUS_WINDOW_REGS, param->control_offset, control_size)
+		&& !fins_words_overlap(param->status_offset, FINS_STATUS_WINDOW_REGS, param->result_offset, result_size))
+	{
+		logged_depth = 0;
+		return param->pipeline_depth;
+	}
+	
+	if (logged_depth != param->pipeline_depth)
+	{
+		LOGE("fins pipeline depth %d disabled: status D%d size %d must hold %d words outside control D%d(%d) and result D%d(%d)\r\n",
+			param->pipeline_depth, param->status_offset, param->status_size, FINS_STATUS_WINDOW_REGS,
+			param->control_offset, param->control_size, param->result_offset, param->result_size);
+		logged_depth = param->pipeline_depth;
+	}
+	return 0;
+}
+
+/*
+ * 写状态窗口: 经典握手只写状态寄存器, 流水线模式下连同其后的trigger_id、result_id一次写出
+ * (状态区的第2、3个字, 由fins_pipeline_depth保证在状态区内)
+ */
+static int fins_write_status_window(short status_reg)
+{
+	struct fins_ctrl_t *fins_c = &fins_ctrl;
+	short regs[FINS_STATUS_WINDOW_REGS] = {0};
+	int num = 1;
+	
+	regs[0] = status_reg;
+	if (ind_proto_pipeline_enabled(&fins_c->pipeline))
+	{
+		regs[1] = (short)fins_c->trigger_id;
+		regs[2] = (short)fins_c->result_id;
+		num = FINS_STATUS_WINDOW_REGS;
+	}
+	
+	return fins_write_registers(fins_c->config_param->status_space, fins_c->config_param->status_offset, 
+		num, regs, fins_c->message_timeout);
+}
+
+/*
+ * 流水线模式下的一次握手处理: 接受触发、写出FIFO头部的结果、处理结果应答, 更新状态窗口.
+ * 返回-1表示写寄存器失败, 需要重连
+ */
+static int fins_pipeline_process(short control_reg, short *status_reg)
+{
+	static ind_proto_pipeline_result_t result;	// 单条结果较大, 不放在触发线程栈上
+	struct fins_ctrl_t *fins_c = &fins_ctrl;
+	uint16_t status = (uint16_t)*status_reg;
+	int flags = 0;
+	
+	flags = ind_proto_pipeline_step(&fins_c->pipeline, (uint16_t)control_reg, &status,
+		&fins_c->trigger_id, &fins_c->result_id, &result, ind_proto_monotonic_ms(),
+		(uint32_t)fins_c->config_param->result_timeout * 1000);
+	*status_reg = (short)status;
+	
+	if (flags & IND_PROTO_PIPELINE_TRIGGERED)
+	{
+		fins_trigger_once();
+	}
+	if ((flags & IND_PROTO_PIPELINE_PUBLISH)
+		&& (fins_write_result(result.data, result.len) < 0))
+	{
+		return -1;
+	}
+	if ((flags & (IND_PROTO_PIPELINE_PUBLISH | IND_PROTO_PIPELINE_STATUS))
+		&& (fins_write_status_window(*status_reg) < 0))
+	{
+		return -1;
+	}
+	
+	return flags;
 }
 
 static int shortbuf_to_string(short *short_buf, int short_len, char *buf, int len)
@@ -455,7 +717,6 @@ static int shortbuf_to_string(short *short_buf, int short_len, char *buf, int le
 static void *fins_trigger_process(void *args)
 {
 	struct fins_ctrl_t *fins_c = &fins_ctrl;
-	struct in_addr ip_addr;
 	short control_reg = 0;
 	short status_reg = 0;
 	int last_command_excuted = 0;
@@ -468,6 +729,10 @@ static void *fins_trigger_process(void *args)
 	short prev_status_reg = 0;
 	int prev_trigger_step = 0;
 	int prev_waiting_result = 0;
+	int poll_changed = 0;
+	int handled_valid = 0;
+	short handled_status_reg = 0;
+	int handled_trigger_step = 0;
 	ind_proto_debug_state_t prev_state = {0};
 	ind_proto_debug_state_t curr_state = {0};
 	
@@ -476,63 +741,77 @@ static void *fins_trigger_process(void *args)
 	
 	fins_c->trigger_process_running = 1;
 	fins_c->trigger_process_end = 0;
-	fins_c->ctx = NULL;
 	fins_c->waiting_result = 0;
 	fins_fill_debug_state(fins_c, control_reg, status_reg, 0, "thread_start", &curr_state);
 	ind_proto_debug_record(&g_fins_debug_ctx, &curr_state, 1);
 	
 	while (fins_c->trigger_process_running)
 	{
-		usleep(fins_c->config_param->control_poll_interval * 1000);
+		// 结果到达时提前唤醒, 否则按轮询间隔读控制寄存器
+		ind_proto_event_wait(&g_fins_wakeup, fins_c->config_param->control_poll_interval);
 		prev_control_reg = control_reg;
 		prev_status_reg = status_reg;
 		prev_trigger_step = fins_c->trigger_step;
 		prev_waiting_result = fins_c->waiting_result;
+		ind_proto_pipeline_set_depth(&fins_c->pipeline, fins_pipeline_depth());
 		
-		if (fins_c->ctx == NULL)
+		if (!fins_net_connected(&fins_c->net))
 		{
-            ip_addr.s_addr = fins_c->config_param->server_ip;
-//			printf("server ip %s port %d\r\n", inet_ntoa(ip_addr), fins_c->config_param->server_port);
-			fins_c->ctx = fins_new_tcp(inet_ntoa(ip_addr), fins_c->config_param->server_port);
-			if (fins_c->ctx == NULL)
-			{
-				sleep(1);
-				continue;
-			}
-			
-			ret = fins_connect(fins_c->ctx);
+			ret = fins_net_connect(&fins_c->net, fins_c->config_param->transport, fins_c->config_param->server_ip,
+				fins_c->config_param->server_port, FINS_CONNECT_TIMEOUT_MS);
 			if (ret != 0)
 			{
-				fins_close(fins_c->ctx);
-				fins_free(fins_c->ctx);
-				fins_c->ctx = NULL;
 				sleep(1);
 				continue;
 			}
-
-			//fins_set_debug(fins_c->ctx, 1);
 			
 			fins_c->trigger_step = 1;
 			fins_c->need_recreate = 0;
+			pthread_mutex_lock(&fins_c->result_lock);
+			fins_c->result_shadow_valid = 0;
+			pthread_mutex_unlock(&fins_c->result_lock);
+			fins_poll_invalidate(&fins_c->poll);
 		}
 
 		if (fins_c->need_recreate)
 		{
-			fins_close(fins_c->ctx);
-			fins_free(fins_c->ctx);
-			fins_c->ctx = NULL;
+			fins_net_disconnect(&fins_c->net);
 			sleep(1);
 			continue;
 		}
 
-        ret = fins_read_registers(fins_c->config_param->control_space, fins_c->config_param->control_offset, 
-            1, &control_reg, fins_c->message_timeout);
-        if (ret < 0)
+		ret = fins_poll_result(&status_reg);
+		if (ret < 0)
+		{
+			fins_c->need_recreate = 1;
+			continue;
+		}
+		if (ret == 2)
+		{
+			clear_error_excuted = 0;
+			fins_fill_debug_state(fins_c, control_reg, status_reg, 0, "result_timeout", &curr_state);
+			ind_proto_debug_record(&g_fins_debug_ctx, &curr_state, 1);
+		}
+
+        poll_changed = fins_poll_cycle(&control_reg);
+        if (poll_changed < 0)
         {
             fins_c->need_recreate = 1;
             continue;
         }
         
+		// 控制字没变且状态、步骤与上次完整处理后相同时, 握手和命令处理不会有新动作.
+		// 步骤1要检查触发源, 流水线要检查结果超时, 这两种情况每周期都处理
+		if (!(poll_changed & (1 << FINS_POLL_AREA_CONTROL)) && handled_valid
+			&& (status_reg == handled_status_reg) && (fins_c->trigger_step == handled_trigger_step)
+			&& (fins_c->trigger_step != 1) && !ind_proto_pipeline_enabled(&fins_c->pipeline))
+		{
+			fins_fill_debug_state(fins_c, control_reg, status_reg, 0, "heartbeat", &curr_state);
+			ind_proto_debug_record_heartbeat(&g_fins_debug_ctx, &curr_state);
+			continue;
+		}
+		handled_valid = 0;
+        
 //        printf("contrl: %#x status: %#x step: %d\r\n",
 //            control_reg, status_reg, fins_c->trigger_step);
 		
@@ -566,6 +845,21 @@ static void *fins_trigger_process(void *args)
 			
 			case 2:
 			{
+				if (ind_proto_pipeline_enabled(&fins_c->pipeline))
+				{
+					ret = fins_pipeline_process(control_reg, &status_reg);
+					if (ret < 0)
+					{
+						fins_c->need_recreate = 1;
+						continue;
+					}
+					if (ret & IND_PROTO_PIPELINE_TRIGGERED)
+					{
+						fins_fill_debug_state(fins_c, control_reg, status_reg, 0, "pipeline_trigger", &curr_state);
+						ind_proto_debug_record(&g_fins_debug_ctx, &curr_state, 0);
+					}
+					break;
+				}
 				if (FN_CHK_BIT(control_reg, FNC_TRIGGER_BIT)
 					&& FN_CHK_BIT(status_reg, FNS_TRIGGER_READY_BIT))
 				{
@@ -581,60 +875,20 @@ static void *fins_trigger_process(void *args)
 						continue;
 					}
 					
-					memset(fins_c->result_buf, 0x0, fins_c->config_param->result_size * 2);
-					ret = fins_write_registers(fins_c->config_param->result_space, fins_c->config_param->result_offset, 
-						fins_c->config_param->result_size, (short int *)fins_c->result_buf, fins_c->message_timeout);
+					ret = fins_write_result(NULL, 0);
 					if (ret < 0)
 					{
 						fins_c->need_recreate = 1;
 						continue;
 					}
 					
+					// 结果由fins_poll_result在到达或超时后发布, 等待期间继续轮询控制寄存器
+					fins_c->result_ready = 0;
+					fins_c->result_deadline_ms = ind_proto_monotonic_ms()
+						+ (uint64_t)fins_c->config_param->result_timeout * 1000;
 					fins_c->waiting_result = 1;
 					fins_trigger_once();
-					if (sem_timedwait_millsecs(&fins_c->result_sem, fins_c->config_param->result_timeout * 1000) < 0)
-					{
-						fins_c->waiting_result = 0;
-						//FN_CLR_BIT(status_reg, FNS_TRIGGER_ACK_BIT);
-						FN_CLR_BIT(status_reg, FNS_ACQUIRING_BIT);
-						FN_CLR_BIT(status_reg, FNS_DECODING_BIT);
-						FN_SET_BIT(status_reg, FNS_RESULT_NG_BIT);
-						ret = fins_write_registers(fins_c->config_param->status_space, fins_c->config_param->status_offset, 
-							1, &status_reg, fins_c->message_timeout);
-						if (ret < 0)
-						{
-							fins_c->need_recreate = 1;
-							continue;
-						}
-						
-						clear_error_excuted = 0;
-						fins_fill_debug_state(fins_c, control_reg, status_reg, 0, "result_timeout", &curr_state);
-						ind_proto_debug_record(&g_fins_debug_ctx, &curr_state, 1);
-					}
-					else
-					{
-						fins_c->waiting_result = 0;
-						//FN_CLR_BIT(status_reg, FNS_TRIGGER_ACK_BIT);
-						FN_CLR_BIT(status_reg, FNS_ACQUIRING_BIT);
-						FN_CLR_BIT(status_reg, FNS_DECODING_BIT);
-						if (fins_c->result_ng)
-						{
-							FN_SET_BIT(status_reg, FNS_RESULT_NG_BIT);
-						}
-						else
-						{
-							FN_SET_BIT(status_reg, FNS_RESULT_OK_BIT);
-						}
-						ret = fins_write_registers(fins_c->config_param->status_space, fins_c->config_param->status_offset, 
-							1, &status_reg, fins_c->message_timeout);
-						if (ret < 0)
-						{
-							fins_c->need_recreate = 1;
-							continue;
-						}
-					}
 					
-					fins_c->trigger_step++;
 					fins_fill_debug_state(fins_c, control_reg, status_reg, 0, "trigger_once", &curr_state);
 					ind_proto_debug_record(&g_fins_debug_ctx, &curr_state, 0);
 				}
@@ -680,12 +934,7 @@ static void *fins_trigger_process(void *args)
 			{
 				last_command_excuted = 1;
 
-				memset(fins_c->command_buf, 0, sizeof(fins_c->command_buf));
-				ret = fins_read_registers(fins_c->config_param->ins_space, 
-											fins_c->config_param->ins_offset, 
-											fins_c->config_param->ins_size, 
-											fins_c->command_buf, 
-											fins_c->message_timeout);
+				ret = fins_read_instruction(fins_c->command_buf, MAX_COMMAND_LEN);
 //                    fins_c->config_param->ins_space, fins_c->config_param->ins_offset, fins_c->config_param->ins_size);
                                             
 				if (ret < 0)
@@ -749,10 +998,10 @@ static void *fins_trigger_process(void *args)
 							ind_proto_debug_record(&g_fins_debug_ctx, &curr_state, 1);
 						}
 
-						ret = fins_send_result(result.c_str(), result.length());
+						ret = fins_send_classic_result(result.c_str(), result.length());
 						if (0 != ret)
 						{
-							printf("fins_send_result error %d\r\n", ret);
+							printf("fins_send_classic_result error %d\r\n", ret);
 						}	
 					}		
 
@@ -806,6 +1055,7 @@ static void *fins_trigger_process(void *args)
 				
 				fins_c->waiting_result = 0;
 				fins_c->trigger_step = 1;
+				ind_proto_pipeline_reset(&fins_c->pipeline);
 				fins_fill_debug_state(fins_c, control_reg, status_reg, 0, "clear_error", &curr_state);
 				ind_proto_debug_record(&g_fins_debug_ctx, &curr_state, 1);
 			}
@@ -823,14 +1073,13 @@ static void *fins_trigger_process(void *args)
 
 		fins_fill_debug_state(fins_c, control_reg, status_reg, 0, "heartbeat", &curr_state);
 		ind_proto_debug_record_heartbeat(&g_fins_debug_ctx, &curr_state);
+		
+		handled_valid = 1;
+		handled_status_reg = status_reg;
+		handled_trigger_step = fins_c->trigger_step;
 	}
 	
-	if (fins_c->ctx != NULL)
-	{
-		fins_close(fins_c->ctx);
-		fins_free(fins_c->ctx);
-		fins_c->ctx = NULL;
-	}
+	fins_net_disconnect(&fins_c->net);
 	
 	fins_c->trigger_process_end = 1;
 	fins_fill_debug_state(fins_c, control_reg, status_reg, 0, "thread_exit", &curr_state);
@@ -917,15 +1166,29 @@ int fins_msg_init(fins_param_opt *c_param)
 	
 	memset(fins_c, 0x0, sizeof(struct fins_ctrl_t));
 	
-	ret = sem_init(&fins_c->result_sem, 0, 0);
+	ret = ind_proto_event_open(&g_fins_wakeup);
 	if (ret < 0)
 	{
-		printf("sem_init failed\r\n");
+		printf("ind_proto_event_open failed\r\n");
 		return -2;
 	}
 	
-	ret = pthread_mutex_init(&fins_c->mutex_lock, NULL);
+	ret = fins_net_init(&fins_c->net);
 	if (ret < 0)
+	{
+		printf("fins_net_init failed\r\n");
+		return -3;
+	}
+	
+	ret = ind_proto_pipeline_init(&fins_c->pipeline);
+	if (ret < 0)
+	{
+		printf("ind_proto_pipeline_init failed\r\n");
+		return -3;
+	}
+	
+	ret = pthread_mutex_init(&fins_c->result_lock, NULL);
+	if (ret != 0)
 	{
 		printf("pthread_mutex_init failed\r\n");
 		return -3;
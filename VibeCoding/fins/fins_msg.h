@@ -37,6 +37,8 @@ typedef struct
 	int ins_space;
 	int ins_offset;
 	int ins_size;
+	int pipeline_depth;		// 流水线握手的在途触发数, 0/1为经典握手
+	int transport;			// 0: FINS/TCP, 1: FINS/UDP
 } fins_param_opt;
 
 #ifdef __cplusplus
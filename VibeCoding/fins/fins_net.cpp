@@ -0,0 +1,766 @@
+/** @file
+ * @brief Non-blocking FINS/TCP and FINS/UDP client, see fins_net.h.
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "fins_net.h"
+#include "log/log.h"
+#include "industrial_protocol_event.h"
+
+#define FINS_TCP_HEADER_LEN (16)
+#define FINS_TCP_CMD_NODE_REQ (0)		// 客户端节点地址请求
+#define FINS_TCP_CMD_NODE_RSP (1)
+#define FINS_TCP_CMD_FRAME (2)			// FINS帧
+#define FINS_HEADER_LEN (10)
+#define FINS_CMD_PARAM_LEN (8)			// MRC SRC 区域 地址(2) 位 数量(2)
+#define FINS_RSP_MIN_LEN (FINS_HEADER_LEN + 4)	// 头部 MRC SRC 结束码(2)
+#define FINS_MRC_MEMORY (0x01)
+#define FINS_SRC_READ (0x01)
+#define FINS_SRC_WRITE (0x02)
+#define FINS_SRC_MULTI_READ (0x04)
+#define FINS_END_CODE_MASK (0x7F3F)		// 去掉网络中继错误和CPU单元错误标志位
+
+enum
+{
+	FINS_NET_REQ_FREE = 0,
+	FINS_NET_REQ_PENDING,
+	FINS_NET_REQ_DONE,
+	FINS_NET_REQ_FAILED,
+};
+
+static void fins_net_put16(uint8_t *p, uint16_t v)
+{
+	p[0] = (uint8_t)(v >> 8);
+	p[1] = (uint8_t)v;
+}
+
+static void fins_net_put32(uint8_t *p, uint32_t v)
+{
+	p[0] = (uint8_t)(v >> 24);
+	p[1] = (uint8_t)(v >> 16);
+	p[2] = (uint8_t)(v >> 8);
+	p[3] = (uint8_t)v;
+}
+
+static uint16_t fins_net_get16(const uint8_t *p)
+{
+	return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static uint32_t fins_net_get32(const uint8_t *p)
+{
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static int fins_net_remaining_ms(uint64_t deadline_ms)
+{
+	uint64_t now_ms = ind_proto_monotonic_ms();
+	return (now_ms >= deadline_ms) ? 0 : (int)(deadline_ms - now_ms);
+}
+
+/* 等待fd可读/可写直到截止时间. 返回1就绪, 0超时, -1出错 */
+static int fins_net_wait_fd(int fd, short events, uint64_t deadline_ms)
+{
+	struct pollfd pfd;
+	int ret = 0;
+
+	pfd.fd = fd;
+	pfd.events = events;
+	pfd.revents = 0;
+	do
+	{
+		ret = poll(&pfd, 1, fins_net_remaining_ms(deadline_ms));
+	} while ((ret < 0) && (errno == EINTR));
+
+	return (ret > 0) ? 1 : ret;
+}
+
+static void fins_net_set_broken(fins_net_t *net)
+{
+	pthread_mutex_lock(&net->lock);
+	net->broken = 1;
+	pthread_cond_broadcast(&net->cond);
+	pthread_mutex_unlock(&net->lock);
+}
+
+static int fins_net_send_all(fins_net_t *net, const uint8_t *buf, int len, uint64_t deadline_ms)
+{
+	ssize_t n = 0;
+	int sent = 0;
+
+	// TCP流上的帧不能交错, 发送整帧期间持有发送锁
+	pthread_mutex_lock(&net->send_lock);
+	while (sent < len)
+	{
+		n = send(net->fd, buf + sent, len - sent, MSG_NOSIGNAL);
+		if (n > 0)
+		{
+			sent += (int)n;
+			continue;
+		}
+		if ((n < 0) && (errno == EINTR))
+		{
+			continue;
+		}
+		if ((n < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+			&& (fins_net_wait_fd(net->fd, POLLOUT, deadline_ms) > 0))
+		{
+			continue;
+		}
+		break;
+	}
+	pthread_mutex_unlock(&net->send_lock);
+
+	return (sent == len) ? 0 : -1;
+}
+
+static int fins_net_recv_exact(int fd, uint8_t *buf, int len, uint64_t deadline_ms)
+{
+	ssize_t n = 0;
+	int got = 0;
+
+	while (got < len)
+	{
+		n = recv(fd, buf + got, len - got, 0);
+		if (n > 0)
+		{
+			got += (int)n;
+			continue;
+		}
+		if (n == 0)
+		{
+			return -1;
+		}
+		if (errno == EINTR)
+		{
+			continue;
+		}
+		if (((errno == EAGAIN) || (errno == EWOULDBLOCK)) && (fins_net_wait_fd(fd, POLLIN, deadline_ms) > 0))
+		{
+			continue;
+		}
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * FINS/TCP连接建立后先交换节点地址: 客户端发送节点号0由PLC自动分配,
+ * 应答中依次是分配给客户端的节点号和PLC的节点号
+ */
+static int fins_net_tcp_handshake(fins_net_t *net, uint64_t deadline_ms)
+{
+	uint8_t req[FINS_TCP_HEADER_LEN + 4];
+	uint8_t rsp[FINS_TCP_HEADER_LEN + 8];
+	uint32_t len = 0;
+
+	memcpy(req, "FINS", 4);
+	fins_net_put32(req + 4, sizeof(req) - 8);
+	fins_net_put32(req + 8, FINS_TCP_CMD_NODE_REQ);
+	fins_net_put32(req + 12, 0);
+	fins_net_put32(req + 16, 0);
+	if (fins_net_send_all(net, req, sizeof(req), deadline_ms) < 0)
+	{
+		return -1;
+	}
+
+	if (fins_net_recv_exact(net->fd, rsp, FINS_TCP_HEADER_LEN, deadline_ms) < 0)
+	{
+		return -1;
+	}
+	len = fins_net_get32(rsp + 4);
+	if ((memcmp(rsp, "FINS", 4) != 0) || (fins_net_get32(rsp + 8) != FINS_TCP_CMD_NODE_RSP)
+		|| (fins_net_get32(rsp + 12) != 0) || (len != sizeof(rsp) - 8))
+	{
+		LOGE("fins tcp node address exchange refused, command %u error %u\r\n",
+			fins_net_get32(rsp + 8), fins_net_get32(rsp + 12));
+		return -1;
+	}
+	if (fins_net_recv_exact(net->fd, rsp + FINS_TCP_HEADER_LEN, 8, deadline_ms) < 0)
+	{
+		return -1;
+	}
+
+	net->sa1 = rsp[19];
+	net->da1 = rsp[23];
+	return 0;
+}
+
+static int fins_net_free_slot(const fins_net_t *net)
+{
+	int i = 0;
+
+	for (i = 0; i < FINS_NET_MAX_INFLIGHT; i++)
+	{
+		if (net->req[i].state == FINS_NET_REQ_FREE)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+static uint8_t fins_net_next_sid(fins_net_t *net)
+{
+	int used = 1;
+	int i = 0;
+
+	while (used)
+	{
+		net->next_sid++;
+		used = 0;
+		for (i = 0; i < FINS_NET_MAX_INFLIGHT; i++)
+		{
+			if ((net->req[i].state != FINS_NET_REQ_FREE) && (net->req[i].sid == net->next_sid))
+			{
+				used = 1;
+			}
+		}
+	}
+	return net->next_sid;
+}
+
+/* 按SID把应答交给对应的请求, 找不到的(已超时的请求)丢弃 */
+static void fins_net_dispatch(fins_net_t *net, const uint8_t *frame, int len)
+{
+	fins_net_req_t *req = NULL;
+	uint16_t end_code = 0;
+	int i = 0;
+	int j = 0;
+
+	if ((len < FINS_RSP_MIN_LEN) || !(frame[0] & 0x40))
+	{
+		return;
+	}
+	end_code = fins_net_get16(frame + 12) & FINS_END_CODE_MASK;
+
+	pthread_mutex_lock(&net->lock);
+	for (i = 0; i < FINS_NET_MAX_INFLIGHT; i++)
+	{
+		req = &net->req[i];
+		if ((req->state != FINS_NET_REQ_PENDING) || (req->sid != frame[9])
+			|| (req->mrc != frame[10]) || (req->src != frame[11]))
+		{
+			continue;
+		}
+
+		if (end_code != 0)
+		{
+			LOGE("fins command %02x%02x sid %u end code %#06x\r\n", req->mrc, req->src, req->sid, end_code);
+			req->state = FINS_NET_REQ_FAILED;
+		}
+		else if (req->dest != NULL)
+		{
+			if (len < FINS_RSP_MIN_LEN + req->nb * req->stride)
+			{
+				req->state = FINS_NET_REQ_FAILED;
+			}
+			else
+			{
+				// 0101的应答是连续的字, 0104的应答每个字前带区域码
+				for (j = 0; j < req->nb; j++)
+				{
+					req->dest[j] = fins_net_get16(frame + FINS_RSP_MIN_LEN + (j + 1) * req->stride - 2);
+				}
+				req->state = FINS_NET_REQ_DONE;
+			}
+		}
+		else
+		{
+			req->state = FINS_NET_REQ_DONE;
+		}
+		pthread_cond_broadcast(&net->cond);
+		break;
+	}
+	pthread_mutex_unlock(&net->lock);
+}
+
+/* 接收并分发一次epoll就绪的数据, 同一时刻只有一个线程调用 */
+static void fins_net_receive(fins_net_t *net, int timeout_ms)
+{
+	struct epoll_event ev;
+	uint32_t frame_len = 0;
+	ssize_t n = 0;
+
+	if (epoll_wait(net->epfd, &ev, 1, timeout_ms) <= 0)
+	{
+		return;
+	}
+
+	if (net->transport == FINS_NET_UDP)
+	{
+		n = recv(net->fd, net->rx_buf, sizeof(net->rx_buf), 0);
+		if (n > 0)
+		{
+			fins_net_dispatch(net, net->rx_buf, (int)n);
+		}
+		else if ((n == 0) || ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR)))
+		{
+			fins_net_set_broken(net);
+		}
+		return;
+	}
+
+	n = recv(net->fd, net->rx_buf + net->rx_len, sizeof(net->rx_buf) - net->rx_len, 0);
+	if ((n == 0) || ((n < 0) && (errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR)))
+	{
+		fins_net_set_broken(net);
+		return;
+	}
+	if (n < 0)
+	{
+		return;
+	}
+
+	net->rx_len += (int)n;
+	while (net->rx_len >= FINS_TCP_HEADER_LEN)
+	{
+		frame_len = fins_net_get32(net->rx_buf + 4) + 8;
+		if ((memcmp(net->rx_buf, "FINS", 4) != 0) || (frame_len < FINS_TCP_HEADER_LEN)
+			|| (frame_len > sizeof(net->rx_buf)) || (fins_net_get32(net->rx_buf + 12) != 0))
+		{
+			LOGE("fins tcp stream error, command %u error %u\r\n",
+				fins_net_get32(net->rx_buf + 8), fins_net_get32(net->rx_buf + 12));
+			fins_net_set_broken(net);
+			return;
+		}
+		if ((uint32_t)net->rx_len < frame_len)
+		{
+			break;
+		}
+
+		if (fins_net_get32(net->rx_buf + 8) == FINS_TCP_CMD_FRAME)
+		{
+			fins_net_dispatch(net, net->rx_buf + FINS_TCP_HEADER_LEN, (int)frame_len - FINS_TCP_HEADER_LEN);
+		}
+		net->rx_len -= (int)frame_len;
+		memmove(net->rx_buf, net->rx_buf + frame_len, net->rx_len);
+	}
+}
+
+static void fins_net_cond_wait(fins_net_t *net, uint64_t deadline_ms)
+{
+	struct timespec ts;
+
+	ts.tv_sec = (time_t)(deadline_ms / 1000);
+	ts.tv_nsec = (long)(deadline_ms % 1000) * 1000 * 1000;
+	pthread_cond_timedwait(&net->cond, &net->lock, &ts);
+}
+
+/*
+ * 持锁调用. slot >= 0时等待该请求完成, slot < 0时等待空闲的请求槽.
+ * 没有线程在接收时由本线程接收, 否则等待接收线程分发. 返回1表示条件满足
+ */
+static int fins_net_wait_locked(fins_net_t *net, int slot, uint64_t deadline_ms)
+{
+	int remaining_ms = 0;
+
+	while (!net->broken)
+	{
+		if ((slot >= 0) ? (net->req[slot].state != FINS_NET_REQ_PENDING) : (fins_net_free_slot(net) >= 0))
+		{
+			return 1;
+		}
+
+		remaining_ms = fins_net_remaining_ms(deadline_ms);
+		if (remaining_ms <= 0)
+		{
+			return 0;
+		}
+
+		if (!net->receiving)
+		{
+			net->receiving = 1;
+			pthread_mutex_unlock(&net->lock);
+			fins_net_receive(net, remaining_ms);
+			pthread_mutex_lock(&net->lock);
+			net->receiving = 0;
+			pthread_cond_broadcast(&net->cond);
+		}
+		else
+		{
+			fins_net_cond_wait(net, deadline_ms);
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * 发送一帧内存区命令, 不等待应答. param为SRC之后的参数, 读命令的应答数据
+ * 每stride字节一个字(字在最后两个字节)写入dest. 返回请求槽
+ */
+static int fins_net_submit(fins_net_t *net, uint8_t src, const uint8_t *param, int param_len,
+	uint16_t *dest, int nb, int stride, uint64_t deadline_ms)
+{
+	uint8_t frame[FINS_TCP_HEADER_LEN + FINS_HEADER_LEN + FINS_CMD_PARAM_LEN + FINS_NET_MAX_WORDS * 2];
+	uint8_t *fins = frame;
+	fins_net_req_t *req = NULL;
+	int slot = 0;
+	int len = 0;
+
+	pthread_mutex_lock(&net->lock);
+	if (!fins_net_wait_locked(net, -1, deadline_ms))
+	{
+		pthread_mutex_unlock(&net->lock);
+		return -1;
+	}
+	slot = fins_net_free_slot(net);
+	req = &net->req[slot];
+	req->state = FINS_NET_REQ_PENDING;
+	req->sid = fins_net_next_sid(net);
+	req->mrc = FINS_MRC_MEMORY;
+	req->src = src;
+	req->dest = dest;
+	req->nb = nb;
+	req->stride = stride;
+	pthread_mutex_unlock(&net->lock);
+
+	if (net->transport == FINS_NET_TCP)
+	{
+		fins = frame + FINS_TCP_HEADER_LEN;
+	}
+	fins[0] = 0x80;		// ICF: 命令, 需要应答
+	fins[1] = 0x00;
+	fins[2] = 0x02;		// GCT
+	fins[3] = 0x00;
+	fins[4] = net->da1;
+	fins[5] = 0x00;		// DA2: CPU单元
+	fins[6] = 0x00;
+	fins[7] = net->sa1;
+	fins[8] = 0x00;
+	fins[9] = req->sid;
+	fins[10] = FINS_MRC_MEMORY;
+	fins[11] = src;
+	memcpy(fins + FINS_HEADER_LEN + 2, param, param_len);
+	len = FINS_HEADER_LEN + 2 + param_len;
+
+	if (net->transport == FINS_NET_TCP)
+	{
+		memcpy(frame, "FINS", 4);
+		fins_net_put32(frame + 4, 8 + len);
+		fins_net_put32(frame + 8, FINS_TCP_CMD_FRAME);
+		fins_net_put32(frame + 12, 0);
+		len += FINS_TCP_HEADER_LEN;
+	}
+
+	if (fins_net_send_all(net, frame, len, deadline_ms) < 0)
+	{
+		pthread_mutex_lock(&net->lock);
+		req->state = FINS_NET_REQ_FREE;
+		net->broken = 1;
+		pthread_cond_broadcast(&net->cond);
+		pthread_mutex_unlock(&net->lock);
+		return -1;
+	}
+
+	return slot;
+}
+
+/* 等待请求完成并释放请求槽. 返回0成功 */
+static int fins_net_finish(fins_net_t *net, int slot, uint64_t deadline_ms)
+{
+	int ret = -1;
+
+	pthread_mutex_lock(&net->lock);
+	if (fins_net_wait_locked(net, slot, deadline_ms) && (net->req[slot].state == FINS_NET_REQ_DONE))
+	{
+		ret = 0;
+	}
+	net->req[slot].state = FINS_NET_REQ_FREE;
+	pthread_cond_broadcast(&net->cond);
+	pthread_mutex_unlock(&net->lock);
+
+	return ret;
+}
+
+/* 登记一个读写线程, 断开连接时等待其退出. 未连接返回-1 */
+static int fins_net_enter(fins_net_t *net)
+{
+	int ret = -1;
+
+	pthread_mutex_lock(&net->lock);
+	if (net->connected && !net->broken)
+	{
+		net->users++;
+		ret = 0;
+	}
+	pthread_mutex_unlock(&net->lock);
+
+	return ret;
+}
+
+static void fins_net_leave(fins_net_t *net)
+{
+	pthread_mutex_lock(&net->lock);
+	net->users--;
+	pthread_cond_broadcast(&net->cond);
+	pthread_mutex_unlock(&net->lock);
+}
+
+/* 超过单帧长度的读写拆成多帧连续发出, 再依次等待应答 */
+static int fins_net_request(fins_net_t *net, uint8_t src, int area, int offset, int nb,
+	uint16_t *dest, const uint16_t *data, int timeout_ms)
+{
+	uint64_t deadline_ms = ind_proto_monotonic_ms() + (uint64_t)timeout_ms;
+	uint8_t param[FINS_CMD_PARAM_LEN + FINS_NET_MAX_WORDS * 2];
+	int slots[FINS_NET_MAX_INFLIGHT];
+	int param_len = 0;
+	int count = 0;
+	int done = 0;
+	int chunk = 0;
+	int slot = 0;
+	int ret = 0;
+	int i = 0;
+
+	if ((nb <= 0) || (offset < 0) || (offset + nb > 0x10000) || (fins_net_enter(net) < 0))
+	{
+		return -1;
+	}
+
+	while ((done < nb) && (ret == 0))
+	{
+		if (count == FINS_NET_MAX_INFLIGHT)
+		{
+			ret = fins_net_finish(net, slots[0], deadline_ms);
+			count--;
+			memmove(slots, slots + 1, count * sizeof(slots[0]));
+			continue;
+		}
+
+		chunk = ((nb - done) < FINS_NET_MAX_WORDS) ? (nb - done) : FINS_NET_MAX_WORDS;
+		param[0] = (uint8_t)area;
+		fins_net_put16(param + 1, (uint16_t)(offset + done));
+		param[3] = 0x00;
+		fins_net_put16(param + 4, (uint16_t)chunk);
+		param_len = FINS_CMD_PARAM_LEN - 2;
+		if (data != NULL)
+		{
+			for (i = 0; i < chunk; i++)
+			{
+				fins_net_put16(param + param_len + i * 2, data[done + i]);
+			}
+			param_len += chunk * 2;
+		}
+
+		slot = fins_net_submit(net, src, param, param_len, (dest != NULL) ? dest + done : NULL, chunk, 2, deadline_ms);
+		if (slot < 0)
+		{
+			ret = -1;
+			break;
+		}
+		slots[count++] = slot;
+		done += chunk;
+	}
+
+	while (count > 0)
+	{
+		if (fins_net_finish(net, slots[0], deadline_ms) < 0)
+		{
+			ret = -1;
+		}
+		count--;
+		memmove(slots, slots + 1, count * sizeof(slots[0]));
+	}
+
+	fins_net_leave(net);
+	return (ret == 0) ? nb : -1;
+}
+
+int fins_net_init(fins_net_t *net)
+{
+	pthread_condattr_t attr;
+
+	memset(net, 0, sizeof(*net));
+	net->fd = -1;
+	net->epfd = -1;
+	if ((pthread_mutex_init(&net->lock, NULL) != 0) || (pthread_mutex_init(&net->send_lock, NULL) != 0))
+	{
+		return -1;
+	}
+	if ((pthread_condattr_init(&attr) != 0) || (pthread_condattr_setclock(&attr, CLOCK_MONOTONIC) != 0)
+		|| (pthread_cond_init(&net->cond, &attr) != 0))
+	{
+		return -1;
+	}
+	pthread_condattr_destroy(&attr);
+
+	return 0;
+}
+
+int fins_net_connect(fins_net_t *net, int transport, int ip, int port, int timeout_ms)
+{
+	uint64_t deadline_ms = ind_proto_monotonic_ms() + (uint64_t)timeout_ms;
+	struct sockaddr_in addr;
+	struct sockaddr_in local;
+	socklen_t addr_len = sizeof(local);
+	struct epoll_event ev;
+	int type = (transport == FINS_NET_UDP) ? SOCK_DGRAM : SOCK_STREAM;
+	int fd = -1;
+	int epfd = -1;
+	int err = 0;
+	int one = 1;
+
+	fins_net_disconnect(net);
+
+	fd = socket(AF_INET, type | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+	{
+		return -1;
+	}
+	if (transport != FINS_NET_UDP)
+	{
+		(void)setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons((uint16_t)port);
+	addr.sin_addr.s_addr = (in_addr_t)ip;
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+	{
+		addr_len = sizeof(err);
+		if ((errno != EINPROGRESS) || (fins_net_wait_fd(fd, POLLOUT, deadline_ms) <= 0)
+			|| (getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &addr_len) < 0) || (err != 0))
+		{
+			close(fd);
+			return -1;
+		}
+	}
+
+	epfd = epoll_create1(EPOLL_CLOEXEC);
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN | EPOLLRDHUP;
+	if ((epfd < 0) || (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0))
+	{
+		if (epfd >= 0)
+		{
+			close(epfd);
+		}
+		close(fd);
+		return -1;
+	}
+
+	pthread_mutex_lock(&net->lock);
+	net->fd = fd;
+	net->epfd = epfd;
+	net->transport = (transport == FINS_NET_UDP) ? FINS_NET_UDP : FINS_NET_TCP;
+	net->broken = 0;
+	net->rx_len = 0;
+	pthread_mutex_unlock(&net->lock);
+
+	if (net->transport == FINS_NET_TCP)
+	{
+		err = fins_net_tcp_handshake(net, deadline_ms);
+	}
+	else
+	{
+		// FINS/UDP的节点号约定为IP地址的最后一个字节
+		addr_len = sizeof(local);
+		err = getsockname(fd, (struct sockaddr *)&local, &addr_len);
+		net->da1 = ((uint8_t *)&addr.sin_addr.s_addr)[3];
+		net->sa1 = ((uint8_t *)&local.sin_addr.s_addr)[3];
+	}
+	if (err != 0)
+	{
+		fins_net_disconnect(net);
+		return -1;
+	}
+
+	pthread_mutex_lock(&net->lock);
+	net->connected = 1;
+	pthread_mutex_unlock(&net->lock);
+
+	return 0;
+}
+
+void fins_net_disconnect(fins_net_t *net)
+{
+	int i = 0;
+
+	pthread_mutex_lock(&net->lock);
+	if (net->fd < 0)
+	{
+		pthread_mutex_unlock(&net->lock);
+		return;
+	}
+
+	net->connected = 0;
+	net->broken = 1;
+	shutdown(net->fd, SHUT_RDWR);	// 唤醒阻塞在epoll上的接收线程
+	pthread_cond_broadcast(&net->cond);
+	while (net->users > 0)
+	{
+		pthread_cond_wait(&net->cond, &net->lock);
+	}
+
+	close(net->epfd);
+	close(net->fd);
+	net->epfd = -1;
+	net->fd = -1;
+	net->rx_len = 0;
+	for (i = 0; i < FINS_NET_MAX_INFLIGHT; i++)
+	{
+		net->req[i].state = FINS_NET_REQ_FREE;
+	}
+	pthread_mutex_unlock(&net->lock);
+}
+
+int fins_net_connected(fins_net_t *net)
+{
+	return net->connected;
+}
+
+int fins_net_read(fins_net_t *net, int area, int offset, int nb, uint16_t *dest, int timeout_ms)
+{
+	if (dest == NULL)
+	{
+		return -1;
+	}
+	return fins_net_request(net, FINS_SRC_READ, area, offset, nb, dest, NULL, timeout_ms);
+}
+
+int fins_net_write(fins_net_t *net, int area, int offset, int nb, const uint16_t *src, int timeout_ms)
+{
+	if (src == NULL)
+	{
+		return -1;
+	}
+	return fins_net_request(net, FINS_SRC_WRITE, area, offset, nb, NULL, src, timeout_ms);
+}
+
+int fins_net_read_multi(fins_net_t *net, const fins_net_word_t *words, int count, uint16_t *dest, int timeout_ms)
+{
+	uint64_t deadline_ms = ind_proto_monotonic_ms() + (uint64_t)timeout_ms;
+	uint8_t param[FINS_NET_MAX_MULTI * 4];
+	int slot = 0;
+	int ret = 0;
+	int i = 0;
+
+	if ((words == NULL) || (dest == NULL) || (count <= 0) || (count > FINS_NET_MAX_MULTI) || (fins_net_enter(net) < 0))
+	{
+		return -1;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		param[i * 4] = words[i].area;
+		fins_net_put16(param + i * 4 + 1, words[i].offset);
+		param[i * 4 + 3] = 0x00;
+	}
+	slot = fins_net_submit(net, FINS_SRC_MULTI_READ, param, count * 4, dest, count, 3, deadline_ms);
+	ret = (slot < 0) ? -1 : fins_net_finish(net, slot, deadline_ms);
+
+	fins_net_leave(net);
+	return (ret == 0) ? count : -1;
+}
@@ -0,0 +1,94 @@
+/** @file
+ * @brief Non-blocking FINS/TCP and FINS/UDP client used by fins_msg.cpp.
+ *
+ * Requests are tagged with a SID and sent without waiting for the previous
+ * response, so the result write of the vision thread and the control poll of
+ * the trigger thread can be on the wire at the same time. Every request has
+ * its own deadline. The socket is non-blocking and read through epoll by
+ * whichever waiting thread currently holds the receiver role; responses are
+ * matched to their request by SID, late responses of timed out requests are
+ * dropped.
+ *
+ * Only memory area read (0101), memory area write (0102) and multiple memory
+ * area read (0104, word access) are used.
+ * Requests longer than FINS_NET_MAX_WORDS are split into several frames that
+ * are sent back to back.
+ */
+
+#ifndef __FINS_NET_H
+#define __FINS_NET_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+#define FINS_NET_TCP (0)
+#define FINS_NET_UDP (1)
+
+#define FINS_NET_MAX_INFLIGHT (8)		// 同时在途的请求数
+#define FINS_NET_MAX_WORDS (990)		// 单帧读写的最大字数
+#define FINS_NET_MAX_MULTI (128)		// 单帧复合读(0104)的最大字数
+#define FINS_NET_RX_BUF_SIZE (4096)
+
+typedef struct
+{
+	int state;				// FINS_NET_REQ_*
+	uint8_t sid;
+	uint8_t mrc;
+	uint8_t src;
+	uint16_t *dest;			// 读请求的数据目的地址
+	int nb;
+	int stride;				// 应答中每个字占的字节数
+} fins_net_req_t;
+
+typedef struct
+{
+	uint8_t area;
+	uint16_t offset;
+} fins_net_word_t;
+
+typedef struct
+{
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	pthread_mutex_t send_lock;
+	int fd;
+	int epfd;
+	int transport;
+	int connected;
+	int broken;				// 连接出错, 等待重连
+	int receiving;			// 已有线程在epoll上接收
+	int users;				// 正在读写的线程数, 断开时等待其退出
+	uint8_t da1;			// PLC节点号
+	uint8_t sa1;			// 本机节点号
+	uint8_t next_sid;
+	fins_net_req_t req[FINS_NET_MAX_INFLIGHT];
+	int rx_len;
+	uint8_t rx_buf[FINS_NET_RX_BUF_SIZE];
+} fins_net_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fins_net_init(fins_net_t *net);
+
+/* ip is in network byte order. Returns 0 once the node addresses are known. */
+int fins_net_connect(fins_net_t *net, int transport, int ip, int port, int timeout_ms);
+
+/* Fails the requests in flight and waits for their threads before closing the socket. */
+void fins_net_disconnect(fins_net_t *net);
+
+int fins_net_connected(fins_net_t *net);
+
+/* Return nb on success, -1 on timeout, FINS error or a broken connection. */
+int fins_net_read(fins_net_t *net, int area, int offset, int nb, uint16_t *dest, int timeout_ms);
+int fins_net_write(fins_net_t *net, int area, int offset, int nb, const uint16_t *src, int timeout_ms);
+
+/* Reads up to FINS_NET_MAX_MULTI scattered words in one 0104 request. Returns count or -1. */
+int fins_net_read_multi(fins_net_t *net, const fins_net_word_t *words, int count, uint16_t *dest, int timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __FINS_NET_H */
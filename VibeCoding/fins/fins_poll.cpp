@@ -0,0 +1,166 @@
+/** @file
+ * @brief Poll planner for the FINS trigger thread, see fins_poll.h.
+ */
+
+#include <string.h>
+
+#include "fins_poll.h"
+
+/*
+ * 0101读整段时每个字的应答2字节; 0104每个字请求4字节、应答3字节.
+ * 区间内的空隙按这个比例折算, 读空隙更便宜时整段读
+ */
+#define FINS_POLL_RANGE_BYTES_PER_WORD (2)
+#define FINS_POLL_MULTI_BYTES_PER_WORD (7)
+
+static int fins_poll_same_config(const fins_poll_plan_t *plan, const fins_poll_area_t *areas, int count)
+{
+	int i = 0;
+
+	if (plan->count != count)
+	{
+		return 0;
+	}
+	for (i = 0; i < count; i++)
+	{
+		if ((plan->areas[i].area != areas[i].area) || (plan->areas[i].offset != areas[i].offset)
+			|| (plan->areas[i].size != areas[i].size))
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+int fins_poll_configure(fins_poll_plan_t *plan, const fins_poll_area_t *areas, int count)
+{
+	int first = 0;
+	int last = 0;
+	int same_area = 1;
+	int i = 0;
+	int j = 0;
+	int k = 0;
+
+	if ((count > 0) && fins_poll_same_config(plan, areas, count))
+	{
+		return 0;
+	}
+
+	memset(plan, 0, sizeof(*plan));
+	if ((count <= 0) || (count > FINS_POLL_MAX_AREAS))
+	{
+		return -1;
+	}
+
+	first = areas[0].offset;
+	last = areas[0].offset + areas[0].size;
+	for (i = 0; i < count; i++)
+	{
+		if ((areas[i].size <= 0) || (areas[i].offset < 0) || (plan->total + areas[i].size > FINS_POLL_MAX_WORDS))
+		{
+			plan->count = 0;
+			return -1;
+		}
+		plan->areas[i] = areas[i];
+		plan->index[i] = plan->total;
+		plan->total += areas[i].size;
+		same_area = same_area && (areas[i].area == areas[0].area);
+		first = (areas[i].offset < first) ? areas[i].offset : first;
+		last = (areas[i].offset + areas[i].size > last) ? (areas[i].offset + areas[i].size) : last;
+	}
+	plan->count = count;
+	plan->range_offset = first;
+	plan->range_size = last - first;
+
+	if (same_area && (plan->range_size <= FINS_NET_MAX_WORDS)
+		&& (plan->range_size * FINS_POLL_RANGE_BYTES_PER_WORD <= plan->total * FINS_POLL_MULTI_BYTES_PER_WORD))
+	{
+		plan->method = FINS_POLL_RANGE;
+	}
+	else if (plan->total <= FINS_NET_MAX_MULTI)
+	{
+		plan->method = FINS_POLL_MULTI;
+		for (i = 0; i < count; i++)
+		{
+			for (j = 0; j < areas[i].size; j++)
+			{
+				plan->items[k].area = (uint8_t)areas[i].area;
+				plan->items[k].offset = (uint16_t)(areas[i].offset + j);
+				k++;
+			}
+		}
+	}
+	else
+	{
+		plan->method = FINS_POLL_SEPARATE;
+	}
+
+	return 0;
+}
+
+void fins_poll_invalidate(fins_poll_plan_t *plan)
+{
+	plan->valid = 0;
+}
+
+int fins_poll_read(fins_poll_plan_t *plan, fins_net_t *net, int timeout_ms)
+{
+	const fins_poll_area_t *area = NULL;
+	int changed = 0;
+	int ret = -1;
+	int i = 0;
+
+	if (plan->count <= 0)
+	{
+		return -1;
+	}
+
+	if (plan->method == FINS_POLL_RANGE)
+	{
+		ret = fins_net_read(net, plan->areas[0].area, plan->range_offset, plan->range_size, plan->range_buf, timeout_ms);
+		for (i = 0; (ret >= 0) && (i < plan->count); i++)
+		{
+			area = &plan->areas[i];
+			memcpy(&plan->words[plan->index[i]], &plan->range_buf[area->offset - plan->range_offset],
+				area->size * sizeof(uint16_t));
+		}
+	}
+	else if (plan->method == FINS_POLL_MULTI)
+	{
+		ret = fins_net_read_multi(net, plan->items, plan->total, plan->words, timeout_ms);
+	}
+	else
+	{
+		for (i = 0; i < plan->count; i++)
+		{
+			area = &plan->areas[i];
+			ret = fins_net_read(net, area->area, area->offset, area->size, &plan->words[plan->index[i]], timeout_ms);
+			if (ret < 0)
+			{
+				break;
+			}
+		}
+	}
+	if (ret < 0)
+	{
+		return -1;
+	}
+
+	for (i = 0; i < plan->count; i++)
+	{
+		if (!plan->valid || (memcmp(&plan->words[plan->index[i]], &plan->prev[plan->index[i]],
+			plan->areas[i].size * sizeof(uint16_t)) != 0))
+		{
+			changed |= (1 << i);
+		}
+	}
+	memcpy(plan->prev, plan->words, plan->total * sizeof(uint16_t));
+	plan->valid = 1;
+
+	return changed;
+}
+
+const uint16_t *fins_poll_data(const fins_poll_plan_t *plan, int i)
+{
+	return &plan->words[plan->index[i]];
+}
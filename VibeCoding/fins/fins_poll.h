@@ -0,0 +1,77 @@
+/** @file
+ * @brief Poll planner for the areas the FINS trigger thread reads every cycle.
+ *
+ * The configured areas (control word, instruction/userdata area) are fetched
+ * in as few round trips as possible:
+ *   - one memory area read (0101) over their whole span when they lie in the
+ *     same area close enough that reading the gap is cheaper than addressing
+ *     every word,
+ *   - otherwise one multiple memory area read (0104) when the words fit into
+ *     one frame,
+ *   - otherwise one 0101 read per area.
+ * After every read the areas are compared with the previous cycle, so the
+ * caller can skip the logic whose inputs did not change.
+ */
+
+#ifndef __FINS_POLL_H
+#define __FINS_POLL_H
+
+#include <stdint.h>
+
+#include "fins_net.h"
+
+#define FINS_POLL_MAX_AREAS (4)
+#define FINS_POLL_MAX_WORDS (256)
+
+#define FINS_POLL_RANGE (0)			// 整段0101读
+#define FINS_POLL_MULTI (1)			// 一帧0104复合读
+#define FINS_POLL_SEPARATE (2)		// 每个区域一帧0101读
+
+typedef struct
+{
+	int area;		// FINS区域码
+	int offset;
+	int size;		// 字数
+} fins_poll_area_t;
+
+typedef struct
+{
+	fins_poll_area_t areas[FINS_POLL_MAX_AREAS];
+	int index[FINS_POLL_MAX_AREAS];		// 区域在words中的起始位置
+	int count;
+	int total;							// 所有区域的字数
+	int method;							// FINS_POLL_*
+	int range_offset;
+	int range_size;
+	int valid;							// prev中是上一周期的数据
+	fins_net_word_t items[FINS_NET_MAX_MULTI];
+	uint16_t words[FINS_POLL_MAX_WORDS];
+	uint16_t prev[FINS_POLL_MAX_WORDS];
+	uint16_t range_buf[FINS_NET_MAX_WORDS];
+} fins_poll_plan_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Plans the reads for the given areas. Nothing happens while the areas are
+ * unchanged; a new plan starts without a previous cycle. Returns 0, or -1
+ * when there are too many areas or words.
+ */
+int fins_poll_configure(fins_poll_plan_t *plan, const fins_poll_area_t *areas, int count);
+
+/* The next read reports every area as changed, e.g. after a reconnect. */
+void fins_poll_invalidate(fins_poll_plan_t *plan);
+
+/* Reads all areas. Returns a mask with bit i set when area i changed since the last read, or -1. */
+int fins_poll_read(fins_poll_plan_t *plan, fins_net_t *net, int timeout_ms);
+
+/* Words of area i from the last read. */
+const uint16_t *fins_poll_data(const fins_poll_plan_t *plan, int i);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __FINS_POLL_H */
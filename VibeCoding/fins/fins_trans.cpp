@@ -63,6 +63,8 @@ CFinsTransModule::ModuleParamOptSet CFinsTransModule::m_stParamOptSet[] = {
 	{"ResultSize",			PINT,	 &CFinsTransModule::SetResultAddressSize, &CFinsTransModule::GetResultAddressSize, 0, 0, 0, 0},       
 	{"InstructionSize",		PINT,	 &CFinsTransModule::SetInstructionAddressSize, &CFinsTransModule::GetInstructionAddressSize, 0, 0, 0, 0},
 	{"ResultTimeout",		PINT,	 &CFinsTransModule::SetResultTimeout, &CFinsTransModule::GetResultTimeout, 0, 0, 0, 0},
+	{"PipelineDepth",		PINT,	 &CFinsTransModule::SetPipelineDepth, &CFinsTransModule::GetPipelineDepth, 0, 0, 0, 0},
+	{"TransportType",		PINT,	 &CFinsTransModule::SetTransportType, &CFinsTransModule::GetTransportType, 0, 0, 0, 0},
 	{"ResultByteSwap",		PBOOL,	 0, 0, 0, 0, &CFinsTransModule::SetByteOrderEnable, &CFinsTransModule::GetByteOrderEnable},
 	{INDUSTRIAL_DEBUG_LEVEL, PINT, &CFinsTransModule::SetIndustrialDebugLevel, &CFinsTransModule::GetIndustrialDebugLevel, 0, 0, 0, 0}
 };
@@ -428,6 +430,18 @@ int CFinsTransModule::SetResultTimeout(int nTimes)
 	return IMVS_EC_OK;
 }
 
+int CFinsTransModule::SetPipelineDepth(int nDepth)
+{
+	fins_para.pipeline_depth = nDepth;
+	return IMVS_EC_OK;
+}
+
+int CFinsTransModule::SetTransportType(int nType)
+{
+	fins_para.transport = nType;
+	return fins_set_recreate(1);
+}
+
 int CFinsTransModule::SetByteOrderEnable(bool nEnable)
 {
 	fins_para.result_byte_swap = (nEnable ? 1 : 0);
@@ -631,6 +645,18 @@ int CFinsTransModule::GetResultTimeout(int *pnTimes)
 	return IMVS_EC_OK;
 }
 
+int CFinsTransModule::GetPipelineDepth(int *pnDepth)
+{
+	*pnDepth = fins_para.pipeline_depth;
+	return IMVS_EC_OK;
+}
+
+int CFinsTransModule::GetTransportType(int *pnType)
+{
+	*pnType = fins_para.transport;
+	return IMVS_EC_OK;
+}
+
 int CFinsTransModule::GetByteOrderEnable(bool *pnEnable)
 {
 	*pnEnable = (fins_para.result_byte_swap ? true : false);
@@ -111,6 +111,8 @@ private:
 	int SetResultAddressSize(int nSize);    
     int SetInstructionAddressSize(int nSize);
 	int SetResultTimeout(int nTimes);
+	int SetPipelineDepth(int nDepth);
+	int SetTransportType(int nType);
 	int SetByteOrderEnable(bool nEnable);
 	int SetIndustrialDebugLevel(int nLevel);
 	
@@ -134,6 +136,8 @@ private:
     int GetInstructionAddressSize(int *pnSize);
 
 	int GetResultTimeout(int *pnTimes);
+	int GetPipelineDepth(int *pnDepth);
+	int GetTransportType(int *pnType);
 	int GetByteOrderEnable(bool *pnEnable);
 	int GetIndustrialDebugLevel(int *pnLevel);
 	int GetmoduParaHandle(IN const char* szParamName, OUT char* pBuff, IN int nBuffSize, OUT int* pDataLen);
@@ -0,0 +1,37 @@
+#include "FtpBackoff.h"
+
+FtpBackoff::FtpBackoff(uint64_t base_us, uint64_t cap_us, uint32_t seed)
+    : m_base_us(base_us == 0 ? 1 : base_us),
+      m_cap_us(cap_us < base_us ? base_us : cap_us),
+      m_failures(0),
+      m_state(seed == 0 ? 0x9e3779b9u : seed) {}
+
+uint64_t FtpBackoff::next() {
+  uint64_t delay = m_base_us;
+  for (uint32_t i = 0; i < m_failures && delay < m_cap_us; ++i) {
+    delay *= 2;
+  }
+  if (delay > m_cap_us) {
+    delay = m_cap_us;
+  }
+  ++m_failures;
+
+  const uint64_t half = delay / 2;
+  return delay - half + random() % (half + 1);
+}
+
+void FtpBackoff::reset() {
+  m_failures = 0;
+}
+
+uint32_t FtpBackoff::failures() const {
+  return m_failures;
+}
+
+uint32_t FtpBackoff::random() {
+  // xorshift32; only spreads retries, no need for a better generator.
+  m_state ^= m_state << 13;
+  m_state ^= m_state >> 17;
+  m_state ^= m_state << 5;
+  return m_state;
+}
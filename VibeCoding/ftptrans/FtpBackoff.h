@@ -0,0 +1,31 @@
+#ifndef FTP_BACKOFF_H
+#define FTP_BACKOFF_H
+
+#include <stdint.h>
+
+// Delay before the next login attempt after consecutive failures. The n-th
+// failure waits a random time in [d/2, d] with d = min(base * 2^(n-1), cap):
+// the first retry after a blip comes quickly, a server that stays down is
+// probed less and less often, and connections that failed together do not
+// retry in lockstep.
+//
+// Not thread-safe; each FTP session owns one.
+class FtpBackoff {
+ public:
+  FtpBackoff(uint64_t base_us, uint64_t cap_us, uint32_t seed);
+
+  // Records a failure and returns the delay before the next attempt.
+  uint64_t next();
+  void reset();
+  uint32_t failures() const;
+
+ private:
+  uint32_t random();
+
+  uint64_t m_base_us;
+  uint64_t m_cap_us;
+  uint32_t m_failures;
+  uint32_t m_state;
+};
+
+#endif
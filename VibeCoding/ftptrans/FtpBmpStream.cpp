@@ -0,0 +1,243 @@
+#include "FtpBmpStream.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define FTP_BMP_USE_NEON 1
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#define FTP_BMP_USE_SSSE3 1
+#endif
+
+const size_t FtpBmpStreamBuf::kStripBytes;
+
+namespace {
+
+const uint32_t kFileHeaderSize = 14;
+const uint32_t kInfoHeaderSize = 40;
+const uint32_t kPaletteSize = 256 * 4;
+
+void PutLe16(char *dst, uint16_t value) {
+  dst[0] = static_cast<char>(value & 0xff);
+  dst[1] = static_cast<char>((value >> 8) & 0xff);
+}
+
+void PutLe32(char *dst, uint32_t value) {
+  PutLe16(dst, static_cast<uint16_t>(value & 0xffff));
+  PutLe16(dst + 2, static_cast<uint16_t>(value >> 16));
+}
+
+}  // namespace
+
+void FtpBmpInterleaveBgr(const uint8_t *b, const uint8_t *g, const uint8_t *r, uint8_t *dst,
+                         uint32_t width) {
+  uint32_t x = 0;
+#if defined(FTP_BMP_USE_NEON)
+  for (; x + 16 <= width; x += 16) {
+    uint8x16x3_t bgr;
+    bgr.val[0] = vld1q_u8(b + x);
+    bgr.val[1] = vld1q_u8(g + x);
+    bgr.val[2] = vld1q_u8(r + x);
+    vst3q_u8(dst + x * 3, bgr);
+  }
+#elif defined(FTP_BMP_USE_SSSE3)
+  const __m128i b0 = _mm_setr_epi8(0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1, 5);
+  const __m128i b1 = _mm_setr_epi8(-1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10, -1);
+  const __m128i b2 = _mm_setr_epi8(-1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1, -1);
+  const __m128i g0 = _mm_setr_epi8(-1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1);
+  const __m128i g1 = _mm_setr_epi8(5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10);
+  const __m128i g2 = _mm_setr_epi8(-1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1);
+  const __m128i r0 = _mm_setr_epi8(-1, -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1);
+  const __m128i r1 = _mm_setr_epi8(-1, 5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1);
+  const __m128i r2 = _mm_setr_epi8(10, -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15);
+  for (; x + 16 <= width; x += 16) {
+    const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + x));
+    const __m128i vg = _mm_loadu_si128(reinterpret_cast<const __m128i *>(g + x));
+    const __m128i vr = _mm_loadu_si128(reinterpret_cast<const __m128i *>(r + x));
+    __m128i *out = reinterpret_cast<__m128i *>(dst + x * 3);
+    _mm_storeu_si128(out, _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(vb, b0), _mm_shuffle_epi8(vg, g0)),
+                                       _mm_shuffle_epi8(vr, r0)));
+    _mm_storeu_si128(out + 1, _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(vb, b1), _mm_shuffle_epi8(vg, g1)),
+                                           _mm_shuffle_epi8(vr, r1)));
+    _mm_storeu_si128(out + 2, _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(vb, b2), _mm_shuffle_epi8(vg, g2)),
+                                           _mm_shuffle_epi8(vr, r2)));
+  }
+#endif
+  for (; x < width; ++x) {
+    dst[x * 3 + 0] = b[x];
+    dst[x * 3 + 1] = g[x];
+    dst[x * 3 + 2] = r[x];
+  }
+}
+
+FtpBmpStreamBuf::FtpBmpStreamBuf()
+    : m_data(nullptr),
+      m_width(0),
+      m_height(0),
+      m_planar_rgb(false),
+      m_row_bytes(0),
+      m_row_stride(0),
+      m_rows_per_strip(0),
+      m_header_size(0),
+      m_file_size(0),
+      m_base(0),
+      m_encode_ns(0) {}
+
+bool FtpBmpStreamBuf::reset(const uint8_t *data, size_t len, uint32_t width, uint32_t height,
+                            bool planar_rgb) {
+  m_data = nullptr;
+  m_file_size = 0;
+  m_base = 0;
+  m_encode_ns = 0;
+  setg(nullptr, nullptr, nullptr);
+
+  const uint64_t channels = planar_rgb ? 3 : 1;
+  const uint64_t row_bytes = static_cast<uint64_t>(width) * channels;
+  const uint64_t row_stride = (row_bytes + 3) / 4 * 4;
+  const uint64_t header_size = kFileHeaderSize + kInfoHeaderSize + (planar_rgb ? 0 : kPaletteSize);
+  const uint64_t file_size = header_size + row_stride * height;
+  if (data == nullptr || width == 0 || height == 0 || len < row_bytes * height ||
+      file_size > 0xffffffffULL) {
+    return false;
+  }
+
+  m_data = data;
+  m_width = width;
+  m_height = height;
+  m_planar_rgb = planar_rgb;
+  m_row_bytes = static_cast<uint32_t>(row_bytes);
+  m_row_stride = static_cast<uint32_t>(row_stride);
+  m_rows_per_strip = static_cast<uint32_t>(std::max<uint64_t>(1, kStripBytes / row_stride));
+  m_rows_per_strip = std::min(m_rows_per_strip, height);
+  m_header_size = static_cast<uint32_t>(header_size);
+  m_file_size = file_size;
+
+  // Same layout as mono8_2_bmp: 8-bit grey palette for mono, none for 24-bit.
+  m_header.assign(m_header_size, 0);
+  char *h = &m_header[0];
+  PutLe16(h, 0x4D42);
+  PutLe32(h + 2, static_cast<uint32_t>(file_size));
+  PutLe32(h + 10, m_header_size);
+  PutLe32(h + 14, kInfoHeaderSize);
+  PutLe32(h + 18, width);
+  PutLe32(h + 22, height);
+  PutLe16(h + 26, 1);
+  PutLe16(h + 28, static_cast<uint16_t>(channels * 8));
+  if (!planar_rgb) {
+    char *palette = h + kFileHeaderSize + kInfoHeaderSize;
+    for (int i = 0; i < 256; ++i) {
+      palette[i * 4 + 0] = static_cast<char>(i);
+      palette[i * 4 + 1] = static_cast<char>(i);
+      palette[i * 4 + 2] = static_cast<char>(i);
+    }
+  }
+
+  const size_t strip_size = static_cast<size_t>(m_rows_per_strip) * m_row_stride;
+  if (m_strip.size() < strip_size) {
+    m_strip.resize(strip_size);
+  }
+
+  load(0);
+  return true;
+}
+
+uint64_t FtpBmpStreamBuf::fileSize() const {
+  return m_file_size;
+}
+
+uint64_t FtpBmpStreamBuf::encodeNs() const {
+  return m_encode_ns;
+}
+
+FtpBmpStreamBuf::int_type FtpBmpStreamBuf::underflow() {
+  if (gptr() == egptr()) {
+    load(m_base + static_cast<uint64_t>(egptr() - eback()));
+  }
+  if (gptr() == egptr()) {
+    return traits_type::eof();
+  }
+  return traits_type::to_int_type(*gptr());
+}
+
+std::streamsize FtpBmpStreamBuf::showmanyc() {
+  const uint64_t pos = m_base + static_cast<uint64_t>(gptr() - eback());
+  return pos < m_file_size ? static_cast<std::streamsize>(m_file_size - pos) : -1;
+}
+
+FtpBmpStreamBuf::pos_type FtpBmpStreamBuf::seekoff(off_type off, std::ios_base::seekdir dir,
+                                                   std::ios_base::openmode which) {
+  if ((which & std::ios_base::in) == 0 || m_data == nullptr) {
+    return pos_type(off_type(-1));
+  }
+
+  off_type base = 0;
+  if (dir == std::ios_base::cur) {
+    base = static_cast<off_type>(m_base + (gptr() - eback()));
+  } else if (dir == std::ios_base::end) {
+    base = static_cast<off_type>(m_file_size);
+  }
+
+  const off_type target = base + off;
+  if (target < 0 || static_cast<uint64_t>(target) > m_file_size) {
+    return pos_type(off_type(-1));
+  }
+
+  const uint64_t pos = static_cast<uint64_t>(target);
+  if (pos < m_base || pos > m_base + static_cast<uint64_t>(egptr() - eback())) {
+    load(pos);
+  } else {
+    setg(eback(), eback() + (pos - m_base), egptr());
+  }
+  return pos_type(target);
+}
+
+FtpBmpStreamBuf::pos_type FtpBmpStreamBuf::seekpos(pos_type pos, std::ios_base::openmode which) {
+  return seekoff(off_type(pos), std::ios_base::beg, which);
+}
+
+void FtpBmpStreamBuf::load(uint64_t pos) {
+  if (pos >= m_file_size) {
+    char *end = m_strip.empty() ? nullptr : &m_strip[0];
+    setg(end, end, end);
+    m_base = m_file_size;
+    return;
+  }
+
+  if (pos < m_header_size) {
+    char *begin = &m_header[0];
+    setg(begin, begin + pos, begin + m_header_size);
+    m_base = 0;
+    return;
+  }
+
+  const uint32_t row = static_cast<uint32_t>((pos - m_header_size) / m_row_stride);
+  const uint32_t first_row = row - row % m_rows_per_strip;
+  const uint32_t rows = std::min(m_rows_per_strip, m_height - first_row);
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  encodeRows(first_row, rows, reinterpret_cast<uint8_t *>(&m_strip[0]));
+  m_encode_ns += static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+
+  m_base = m_header_size + static_cast<uint64_t>(first_row) * m_row_stride;
+  char *begin = &m_strip[0];
+  setg(begin, begin + (pos - m_base), begin + static_cast<size_t>(rows) * m_row_stride);
+}
+
+void FtpBmpStreamBuf::encodeRows(uint32_t first_row, uint32_t rows, uint8_t *dst) const {
+  const size_t plane = static_cast<size_t>(m_width) * m_height;
+  for (uint32_t i = 0; i < rows; ++i, dst += m_row_stride) {
+    // BMP rows are stored bottom-up.
+    const size_t src_row = static_cast<size_t>(m_height - 1 - (first_row + i)) * m_width;
+    if (m_planar_rgb) {
+      FtpBmpInterleaveBgr(m_data + 2 * plane + src_row, m_data + plane + src_row, m_data + src_row,
+                          dst, m_width);
+    } else {
+      memcpy(dst, m_data + src_row, m_width);
+    }
+    memset(dst + m_row_bytes, 0, m_row_stride - m_row_bytes);
+  }
+}
@@ -0,0 +1,88 @@
+#ifndef FTP_BMP_STREAM_H
+#define FTP_BMP_STREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <istream>
+#include <streambuf>
+#include <vector>
+
+// Read-only streambuf that encodes a raw frame as BMP while it is read.
+//
+// The header is emitted first, then bottom-up rows are produced in strips of
+// roughly kStripBytes: mono rows are copied, planar RGB rows are interleaved
+// into BGR. The source frame is never modified, so a failed upload can simply
+// be rewound and read again. The caller must keep the frame alive until the
+// stream is reset or destroyed.
+class FtpBmpStreamBuf : public std::streambuf {
+ public:
+  static const size_t kStripBytes = 64 * 1024;
+
+  FtpBmpStreamBuf();
+
+  // `planar_rgb` selects three consecutive width*height planes in R, G, B
+  // order; otherwise the frame is 8-bit mono. Returns false if the frame is
+  // too short or the BMP would not fit the 32-bit size fields.
+  bool reset(const uint8_t *data, size_t len, uint32_t width, uint32_t height, bool planar_rgb);
+
+  uint64_t fileSize() const;
+  // Time spent converting rows since the last reset, for upload telemetry.
+  uint64_t encodeNs() const;
+
+ protected:
+  int_type underflow() override;
+  std::streamsize showmanyc() override;
+  pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                   std::ios_base::openmode which) override;
+  pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+
+ private:
+  void load(uint64_t pos);
+  void encodeRows(uint32_t first_row, uint32_t rows, uint8_t *dst) const;
+
+  const uint8_t *m_data;
+  uint32_t m_width;
+  uint32_t m_height;
+  bool m_planar_rgb;
+  uint32_t m_row_bytes;
+  uint32_t m_row_stride;
+  uint32_t m_rows_per_strip;
+  uint32_t m_header_size;
+  uint64_t m_file_size;
+  uint64_t m_base;
+  uint64_t m_encode_ns;
+  std::vector<char> m_header;
+  std::vector<char> m_strip;
+};
+
+// istream bound to an FtpBmpStreamBuf, kept per connection like FtpSlotIStream.
+class FtpBmpIStream : public std::istream {
+ public:
+  FtpBmpIStream() : std::istream(nullptr) {
+    rdbuf(&m_buf);
+  }
+
+  bool reset(const uint8_t *data, size_t len, uint32_t width, uint32_t height, bool planar_rgb) {
+    const bool ok = m_buf.reset(data, len, width, height, planar_rgb);
+    clear();
+    return ok;
+  }
+
+  uint64_t fileSize() const {
+    return m_buf.fileSize();
+  }
+
+  uint64_t encodeNs() const {
+    return m_buf.encodeNs();
+  }
+
+ private:
+  FtpBmpStreamBuf m_buf;
+};
+
+// Writes `width` pixels as B, G, R triplets. Exposed for the unit test.
+void FtpBmpInterleaveBgr(const uint8_t *b, const uint8_t *g, const uint8_t *r, uint8_t *dst,
+                         uint32_t width);
+
+#endif
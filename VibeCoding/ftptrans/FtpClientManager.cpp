@@ -25,7 +25,6 @@
 #include "FtpClientManager.h"
 #include "FtpClientMonitor.h"
 #include "mm.h"
-#include "bmp.h"
 #include "net.h"
 #include "utils.h"
 #include "algo_common.h"
@@ -35,7 +34,6 @@
 #include "thread/ThreadApi.h"
 #include "adapter/ScheErrorCodeDefine.h"
 #include "log/log.h"
-#include "raw.h"
 
 #define FTP_CFG_ADDR_OK                                      0
 #define FTP_CFG_PORT_OK                                      1
@@ -52,6 +50,10 @@ namespace {
 
 const char kTextDefaultFileName[] = "result";
 
+const uint64_t kTransferRetryUs = 100 * 1000ULL;			// 文本/日志上传失败但连接仍在时的重试间隔
+const uint64_t kSpoolReopenIntervalUs = 10 * 1000000ULL;	// spool目录不可用(如未插卡)时的重试间隔
+const uint64_t kSpoolRateWindowUs = 1000000ULL;				// 回放速率统计窗口
+
 std::string StripKnownTextExtension(const std::string& file_name)
 {
 	std::string lower(file_name);
@@ -87,31 +89,35 @@ void ReplaceIllegalFileNameChars(std::string& file_name)
 
 }  // namespace
 
-void* ftpClientProcThread(void* argv)
-{
-	FtpClientManager* instance = (FtpClientManager*)argv;
-	instance->ftpClientProc();
-	return nullptr;
-}
-
 FtpClientManager::FtpClientManager()
 	: m_nLogId(0),
-	  m_nImgDataSize(0),
-	  m_nConvertBufSize(0),
-	  m_pConvertImageBuf(nullptr),
-	  m_fifoArray(nullptr),
-	  m_bRunning(false),
-	  m_bNeedRelogin(false),
-	  m_bEnd(false),
-	  m_bRootDirChange(true),
+	  m_bLogIdSet(false),
+	  m_nConnectionCount(1),
+	  m_bStandbyEnable(false),
+	  m_nConnectTimeoutMs(3000),
+	  m_bInited(false),
+	  m_nOverflowPolicy(FTP_OVERFLOW_DROP_NEWEST),
+	  m_nBlockTimeoutMs(20),
+	  m_bSpoolEnable(false),
+	  m_bSpoolConfigChanged(false),
+	  m_nSpoolMedia(STORAGE_MEDIA_EMMC),
+	  m_nSpoolMaxSizeMB(256),
+	  m_nSpoolReplayRateKB(2048),
+	  m_nSpoolReplayBps(0),
+	  m_nSpoolRetryOpenUs(0),
+	  m_nSpoolLastReplayUs(0),
+	  m_nSpoolLastReplayBytes(0),
+	  m_nSpoolWindowStartUs(0),
+	  m_nSpoolWindowBytes(0),
 	  m_bTextTransferEnable(false),
 	  m_bTextTimestampEnable(false),
 	  m_eTextFileFormat(TEXT_FILE_FORMAT_TXT),
 	  m_strTextFileName(kTextDefaultFileName),
 	  m_textCache(10000),
-	  m_bPendingTextUpload(false)
+	  m_bPendingTextUpload(false),
+	  m_nPendingTextUploadId(0)
 {
-	memset(&m_queue, 0, sizeof(m_queue));
+	memset(&m_spoolResolved, 0, sizeof(m_spoolResolved));
 }
 
 FtpClientManager::~FtpClientManager()
@@ -122,9 +128,90 @@ FtpClientManager::~FtpClientManager()
 void FtpClientManager::setLogId(int nLogId)
 {
 	m_nLogId = nLogId;
+	m_bLogIdSet = true;
+
+	std::shared_ptr<FtpConnectionHub> pHub = hub();
+	if (pHub)
+	{
+		pHub->setLogId(nLogId);
+	}
+}
+
+std::shared_ptr<FtpConnectionHub> FtpClientManager::hub()
+{
+	std::lock_guard<std::mutex> lock(m_hubMutex);
+	return m_hub;
+}
+
+void FtpClientManager::notifyHub()
+{
+	std::shared_ptr<FtpConnectionHub> pHub = hub();
+	if (pHub)
+	{
+		pHub->notify();
+	}
+}
+
+int FtpClientManager::attachHub()
+{
+	if (FTP_CFG_ALL_OK != (m_cfgInfo.cfgState & FTP_CFG_ALL_OK))
+	{
+		LOGD("FTP client incomplete cfg.\n");
+		return IMVS_EC_OK;
+	}
+
+	FtpServerConfig stConfig;
+	stConfig.addr = m_cfgInfo.addr;
+	stConfig.port = m_cfgInfo.port;
+	stConfig.username = m_cfgInfo.username;
+	stConfig.password = m_cfgInfo.password;
+	stConfig.anonymousLogin = m_cfgInfo.anonymousLogin;
+
+	// 服务器参数相同的模块共用登录会话和槽位, 第一个模块挂接时创建连接池
+	std::shared_ptr<FtpConnectionHub> pHub = FtpConnectionHub::acquire(stConfig);
+	if (!pHub)
+	{
+		LOGE("ftp connection hub for %s:%u unavailable\n", stConfig.addr.c_str(), stConfig.port);
+		return IMVS_EC_OUTOFMEMORY;
+	}
+
+	pHub->attach(this);
+	if (m_bLogIdSet)
+	{
+		pHub->setLogId(m_nLogId);
+	}
+
+	std::lock_guard<std::mutex> lock(m_hubMutex);
+	m_hub = pHub;
+	return IMVS_EC_OK;
+}
+
+void FtpClientManager::detachHub()
+{
+	std::shared_ptr<FtpConnectionHub> pHub;
+	{
+		std::lock_guard<std::mutex> lock(m_hubMutex);
+		pHub.swap(m_hub);
+	}
+
+	// 最后一个模块摘除后pHub析构, 连接池在此退出登录并释放槽位内存
+	if (pHub)
+	{
+		pHub->detach(this);
+	}
+}
+
+void FtpClientManager::rebindHub()
+{
+	// 服务器参数变化后换到对应的连接池, 原连接池上的其他模块不受影响
+	std::lock_guard<std::mutex> lock(m_bindMutex);
+	if (!m_bInited)
+	{
+		return;
+	}
 
-	std::string logFile = "/mnt/log/" + std::to_string(nLogId) + "ftp.log";
-	m_ftpClient.add_observer(std::make_shared<FtpMonitor>(logFile));
+	detachHub();
+	attachHub();
 }
 
 int FtpClientManager::enqueueFtpData(const struct FtpFifoParam *data)
@@ -135,29 +222,215 @@ int FtpClientManager::enqueueFtpData(const struct FtpFifoParam *data)
 		return IMVS_EC_NULL_PTR;
 	}
 
-	std::lock_guard<std::mutex> lock(m_queueMutex);
-	struct FtpFifoParam *param = (struct FtpFifoParam*)sfifo_in_addr(&m_queue);
-	if (NULL == param)
+	// 日志文件不占用图像槽位, 走控制连接的日志队列
+	if (TO_LOG == data->type)
+	{
+		return enqueueLogFile(data->fileName);
+	}
+
+	std::shared_ptr<FtpConnectionHub> pHub = hub();
+	if (!pHub)
+	{
+		return IMVS_EC_NULL_PTR;
+	}
+
+	return pHub->enqueue(this, data, m_nOverflowPolicy, m_nBlockTimeoutMs);
+}
+
+int FtpClientManager::enqueueLogFile(const char* szPath)
+{
+	std::lock_guard<std::mutex> lock(m_taskMutex);
+	if (m_logFileQueue.size() >= (size_t)FTP_LOG_QUEUE_DEPTH)
 	{
 		return IMVS_EC_NULL_PTR;
 	}
 
-	param->usedLen = data->usedLen;
-	param->type = data->type;
-	snprintf(param->fileName, FILE_NAME_MAXSIZE, "%s", data->fileName);
-	snprintf(param->dirName, DIR_NAME_MAXSIZE, "%s", data->dirName);
+	m_logFileQueue.push_back(szPath);
+	notifyHub();
+	return IMVS_EC_OK;
+}
+
+void FtpClientManager::setQueueOverflowPolicy(int nPolicy)
+{
+	if (nPolicy < FTP_OVERFLOW_DROP_NEWEST || nPolicy > FTP_OVERFLOW_BLOCK)
+	{
+		LOGW("invalid ftp queue overflow policy:%d\n", nPolicy);
+		return;
+	}
+
+	m_nOverflowPolicy = nPolicy;
+}
+
+void FtpClientManager::setQueueBlockTimeoutMs(int nTimeoutMs)
+{
+	m_nBlockTimeoutMs = (nTimeoutMs < 0) ? 0 : nTimeoutMs;
+}
+
+int FtpClientManager::getDirCacheStats(char* pBuff, int nBuffSize, int* pDataLen)
+{
+	if (nullptr == pBuff || nBuffSize <= 0 || nullptr == pDataLen)
+	{
+		return IMVS_EC_PARAM;
+	}
+
+	// 目录缓存属于共用的连接, 统计的是同一连接池上所有模块的命中
+	unsigned long long ullHits = 0;
+	unsigned long long ullMisses = 0;
+	std::shared_ptr<FtpConnectionHub> pHub = hub();
+	if (pHub)
+	{
+		pHub->dirCacheStats(&ullHits, &ullMisses);
+	}
+
+	snprintf(pBuff, nBuffSize, "{\"hits\":%llu,\"misses\":%llu}", ullHits, ullMisses);
+	*pDataLen = strlen(pBuff);
+
+	return IMVS_EC_OK;
+}
+
+int FtpClientManager::getUploadStats(char* pBuff, int nBuffSize, int* pDataLen)
+{
+	if (nullptr == pBuff || nBuffSize <= 0 || nullptr == pDataLen)
+	{
+		return IMVS_EC_PARAM;
+	}
+
+	m_uploadStats.formatJson(pBuff, nBuffSize);
+	*pDataLen = strlen(pBuff);
+
+	return IMVS_EC_OK;
+}
+
+int FtpClientManager::getDebugInfo(char* pBuff, int nBuffSize, int* pDataLen)
+{
+	if (nullptr == pBuff || nBuffSize <= 0 || nullptr == pDataLen)
+	{
+		return IMVS_EC_PARAM;
+	}
+
+	char szQueue[768] = {0};
+	char szDirCache[128] = {0};
+	char szUpload[1024] = {0};
+	char szSpool[512] = {0};
+	int nLen = 0;
+	getQueueStats(szQueue, sizeof(szQueue), &nLen);
+	getDirCacheStats(szDirCache, sizeof(szDirCache), &nLen);
+	getUploadStats(szUpload, sizeof(szUpload), &nLen);
+	getSpoolStats(szSpool, sizeof(szSpool), &nLen);
+
+	snprintf(pBuff, nBuffSize, "{\"queue\":%s,\"dir_cache\":%s,\"upload\":%s,\"spool\":%s}",
+		szQueue, szDirCache, szUpload, szSpool);
+	*pDataLen = strlen(pBuff);
 
-	param->image.format = data->image.format;
-	param->image.width = data->image.width;
-	param->image.height = data->image.height;
-	param->image.step[0] = data->image.step[0];
-	memcpy(param->image.data[0], data->image.data[0], data->usedLen);
+	return IMVS_EC_OK;
+}
+
+int FtpClientManager::getQueueStats(char* pBuff, int nBuffSize, int* pDataLen)
+{
+	if (nullptr == pBuff || nBuffSize <= 0 || nullptr == pDataLen)
+	{
+		return IMVS_EC_PARAM;
+	}
+
+	static const char* s_szPolicyName[] = {"drop_newest", "drop_oldest", "block"};
+	int nPolicy = m_nOverflowPolicy;
+
+	// used/high_water/enqueued及丢帧计数只统计本模块, depth/capacity_bytes/in_flight/pool_*为共用帧缓冲
+	FtpSlotRingStats stPool;
+	memset(&stPool, 0, sizeof(stPool));
+	stPool.depth = FTP_FIFO_DEPTH;
+	size_t nShare = 0;
+	size_t nTenants = 0;
+	std::shared_ptr<FtpConnectionHub> pHub = hub();
+	if (pHub)
+	{
+		stPool = pHub->poolStats();
+		nShare = pHub->fairShare();
+		nTenants = pHub->tenantCount();
+	}
+
+	snprintf(pBuff, nBuffSize,
+		"{\"policy\":\"%s\",\"depth\":%zu,\"capacity_bytes\":%zu,\"share_bytes\":%zu,\"tenants\":%zu,"
+		"\"used\":%zu,\"used_bytes\":%zu,\"in_flight\":%zu,\"high_water\":%zu,\"enqueued\":%llu,"
+		"\"dropped_newest\":%llu,\"dropped_oldest\":%llu,\"block_timeouts\":%llu,\"pool_used\":%zu,"
+		"\"pool_used_bytes\":%zu,\"pool_high_water\":%zu,\"pool_high_water_bytes\":%zu}",
+		s_szPolicyName[nPolicy], stPool.depth, stPool.capacity_bytes, nShare, nTenants,
+		m_tenantQueue.held.load(), m_tenantQueue.heldBytes.load(), stPool.in_flight,
+		m_tenantQueue.highWater.load(), (unsigned long long)m_tenantQueue.enqueued.load(),
+		(unsigned long long)m_tenantQueue.droppedNewest.load(), (unsigned long long)m_tenantQueue.droppedOldest.load(),
+		(unsigned long long)m_tenantQueue.blockTimeouts.load(), stPool.used, stPool.used_bytes,
+		stPool.high_water, stPool.high_water_bytes);
+	*pDataLen = strlen(pBuff);
+
+	return IMVS_EC_OK;
+}
+
+int FtpClientManager::getSpoolStats(char* pBuff, int nBuffSize, int* pDataLen)
+{
+	if (nullptr == pBuff || nBuffSize <= 0 || nullptr == pDataLen)
+	{
+		return IMVS_EC_PARAM;
+	}
 
-	sfifo_in_skip(&m_queue);
+	FtpSpoolStats stats = m_spool.stats();
+	int nRateKB = m_nSpoolReplayRateKB;
+
+	snprintf(pBuff, nBuffSize,
+		"{\"enabled\":%d,\"open\":%d,\"media\":\"%s\",\"records\":%llu,\"bytes\":%llu,\"disk_bytes\":%llu,"
+		"\"max_bytes\":%llu,\"appended\":%llu,\"replayed\":%llu,\"evicted\":%llu,\"corrupted\":%llu,"
+		"\"append_failures\":%llu,\"replay_limit_bps\":%llu,\"replay_bps\":%llu}",
+		m_bSpoolEnable ? 1 : 0, (stats.max_bytes > 0) ? 1 : 0,
+		storage_media_to_string((StorageMedia)m_nSpoolMedia.load()),
+		(unsigned long long)stats.records, (unsigned long long)stats.bytes,
+		(unsigned long long)stats.disk_bytes, (unsigned long long)stats.max_bytes,
+		(unsigned long long)stats.appended, (unsigned long long)stats.replayed,
+		(unsigned long long)stats.evicted, (unsigned long long)stats.corrupted,
+		(unsigned long long)stats.append_failures, (unsigned long long)nRateKB * 1024,
+		(unsigned long long)m_nSpoolReplayBps.load());
+	*pDataLen = strlen(pBuff);
 
 	return IMVS_EC_OK;
 }
 
+void FtpClientManager::setSpoolEnable(bool enable)
+{
+	m_bSpoolEnable = enable;
+	m_bSpoolConfigChanged = true;
+	notifyHub();
+}
+
+void FtpClientManager::setSpoolMedia(int nMedia)
+{
+	if (nMedia != STORAGE_MEDIA_EMMC && nMedia != STORAGE_MEDIA_MICROSD)
+	{
+		LOGW("invalid ftp spool media:%d\n", nMedia);
+		return;
+	}
+
+	m_nSpoolMedia = nMedia;
+	m_bSpoolConfigChanged = true;
+	notifyHub();
+}
+
+void FtpClientManager::setSpoolMaxSizeMB(int nSizeMB)
+{
+	if (nSizeMB <= 0)
+	{
+		LOGW("invalid ftp spool size:%d\n", nSizeMB);
+		return;
+	}
+
+	m_nSpoolMaxSizeMB = nSizeMB;
+	m_bSpoolConfigChanged = true;
+	notifyHub();
+}
+
+void FtpClientManager::setSpoolReplayRateKB(int nRateKB)
+{
+	m_nSpoolReplayRateKB = (nRateKB < 0) ? 0 : nRateKB;
+	notifyHub();
+}
+
 void FtpClientManager::setTextTransEnable(bool enable)
 {
 	std::lock_guard<std::mutex> lock(m_txtMutex);
@@ -169,9 +442,7 @@ void FtpClientManager::setTextTransEnable(bool enable)
 	m_bTextTransferEnable = enable;
 	m_textCache.clear();
 	m_textUploadController.reset();
-	m_bPendingTextUpload = false;
-	m_pendingTextUploadContent.clear();
-	m_pendingTextUploadFileName.clear();
+	clearPendingTextUploadLocked();
 	if (enable)
 	{
 		queueTextDeleteLocked(buildTextRemoteFileNameLocked());
@@ -218,9 +489,31 @@ void FtpClientManager::setTextFileFormat(int format)
 	m_eTextFileFormat = new_format;
 	m_textCache.clear();
 	m_textUploadController.reset();
-	m_bPendingTextUpload = false;
-	m_pendingTextUploadContent.clear();
-	m_pendingTextUploadFileName.clear();
+	clearPendingTextUploadLocked();
+	queueTextDeleteLocked(old_remote_file);
+}
+
+void FtpClientManager::setTextUploadMode(int mode)
+{
+	if (mode < TEXT_UPLOAD_FULL_REWRITE || mode > TEXT_UPLOAD_APPEND)
+	{
+		LOGW("invalid text upload mode:%d\n", mode);
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_txtMutex);
+	const TextUploadMode new_mode = static_cast<TextUploadMode>(mode);
+	if (m_textUploadController.uploadMode() == new_mode)
+	{
+		return;
+	}
+
+	// JSON追加模式使用不同扩展名, 与切换格式一样先删除旧文件再重新累计
+	const std::string old_remote_file = buildTextRemoteFileNameLocked();
+	m_textUploadController.setUploadMode(new_mode);
+	m_textCache.clear();
+	m_textUploadController.reset();
+	clearPendingTextUploadLocked();
 	queueTextDeleteLocked(old_remote_file);
 }
 
@@ -271,9 +564,7 @@ void FtpClientManager::resetTextTransferState(bool delete_remote_file)
 	std::lock_guard<std::mutex> lock(m_txtMutex);
 	m_textCache.clear();
 	m_textUploadController.reset();
-	m_bPendingTextUpload = false;
-	m_pendingTextUploadContent.clear();
-	m_pendingTextUploadFileName.clear();
+	clearPendingTextUploadLocked();
 	if (delete_remote_file)
 	{
 		queueTextDeleteLocked(buildTextRemoteFileNameLocked());
@@ -316,8 +607,8 @@ void FtpClientManager::setAnonymousLogin(bool enable)
 
 	if (enable != m_cfgInfo.anonymousLogin)
 	{
-		m_bNeedRelogin = true;
 		m_cfgInfo.anonymousLogin = enable;
+		rebindHub();
 	}
 }
 
@@ -333,8 +624,8 @@ void FtpClientManager::setUsername(const char *username)
 
 	if (std::string(username) != m_cfgInfo.username)
 	{
-		m_bNeedRelogin = true;
 		m_cfgInfo.username = std::string(username);
+		rebindHub();
 	}
 }
 
@@ -350,8 +641,8 @@ void FtpClientManager::setPassword(const char *password)
 
 	if (std::string(password) != m_cfgInfo.password)
 	{
-		m_bNeedRelogin = true;
 		m_cfgInfo.password = std::string(password);
+		rebindHub();
 	}
 }
 
@@ -368,8 +659,8 @@ void FtpClientManager::setAddr(const char *strAddr)
 
 	if (std::string(strAddr) != m_cfgInfo.addr)
 	{
-		m_bNeedRelogin = true;
 		m_cfgInfo.addr = std::string(strAddr);
+		rebindHub();
 	}
 }
 
@@ -379,15 +670,64 @@ void FtpClientManager::setPort(unsigned short port)
 
 	if (port != m_cfgInfo.port)
 	{
-		m_bNeedRelogin = true;
 		m_cfgInfo.port = port;
+		rebindHub();
 	}
 }
 
 void FtpClientManager::setRootDir(const char* szPath)
 {
+	// 上传时按当前根目录拼接绝对路径, 已确认的目录命中缓存, 不需要通知连接
+	std::lock_guard<std::mutex> lock(m_rootDirMutex);
 	m_strRootDirClient = szPath;
-	m_bRootDirChange = true;
+}
+
+std::string FtpClientManager::rootDirClient()
+{
+	std::lock_guard<std::mutex> lock(m_rootDirMutex);
+	return m_strRootDirClient;
+}
+
+void FtpClientManager::setConnectionCount(int nCount)
+{
+	if (nCount < 1 || nCount > FTP_MAX_CONNECTIONS)
+	{
+		LOGW("invalid ftp connection count:%d\n", nCount);
+		return;
+	}
+
+	m_nConnectionCount = nCount;
+	std::shared_ptr<FtpConnectionHub> pHub = hub();
+	if (pHub)
+	{
+		pHub->updateOptions();
+	}
+}
+
+void FtpClientManager::setStandbyEnable(bool enable)
+{
+	m_bStandbyEnable = enable;
+	std::shared_ptr<FtpConnectionHub> pHub = hub();
+	if (pHub)
+	{
+		pHub->updateOptions();
+	}
+}
+
+void FtpClientManager::setConnectTimeoutMs(int nTimeoutMs)
+{
+	if (nTimeoutMs < 100 || nTimeoutMs > 60000)
+	{
+		LOGW("invalid ftp connect timeout:%d ms\n", nTimeoutMs);
+		return;
+	}
+
+	m_nConnectTimeoutMs = nTimeoutMs;
+	std::shared_ptr<FtpConnectionHub> pHub = hub();
+	if (pHub)
+	{
+		pHub->updateOptions();
+	}
 }
 
 std::string FtpClientManager::normalizeTextFileName(const std::string& file_name)
@@ -428,7 +768,7 @@ bool FtpClientManager::buildTextRecord(const std::string& text, TextRecord& reco
 
 std::string FtpClientManager::buildTextRemoteFileNameLocked() const
 {
-	return m_strTextFileName + TextResultSerializer::extension(m_eTextFileFormat);
+	return m_strTextFileName + TextResultSerializer::extension(m_eTextFileFormat, m_textUploadController.uploadMode());
 }
 
 void FtpClientManager::queueTextDeleteLocked(const std::string& remote_file_name)
@@ -442,129 +782,69 @@ void FtpClientManager::queueTextDeleteLocked(const std::string& remote_file_name
 		== m_pendingTextDeleteFiles.end())
 	{
 		m_pendingTextDeleteFiles.push_back(remote_file_name);
+		notifyHub();
 	}
 }
 
 void FtpClientManager::queueTextUploadLocked()
 {
-	const TextSnapshot snapshot = m_textCache.snapshot();
-	m_pendingTextUploadFileName = buildTextRemoteFileNameLocked();
-	m_pendingTextUploadContent = TextResultSerializer::serialize(snapshot, m_eTextFileFormat, m_bTextTimestampEnable);
-	m_bPendingTextUpload = !m_pendingTextUploadFileName.empty() && !m_pendingTextUploadContent.empty();
+	const std::string remote_file = buildTextRemoteFileNameLocked();
+	const TextUploadPlan plan = m_textUploadController.planUpload(remote_file, m_eTextFileFormat,
+		m_bTextTimestampEnable, m_textCache.firstSequence(), m_textCache.endSequence(), m_textCache.maxItemCount());
+
+	// 快照只引用缓存分段, O(1)获取; 序列化推迟到FTP线程在锁外完成
+	m_pendingTextUploadFileName = remote_file;
+	m_pendingTextUploadPlan = plan;
+	m_pendingTextUploadSnapshot = m_textCache.snapshotFrom(plan.begin_sequence);
+	m_nPendingTextUploadId++;
+	m_bPendingTextUpload = !m_pendingTextUploadFileName.empty() && !m_pendingTextUploadSnapshot.empty();
+	if (m_bPendingTextUpload)
+	{
+		notifyHub();
+	}
+}
+
+TextSerializeOptions FtpClientManager::textSerializeOptions(const TextUploadPlan& plan)
+{
+	TextSerializeOptions options;
+	options.format = plan.format;
+	options.include_timestamp = plan.include_timestamp;
+	options.column_count = plan.column_count;
+	// append: 只包含远端文件之后新增的记录, 通过APPE追加, 不再写表头
+	// appendable: 远端文件无法续写(首次上传/头部记录被裁剪/列数增加等), 按可追加格式整体重写
+	options.appendable = plan.append || plan.appendable;
+	options.with_header = !plan.append;
+	return options;
+}
+
+void FtpClientManager::clearPendingTextUploadLocked()
+{
+	m_bPendingTextUpload = false;
+	m_pendingTextUploadSnapshot = TextSnapshot();
+	m_pendingTextUploadFileName.clear();
+	m_pendingTextUploadPlan = TextUploadPlan();
 }
 
 bool FtpClientManager::getReLoginState()
 {
-	return m_bNeedRelogin;
+	std::shared_ptr<FtpConnectionHub> pHub = hub();
+	return !pHub || pHub->getReLoginState();
 }
 
 bool FtpClientManager::isConnect()
 {
-	return m_ftpClient.is_connected();
-}
-
-void FtpClientManager::processQueue(struct simple_fifo *pQueue)
-{
-	try
-	{
-		struct FtpFifoParam *pParam = (struct FtpFifoParam *)sfifo_out_addr(pQueue);
-
-		handleFifoData(pParam);
-
-		sfifo_out_skip(pQueue);
-	}
-	catch (const std::exception &e)
-	{
-		LOGE("Exception during file upload: %s\n", e.what());
-		logout();
-		m_bNeedRelogin = true;
-	}
-}
-
-bool FtpClientManager::performLogin()
-{
-	try
-	{
-		logout();
-		return login();
-	}
-	catch (const std::exception &e)
-	{
-		LOGE("FTP exception during login: %s\n", e.what());
-		return false;
-	}
-}
-
-bool FtpClientManager::login()
-{
-	if (FTP_CFG_ALL_OK != m_cfgInfo.cfgState)
-	{
-		LOGD("FTP client incomplete cfg.\n");
-		return false;
-	}
-
-	ftp::replies replies = m_ftpClient.connect(m_cfgInfo.addr, m_cfgInfo.port);
-
-	if (!replies.get_replies().empty() && !replies.get_replies().back().is_positive())
-	{
-		LOGE("Failed to connect to FTP server.\n");
-		return false;
-	}
-
-	if (m_cfgInfo.anonymousLogin)
-	{
-		replies = m_ftpClient.login("anonymous", "anonymous");
-	}
-	else
-	{
-		replies = m_ftpClient.login(m_cfgInfo.username, m_cfgInfo.password);
-	}
-
-	if (!replies.get_replies().empty() && !replies.get_replies().back().is_positive())
-	{
-		LOGE("Failed to login with provided credentials.\n");
-		return false;
-	}
-
-	ftp::reply reply = m_ftpClient.get_current_directory();
-	if (reply.is_negative())
-	{
-		LOGE("Failed get server root directory: %s\n", reply.get_status_string().c_str());
-		return false;
-	}
-
-	m_strRootDirServer = m_utils.extractDirectory(reply.get_status_string());
-
-	return true;
+	std::shared_ptr<FtpConnectionHub> pHub = hub();
+	return pHub && pHub->isConnect();
 }
 
-void FtpClientManager::logout()
+bool FtpClientManager::acceptsFrames()
 {
-	try
-	{
-		if (m_ftpClient.is_connected())
-		{
-			try
-			{
-				//scmvs自带服务器不支持重置指令
-				//m_ftpClient.logout();
-
-				m_ftpClient.disconnect(true);
-			}
-			catch (const std::exception &e)
-			{
-				LOGE("Graceful disconnect failed: %s\n", e.what());
-				m_ftpClient.disconnect(false);
-			}
-		}
-	}
-	catch (const std::exception &e)
-	{
-		LOGE("Exception during logout: %s\n", e.what());
-	}
+	// 开启spool且服务器已配置时, 断线期间的帧由主连接线程写入spool
+	return isConnect()
+		|| (m_bSpoolEnable && FTP_CFG_ALL_OK == (m_cfgInfo.cfgState & FTP_CFG_ALL_OK));
 }
 
-std::unique_ptr<std::istream> FtpClientManager::makeIstreamByFormat(struct FtpFifoParam* pParam)
+std::istream* FtpClientManager::makeIstreamByFormat(FtpSession& session, struct FtpFifoParam* pParam)
 {
 	if (nullptr == pParam || nullptr == pParam->image.data[0] || pParam->usedLen == 0)
 	{
@@ -573,121 +853,73 @@ std::unique_ptr<std::istream> FtpClientManager::makeIstreamByFormat(struct FtpFi
 		return nullptr;
 	}
 
-	if (m_nImgDataSize <= 0 || m_nConvertBufSize <= 0 || nullptr == m_pConvertImageBuf || nullptr == m_fifoArray || nullptr == m_fifoArray[0].image.data[0])
+	if (TO_LOG == pParam->type)
 	{
-		LOGE("ftp memory not ready, imgSize=%d convertSize=%d convertBuf=%p fifo=%p store=%p\n",
-			m_nImgDataSize, m_nConvertBufSize, m_pConvertImageBuf, m_fifoArray,
-			(m_fifoArray ? m_fifoArray[0].image.data[0] : nullptr));
-		return nullptr;
-	}
-
-	if (pParam->usedLen > (uint32_t)m_nImgDataSize)
-	{
-		LOGE("ftp usedLen overflow, usedLen=%u storeSlot=%d type=%d file=%s\n",
-			pParam->usedLen, m_nImgDataSize, pParam->type, pParam->fileName);
-		return nullptr;
-	}
+		std::string strArchive;
+		std::string strEntry;
+		if (FtpZipArchive::splitPath(pParam->fileName, &strArchive, &strEntry))
+		{
+			// 归档内的日志直接解压到数据连接, 不落盘
+			if (!session.logZipStream.open(strArchive, strEntry))
+			{
+				LOGE("open log %s in %s failed!\n", strEntry.c_str(), strArchive.c_str());
+				return nullptr;
+			}
+			return &session.logZipStream;
+		}
 
-	{
-		uintptr_t out_addr = (uintptr_t)pParam->image.data[0];
-		uintptr_t store_start = (uintptr_t)m_fifoArray[0].image.data[0];
-		uintptr_t store_span = (uintptr_t)m_nImgDataSize * (uintptr_t)FTP_FIFO_DEPTH;
-		uintptr_t store_end = store_start + store_span;
-		uintptr_t out_end = out_addr + (uintptr_t)m_nImgDataSize;
-		if ((store_end < store_start) || (out_end < out_addr)
-			|| (out_addr < store_start) || (out_end > store_end))
+		if (session.logStream.is_open())
 		{
-			LOGE("ftp output ptr invalid, out=%p outEnd=0x%zx store=[0x%zx,0x%zx)\n",
-				pParam->image.data[0], (size_t)out_end, (size_t)store_start, (size_t)store_end);
+			session.logStream.close();
+		}
+		session.logStream.clear();
+		session.logStream.open(pParam->fileName, std::ios_base::binary);
+		if (!session.logStream.is_open())
+		{
+			LOGE("read %s ifstream failed!\n", pParam->fileName);
 			return nullptr;
 		}
+		return &session.logStream;
 	}
 
-	if (TO_LOG == pParam->type)
+	if (TO_SPOOL == pParam->type)
 	{
-		auto src = std::make_unique<std::ifstream>(pParam->fileName, std::ios_base::binary);
-		if (!src->is_open())
-		{
-			LOGE("read %s ifstream failed!\n", pParam->fileName);
-			return nullptr;
-		}
-		return std::move(src);
-	}
-	else if (TO_JPG == pParam->type || TO_TXT == pParam->type)
+		// replaySpool已打开spool中最早的记录, 边读文件边上传
+		return session.spoolStream.isOpen() ? &session.spoolStream : nullptr;
+	}
+
+	// 槽位内存的边界已由连接池在领取时校验(FtpConnectionHub::validSlot)
+	if (TO_JPG == pParam->type || TO_TXT == pParam->type)
 	{
-		auto src = std::make_unique<std::stringstream>();
-		src->write((char*)pParam->image.data[0], pParam->usedLen);
-		return std::move(src);
+		// 槽位被本连接领取(FtpSlotRing::claim), 在finishSlot完成或放回之前生产者不会复用, 直接引用槽内存, 不做拷贝
+		session.slotStream.reset((const char*)pParam->image.data[0], pParam->usedLen);
+		return &session.slotStream;
 	}
 	else if (TO_BMP == pParam->type)
 	{
-		BMPENCPARAM strBmpEncParam = {0};
+		// 边读边编码: 行条带直接从槽内存转换到数据连接, 槽内容保持不变, 失败重传时可重新读取
 		HKA_IMAGE *img = &pParam->image;
-		uint64_t pixel_count = (uint64_t)img->width * (uint64_t)img->height;
-		uint64_t mono_need = pixel_count;
-		uint64_t color_need = pixel_count * 3ULL;
-		if ((0 == img->width) || (0 == img->height))
+		bool bPlanarRgb = (HKA_IMG_RGB_RGB24_P3 == img->format);
+		if (!session.bmpStream.reset((const uint8_t*)img->data[0], pParam->usedLen, img->width, img->height, bPlanarRgb))
 		{
-			LOGE("invalid image size, width=%u height=%u file=%s\n", img->width, img->height, pParam->fileName);
+			LOGE("bmp stream init failed, usedLen=%u w=%u h=%u format=%d file=%s\n",
+				pParam->usedLen, img->width, img->height, img->format, pParam->fileName);
 			return nullptr;
 		}
-
-		if (mono_need > (uint64_t)m_nConvertBufSize || color_need > (uint64_t)m_nConvertBufSize)
+		return &session.bmpStream;
+	}
+	else if (TO_FLI == pParam->type)
+	{
+		// 与BMP相同, 每个条带约64KB原始数据, 压缩与发送交替进行
+		HKA_IMAGE *img = &pParam->image;
+		bool bPlanarRgb = (HKA_IMG_RGB_RGB24_P3 == img->format);
+		if (!session.fliStream.reset((const uint8_t*)img->data[0], pParam->usedLen, img->width, img->height, bPlanarRgb))
 		{
-			LOGE("image size too large for convert buffer, mono_need=%llu color_need=%llu convert=%d\n",
-				(unsigned long long)mono_need, (unsigned long long)color_need, m_nConvertBufSize);
+			LOGE("fli stream init failed, usedLen=%u w=%u h=%u format=%d file=%s\n",
+				pParam->usedLen, img->width, img->height, img->format, pParam->fileName);
 			return nullptr;
 		}
-
-		if (HKA_IMG_RGB_RGB24_P3 == img->format)
-		{
-			if (pParam->usedLen < color_need)
-			{
-				LOGE("rgb image len too small, usedLen=%u need=%llu file=%s\n",
-					pParam->usedLen, (unsigned long long)color_need, pParam->fileName);
-				return nullptr;
-			}
-
-			int cvt_ret = imgConvertP3ToC3(pParam->image.data[0], pParam->usedLen, m_pConvertImageBuf, m_nConvertBufSize, pParam->image.width, pParam->image.height);
-			if (0 != cvt_ret)
-			{
-				LOGE("imgConvertP3ToC3 failed, ret=%d len=%u w=%u h=%u\n", cvt_ret, pParam->usedLen, pParam->image.width, pParam->image.height);
-				return nullptr;
-			}
-			strBmpEncParam.image_pixel_bit = COLOR_IMAGE_PIXEL_BIT;
-			strBmpEncParam.input_len = (u32)color_need;
-		}
-		else
-		{
-			if (pParam->usedLen < mono_need)
-			{
-				LOGE("mono image len too small, usedLen=%u need=%llu file=%s\n",
-					pParam->usedLen, (unsigned long long)mono_need, pParam->fileName);
-				return nullptr;
-			}
-
-			memcpy(m_pConvertImageBuf, (void*)img->data[0], (size_t)mono_need);
-			strBmpEncParam.image_pixel_bit = MONO_IMAGE_PIXEL_BIT;
-			strBmpEncParam.input_len = (u32)mono_need;
-		}
-	
-		strBmpEncParam.input_data = (void *)m_pConvertImageBuf;
-		strBmpEncParam.image_height = img->height;
-		strBmpEncParam.image_width = img->width;
-		strBmpEncParam.output_bufsize = m_nImgDataSize;
-		strBmpEncParam.output_data = img->data[0];
-	
-		int nErrCode = mono8_2_bmp(&strBmpEncParam);
-		if (IMVS_EC_OK != nErrCode)
-		{
-			LOGE("mono8 convert bmp failed: %d\n", nErrCode);
-			return nullptr;
-		}
-
-		uint32_t bmpLen = strBmpEncParam.output_len;
-		auto src = std::make_unique<std::stringstream>();
-		src->write((char*)pParam->image.data[0], bmpLen);
-		return std::move(src);
+		return &session.fliStream;
 	}
 	else
 	{
@@ -697,7 +929,7 @@ std::unique_ptr<std::istream> FtpClientManager::makeIstreamByFormat(struct FtpFi
 	return nullptr;
 }
 
-void FtpClientManager::handleFifoData(struct FtpFifoParam *pParam)
+void FtpClientManager::handleFifoData(FtpSession& session, struct FtpFifoParam *pParam)
 {
 	if (NULL == pParam || pParam->usedLen <= 0 || NULL == pParam->image.data[0])
 	{
@@ -708,32 +940,69 @@ void FtpClientManager::handleFifoData(struct FtpFifoParam *pParam)
 	std::string fileName(pParam->fileName);
 	std::string dirName(pParam->dirName);
 
-	if (!handleDirectory(dirName))
+	uint64_t nDequeueUs = FtpUploadStats::nowUs();
+	if (0 != pParam->enqueueUs)
 	{
-		m_bRootDirChange = true;
+		// 只统计首次出队, 重传不重复计入
+		m_uploadStats.recordStage(FTP_STAGE_QUEUE_WAIT,
+			(nDequeueUs > pParam->enqueueUs) ? nDequeueUs - pParam->enqueueUs : 0);
+		pParam->enqueueUs = 0;
+	}
+
+	bool bDirOk = handleDirectory(session, dirName);
+	uint64_t nStartUs = FtpUploadStats::nowUs();
+	m_uploadStats.recordStage(FTP_STAGE_DIRECTORY, nStartUs - nDequeueUs);
+	if (!bDirOk)
+	{
+		m_uploadStats.increment(FTP_COUNTER_FAILURES);
 		return;
 	}
 
 	std::string remotePath;
 	if (TO_LOG == pParam->type)
 	{
-		remotePath = m_strCurrentDir + m_utils.getFilename(fileName);
+		remotePath = session.currentDir + m_utils.getFilename(fileName);
 	}
 	else
 	{
-		remotePath = m_strCurrentDir + fileName;
+		remotePath = session.currentDir + fileName;
 	}
 
-	auto stream = makeIstreamByFormat(pParam);
-	if (!stream)
+	std::istream* stream = makeIstreamByFormat(session, pParam);
+	if (nullptr == stream)
 	{
 		LOGE("failed to create stream for file:%s\n", fileName.c_str());
+		m_uploadStats.increment(FTP_COUNTER_FAILURES);
 		return;
 	}
 
 	ftp::istream_adapter adapter(*stream);
 
-	ftp::replies replies = m_ftpClient.upload_file(adapter, remotePath);
+	nStartUs = FtpUploadStats::nowUs();
+	ftp::replies replies = session.client.upload_file(adapter, remotePath);
+	uint64_t nElapsedUs = FtpUploadStats::nowUs() - nStartUs;
+
+	// 读到的位置即已发送字节数
+	stream->clear();
+	std::streamoff nBytes = stream->tellg();
+	bool bSourceBroken = false;
+	if (TO_LOG == pParam->type)
+	{
+		if (session.logZipStream.isOpen())
+		{
+			bSourceBroken = !session.logZipStream.ok();
+			session.logZipStream.close();
+		}
+		if (session.logStream.is_open())
+		{
+			session.logStream.close();
+		}
+	}
+	else if (TO_SPOOL == pParam->type)
+	{
+		bSourceBroken = !session.spoolStream.ok();
+		session.spoolStream.close();
+	}
 
 	const std::vector<ftp::reply> & reply_list = replies.get_replies();
 	if (!reply_list.empty() && !reply_list.back().is_positive())
@@ -742,52 +1011,277 @@ void FtpClientManager::handleFifoData(struct FtpFifoParam *pParam)
 			reply_list.back().get_status_string().c_str());
 		throw std::runtime_error("Upload failed: " + reply_list.back().get_status_string());
 	}
+	else if (bSourceBroken)
+	{
+		// 归档/spool记录损坏或上传期间被改写(长度/CRC不符): 删除不完整的远端文件, 不重传
+		LOGE("%s failed size/crc check, removing remote file\n", fileName.c_str());
+		m_uploadStats.increment(FTP_COUNTER_FAILURES);
+		session.client.remove_file(remotePath);
+	}
 	else
 	{
-		LOGI("Successfully uploaded file: %s\n", remotePath.c_str());
+		// BMP/FLI编码与发送交替进行, 从总耗时中扣除编码时间即为网络与服务器耗时
+		uint64_t nEncodeUs = 0;
+		if (TO_BMP == pParam->type)
+		{
+			nEncodeUs = session.bmpStream.encodeNs() / 1000;
+			m_uploadStats.recordStage(FTP_STAGE_ENCODE, nEncodeUs);
+		}
+		else if (TO_FLI == pParam->type)
+		{
+			nEncodeUs = session.fliStream.encodeNs() / 1000;
+			m_uploadStats.recordStage(FTP_STAGE_ENCODE, nEncodeUs);
+		}
+		m_uploadStats.recordStage(FTP_STAGE_TRANSFER, (nElapsedUs > nEncodeUs) ? nElapsedUs - nEncodeUs : 0);
+		if (nBytes > 0)
+		{
+			m_uploadStats.recordThroughput((uint64_t)nBytes, nElapsedUs);
+		}
+		m_uploadStats.increment(FTP_COUNTER_UPLOADS);
+
+		LOGI("Successfully uploaded file: %s on connection %d, %lld bytes in %llu us\n", remotePath.c_str(),
+			session.index, (long long)nBytes, (unsigned long long)nElapsedUs);
 	}
 }
 
-bool FtpClientManager::uploadTextSnapshot(const std::string& remote_file_name, const std::string& content)
+bool FtpClientManager::ensureSpoolOpen()
 {
-	if (remote_file_name.empty() || content.empty())
+	if (m_bSpoolConfigChanged.exchange(false))
+	{
+		m_spool.close();
+		m_nSpoolRetryOpenUs = 0;
+	}
+
+	if (!m_bSpoolEnable)
+	{
+		if (m_spool.isOpen())
+		{
+			// 关闭后记录保留在存储上, 重新开启时继续回放
+			m_spool.close();
+		}
+		return false;
+	}
+
+	if (m_spool.isOpen())
 	{
 		return true;
 	}
 
+	uint64_t nNowUs = FtpUploadStats::nowUs();
+	if (nNowUs < m_nSpoolRetryOpenUs)
+	{
+		return false;
+	}
+	m_nSpoolRetryOpenUs = nNowUs + kSpoolReopenIntervalUs;
+
+	StorageWriteRequest stRequest;
+	memset(&stRequest, 0, sizeof(stRequest));
+	stRequest.media = (StorageMedia)m_nSpoolMedia.load();
+	stRequest.type = STORAGE_BIZ_SAVE_IMAGE;
+	snprintf(stRequest.relative_path, sizeof(stRequest.relative_path), "ftp_spool/%d", m_nLogId);
+
+	int ret = storage_resolve_write_path(&stRequest, &m_spoolResolved);
+	if (STORAGE_OK != ret)
+	{
+		LOGE("resolve ftp spool path failed: %s\n", storage_error_to_string((StorageErrorCode)ret));
+		return false;
+	}
+
+	if (!m_spool.open(m_spoolResolved.abs_path, (uint64_t)m_nSpoolMaxSizeMB * 1024 * 1024))
+	{
+		LOGE("open ftp spool %s failed\n", m_spoolResolved.abs_path);
+		return false;
+	}
+
+	LOGI("ftp spool opened at %s, %llu records pending\n", m_spoolResolved.abs_path,
+		(unsigned long long)m_spool.stats().records);
+	return true;
+}
+
+bool FtpClientManager::appendSpool(const struct FtpFifoParam* pParam, std::istream& stream, uint64_t nLength)
+{
+	// 按本条记录的大小申请写入令牌, microSD空间不足或被拔出时拒绝写入
+	StorageResolvedPath stResolved = m_spoolResolved;
+	stResolved.required_size = nLength + FILE_NAME_MAXSIZE + DIR_NAME_MAXSIZE;
+
+	StorageWriteToken stToken;
+	int ret = storage_begin_write(&stResolved, &stToken);
+	if (STORAGE_OK != ret)
+	{
+		LOGE("ftp spool write refused: %s\n", storage_error_to_string((StorageErrorCode)ret));
+		if (STORAGE_E_SD_REMOVED == ret)
+		{
+			m_spool.close();
+		}
+		return false;
+	}
+
+	bool bAppended = (TO_FLI == pParam->type)
+		? m_spool.appendUpTo(pParam->dirName, pParam->fileName, stream, nLength)
+		: m_spool.append(pParam->dirName, pParam->fileName, stream, nLength);
+	if (!bAppended)
+	{
+		storage_abort_write(&stToken);
+		return false;
+	}
+
+	ret = storage_commit_write(&stToken);
+	if (STORAGE_OK != ret)
+	{
+		// 写入期间介质被弹出或拔出, 重新解析路径后再用
+		LOGE("ftp spool write cancelled: %s\n", storage_error_to_string((StorageErrorCode)ret));
+		m_spool.close();
+		return false;
+	}
+	return true;
+}
+
+bool FtpClientManager::spoolSlot(FtpSession& session, struct FtpFifoParam* pParam)
+{
+	// 未完成服务器配置时不落盘, 避免长期未配置的模块持续写存储
+	if (FTP_CFG_ALL_OK != (m_cfgInfo.cfgState & FTP_CFG_ALL_OK) || !ensureSpoolOpen())
+	{
+		return false;
+	}
+
+	std::istream* stream = makeIstreamByFormat(session, pParam);
+	uint64_t nLength = pParam->usedLen;
+	if (TO_BMP == pParam->type)
+	{
+		nLength = session.bmpStream.fileSize();
+	}
+	else if (TO_FLI == pParam->type)
+	{
+		// 压缩后大小在读完前未知, 按上限预留空间, 实际写入多少记多少
+		nLength = session.fliStream.maxFileSize();
+	}
+	if (nullptr == stream || !m_spool.isOpen() || !appendSpool(pParam, *stream, nLength))
+	{
+		LOGW("spool %s failed, frame dropped\n", pParam->fileName);
+		return false;
+	}
+	return true;
+}
+
+uint64_t FtpClientManager::spoolReplayDueUs()
+{
+	// 按上一条记录的字节数和当前限速推迟下一次回放, 限速修改后立即生效
+	uint64_t nRate = (uint64_t)m_nSpoolReplayRateKB.load() * 1024;
+	if (0 == nRate || 0 == m_nSpoolLastReplayBytes)
+	{
+		return 0;
+	}
+	return m_nSpoolLastReplayUs + m_nSpoolLastReplayBytes * 1000000ULL / nRate;
+}
+
+bool FtpClientManager::replaySpool(FtpSession& session)
+{
+	if (session.needLogin || !session.client.is_connected() || !ensureSpoolOpen() || m_spool.empty())
+	{
+		return false;
+	}
+
+	uint64_t nNowUs = FtpUploadStats::nowUs();
+	if (nNowUs < spoolReplayDueUs())
+	{
+		return false;
+	}
+
+	std::string strDir;
+	std::string strFile;
+	uint64_t nLength = 0;
+	if (!m_spool.openFront(&session.spoolStream, &strDir, &strFile, &nLength))
+	{
+		return false;
+	}
+
+	struct FtpFifoParam stParam;
+	memset(&stParam, 0, sizeof(stParam));
+	stParam.type = TO_SPOOL;
+	snprintf(stParam.fileName, FILE_NAME_MAXSIZE, "%s", strFile.c_str());
+	snprintf(stParam.dirName, DIR_NAME_MAXSIZE, "%s", strDir.c_str());
+	stParam.usedLen = (uint32_t)std::min<uint64_t>(nLength, UINT32_MAX);
+	stParam.image.data[0] = stParam.fileName;
+
 	try
 	{
-		if (!handleDirectory(""))
+		handleFifoData(session, &stParam);
+	}
+	catch (const std::exception &e)
+	{
+		LOGE("Exception during spool replay: %s\n", e.what());
+		// 记录保留在spool队首, 重登录后重传
+		session.spoolStream.close();
+		m_uploadStats.increment(FTP_COUNTER_FAILURES);
+		m_uploadStats.increment(FTP_COUNTER_RETRIES);
+		FtpConnectionHub::logout(session);
+		session.needLogin = true;
+		return true;
+	}
+	session.spoolStream.close();
+	m_spool.popFront();
+
+	m_nSpoolLastReplayUs = nNowUs;
+	m_nSpoolLastReplayBytes = nLength;
+
+	uint64_t nEndUs = FtpUploadStats::nowUs();
+	if (0 == m_nSpoolWindowStartUs)
+	{
+		m_nSpoolWindowStartUs = nNowUs;
+	}
+	m_nSpoolWindowBytes += nLength;
+	if (nEndUs - m_nSpoolWindowStartUs >= kSpoolRateWindowUs || m_spool.empty())
+	{
+		m_nSpoolReplayBps = m_spool.empty() ? 0
+			: m_nSpoolWindowBytes * 1000000ULL / (nEndUs - m_nSpoolWindowStartUs);
+		m_nSpoolWindowStartUs = m_spool.empty() ? 0 : nEndUs;
+		m_nSpoolWindowBytes = 0;
+	}
+	return true;
+}
+
+bool FtpClientManager::uploadTextSnapshot(FtpSession& session, const std::string& remote_file_name,
+	TextResultIStream& content, bool append)
+{
+	if (remote_file_name.empty() || content.peek() == std::char_traits<char>::eof())
+	{
+		return true;
+	}
+
+	try
+	{
+		if (!handleDirectory(session, ""))
 		{
-			m_bRootDirChange = true;
 			return false;
 		}
 
-		std::stringstream stream;
-		stream.write(content.data(), content.size());
-		ftp::istream_adapter adapter(stream);
-		ftp::replies replies = m_ftpClient.upload_file(adapter, remote_file_name);
+		// 边序列化边上传, 内存占用只有一个序列化块
+		ftp::istream_adapter adapter(content);
+		const std::string remote_path = session.currentDir + remote_file_name;
+		ftp::replies replies = append ? session.client.append_file(adapter, remote_path)
+			: session.client.upload_file(adapter, remote_path);
 		const std::vector<ftp::reply>& reply_list = replies.get_replies();
 		if (!reply_list.empty() && !reply_list.back().is_positive())
 		{
-			LOGE("Failed to upload text file: %s, reply: %s\n",
+			LOGE("Failed to %s text file: %s, reply: %s\n", append ? "append" : "upload",
 				remote_file_name.c_str(), reply_list.back().get_status_string().c_str());
 			return false;
 		}
 
-		LOGI("Successfully uploaded text file: %s\n", remote_file_name.c_str());
+		LOGI("Successfully %s text file: %s, %llu bytes\n", append ? "appended" : "uploaded",
+			remote_file_name.c_str(), static_cast<unsigned long long>(content.bytesProduced()));
 		return true;
 	}
 	catch (const std::exception& e)
 	{
 		LOGE("Exception during text file upload: %s\n", e.what());
-		logout();
-		m_bNeedRelogin = true;
+		FtpConnectionHub::logout(session);
+		session.needLogin = true;
 		return false;
 	}
 }
 
-bool FtpClientManager::deleteRemoteTextFile(const std::string& remote_file_name)
+bool FtpClientManager::deleteRemoteTextFile(FtpSession& session, const std::string& remote_file_name)
 {
 	if (remote_file_name.empty())
 	{
@@ -796,13 +1290,12 @@ bool FtpClientManager::deleteRemoteTextFile(const std::string& remote_file_name)
 
 	try
 	{
-		if (!handleDirectory(""))
+		if (!handleDirectory(session, ""))
 		{
-			m_bRootDirChange = true;
 			return false;
 		}
 
-		ftp::reply reply = m_ftpClient.remove_file(remote_file_name);
+		ftp::reply reply = session.client.remove_file(session.currentDir + remote_file_name);
 		if (reply.is_positive() || reply.get_code() == 550)
 		{
 			LOGI("Delete remote text file %s ret=%d\n", remote_file_name.c_str(), reply.get_code());
@@ -816,22 +1309,24 @@ bool FtpClientManager::deleteRemoteTextFile(const std::string& remote_file_name)
 	catch (const std::exception& e)
 	{
 		LOGE("Exception during text file delete: %s\n", e.what());
-		logout();
-		m_bNeedRelogin = true;
+		FtpConnectionHub::logout(session);
+		session.needLogin = true;
 		return false;
 	}
 }
 
-void FtpClientManager::processPendingTextTransfer()
+bool FtpClientManager::processPendingTextTransfer(FtpSession& session)
 {
-	if (!m_ftpClient.is_connected())
+	if (!session.client.is_connected())
 	{
-		return;
+		return false;
 	}
 
 	std::string delete_file;
 	std::string upload_file;
-	std::string upload_content;
+	TextSnapshot upload_snapshot;
+	TextUploadPlan upload_plan;
+	uint64_t upload_id = 0;
 	bool has_upload = false;
 
 	{
@@ -843,16 +1338,18 @@ void FtpClientManager::processPendingTextTransfer()
 		else if (m_bPendingTextUpload)
 		{
 			upload_file = m_pendingTextUploadFileName;
-			upload_content = m_pendingTextUploadContent;
+			upload_snapshot = m_pendingTextUploadSnapshot;
+			upload_plan = m_pendingTextUploadPlan;
+			upload_id = m_nPendingTextUploadId;
 			has_upload = true;
 		}
 	}
 
 	if (!delete_file.empty())
 	{
-		if (!deleteRemoteTextFile(delete_file))
+		if (!deleteRemoteTextFile(session, delete_file))
 		{
-			return;
+			return false;
 		}
 
 		std::lock_guard<std::mutex> lock(m_txtMutex);
@@ -860,361 +1357,246 @@ void FtpClientManager::processPendingTextTransfer()
 		{
 			m_pendingTextDeleteFiles.erase(m_pendingTextDeleteFiles.begin());
 		}
-		return;
+		return true;
 	}
 
 	if (!has_upload)
 	{
-		return;
+		return false;
 	}
 
-	if (!uploadTextSnapshot(upload_file, upload_content))
+	TextResultIStream upload_content(upload_snapshot, textSerializeOptions(upload_plan));
+	const bool uploaded = uploadTextSnapshot(session, upload_file, upload_content, upload_plan.append);
+
+	std::lock_guard<std::mutex> lock(m_txtMutex);
+	if (!uploaded)
 	{
-		return;
+		// 远端文件可能只写了一部分, 放弃续写, 下次整体重写
+		m_textUploadController.invalidateRemote();
+		if (m_bPendingTextUpload)
+		{
+			queueTextUploadLocked();
+		}
+		return false;
 	}
 
-	std::lock_guard<std::mutex> lock(m_txtMutex);
-	if (m_bPendingTextUpload && m_pendingTextUploadFileName == upload_file
-		&& m_pendingTextUploadContent == upload_content)
+	m_textUploadController.onUploadCommitted(upload_file, upload_plan);
+	if (!m_bPendingTextUpload)
+	{
+		return true;
+	}
+	if (m_nPendingTextUploadId == upload_id)
 	{
-		m_bPendingTextUpload = false;
-		m_pendingTextUploadFileName.clear();
-		m_pendingTextUploadContent.clear();
+		clearPendingTextUploadLocked();
 	}
+	else
+	{
+		// 上传期间有新的刷新请求, 按最新的远端状态重新规划, 避免重复追加
+		queueTextUploadLocked();
+	}
+	return true;
 }
 
 int FtpClientManager::noopCheckAsync()
 {
-	std::promise<int> promise;
-	std::future<int> future = promise.get_future();
-
+	std::shared_ptr<FtpConnectionHub> pHub = hub();
+	if (!pHub)
 	{
-		std::lock_guard<std::mutex> lock(m_taskMutex);
-		m_taskQueue.emplace([this, &promise]() {
-			try
-			{
-				ftp::reply reply = m_ftpClient.send_noop();
-				if (!reply.is_positive())
-				{
-					LOGE("Noop asyn test failed, need to relogin.\n");
-					m_bNeedRelogin = true;
-					promise.set_value(IMVS_EC_PARAM);
-				}
-				else
-				{
-					LOGD("Noop asyn test succeeded.\n");
-					promise.set_value(IMVS_EC_OK);
-				}
-			}
-			catch (const std::exception &e)
-			{
-				LOGE("Exception during noop asyn test: %s\n", e.what());
-				logout();
-				m_bNeedRelogin = true;
-				promise.set_value(IMVS_EC_COMMU_INVALID_ADDRESS);
-			}
-		});
+		return IMVS_EC_COMMU_INVALID_ADDRESS;
 	}
 
-	return future.get();
-}
-
-int FtpClientManager::noopCheck()
-{
-	try
-	{
-		ftp::reply reply = m_ftpClient.send_noop();
-		if (!reply.is_positive())
-		{
-			LOGE("Noop test failed, need to relogin.\n");
-			m_bNeedRelogin = true;
-			return IMVS_EC_PARAM;
-		}
-		else
-		{
-			LOGD("Noop test succeeded.\n");
-		}
-	}
-	catch (const std::exception &e)
-	{
-		LOGE("Exception during noop test: %s\n", e.what());
-		logout();
-		m_bNeedRelogin = true;
-		return IMVS_EC_PARAM;
-	}
-	
-	return IMVS_EC_OK;
+	return pHub->noopCheckAsync();
 }
 
-bool FtpClientManager::rootDirectoryChange()
+bool FtpClientManager::ensureRemoteDirectory(FtpSession& session, const std::string& strPath)
 {
-	if (false == m_bRootDirChange)
+	if (session.dirCache.lookup(strPath))
 	{
 		return true;
 	}
 
-	ftp::reply reply = m_ftpClient.change_current_directory(m_strRootDirServer);
-	if (!reply.is_positive())
+	// 由深到浅找到第一个已知存在的祖先目录, 登录目录本身必然存在
+	std::vector<std::string> missingDirs;
+	std::string path = strPath;
+	while (!path.empty() && path != "/" && path != session.rootDirServer && !session.dirCache.contains(path))
 	{
-		LOGE("Failed return to root directory: %s\n", reply.get_status_string().c_str());
-		return false;
+		missingDirs.push_back(path);
+		path = FtpDirCache::parentPath(path);
 	}
 
-	std::istringstream dirStream(m_strRootDirClient);
-	std::string segment;
-	std::string currentPath = m_strRootDirServer;
-
-	while (std::getline(dirStream, segment, '/'))
+	for (auto it = missingDirs.rbegin(); it != missingDirs.rend(); ++it)
 	{
-		if (segment.empty() || segment == ".")
+		ftp::reply reply = session.client.create_directory(*it);
+		if (!reply.is_positive()
+			&& (550 != reply.get_code())
+			&& (521 != reply.get_code()))
 		{
-			continue;
-		}
-
-		if (currentPath.back() != '/')
-		{
-			currentPath += "/";
-		}
-		currentPath += segment;
-
-		ftp::reply reply = m_ftpClient.change_current_directory(currentPath);
-		if (!reply.is_positive())
-		{
-			reply = m_ftpClient.create_directory(currentPath);
-			if (!reply.is_positive() 
-				&& (550 != reply.get_code())
-				&& (521 != reply.get_code()))
-			{
-				LOGE("Failed to create directory: %s, %s\n", 
-					currentPath.c_str(), reply.get_status_string().c_str());
-				return false;
-			}
-
-			reply = m_ftpClient.change_current_directory(currentPath);
-			if (!reply.is_positive())
-			{
-				LOGE("Failed to change to directory: %s, %s\n", 
-					currentPath.c_str(), reply.get_status_string().c_str());
-				return false;
-			}
+			LOGE("Failed to create directory %s:%s\n",
+				it->c_str(), reply.get_status_string().c_str());
+			return false;
 		}
+		session.dirCache.insert(*it);
 	}
 
-	m_bRootDirChange = false;
 	return true;
 }
 
-bool FtpClientManager::createDirectory(const std::string& strDir)
+bool FtpClientManager::createDirectory(FtpSession& session, const std::string& strRootDir, const std::string& strDir)
 {
-	if (strDir.empty())
-	{
-		m_strCurrentDir.clear();
-		return true;
-	}
-
-	ftp::reply reply = m_ftpClient.create_directory(strDir);
-	if (!reply.is_positive() 
-		&& (550 != reply.get_code())
-		&& (521 != reply.get_code()))
+	std::string target = FtpDirCache::joinPath(strRootDir, strDir);
+	if (!strDir.empty() && !ensureRemoteDirectory(session, target))
 	{
-		LOGE("Failed to create directory %s:%s\n", 
-			strDir.c_str(), reply.get_status_string().c_str());
 		return false;
 	}
 
-	m_strCurrentDir = strDir + "/";
+	// 上传使用绝对路径, 不依赖控制连接的当前目录
+	session.currentDir = ("/" == target) ? target : target + "/";
 	return true;
 }
 
-bool FtpClientManager::handleDirectory(const std::string& strDirName)
+bool FtpClientManager::handleDirectory(FtpSession& session, const std::string& strDirName)
 {
-	try
-	{
-		if (!rootDirectoryChange())
-		{
-			return false;
-		}
-		return createDirectory(strDirName);
-	}
-	catch (const std::exception& e)
+	// 连接异常不在此处捕获: 由调用方退出登录并保留待传内容(槽位放回队列, spool记录和日志留在队首), 重登录后重传
+	// 连接由多个模块共用, 根目录按本模块的配置逐次拼接; 已确认存在时只是一次缓存命中
+	std::string strRootDir = FtpDirCache::joinPath(session.rootDirServer, rootDirClient());
+	if (!ensureRemoteDirectory(session, strRootDir))
 	{
-		LOGE("FTP exception caught: %s\n", e.what());
-		logout();
-		m_bNeedRelogin = true;
 		return false;
 	}
-
-	return false;
+	return createDirectory(session, strRootDir, strDirName);
 }
 
-void FtpClientManager::taskProc()
+bool FtpClientManager::taskProc(FtpSession& session)
 {
-	std::function<void()> task;
-	{
-		std::lock_guard<std::mutex> lock(m_taskMutex);
-		if (!m_taskQueue.empty())
-		{
-			task = std::move(m_taskQueue.front());
-			m_taskQueue.pop();
-		}
-	}
-
-	if (task)
+	bool bProgress = false;
+	if (processPendingLogTransfer(session))
+	{
+		bProgress = true;
+	}
+	if (processPendingTextTransfer(session))
 	{
-		task();
+		bProgress = true;
+	}
+
+	return bProgress;
+}
+
+bool FtpClientManager::hasPendingTransfer()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_taskMutex);
+		if (!m_logFileQueue.empty())
+		{
+			return true;
+		}
 	}
 
-	processPendingTextTransfer();
+	std::lock_guard<std::mutex> lock(m_txtMutex);
+	return !m_pendingTextDeleteFiles.empty() || m_bPendingTextUpload;
 }
 
-void FtpClientManager::ftpClientProc()
+void FtpClientManager::onDisconnected()
 {
-	struct simple_fifo *pQueue = &m_queue;
-	uint32_t idleCount = 0;
-
-	thread_set_name("ftp_client");
+	std::lock_guard<std::mutex> lock(m_taskMutex);
+	m_logFileQueue.clear();
+}
 
-	while (!m_bEnd)
+uint64_t FtpClientManager::nextDueUs(uint64_t nNowUs)
+{
+	uint64_t nDeadlineUs = FtpWakeup::kNoDeadline;
+	if (hasPendingTransfer())
 	{
-		if (m_bNeedRelogin)
-		{
-			LOGD("Need relogged in. Attempting to login...\n");
-			m_bRootDirChange = true;
-
-			if (!performLogin())
-			{
-				LOGE("Failed to login to FTP server.\n");
-				std::this_thread::sleep_for(std::chrono::seconds(1));
-			}
-			else
-			{
-				m_bNeedRelogin = false;
-				LOGI("Successfully logged in to FTP server.\n");
-			}
-		}
-
-		taskProc();
+		nDeadlineUs = nNowUs + kTransferRetryUs;
+	}
+	if (!m_spool.empty())
+	{
+		nDeadlineUs = std::min(nDeadlineUs, spoolReplayDueUs());
+	}
+	return nDeadlineUs;
+}
 
-		if (!m_ftpClient.is_connected())
-		{
-			sfifo_drain(pQueue);
-			// 切碎睡眠时间，防止退出时等待过长
-			for (int cnt = 0; cnt < 5 && !m_bEnd; ++cnt)
-			{
-				std::this_thread::sleep_for(std::chrono::milliseconds(10));
-			}
-			//continue;
-		}
+bool FtpClientManager::processPendingLogTransfer(FtpSession& session)
+{
+	if (!session.client.is_connected())
+	{
+		return false;
+	}
 
-		if (sfifo_is_empty(pQueue))
+	struct FtpFifoParam stParam;
+	memset(&stParam, 0, sizeof(stParam));
+	{
+		std::lock_guard<std::mutex> lock(m_taskMutex);
+		if (m_logFileQueue.empty())
 		{
-			std::this_thread::sleep_for(std::chrono::milliseconds(10));
-			idleCount++;
-			// 空闲时每隔10秒进行一次连接检测
-			if (idleCount >= 1000)
-			{
-				idleCount = 0;
-				noopCheck();
-			}
-			continue;
+			return false;
 		}
-		processQueue(pQueue);
+		snprintf(stParam.fileName, FILE_NAME_MAXSIZE, "%s", m_logFileQueue.front().c_str());
 	}
+	stParam.type = TO_LOG;
+	stParam.usedLen = strlen(stParam.fileName);
+	stParam.image.data[0] = stParam.fileName;
 
-	logout();
+	try
+	{
+		handleFifoData(session, &stParam);
+	}
+	catch (const std::exception &e)
+	{
+		LOGE("Exception during log upload: %s\n", e.what());
+		m_uploadStats.increment(FTP_COUNTER_FAILURES);
+		m_uploadStats.increment(FTP_COUNTER_RETRIES);
+		FtpConnectionHub::logout(session);
+		session.needLogin = true;
+		return false;
+	}
 
-	m_bRunning = false;
-	LOGI("FtpClientManager thread stopped.\n");
+	std::lock_guard<std::mutex> lock(m_taskMutex);
+	if (!m_logFileQueue.empty() && m_logFileQueue.front() == stParam.fileName)
+	{
+		m_logFileQueue.pop_front();
+	}
+	return true;
 }
 
 void FtpClientManager::DeInit()
 {
-	m_bEnd = true;
-
-	while(m_bRunning)
 	{
-		usleep(10000);
+		std::lock_guard<std::mutex> lock(m_bindMutex);
+		m_bInited = false;
+		detachHub();
 	}
 
-	MMZmemFree((void**)&m_pConvertImageBuf);
-	m_nConvertBufSize = 0;
+	// 摘除后连接池线程不再访问本模块, spool可以安全关闭
+	m_spool.close();
 
-	if (m_fifoArray)
 	{
-		if (m_fifoArray[0].image.data[0])
-		{
-			MMZmemFree((void**)&(m_fifoArray[0].image.data[0]));
-		}
-		MMZmemFree((void**)&(m_fifoArray));
+		std::lock_guard<std::mutex> lock(m_taskMutex);
+		m_logFileQueue.clear();
 	}
 
 	std::lock_guard<std::mutex> lock(m_txtMutex);
 	m_textCache.clear();
 	m_textUploadController.reset();
 	m_pendingTextDeleteFiles.clear();
-	m_bPendingTextUpload = false;
-	m_pendingTextUploadFileName.clear();
-	m_pendingTextUploadContent.clear();
+	clearPendingTextUploadLocked();
 }
 
 int FtpClientManager::Init()
 {
-	m_fifoArray = (struct FtpFifoParam*)MMZmemAllocHigh(sizeof(struct FtpFifoParam) * FTP_FIFO_DEPTH, 
-															8, (char*)"ftpmsg.ftp_fifo");
-	if (NULL == m_fifoArray)
 	{
-		LOGE("malloc ftp fifo array memory failed\r\n");
-		return -2;
-	}
-
-	memset(m_fifoArray, 0, sizeof(struct FtpFifoParam) * FTP_FIFO_DEPTH);
-
-	int nSenSorSize = SENSOR_SIZE + BMP_EXTRA_SIZE;
-	char* pStoreBuf = (char *)MMZmemAllocHigh(nSenSorSize * FTP_FIFO_DEPTH, 
-												8, (char*)"ftpmsg.store_buf");
-	if (NULL == pStoreBuf)
-	{
-		LOGE("malloc store fifo img memory [size:%d] failed\r\n", nSenSorSize);
-		return IMVS_EC_OUTOFMEMORY;
-	}
-	memset(pStoreBuf, 0, nSenSorSize * FTP_FIFO_DEPTH);
-	LOGI("init store buf size:%d, %p\n", nSenSorSize, pStoreBuf);
-
-	for (int i = 0; i < FTP_FIFO_DEPTH; i++)
-	{
-		m_fifoArray[i].image.data[0] = pStoreBuf + i * nSenSorSize;
-	}
-	m_nImgDataSize = nSenSorSize;
-
-	m_nConvertBufSize = SENSOR_SIZE;
-	m_pConvertImageBuf = (char *)MMZmemAlloc(m_nConvertBufSize, 8, (char*)"ftpmsg.convert_img");
-	if (NULL == m_pConvertImageBuf)
-	{
-		LOGE("malloc c3 img memory failed\r\n");
-		return IMVS_EC_OUTOFMEMORY;
-	}
-	memset(m_pConvertImageBuf, 0, m_nConvertBufSize);
-
-	sfifo_init(&m_queue, sizeof(struct FtpFifoParam), FTP_FIFO_DEPTH, (void*)(m_fifoArray));
-
-	m_bEnd = false;
-	pthread_t ftpCMangThread;
-	int ret = thread_spawn_ex(&ftpCMangThread, 0, 
-								SCHED_POLICY_RR,
-								SCHED_PRI_HIGH_50,
-								10 * 1024, 
-								ftpClientProcThread, this);
-	if (ret < 0)
-	{
-		LOGE("ftp_client data thread creation failed!\r\n");
-		return -3;
+		// 配置不完整时暂不挂接, 补全配置后由rebindHub挂接
+		std::lock_guard<std::mutex> lock(m_bindMutex);
+		m_bInited = true;
+		int ret = attachHub();
+		if (IMVS_EC_OK != ret)
+		{
+			return ret;
+		}
 	}
 
-	m_bRunning = true;
 	resetTextTransferState(m_bTextTransferEnable);
 
 	LOGI("ftp init ok!\r\n");
 
 	return 0;
 }
-
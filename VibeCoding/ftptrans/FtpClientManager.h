@@ -4,45 +4,35 @@
 #include <atomic>
 #include <vector>
 #include <cstring>
+#include <fstream>
 #include <memory>
 #include <string>
 #include <iostream>
 #include <mutex>
+#include <deque>
 #include <queue>
 
 #include <ftp/client.hpp>
 #include <ftp/stream/istream_adapter.hpp>
 
 #include "hka_types.h"
-#include "simple_fifo.h"
 #include "FtpClientUtils.h"
+#include "FtpConnectionHub.h"
 #include "TextResultCache.h"
 #include "TextResultSerializer.h"
 #include "TextUploadController.h"
-
-#define FILE_NAME_MAXSIZE 256
-#define DIR_NAME_MAXSIZE 256
-
-enum eTransportOption
-{
-	TO_JPG = 0,
-	TO_BMP = 1,
-	TO_LOG = 2,
-	TO_TXT = 3
-};
-
-// 定义FTP FIFO参数结构体
-struct FtpFifoParam 
-{
-	uint32_t usedLen;
-	HKA_IMAGE image;
-	char fileName[FILE_NAME_MAXSIZE];
-	char dirName[DIR_NAME_MAXSIZE];
-	int  type;
-};
-
+#include "StorageApi.h"
+
+/**
+ * @brief 单个ftptrans模块的FTP客户端
+ *
+ * 登录会话、上传线程和帧槽位由服务器参数相同的模块共用(FtpConnectionHub), 本类只保存
+ * 本模块的配置、排队/上传统计、spool以及文本和日志传输状态.
+ */
 class FtpClientManager : public std::enable_shared_from_this<FtpClientManager> 
 {
+	friend class FtpConnectionHub;
+
 public:
 	/**
 	 * @brief FTP客户端配置信息
@@ -60,7 +50,9 @@ public:
 	} FtpClientConfig;
 
 
-	static constexpr auto FTP_FIFO_DEPTH = 6; 
+	static constexpr auto FTP_FIFO_DEPTH = FtpConnectionHub::FTP_FIFO_DEPTH;
+	static constexpr auto FTP_MAX_CONNECTIONS = FtpConnectionHub::FTP_MAX_CONNECTIONS;
+	static constexpr auto FTP_LOG_QUEUE_DEPTH = 6;		///< 待上传日志文件的最大排队数
 
 public:
 	FtpClientManager();
@@ -71,8 +63,6 @@ public:
 
 	void DeInit();
 
-	void ftpClientProc();
-
 	void setAnonymousLogin(bool enable);
 
 	void setUsername(const char *username);
@@ -85,6 +75,28 @@ public:
 
 	int enqueueFtpData(const struct FtpFifoParam *data);
 
+	void setQueueOverflowPolicy(int nPolicy);
+
+	void setQueueBlockTimeoutMs(int nTimeoutMs);
+
+	int getQueueStats(char* pBuff, int nBuffSize, int* pDataLen);
+
+	int getDirCacheStats(char* pBuff, int nBuffSize, int* pDataLen);
+
+	int getUploadStats(char* pBuff, int nBuffSize, int* pDataLen);
+
+	int getDebugInfo(char* pBuff, int nBuffSize, int* pDataLen);
+
+	int getSpoolStats(char* pBuff, int nBuffSize, int* pDataLen);
+
+	void setSpoolEnable(bool enable);
+
+	void setSpoolMedia(int nMedia);
+
+	void setSpoolMaxSizeMB(int nSizeMB);
+
+	void setSpoolReplayRateKB(int nRateKB);
+
 	void enqueueTextData(const std::string& text);
 
 	void setLogId(int nLogId);
@@ -93,12 +105,27 @@ public:
 
 	bool isConnect();
 
+	bool acceptsFrames();
+
 	int noopCheckAsync();
 
 	void setRootDir(const char* szPath);
 
+	void setConnectionCount(int nCount);
+
+	/**
+	 * @brief 开启后连接池额外保持一条已登录的备用连接, 上传连接断开时直接接替
+	 */
+	void setStandbyEnable(bool enable);
+
+	/**
+	 * @brief 登录前TCP连接探测的超时, 连接池取各模块的最大值
+	 */
+	void setConnectTimeoutMs(int nTimeoutMs);
+
 	void setTextTransEnable(bool enable);
 	void setTextFileFormat(int format);
+	void setTextUploadMode(int mode);
 	void setTextTimestampEnable(bool enable);
 	void setTextFileName(const char* file_name);
 	void setTextRetentionPolicy(int policy);
@@ -109,59 +136,100 @@ public:
 	void triggerTextFinalRefresh();
 
 private:
-	bool login();
+	std::shared_ptr<FtpConnectionHub> hub();
+
+	void notifyHub();
+
+	int attachHub();
 
-	void logout();
+	void detachHub();
+
+	void rebindHub();
+
+	bool taskProc(FtpSession& session);
+
+	bool hasPendingTransfer();
 
-	int noopCheck();
+	void onDisconnected();
 
-	void taskProc();
+	uint64_t nextDueUs(uint64_t nNowUs);
 
-	bool performLogin();
+	int enqueueLogFile(const char* szPath);
 
-	void processQueue(struct simple_fifo *pQueue);
+	bool processPendingLogTransfer(FtpSession& session);
+
+	void handleFifoData(FtpSession& session, struct FtpFifoParam *pParam);
 
-	void handleFifoData(struct FtpFifoParam *pParam);
+	std::string rootDirClient();
 
-	bool rootDirectoryChange();
+	bool ensureRemoteDirectory(FtpSession& session, const std::string& strPath);
 
-	bool createDirectory(const std::string& strDir);
+	bool createDirectory(FtpSession& session, const std::string& strRootDir, const std::string& strDir);
 
-	bool handleDirectory(const std::string& strDirName);
+	bool handleDirectory(FtpSession& session, const std::string& strDirName);
+
+	std::istream* makeIstreamByFormat(FtpSession& session, struct FtpFifoParam* pParam);
+
+	bool ensureSpoolOpen();
+
+	bool appendSpool(const struct FtpFifoParam* pParam, std::istream& stream, uint64_t nLength);
+
+	bool spoolSlot(FtpSession& session, struct FtpFifoParam* pParam);
+
+	uint64_t spoolReplayDueUs();
+
+	bool replaySpool(FtpSession& session);
 
-	std::unique_ptr<std::istream> makeIstreamByFormat(struct FtpFifoParam* pParam);
 	void queueTextUploadLocked();
 	void queueTextDeleteLocked(const std::string& remote_file_name);
 	std::string buildTextRemoteFileNameLocked() const;
-	bool uploadTextSnapshot(const std::string& remote_file_name, const std::string& content);
-	bool deleteRemoteTextFile(const std::string& remote_file_name);
-	void processPendingTextTransfer();
+	void clearPendingTextUploadLocked();
+	static TextSerializeOptions textSerializeOptions(const TextUploadPlan& plan);
+	bool uploadTextSnapshot(FtpSession& session, const std::string& remote_file_name, TextResultIStream& content,
+		bool append);
+	bool deleteRemoteTextFile(FtpSession& session, const std::string& remote_file_name);
+	bool processPendingTextTransfer(FtpSession& session);
 	static std::string normalizeTextFileName(const std::string& file_name);
 	static bool buildTextRecord(const std::string& text, TextRecord& record);
 
 	int m_nLogId;
-	int m_nImgDataSize;
-	int m_nConvertBufSize;
-	char *m_pConvertImageBuf;
+	bool m_bLogIdSet;
 
-	ftp::client m_ftpClient;
 	FtpClientUtils m_utils;
 
-	FtpClientConfig m_cfgInfo;
-	struct FtpFifoParam* m_fifoArray;
-	struct simple_fifo m_queue;
+	std::atomic<int> m_nConnectionCount;		///< 本模块配置的上传连接数, 连接池取各模块的最大值
+	std::atomic<bool> m_bStandbyEnable;			///< 本模块要求备用连接, 任一模块开启即生效
+	std::atomic<int> m_nConnectTimeoutMs;		///< 本模块配置的连接超时, 连接池取各模块的最大值
 
-	std::atomic<bool> m_bRunning;
-	std::atomic<bool> m_bNeedRelogin;
-	std::atomic<bool> m_bEnd;
-	std::atomic<bool> m_bRootDirChange;
+	FtpClientConfig m_cfgInfo;
+	bool m_bInited;								///< Init之后配置变化才重新挂接连接池, 由m_bindMutex保护
+	std::shared_ptr<FtpConnectionHub> m_hub;	///< 配置完整时挂接的共享连接池, 由m_hubMutex保护
+	std::mutex m_hubMutex;
+	std::mutex m_bindMutex;						///< 串行化配置变化/Init/DeInit引起的挂接和摘除
+
+	FtpTenantQueue m_tenantQueue;				///< 本模块在共享槽位池中的排队统计
+	FtpUploadStats m_uploadStats;				///< 各阶段耗时直方图与重传/重登录/NOOP失败计数, 无锁
+	std::atomic<int> m_nOverflowPolicy;			///< FtpOverflowPolicy
+	std::atomic<int> m_nBlockTimeoutMs;			///< 阻塞策略的最长等待时间
+
+	FtpSpool m_spool;							///< 断线期间待上传的帧, 仅连接池主连接线程读写
+	StorageResolvedPath m_spoolResolved;		///< spool目录的存储解析结果, 写入时据此校验介质
+	std::atomic<bool> m_bSpoolEnable;
+	std::atomic<bool> m_bSpoolConfigChanged;	///< 配置变化, 由主连接线程重新打开spool
+	std::atomic<int> m_nSpoolMedia;				///< StorageMedia
+	std::atomic<int> m_nSpoolMaxSizeMB;
+	std::atomic<int> m_nSpoolReplayRateKB;		///< 回放限速(KB/s), 0为不限速
+	std::atomic<uint64_t> m_nSpoolReplayBps;	///< 最近一个统计窗口的实际回放速率
+	uint64_t m_nSpoolRetryOpenUs;				///< 打开失败后的下次重试时刻
+	uint64_t m_nSpoolLastReplayUs;				///< 限速: 上一次回放的开始时刻
+	uint64_t m_nSpoolLastReplayBytes;			///< 限速: 上一次回放的字节数
+	uint64_t m_nSpoolWindowStartUs;
+	uint64_t m_nSpoolWindowBytes;
 
-	std::string m_strRootDirServer;
 	std::string m_strRootDirClient;
-	std::string m_strCurrentDir;
+	std::mutex m_rootDirMutex;					///< 各上传连接每次上传时读取m_strRootDirClient
 
 	std::mutex m_taskMutex;
-	std::mutex m_queueMutex;
 	std::mutex m_txtMutex;
 
 	bool m_bTextTransferEnable;
@@ -173,9 +241,11 @@ private:
 	std::vector<std::string> m_pendingTextDeleteFiles;
 	bool m_bPendingTextUpload;
 	std::string m_pendingTextUploadFileName;
-	std::string m_pendingTextUploadContent;
-	
-	std::queue<std::function<void()>> m_taskQueue;
+	TextSnapshot m_pendingTextUploadSnapshot;
+	TextUploadPlan m_pendingTextUploadPlan;
+	uint64_t m_nPendingTextUploadId;			///< 每次重新规划递增, 用于判断上传期间是否有新请求
+
+	std::deque<std::string> m_logFileQueue;		///< 待上传的日志文件, 由m_taskMutex保护
 };
 
 #endif // FTP_CLIENT_MANAGER_HPP
@@ -0,0 +1,106 @@
+#include "FtpConnectProbe.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+
+namespace {
+
+void SetError(std::string *error, const std::string &message) {
+  if (error != nullptr) {
+    *error = message;
+  }
+}
+
+// Returns 0 once connected, otherwise an errno value.
+int ConnectWithin(const struct addrinfo *addr, int timeout_ms) {
+  const int fd = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+  if (fd < 0) {
+    return errno;
+  }
+
+  int result = 0;
+  const int flags = fcntl(fd, F_GETFL, 0);
+  if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+    result = errno;
+  } else if (connect(fd, addr->ai_addr, addr->ai_addrlen) != 0) {
+    result = errno;
+    if (result == EINPROGRESS) {
+      struct pollfd pfd;
+      pfd.fd = fd;
+      pfd.events = POLLOUT;
+      pfd.revents = 0;
+      int ready = 0;
+      do {
+        ready = poll(&pfd, 1, timeout_ms);
+      } while (ready < 0 && errno == EINTR);
+
+      if (ready == 0) {
+        result = ETIMEDOUT;
+      } else if (ready < 0) {
+        result = errno;
+      } else {
+        socklen_t len = sizeof(result);
+        if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &result, &len) != 0) {
+          result = errno;
+        }
+      }
+    }
+  }
+  close(fd);
+  return result;
+}
+
+}  // namespace
+
+bool FtpProbeConnect(const std::string &host, unsigned short port, int timeout_ms, std::string *error) {
+  if (host.empty()) {
+    SetError(error, "no server address");
+    return false;
+  }
+
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  char service[8];
+  snprintf(service, sizeof(service), "%u", static_cast<unsigned>(port));
+
+  struct addrinfo *addrs = nullptr;
+  const int gai = getaddrinfo(host.c_str(), service, &hints, &addrs);
+  if (gai != 0) {
+    SetError(error, std::string("resolve failed: ") + gai_strerror(gai));
+    return false;
+  }
+
+  // The timeout covers all addresses of a multi-homed name together.
+  typedef std::chrono::steady_clock Clock;
+  const Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeout_ms < 0 ? 0 : timeout_ms);
+  int result = ETIMEDOUT;
+  for (const struct addrinfo *addr = addrs; addr != nullptr; addr = addr->ai_next) {
+    const long long left_ms =
+        std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+    if (left_ms <= 0) {
+      result = ETIMEDOUT;
+      break;
+    }
+    result = ConnectWithin(addr, static_cast<int>(left_ms));
+    if (result == 0) {
+      break;
+    }
+  }
+  freeaddrinfo(addrs);
+
+  if (result != 0) {
+    SetError(error, strerror(result));
+    return false;
+  }
+  return true;
+}
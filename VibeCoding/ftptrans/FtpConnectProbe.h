@@ -0,0 +1,15 @@
+#ifndef FTP_CONNECT_PROBE_H
+#define FTP_CONNECT_PROBE_H
+
+#include <string>
+
+// Opens and closes a TCP connection to host:port within timeout_ms. The FTP
+// client library connects with a blocking socket, which waits for the kernel's
+// SYN retries (minutes) when the server host is unreachable; probing first
+// bounds a failed login attempt by timeout_ms.
+//
+// Returns true if the connection was accepted; otherwise |error| (optional)
+// describes why.
+bool FtpProbeConnect(const std::string &host, unsigned short port, int timeout_ms, std::string *error);
+
+#endif
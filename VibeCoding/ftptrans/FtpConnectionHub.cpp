@@ -0,0 +1,1332 @@
+/** @file
+  * @brief   ftp connection hub shared by ftp client managers with the same server config
+  */
+
+#include <algorithm>
+#include <cstdio>
+#include <future>
+
+#include "FtpConnectionHub.h"
+#include "FtpClientManager.h"
+#include "FtpClientMonitor.h"
+#include "FtpConnectProbe.h"
+#include "mm.h"
+#include "utils.h"
+#include "algo_common.h"
+#include "sensor_capability.h"
+#include "thread/ThreadApi.h"
+#include "adapter/ScheErrorCodeDefine.h"
+#include "log/log.h"
+
+namespace {
+
+const uint64_t kKeepaliveIntervalUs = 10 * 1000000ULL;		// 空闲多久后发送NOOP检测连接
+const uint64_t kLoginBackoffBaseUs = 100000ULL;			// 首次登录失败后的重试间隔上限, 之后逐次翻倍
+const uint64_t kLoginBackoffCapUs = 10 * 1000000ULL;		// 登录重试间隔的最大值
+const uint64_t kTenantIdleUs = 1000000ULL;					// 超过该时间未入队的模块不再保留份额
+
+std::mutex g_hubMutex;
+std::vector<std::weak_ptr<FtpConnectionHub>> g_hubs;		///< 已创建的连接池, 最后一个模块退出后自动失效
+
+}  // namespace
+
+void* ftpClientProcThread(void* argv)
+{
+	FtpConnectionHub* instance = (FtpConnectionHub*)argv;
+	instance->ftpClientProc();
+	return nullptr;
+}
+
+struct FtpWorkerArg
+{
+	FtpConnectionHub* instance;
+	int index;
+};
+
+void* ftpWorkerProcThread(void* argv)
+{
+	FtpWorkerArg* arg = (FtpWorkerArg*)argv;
+	FtpConnectionHub* instance = arg->instance;
+	int index = arg->index;
+	delete arg;
+
+	instance->ftpWorkerProc(index);
+	return nullptr;
+}
+
+void* ftpStandbyProcThread(void* argv)
+{
+	FtpConnectionHub* instance = (FtpConnectionHub*)argv;
+	instance->ftpStandbyProc();
+	return nullptr;
+}
+
+std::shared_ptr<FtpConnectionHub> FtpConnectionHub::acquire(const FtpServerConfig& config)
+{
+	std::lock_guard<std::mutex> lock(g_hubMutex);
+
+	std::shared_ptr<FtpConnectionHub> hub;
+	for (auto it = g_hubs.begin(); it != g_hubs.end();)
+	{
+		std::shared_ptr<FtpConnectionHub> candidate = it->lock();
+		if (!candidate)
+		{
+			it = g_hubs.erase(it);
+			continue;
+		}
+		if (!hub && candidate->m_config == config)
+		{
+			hub = candidate;
+		}
+		++it;
+	}
+	if (hub)
+	{
+		return hub;
+	}
+
+	hub = std::make_shared<FtpConnectionHub>(config);
+	if (IMVS_EC_OK != hub->start())
+	{
+		return nullptr;
+	}
+	g_hubs.push_back(hub);
+	LOGI("ftp connection hub created for %s:%u\n", config.addr.c_str(), config.port);
+	return hub;
+}
+
+FtpConnectionHub::FtpConnectionHub(const FtpServerConfig& config)
+	: m_config(config),
+	  m_pStoreBuf(nullptr),
+	  m_nStoreSize(0),
+	  m_bStandbyBusy(false),
+	  m_nConnectionCount(1),
+	  m_bStandbyEnable(false),
+	  m_bStandbyStarted(false),
+	  m_nConnectTimeoutMs(3000),
+	  m_nStartedWorkers(0),
+	  m_nRunningWorkers(0),
+	  m_bLogIdSet(false),
+	  m_fifoArray(nullptr),
+	  m_nReplayCursor(0),
+	  m_bRunning(false),
+	  m_bEnd(false)
+{
+	// 各连接的退避抖动取不同种子, 同时断开的连接不会同时重试
+	const uint32_t nSeed = (uint32_t)FtpUploadStats::nowUs();
+	for (int i = 0; i < FTP_MAX_CONNECTIONS; i++)
+	{
+		m_sessions.emplace_back(new FtpSession(i, kLoginBackoffBaseUs, kLoginBackoffCapUs, nSeed + i));
+	}
+	m_standby.reset(new FtpSession(FTP_STANDBY_INDEX, kLoginBackoffBaseUs, kLoginBackoffCapUs,
+		nSeed + FTP_STANDBY_INDEX));
+}
+
+FtpConnectionHub::~FtpConnectionHub()
+{
+	stop();
+	LOGI("ftp connection hub for %s:%u released\n", m_config.addr.c_str(), m_config.port);
+}
+
+int FtpConnectionHub::start()
+{
+	m_fifoArray = (struct FtpFifoParam*)MMZmemAllocHigh(sizeof(struct FtpFifoParam) * FTP_FIFO_DEPTH,
+															8, (char*)"ftpmsg.ftp_fifo");
+	if (NULL == m_fifoArray)
+	{
+		LOGE("malloc ftp fifo array memory failed\r\n");
+		return IMVS_EC_OUTOFMEMORY;
+	}
+
+	memset(m_fifoArray, 0, sizeof(struct FtpFifoParam) * FTP_FIFO_DEPTH);
+
+	// BMP在上传时流式编码, 缓冲只需容纳原始帧; 各帧按实际长度分配, 同一服务器的各模块共用
+	m_nStoreSize = (size_t)SENSOR_SIZE * FTP_FIFO_RAW_FRAMES;
+	m_pStoreBuf = (char *)MMZmemAllocHigh(m_nStoreSize, 8, (char*)"ftpmsg.store_buf");
+	if (NULL == m_pStoreBuf)
+	{
+		LOGE("malloc store fifo img memory [size:%zu] failed\r\n", m_nStoreSize);
+		m_nStoreSize = 0;
+		return IMVS_EC_OUTOFMEMORY;
+	}
+	memset(m_pStoreBuf, 0, m_nStoreSize);
+	LOGI("init store buf size:%zu, %p\n", m_nStoreSize, m_pStoreBuf);
+
+	m_slotRing.reset(FTP_FIFO_DEPTH, m_nStoreSize);
+	m_slotOwners.reset(new SlotOwner[FTP_FIFO_DEPTH]);
+
+	m_bEnd = false;
+	m_bRunning = true;
+	pthread_t ftpCMangThread;
+	int ret = thread_spawn_ex(&ftpCMangThread, 0,
+								SCHED_POLICY_RR,
+								SCHED_PRI_HIGH_50,
+								10 * 1024,
+								ftpClientProcThread, this);
+	if (ret < 0)
+	{
+		LOGE("ftp_client data thread creation failed!\r\n");
+		m_bRunning = false;
+		return IMVS_EC_RESOURCE_CREATE;
+	}
+
+	return IMVS_EC_OK;
+}
+
+void FtpConnectionHub::stop()
+{
+	m_bEnd = true;
+	m_wakeup.notify();
+
+	while (m_bRunning || m_nRunningWorkers > 0)
+	{
+		usleep(10000);
+	}
+	m_nStartedWorkers = 0;
+	m_bStandbyStarted = false;
+
+	// 各线程均已退出, 备用连接不会再被接替
+	logout(*m_standby);
+
+	if (m_pStoreBuf)
+	{
+		MMZmemFree((void**)&m_pStoreBuf);
+		m_nStoreSize = 0;
+	}
+	if (m_fifoArray)
+	{
+		MMZmemFree((void**)&(m_fifoArray));
+	}
+}
+
+void FtpConnectionHub::attach(FtpClientManager* pTenant)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_tenantMutex);
+		Tenant stTenant = {pTenant, 0, false};
+		m_tenants.push_back(stTenant);
+	}
+	{
+		std::lock_guard<std::mutex> produceLock(m_produceMutex);
+		m_producers.push_back(pTenant);
+	}
+	updateOptions();
+}
+
+void FtpConnectionHub::detach(FtpClientManager* pTenant)
+{
+	{
+		// 持有入队锁标记退出, 之后该模块不会再有新帧入队, 入队线程也不再访问该模块的占用
+		std::lock_guard<std::mutex> produceLock(m_produceMutex);
+		m_producers.erase(std::remove(m_producers.begin(), m_producers.end(), pTenant), m_producers.end());
+		std::lock_guard<std::mutex> lock(m_tenantMutex);
+		for (auto& tenant : m_tenants)
+		{
+			if (tenant.manager == pTenant)
+			{
+				tenant.detaching = true;
+			}
+		}
+	}
+	m_wakeup.notify();
+	m_spaceWakeup.notify();
+
+	{
+		std::unique_lock<std::mutex> lock(m_tenantMutex);
+		m_tenantCond.wait(lock, [this, pTenant]() {
+			for (const auto& tenant : m_tenants)
+			{
+				if (tenant.manager == pTenant && tenant.users > 0)
+				{
+					return false;
+				}
+			}
+			return true;
+		});
+		m_tenants.erase(std::remove_if(m_tenants.begin(), m_tenants.end(),
+			[pTenant](const Tenant& tenant) { return tenant.manager == pTenant; }), m_tenants.end());
+	}
+
+	{
+		// 未上传的帧不再属于任何模块, 被领取时直接丢弃. 与finishSlot的扣减互斥,
+		// 入队线程已不再访问该模块, 之后清零占用不会被并发的扣减改写
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		for (size_t i = 0; m_slotOwners && i < FTP_FIFO_DEPTH; i++)
+		{
+			FtpClientManager* pExpected = pTenant;
+			m_slotOwners[i].manager.compare_exchange_strong(pExpected, nullptr);
+		}
+	}
+	pTenant->m_tenantQueue.held = 0;
+	pTenant->m_tenantQueue.heldBytes = 0;
+
+	updateOptions();
+}
+
+bool FtpConnectionHub::acquireTenant(FtpClientManager* pTenant)
+{
+	std::lock_guard<std::mutex> lock(m_tenantMutex);
+	for (auto& tenant : m_tenants)
+	{
+		if (tenant.manager == pTenant && !tenant.detaching)
+		{
+			tenant.users++;
+			return true;
+		}
+	}
+	return false;
+}
+
+void FtpConnectionHub::releaseTenant(FtpClientManager* pTenant)
+{
+	std::lock_guard<std::mutex> lock(m_tenantMutex);
+	for (auto& tenant : m_tenants)
+	{
+		if (tenant.manager == pTenant && tenant.users > 0)
+		{
+			if (0 == --tenant.users && tenant.detaching)
+			{
+				m_tenantCond.notify_all();
+			}
+			return;
+		}
+	}
+}
+
+std::vector<FtpClientManager*> FtpConnectionHub::acquireTenants()
+{
+	std::vector<FtpClientManager*> tenants;
+	std::lock_guard<std::mutex> lock(m_tenantMutex);
+	for (auto& tenant : m_tenants)
+	{
+		if (!tenant.detaching)
+		{
+			tenant.users++;
+			tenants.push_back(tenant.manager);
+		}
+	}
+	return tenants;
+}
+
+void FtpConnectionHub::releaseTenants(const std::vector<FtpClientManager*>& tenants)
+{
+	for (auto pTenant : tenants)
+	{
+		releaseTenant(pTenant);
+	}
+}
+
+void FtpConnectionHub::broadcast(FtpUploadCounter eCounter)
+{
+	// 连接是共用的, 登录失败/重登录/NOOP失败计入每个模块的统计
+	std::lock_guard<std::mutex> lock(m_tenantMutex);
+	for (auto& tenant : m_tenants)
+	{
+		tenant.manager->m_uploadStats.increment(eCounter);
+	}
+}
+
+size_t FtpConnectionHub::tenantCount()
+{
+	std::lock_guard<std::mutex> lock(m_tenantMutex);
+	return m_tenants.size();
+}
+
+size_t FtpConnectionHub::fairShare()
+{
+	size_t nShare = 0;
+	size_t nReserved = 0;
+	std::lock_guard<std::mutex> lock(m_produceMutex);
+	shareLocked(nullptr, FtpUploadStats::nowUs(), &nShare, &nReserved);
+	return nShare;
+}
+
+void FtpConnectionHub::shareLocked(FtpClientManager* pTenant, uint64_t nNowUs, size_t* pShare, size_t* pReserved) const
+{
+	// 只有最近在出图的模块分享帧缓冲, 停止触发的模块不占份额.
+	// 各模块的入队时刻和占用都是原子量, 上传连接更新占用时不需要持有本锁
+	size_t nActive = 0;
+	for (auto pProducer : m_producers)
+	{
+		if (pProducer == pTenant || nNowUs - pProducer->m_tenantQueue.lastEnqueueUs < kTenantIdleUs)
+		{
+			nActive++;
+		}
+	}
+	*pShare = std::max<size_t>(1, m_nStoreSize / std::max<size_t>(1, nActive));
+
+	// 其他模块尚未用满的份额为其保留
+	*pReserved = 0;
+	for (auto pProducer : m_producers)
+	{
+		if (pProducer != pTenant && nNowUs - pProducer->m_tenantQueue.lastEnqueueUs < kTenantIdleUs)
+		{
+			size_t nHeld = pProducer->m_tenantQueue.heldBytes;
+			*pReserved += (nHeld < *pShare) ? *pShare - nHeld : 0;
+		}
+	}
+}
+
+bool FtpConnectionHub::producingLocked(const FtpClientManager* pTenant) const
+{
+	return std::find(m_producers.begin(), m_producers.end(), pTenant) != m_producers.end();
+}
+
+void FtpConnectionHub::updateOptions()
+{
+	int nCount = 1;
+	bool bStandby = false;
+	int nTimeoutMs = 0;
+	{
+		std::lock_guard<std::mutex> lock(m_tenantMutex);
+		for (const auto& tenant : m_tenants)
+		{
+			if (!tenant.detaching)
+			{
+				nCount = std::max(nCount, tenant.manager->m_nConnectionCount.load());
+				bStandby = bStandby || tenant.manager->m_bStandbyEnable;
+				nTimeoutMs = std::max(nTimeoutMs, tenant.manager->m_nConnectTimeoutMs.load());
+			}
+		}
+	}
+	m_nConnectionCount = nCount;
+	m_bStandbyEnable = bStandby;
+	if (nTimeoutMs > 0)
+	{
+		m_nConnectTimeoutMs = nTimeoutMs;
+	}
+	m_wakeup.notify();
+}
+
+void FtpConnectionHub::setLogId(int nLogId)
+{
+	// 连接日志按首个挂上来的模块命名, 其他模块共用同一组日志文件
+	if (m_bLogIdSet.exchange(true))
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_sessionMutex);
+	std::string logFile = "/mnt/log/" + std::to_string(nLogId) + "ftp.log";
+	m_sessions[0]->client.add_observer(std::make_shared<FtpMonitor>(logFile));
+
+	for (size_t i = 1; i < m_sessions.size(); i++)
+	{
+		logFile = "/mnt/log/" + std::to_string(nLogId) + "ftp_" + std::to_string(i) + ".log";
+		m_sessions[i]->client.add_observer(std::make_shared<FtpMonitor>(logFile));
+	}
+
+	// 日志文件跟随连接对象, 备用连接接替后其日志记录的是接替的上传连接
+	logFile = "/mnt/log/" + std::to_string(nLogId) + "ftp_standby.log";
+	m_standby->client.add_observer(std::make_shared<FtpMonitor>(logFile));
+}
+
+void FtpConnectionHub::notify()
+{
+	m_wakeup.notify();
+}
+
+bool FtpConnectionHub::isConnect()
+{
+	std::lock_guard<std::mutex> lock(m_sessionMutex);
+	return m_sessions[0]->client.is_connected();
+}
+
+bool FtpConnectionHub::getReLoginState()
+{
+	std::lock_guard<std::mutex> lock(m_sessionMutex);
+	return m_sessions[0]->needLogin;
+}
+
+FtpSlotRingStats FtpConnectionHub::poolStats() const
+{
+	return m_slotRing.stats();
+}
+
+void FtpConnectionHub::dirCacheStats(unsigned long long* pHits, unsigned long long* pMisses)
+{
+	*pHits = 0;
+	*pMisses = 0;
+	std::lock_guard<std::mutex> lock(m_sessionMutex);
+	for (auto& session : m_sessions)
+	{
+		*pHits += session->dirCache.hits();
+		*pMisses += session->dirCache.misses();
+	}
+	*pHits += m_standby->dirCache.hits();
+	*pMisses += m_standby->dirCache.misses();
+}
+
+FtpClientManager* FtpConnectionHub::releaseOwner(SlotOwner& owner)
+{
+	// 取走所属模块的一方负责扣减, 同一帧的占用只扣减一次
+	FtpClientManager* pOwner = owner.manager.exchange(nullptr);
+	if (nullptr != pOwner)
+	{
+		pOwner->m_tenantQueue.held--;
+		pOwner->m_tenantQueue.heldBytes -= owner.bytes;
+	}
+	return pOwner;
+}
+
+bool FtpConnectionHub::evictOldestLocked(FtpClientManager* pTenant, int nPolicy, size_t nShare)
+{
+	// 只能挤掉环尾(最早且未在上传)的帧: 本模块drop-oldest时挤掉自己的,
+	// 或本模块未用满份额而环尾属于超额模块. 是否在上传以槽位状态为准,
+	// 环尾被上传连接领取时evictOldest失败, 不需要与上传连接争锁
+	size_t nOldest = m_slotRing.oldest();
+	if (FtpSlotRing::kInvalidSlot == nOldest)
+	{
+		return false;
+	}
+
+	SlotOwner& victim = m_slotOwners[nOldest];
+	FtpClientManager* pVictim = victim.manager;
+	if (nullptr != pVictim && !producingLocked(pVictim))
+	{
+		// 正在退出的模块的帧按已丢弃处理, 其占用由detach清零
+		pVictim = nullptr;
+	}
+
+	if (pVictim == pTenant)
+	{
+		if (FTP_OVERFLOW_DROP_OLDEST != nPolicy)
+		{
+			return false;
+		}
+	}
+	else if (nullptr != pVictim
+		&& !(pTenant->m_tenantQueue.heldBytes < nShare && pVictim->m_tenantQueue.heldBytes > nShare))
+	{
+		return false;
+	}
+
+	if (!m_slotRing.evictOldest(nOldest))
+	{
+		return false;
+	}
+	if (nullptr != pVictim && nullptr != releaseOwner(victim))
+	{
+		pVictim->m_tenantQueue.droppedOldest++;
+	}
+	return true;
+}
+
+int FtpConnectionHub::enqueue(FtpClientManager* pTenant, const struct FtpFifoParam *data,
+	int nPolicy, int nBlockTimeoutMs)
+{
+	FtpTenantQueue& queue = pTenant->m_tenantQueue;
+	const uint64_t nStartUs = FtpUploadStats::nowUs();
+	const uint64_t nDeadlineUs = nStartUs + (uint64_t)std::max(nBlockTimeoutMs, 0) * 1000;
+	const size_t nBytes = data->usedLen;
+	queue.lastEnqueueUs = nStartUs;
+
+	if (nBytes > m_nStoreSize)
+	{
+		LOGE("ftp frame larger than the store buffer, usedLen=%zu store=%zu file=%s\n",
+			nBytes, m_nStoreSize, data->fileName);
+		queue.droppedNewest++;
+		return IMVS_EC_NULL_PTR;
+	}
+
+	for (;;)
+	{
+		// 先取事件序号再尝试入队, 之后完成的槽位会使阻塞等待立即返回
+		uint64_t nEpoch = m_spaceWakeup.epoch();
+		size_t nSlot = FtpSlotRing::kInvalidSlot;
+		struct FtpFifoParam *param = nullptr;
+		{
+			// 槽位环的生产者调用在此串行, 锁内只预留槽位和帧缓冲. 上传连接只取m_queueMutex,
+			// 入队与出队互不等待: 挤帧和领取都以槽位状态的原子比较交换为准
+			std::lock_guard<std::mutex> produceLock(m_produceMutex);
+			if (!producingLocked(pTenant))
+			{
+				return IMVS_EC_NULL_PTR;
+			}
+			size_t nShare = 0;
+			size_t nReserved = 0;
+			shareLocked(pTenant, FtpUploadStats::nowUs(), &nShare, &nReserved);
+
+			// 份额以内可以入队; 超出份额时只能使用其他模块保留份额之外的空闲空间.
+			// 帧缓冲只能从环尾释放, 丢弃队列中间的帧腾不出空间, 因此超额时直接丢弃新帧
+			size_t nFree = m_slotRing.capacity() - m_slotRing.usedBytes();
+			if (queue.heldBytes < nShare || nFree >= nReserved + nBytes)
+			{
+				// 空间不足时从环尾挤出帧, 直到能放下本帧的连续空间
+				while (!m_slotRing.fits(nBytes) && evictOldestLocked(pTenant, nPolicy, nShare))
+				{
+				}
+				nSlot = m_slotRing.beginWrite(FTP_OVERFLOW_DROP_NEWEST, 0, nBytes);
+			}
+
+			if (FtpSlotRing::kInvalidSlot != nSlot)
+			{
+				// 模块退出时按m_slotOwners清除归属, 预留后即登记, 拷贝期间退出的帧被领取时丢弃
+				SlotOwner& owner = m_slotOwners[nSlot];
+				owner.bytes = nBytes;
+				owner.manager = pTenant;
+
+				queue.heldBytes += nBytes;
+				size_t nHeld = ++queue.held;
+				if (nHeld > queue.highWater)
+				{
+					queue.highWater = nHeld;
+				}
+				queue.enqueued++;
+				param = &m_fifoArray[nSlot];
+				param->image.data[0] = m_pStoreBuf + m_slotRing.offsetOf(nSlot);
+			}
+		}
+
+		if (FtpSlotRing::kInvalidSlot != nSlot)
+		{
+			// 槽位发布(commitWrite)之前上传连接看不到它, 各模块在锁外并行拷贝帧数据
+			param->usedLen = data->usedLen;
+			param->type = data->type;
+			snprintf(param->fileName, FILE_NAME_MAXSIZE, "%s", data->fileName);
+			snprintf(param->dirName, DIR_NAME_MAXSIZE, "%s", data->dirName);
+
+			param->image.format = data->image.format;
+			param->image.width = data->image.width;
+			param->image.height = data->image.height;
+			param->image.step[0] = data->image.step[0];
+			memcpy(param->image.data[0], data->image.data[0], data->usedLen);
+			param->enqueueUs = FtpUploadStats::nowUs();
+
+			{
+				// 先拷贝完的帧等待更早预留的帧, 槽位仍按预留顺序发布
+				std::lock_guard<std::mutex> produceLock(m_produceMutex);
+				m_slotRing.commitWrite(nSlot, FtpSlotRing::orderKey(param->dirName));
+			}
+			m_wakeup.notify();
+			return IMVS_EC_OK;
+		}
+
+		// 阻塞策略在锁外等待槽位完成, 不妨碍其他模块入队
+		if (FTP_OVERFLOW_BLOCK != nPolicy)
+		{
+			queue.droppedNewest++;
+			return IMVS_EC_NULL_PTR;
+		}
+		uint64_t nNowUs = FtpUploadStats::nowUs();
+		if (nNowUs >= nDeadlineUs)
+		{
+			queue.blockTimeouts++;
+			return IMVS_EC_NULL_PTR;
+		}
+		// 其他模块停止出图后份额变大, 没有槽位完成时也按空闲判定周期重试
+		m_spaceWakeup.waitUntil(nEpoch, std::min(nDeadlineUs, nNowUs + kTenantIdleUs));
+	}
+}
+
+size_t FtpConnectionHub::claimSlot(FtpClientManager** ppOwner)
+{
+	std::lock_guard<std::mutex> lock(m_queueMutex);
+	*ppOwner = nullptr;
+	for (;;)
+	{
+		size_t nSlot = m_slotRing.claim();
+		if (FtpSlotRing::kInvalidSlot == nSlot)
+		{
+			return nSlot;
+		}
+
+		// 已丢弃的帧就地完成, 尽早归还其占用的帧缓冲
+		FtpClientManager* pManager = m_slotOwners[nSlot].manager;
+		if (nullptr == pManager)
+		{
+			m_slotRing.complete(nSlot);
+			m_spaceWakeup.notify();
+			continue;
+		}
+
+		if (acquireTenant(pManager))
+		{
+			*ppOwner = pManager;
+		}
+		return nSlot;
+	}
+}
+
+void FtpConnectionHub::finishSlot(size_t nSlot, bool bDone)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		if (bDone)
+		{
+			releaseOwner(m_slotOwners[nSlot]);
+			m_slotRing.complete(nSlot);
+		}
+		else
+		{
+			// 上传失败放回待传状态, 由任一已登录的连接重新上传
+			m_slotRing.release(nSlot);
+		}
+	}
+
+	// 槽位完成或放回后, 同目录的后续帧可被其他空闲连接领取
+	m_wakeup.notify();
+	if (bDone)
+	{
+		m_spaceWakeup.notify();
+	}
+}
+
+bool FtpConnectionHub::validSlot(const struct FtpFifoParam* pParam)
+{
+	if (0 == m_nStoreSize || nullptr == m_fifoArray || nullptr == m_pStoreBuf)
+	{
+		LOGE("ftp memory not ready, storeSize=%zu fifo=%p\n", m_nStoreSize, m_fifoArray);
+		return false;
+	}
+
+	// 帧数据必须整体落在帧缓冲内
+	uintptr_t out_addr = (uintptr_t)pParam->image.data[0];
+	uintptr_t store_start = (uintptr_t)m_pStoreBuf;
+	uintptr_t store_end = store_start + (uintptr_t)m_nStoreSize;
+	uintptr_t out_end = out_addr + (uintptr_t)pParam->usedLen;
+	if ((out_end < out_addr) || (out_addr < store_start) || (out_end > store_end))
+	{
+		LOGE("ftp output ptr invalid, out=%p usedLen=%u store=[0x%zx,0x%zx) type=%d file=%s\n",
+			pParam->image.data[0], pParam->usedLen, (size_t)store_start, (size_t)store_end,
+			pParam->type, pParam->fileName);
+		return false;
+	}
+	return true;
+}
+
+bool FtpConnectionHub::uploadNextSlot(FtpSession& session)
+{
+	FtpClientManager* pOwner = nullptr;
+	size_t nSlot = claimSlot(&pOwner);
+	if (FtpSlotRing::kInvalidSlot == nSlot)
+	{
+		return false;
+	}
+
+	// 所属模块已退出的帧直接丢弃
+	bool bDone = true;
+	if (nullptr != pOwner)
+	{
+		struct FtpFifoParam* pParam = &m_fifoArray[nSlot];
+		if (!validSlot(pParam))
+		{
+			pOwner->m_uploadStats.increment(FTP_COUNTER_FAILURES);
+		}
+		else
+		{
+			// 上传期间槽位由本连接持有, 生产者无法覆盖, 上传流直接引用槽内存
+			try
+			{
+				pOwner->handleFifoData(session, pParam);
+			}
+			catch (const std::exception &e)
+			{
+				LOGE("Exception during file upload on connection %d: %s\n", session.index, e.what());
+				// 槽位放回队列, 重登录后重传
+				pOwner->m_uploadStats.increment(FTP_COUNTER_FAILURES);
+				pOwner->m_uploadStats.increment(FTP_COUNTER_RETRIES);
+				logout(session);
+				session.needLogin = true;
+				bDone = false;
+			}
+		}
+		releaseTenant(pOwner);
+	}
+
+	finishSlot(nSlot, bDone);
+	return true;
+}
+
+void FtpConnectionHub::spoolReadySlots(FtpSession& session)
+{
+	// 断线期间逐个取出待传帧: 所属模块开启spool时写入该模块的spool, 否则丢弃
+	while (!m_bEnd)
+	{
+		FtpClientManager* pOwner = nullptr;
+		size_t nSlot = claimSlot(&pOwner);
+		if (FtpSlotRing::kInvalidSlot == nSlot)
+		{
+			break;
+		}
+
+		if (nullptr != pOwner)
+		{
+			struct FtpFifoParam* pParam = &m_fifoArray[nSlot];
+			if (validSlot(pParam))
+			{
+				pOwner->spoolSlot(session, pParam);
+			}
+			releaseTenant(pOwner);
+		}
+		finishSlot(nSlot, true);
+	}
+}
+
+bool FtpConnectionHub::anyConnected()
+{
+	std::lock_guard<std::mutex> lock(m_sessionMutex);
+	for (size_t i = 0; i < m_sessions.size() && (int)i < m_nConnectionCount; i++)
+	{
+		if (!m_sessions[i]->needLogin && m_sessions[i]->client.is_connected())
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool FtpConnectionHub::replaySpool(FtpSession& session, const std::vector<FtpClientManager*>& tenants)
+{
+	// 各模块轮流回放一条, 一个模块积压很多记录时其他模块不必等它回放完
+	for (size_t i = 0; i < tenants.size(); i++)
+	{
+		size_t nIndex = (m_nReplayCursor + i) % tenants.size();
+		if (tenants[nIndex]->replaySpool(session))
+		{
+			m_nReplayCursor = nIndex + 1;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool FtpConnectionHub::taskProc(FtpSession& session)
+{
+	std::function<void(FtpSession&)> task;
+	{
+		std::lock_guard<std::mutex> lock(m_taskMutex);
+		if (!m_taskQueue.empty())
+		{
+			task = std::move(m_taskQueue.front());
+			m_taskQueue.pop();
+		}
+	}
+
+	if (task)
+	{
+		task(session);
+		return true;
+	}
+	return false;
+}
+
+bool FtpConnectionHub::performLogin(FtpSession& session)
+{
+	bool bLogin = false;
+	try
+	{
+		logout(session);
+		bLogin = login(session);
+	}
+	catch (const std::exception &e)
+	{
+		LOGE("FTP exception during login: %s\n", e.what());
+	}
+
+	if (!bLogin)
+	{
+		// 连续失败时重试间隔逐次翻倍并加随机抖动, 短暂中断后的首次重试仍然很快
+		broadcast(FTP_COUNTER_LOGIN_FAILURES);
+		session.loginRetryUs = FtpUploadStats::nowUs() + session.backoff.next();
+		return false;
+	}
+	if (session.everLoggedIn)
+	{
+		broadcast(FTP_COUNTER_RELOGINS);
+	}
+	session.everLoggedIn = true;
+	session.backoff.reset();
+	session.needLogin = false;
+	session.loginRetryUs = 0;
+	return true;
+}
+
+bool FtpConnectionHub::login(FtpSession& session)
+{
+	// 客户端库用阻塞socket连接, 服务器不可达时要等内核多次重发SYN; 先按超时探测一次
+	std::string strError;
+	if (!FtpProbeConnect(m_config.addr, m_config.port, m_nConnectTimeoutMs, &strError))
+	{
+		LOGE("FTP server %s:%u unreachable: %s\n", m_config.addr.c_str(), m_config.port, strError.c_str());
+		return false;
+	}
+
+	ftp::client& client = session.client;
+	ftp::replies replies = client.connect(m_config.addr, m_config.port);
+
+	if (!replies.get_replies().empty() && !replies.get_replies().back().is_positive())
+	{
+		LOGE("Failed to connect to FTP server.\n");
+		return false;
+	}
+
+	if (m_config.anonymousLogin)
+	{
+		replies = client.login("anonymous", "anonymous");
+	}
+	else
+	{
+		replies = client.login(m_config.username, m_config.password);
+	}
+
+	if (!replies.get_replies().empty() && !replies.get_replies().back().is_positive())
+	{
+		LOGE("Failed to login with provided credentials.\n");
+		return false;
+	}
+
+	// 同一账号登录后的根目录不变, 重登录时不再查询
+	if (session.rootDirServer.empty())
+	{
+		ftp::reply reply = client.get_current_directory();
+		if (reply.is_negative())
+		{
+			LOGE("Failed get server root directory: %s\n", reply.get_status_string().c_str());
+			return false;
+		}
+		session.rootDirServer = FtpDirCache::joinPath(m_utils.extractDirectory(reply.get_status_string()), "");
+	}
+
+	// 目录缓存只对本次登录有效
+	session.dirCache.clear();
+
+	return true;
+}
+
+void FtpConnectionHub::logout(FtpSession& session)
+{
+	try
+	{
+		if (session.client.is_connected())
+		{
+			try
+			{
+				//scmvs自带服务器不支持重置指令
+				//session.client.logout();
+
+				session.client.disconnect(true);
+			}
+			catch (const std::exception &e)
+			{
+				LOGE("Graceful disconnect failed: %s\n", e.what());
+				session.client.disconnect(false);
+			}
+		}
+	}
+	catch (const std::exception &e)
+	{
+		LOGE("Exception during logout: %s\n", e.what());
+	}
+}
+
+int FtpConnectionHub::noopCheckAsync()
+{
+	std::promise<int> promise;
+	std::future<int> future = promise.get_future();
+
+	{
+		std::lock_guard<std::mutex> lock(m_taskMutex);
+		m_taskQueue.emplace([this, &promise](FtpSession& session) {
+			try
+			{
+				ftp::reply reply = session.client.send_noop();
+				if (!reply.is_positive())
+				{
+					LOGE("Noop asyn test failed, need to relogin.\n");
+					broadcast(FTP_COUNTER_NOOP_FAILURES);
+					session.needLogin = true;
+					promise.set_value(IMVS_EC_PARAM);
+				}
+				else
+				{
+					LOGD("Noop asyn test succeeded.\n");
+					promise.set_value(IMVS_EC_OK);
+				}
+			}
+			catch (const std::exception &e)
+			{
+				LOGE("Exception during noop asyn test: %s\n", e.what());
+				broadcast(FTP_COUNTER_NOOP_FAILURES);
+				logout(session);
+				session.needLogin = true;
+				promise.set_value(IMVS_EC_COMMU_INVALID_ADDRESS);
+			}
+		});
+	}
+	m_wakeup.notify();
+
+	// 调用方持有连接池的引用, 主连接线程在连接池析构前一定会执行该任务
+	return future.get();
+}
+
+int FtpConnectionHub::noopCheck(FtpSession& session)
+{
+	try
+	{
+		ftp::reply reply = session.client.send_noop();
+		if (!reply.is_positive())
+		{
+			LOGE("Noop test failed, need to relogin.\n");
+			broadcast(FTP_COUNTER_NOOP_FAILURES);
+			session.needLogin = true;
+			return IMVS_EC_PARAM;
+		}
+		else
+		{
+			LOGD("Noop test succeeded.\n");
+		}
+	}
+	catch (const std::exception &e)
+	{
+		LOGE("Exception during noop test: %s\n", e.what());
+		broadcast(FTP_COUNTER_NOOP_FAILURES);
+		logout(session);
+		session.needLogin = true;
+		return IMVS_EC_PARAM;
+	}
+
+	return IMVS_EC_OK;
+}
+
+bool FtpConnectionHub::promoteStandby(int nIndex)
+{
+	if (!m_bStandbyEnable)
+	{
+		return false;
+	}
+
+	FtpSession* pStandby = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(m_sessionMutex);
+		if (m_bStandbyBusy || m_standby->needLogin || !m_standby->client.is_connected())
+		{
+			return false;
+		}
+		m_bStandbyBusy = true;
+		pStandby = m_standby.get();
+	}
+
+	// 空闲的备用连接可能已被服务器断开, 接替前用一次NOOP确认
+	bool bAlive = (IMVS_EC_OK == noopCheck(*pStandby));
+	{
+		std::lock_guard<std::mutex> lock(m_sessionMutex);
+		m_bStandbyBusy = false;
+		if (bAlive)
+		{
+			// 断开的连接转为备用, 由备用线程立即重新登录, 失败后按退避间隔重试
+			m_sessions[nIndex]->spoolStream.close();
+			std::swap(m_sessions[nIndex], m_standby);
+			m_sessions[nIndex]->index = nIndex;
+			m_standby->index = FTP_STANDBY_INDEX;
+			m_standby->needLogin = true;
+			m_standby->loginRetryUs = 0;
+		}
+	}
+	m_wakeup.notify();
+
+	if (!bAlive)
+	{
+		return false;
+	}
+	LOGI("Connection %d switched to the standby login.\n", nIndex);
+	broadcast(FTP_COUNTER_FAILOVERS);
+	return true;
+}
+
+void FtpConnectionHub::startWorkers()
+{
+	while (m_nStartedWorkers + 1 < m_nConnectionCount && m_nStartedWorkers + 1 < FTP_MAX_CONNECTIONS)
+	{
+		FtpWorkerArg* arg = new FtpWorkerArg;
+		arg->instance = this;
+		arg->index = m_nStartedWorkers + 1;
+
+		m_nRunningWorkers++;
+		pthread_t ftpWorkerThread;
+		int ret = thread_spawn_ex(&ftpWorkerThread, 0,
+									SCHED_POLICY_RR,
+									SCHED_PRI_HIGH_50,
+									10 * 1024,
+									ftpWorkerProcThread, arg);
+		if (ret < 0)
+		{
+			LOGE("ftp worker %d thread creation failed!\r\n", arg->index);
+			m_nRunningWorkers--;
+			delete arg;
+			return;
+		}
+		m_nStartedWorkers++;
+	}
+
+	if (m_bStandbyEnable && !m_bStandbyStarted)
+	{
+		m_nRunningWorkers++;
+		pthread_t ftpStandbyThread;
+		int ret = thread_spawn_ex(&ftpStandbyThread, 0,
+									SCHED_POLICY_RR,
+									SCHED_PRI_HIGH_50,
+									10 * 1024,
+									ftpStandbyProcThread, this);
+		if (ret < 0)
+		{
+			LOGE("ftp standby thread creation failed!\r\n");
+			m_nRunningWorkers--;
+			return;
+		}
+		m_bStandbyStarted = true;
+	}
+}
+
+void FtpConnectionHub::ftpWorkerProc(int nIndex)
+{
+	char szName[16] = {0};
+	snprintf(szName, sizeof(szName), "ftp_client%d", nIndex);
+	thread_set_name(szName);
+
+	// 先取事件序号再检查退出标志和任务, 之后到达的事件会使等待立即返回
+	for (uint64_t nEpoch = m_wakeup.epoch(); !m_bEnd; nEpoch = m_wakeup.epoch())
+	{
+		// 会话只由本线程交换, 每轮重新取得
+		FtpSession& session = *m_sessions[nIndex];
+
+		// 连接数调小后多余的连接退出登录并空闲, 调大时由updateOptions唤醒
+		if (nIndex >= m_nConnectionCount)
+		{
+			logout(session);
+			m_wakeup.waitUntil(nEpoch, FtpWakeup::kNoDeadline);
+			continue;
+		}
+
+		if (session.needLogin || !session.client.is_connected())
+		{
+			// 有就绪的备用连接时直接接替, 上传失败放回的帧随即重传
+			if (promoteStandby(nIndex))
+			{
+				continue;
+			}
+
+			if (FtpUploadStats::nowUs() < session.loginRetryUs)
+			{
+				m_wakeup.waitUntil(nEpoch, session.loginRetryUs);
+				continue;
+			}
+
+			if (!performLogin(session))
+			{
+				LOGE("Connection %d failed to login to FTP server.\n", nIndex);
+				continue;
+			}
+			LOGI("Connection %d logged in to FTP server.\n", nIndex);
+		}
+
+		if (!uploadNextSlot(session))
+		{
+			m_wakeup.waitUntil(nEpoch, FtpWakeup::kNoDeadline);
+		}
+	}
+
+	logout(*m_sessions[nIndex]);
+
+	m_nRunningWorkers--;
+	LOGI("FtpConnectionHub worker %d stopped.\n", nIndex);
+}
+
+void FtpConnectionHub::ftpClientProc()
+{
+	uint64_t nLastActiveUs = FtpUploadStats::nowUs();
+
+	thread_set_name("ftp_client");
+
+	// 先取事件序号再检查退出标志和任务, 之后到达的事件会使等待立即返回
+	for (uint64_t nEpoch = m_wakeup.epoch(); !m_bEnd; nEpoch = m_wakeup.epoch())
+	{
+		// 会话只由本线程交换, 每轮重新取得
+		FtpSession& session = *m_sessions[0];
+		uint64_t nNowUs = FtpUploadStats::nowUs();
+		bool bBusy = false;
+
+		if (session.needLogin && promoteStandby(0))
+		{
+			nLastActiveUs = nNowUs;
+			continue;
+		}
+
+		if (session.needLogin && nNowUs >= session.loginRetryUs)
+		{
+			LOGD("Need relogged in. Attempting to login...\n");
+
+			if (!performLogin(session))
+			{
+				LOGE("Failed to login to FTP server.\n");
+			}
+			else
+			{
+				LOGI("Successfully logged in to FTP server.\n");
+				bBusy = true;
+			}
+		}
+
+		startWorkers();
+
+		// 本轮持有各模块的引用, 等待前释放, 模块退出时最多等待当前这一轮
+		std::vector<FtpClientManager*> tenants = acquireTenants();
+
+		if (taskProc(session))
+		{
+			bBusy = true;
+		}
+		// 每个模块每轮最多处理一个日志文件和一次文本上传, 轮流使用主连接
+		for (auto pTenant : tenants)
+		{
+			if (pTenant->taskProc(session))
+			{
+				bBusy = true;
+			}
+		}
+
+		if (!session.client.is_connected())
+		{
+			// 连接池全部断线时, 开启spool的帧写入本地存储, 重连后回放; 否则丢弃.
+			// 仍有已登录的上传连接时帧留给它们, 上传失败放回的帧也由它们重传
+			if (!anyConnected())
+			{
+				spoolReadySlots(session);
+			}
+			for (auto pTenant : tenants)
+			{
+				pTenant->onDisconnected();
+			}
+		}
+
+		// 实时帧优先, 没有实时帧时按限速回放spool. 主连接未登录时不取帧,
+		// 否则每帧都失败放回, 空转到登录退避到期
+		if (!session.needLogin && session.client.is_connected()
+			&& (uploadNextSlot(session) || replaySpool(session, tenants)))
+		{
+			bBusy = true;
+		}
+
+		nNowUs = FtpUploadStats::nowUs();
+		if (bBusy)
+		{
+			releaseTenants(tenants);
+			nLastActiveUs = nNowUs;
+			continue;
+		}
+
+		// 空闲时只按定时器唤醒: 登录退避到期, 或空闲10秒进行一次连接检测
+		uint64_t nDeadlineUs = FtpWakeup::kNoDeadline;
+		bool bKeepalive = false;
+		if (session.needLogin)
+		{
+			nDeadlineUs = session.loginRetryUs;
+		}
+		else if (session.client.is_connected())
+		{
+			if (nNowUs - nLastActiveUs >= kKeepaliveIntervalUs)
+			{
+				bKeepalive = true;
+			}
+			nDeadlineUs = nLastActiveUs + kKeepaliveIntervalUs;
+			for (auto pTenant : tenants)
+			{
+				nDeadlineUs = std::min(nDeadlineUs, pTenant->nextDueUs(nNowUs));
+			}
+		}
+		releaseTenants(tenants);
+
+		if (bKeepalive)
+		{
+			noopCheck(session);
+			nLastActiveUs = nNowUs;
+			continue;
+		}
+		m_wakeup.waitUntil(nEpoch, nDeadlineUs);
+	}
+
+	logout(*m_sessions[0]);
+	m_sessions[0]->spoolStream.close();
+
+	m_bRunning = false;
+	LOGI("FtpConnectionHub thread stopped.\n");
+}
+
+void FtpConnectionHub::ftpStandbyProc()
+{
+	uint64_t nLastActiveUs = 0;
+
+	thread_set_name("ftp_standby");
+
+	for (uint64_t nEpoch = m_wakeup.epoch(); !m_bEnd; nEpoch = m_wakeup.epoch())
+	{
+		// 上传线程正在接替备用连接时等其完成, 完成后会唤醒本线程
+		FtpSession* pSession = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(m_sessionMutex);
+			if (!m_bStandbyBusy)
+			{
+				m_bStandbyBusy = true;
+				pSession = m_standby.get();
+			}
+		}
+		if (nullptr == pSession)
+		{
+			m_wakeup.waitUntil(nEpoch, FtpWakeup::kNoDeadline);
+			continue;
+		}
+
+		const uint64_t nNowUs = FtpUploadStats::nowUs();
+		uint64_t nDeadlineUs = FtpWakeup::kNoDeadline;
+		bool bRetry = false;
+		if (!m_bStandbyEnable)
+		{
+			// 各模块都关闭备用连接后退出登录, 重新开启时再登录
+			logout(*pSession);
+			pSession->needLogin = true;
+		}
+		else if (pSession->needLogin || !pSession->client.is_connected())
+		{
+			if (nNowUs < pSession->loginRetryUs)
+			{
+				nDeadlineUs = pSession->loginRetryUs;
+			}
+			else
+			{
+				if (performLogin(*pSession))
+				{
+					LOGI("Standby connection logged in to FTP server.\n");
+				}
+				else
+				{
+					LOGE("Standby connection failed to login to FTP server.\n");
+				}
+				nLastActiveUs = nNowUs;
+				bRetry = true;
+			}
+		}
+		else if (nNowUs - nLastActiveUs >= kKeepaliveIntervalUs)
+		{
+			// 空闲连接同样定时NOOP, 保证接替时连接可用
+			noopCheck(*pSession);
+			nLastActiveUs = nNowUs;
+			bRetry = true;
+		}
+		else
+		{
+			nDeadlineUs = nLastActiveUs + kKeepaliveIntervalUs;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_sessionMutex);
+			m_bStandbyBusy = false;
+		}
+		if (!bRetry)
+		{
+			m_wakeup.waitUntil(nEpoch, nDeadlineUs);
+		}
+	}
+
+	m_nRunningWorkers--;
+	LOGI("FtpConnectionHub standby stopped.\n");
+}
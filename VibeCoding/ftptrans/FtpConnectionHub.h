@@ -0,0 +1,318 @@
+#ifndef FTP_CONNECTION_HUB_H
+#define FTP_CONNECTION_HUB_H
+
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include <ftp/client.hpp>
+
+#include "hka_types.h"
+#include "FtpBackoff.h"
+#include "FtpBmpStream.h"
+#include "FtpClientUtils.h"
+#include "FtpDirCache.h"
+#include "FtpLosslessCodec.h"
+#include "FtpSlotRing.h"
+#include "FtpSlotStream.h"
+#include "FtpSpool.h"
+#include "FtpUploadStats.h"
+#include "FtpWakeup.h"
+#include "FtpZipReader.h"
+
+#define FILE_NAME_MAXSIZE 256
+#define DIR_NAME_MAXSIZE 256
+
+enum eTransportOption
+{
+	TO_JPG = 0,
+	TO_BMP = 1,
+	TO_LOG = 2,
+	TO_TXT = 3,
+	TO_SPOOL = 4,		///< 内部类型: 回放本地spool中的待上传文件
+	TO_FLI = 5			///< 无损压缩(.fli), 上传线程按条带边压缩边发送
+};
+
+// 定义FTP FIFO参数结构体
+struct FtpFifoParam
+{
+	uint32_t usedLen;
+	HKA_IMAGE image;
+	char fileName[FILE_NAME_MAXSIZE];
+	char dirName[DIR_NAME_MAXSIZE];
+	int  type;
+	uint64_t enqueueUs;		///< 入队时刻(us), 出队时统计排队耗时后清零
+};
+
+/**
+ * @brief 登录FTP服务器所需的参数, 参数完全相同的模块共用一个FtpConnectionHub
+ */
+struct FtpServerConfig
+{
+	std::string addr;					///< FTP服务器地址
+	unsigned short port;				///< FTP服务器端口
+	std::string username; 				///< FTP登录用户名
+	std::string password; 				///< FTP登录密码
+	bool anonymousLogin;				///< 匿名登录
+
+	FtpServerConfig() : port(0), anonymousLogin(false) {}
+
+	bool operator==(const FtpServerConfig& other) const
+	{
+		return addr == other.addr && port == other.port && anonymousLogin == other.anonymousLogin
+			&& (anonymousLogin || (username == other.username && password == other.password));
+	}
+};
+
+/**
+ * @brief 单条FTP连接的状态, 每个上传线程独占一个; 备用连接接替时与上传线程的会话整体交换
+ */
+struct FtpSession
+{
+	int index;								///< 连接序号, 0为主连接, FTP_STANDBY_INDEX为备用连接
+	ftp::client client;						///< FTP控制/数据连接
+	std::atomic<bool> needLogin;			///< 需要重新登录
+	std::string rootDirServer;				///< 登录后服务器返回的根目录
+	std::string currentDir;					///< 当前上传目录的绝对路径前缀, 以'/'结尾
+	FtpDirCache dirCache;					///< 本次登录已确认存在的目录, 各模块共用
+	FtpSlotIStream slotStream;				///< 直接引用FIFO槽内存的上传流, 逐帧复用
+	FtpBmpIStream bmpStream;				///< BMP边读边编码的上传流, 逐帧复用
+	FtpLosslessIStream fliStream;			///< FLI边读边压缩的上传流, 逐帧复用
+	std::ifstream logStream;				///< 日志文件上传流
+	FtpZipEntryIStream logZipStream;		///< 日志归档条目上传流, 边解压边上传
+	FtpSpoolIStream spoolStream;			///< spool记录回放流, 仅主连接使用
+	bool everLoggedIn;						///< 曾登录成功过, 之后的登录计为重登录
+	std::atomic<uint64_t> loginRetryUs;		///< 登录失败后的下次重试时刻(FtpUploadStats::nowUs), 0表示立即
+	FtpBackoff backoff;						///< 连续登录失败的退避间隔, 登录成功后复位
+
+	FtpSession(int nIndex, uint64_t nBackoffBaseUs, uint64_t nBackoffCapUs, uint32_t nSeed)
+		: index(nIndex), needLogin(true), everLoggedIn(false), loginRetryUs(0),
+		  backoff(nBackoffBaseUs, nBackoffCapUs, nSeed) {}
+};
+
+/**
+ * @brief 单个模块在共享槽位池中的排队统计, 由模块持有, 连接池在入队/出队时更新
+ */
+struct FtpTenantQueue
+{
+	std::atomic<size_t> held;				///< 当前占用的槽位(待传+上传中)
+	std::atomic<size_t> heldBytes;			///< 当前占用的帧数据字节数
+	std::atomic<size_t> highWater;
+	std::atomic<uint64_t> enqueued;
+	std::atomic<uint64_t> droppedNewest;	///< 新帧被丢弃(含超出公平份额时)
+	std::atomic<uint64_t> droppedOldest;	///< 已入队的帧被挤出(本模块或其他模块入队时)
+	std::atomic<uint64_t> blockTimeouts;
+	std::atomic<uint64_t> lastEnqueueUs;	///< 最近一次入队时刻, 据此判断模块是否仍在出图
+
+	FtpTenantQueue()
+		: held(0), heldBytes(0), highWater(0), enqueued(0), droppedNewest(0), droppedOldest(0), blockTimeouts(0),
+		  lastEnqueueUs(0) {}
+};
+
+class FtpClientManager;
+
+/**
+ * @brief 进程内共享的FTP连接池
+ *
+ * 服务器参数(FtpServerConfig)相同的FtpClientManager挂到同一个连接池上, 共用登录会话、
+ * 上传线程和帧缓冲. 帧数据按实际长度从一块FTP_FIFO_RAW_FRAMES个原始帧大小的环形缓冲中
+ * 分配, 文件名/目录/图像参数放在FTP_FIFO_DEPTH个描述符槽位中, 小的JPG可以排更多帧.
+ * 每个槽位记录所属模块, 上传统计、spool和文本/日志传输仍按模块区分. 最近在出图的模块
+ * 各保底缓冲字节数/模块数的份额, 超出部分只能占用其他模块份额之外的空闲空间, 一个模块
+ * 积压不会挤掉其他模块的帧. 最后一个模块退出时连接池退出登录并释放缓冲.
+ *
+ * 任一模块开启备用连接时, 另有一个线程保持一条已登录的空闲连接; 上传连接断开后其线程
+ * 直接换上备用连接继续上传, 断开的连接转为备用并在后台按退避间隔重新登录.
+ */
+class FtpConnectionHub
+{
+public:
+	static constexpr auto FTP_FIFO_DEPTH = 128;			///< 描述符槽位数, 限制排队的帧数
+	static constexpr auto FTP_FIFO_RAW_FRAMES = 6;		///< 帧缓冲字节数 = 该数目 * SENSOR_SIZE
+	static constexpr auto FTP_MAX_CONNECTIONS = 4;
+	static constexpr auto FTP_STANDBY_INDEX = FTP_MAX_CONNECTIONS;	///< 备用连接的序号
+
+	/**
+	 * @brief 取得与config对应的连接池, 不存在时创建并启动
+	 * @return 失败(内存不足/线程创建失败)返回nullptr
+	 */
+	static std::shared_ptr<FtpConnectionHub> acquire(const FtpServerConfig& config);
+
+	explicit FtpConnectionHub(const FtpServerConfig& config);
+
+	~FtpConnectionHub();
+
+	void attach(FtpClientManager* pTenant);
+
+	/**
+	 * @brief 移除模块: 等待正在为其上传的线程结束, 其未上传的帧随后被丢弃
+	 */
+	void detach(FtpClientManager* pTenant);
+
+	int enqueue(FtpClientManager* pTenant, const struct FtpFifoParam *data, int nPolicy, int nBlockTimeoutMs);
+
+	/**
+	 * @brief 汇总各模块的连接配置: 上传连接数和连接超时取最大值, 任一模块开启即启用备用连接
+	 */
+	void updateOptions();
+
+	void setLogId(int nLogId);
+
+	void notify();
+
+	bool isConnect();
+
+	bool getReLoginState();
+
+	int noopCheckAsync();
+
+	size_t tenantCount();
+
+	FtpSlotRingStats poolStats() const;
+
+	void dirCacheStats(unsigned long long* pHits, unsigned long long* pMisses);
+
+	/**
+	 * @brief 每个正在出图的模块保底可占用的帧缓冲字节数
+	 */
+	size_t fairShare();
+
+	/**
+	 * @brief 断开连接, 调用方随后置needLogin由所属线程重新登录
+	 */
+	static void logout(FtpSession& session);
+
+	void ftpClientProc();
+
+	void ftpWorkerProc(int nIndex);
+
+	void ftpStandbyProc();
+
+private:
+	struct Tenant
+	{
+		FtpClientManager* manager;
+		int users;							///< 正在使用该模块的连接线程数
+		bool detaching;
+	};
+
+	/**
+	 * 入队线程在发布槽位前写入; 之后谁把manager换成nullptr谁负责扣减该模块的占用,
+	 * 上传中与否以m_slotRing的槽位状态为准
+	 */
+	struct SlotOwner
+	{
+		std::atomic<FtpClientManager*> manager;	///< nullptr表示空闲或帧已丢弃
+		size_t bytes;						///< 计入所属模块的帧数据长度
+
+		SlotOwner() : manager(nullptr), bytes(0) {}
+	};
+
+	int start();
+
+	void stop();
+
+	bool acquireTenant(FtpClientManager* pTenant);
+
+	void releaseTenant(FtpClientManager* pTenant);
+
+	std::vector<FtpClientManager*> acquireTenants();
+
+	void releaseTenants(const std::vector<FtpClientManager*>& tenants);
+
+	void broadcast(FtpUploadCounter eCounter);
+
+	/**
+	 * @brief 以下三个方法由入队线程持有m_produceMutex调用, 不与上传连接争锁
+	 */
+	void shareLocked(FtpClientManager* pTenant, uint64_t nNowUs, size_t* pShare, size_t* pReserved) const;
+
+	bool producingLocked(const FtpClientManager* pTenant) const;
+
+	bool evictOldestLocked(FtpClientManager* pTenant, int nPolicy, size_t nShare);
+
+	/**
+	 * @brief 取走槽位的所属模块并扣减其占用, 返回该模块; 已被取走时返回nullptr
+	 */
+	FtpClientManager* releaseOwner(SlotOwner& owner);
+
+	size_t claimSlot(FtpClientManager** ppOwner);
+
+	void finishSlot(size_t nSlot, bool bDone);
+
+	bool validSlot(const struct FtpFifoParam* pParam);
+
+	bool uploadNextSlot(FtpSession& session);
+
+	void spoolReadySlots(FtpSession& session);
+
+	/**
+	 * @brief 连接池中是否还有已登录的连接, 有则待传帧留给该连接, 不写入spool
+	 */
+	bool anyConnected();
+
+	bool replaySpool(FtpSession& session, const std::vector<FtpClientManager*>& tenants);
+
+	bool taskProc(FtpSession& session);
+
+	bool performLogin(FtpSession& session);
+
+	bool login(FtpSession& session);
+
+	int noopCheck(FtpSession& session);
+
+	/**
+	 * @brief 用已登录的备用连接替换nIndex号连接, 由该连接所属线程调用
+	 * @return 备用连接未开启/未就绪时返回false, 调用方照常重新登录
+	 */
+	bool promoteStandby(int nIndex);
+
+	void startWorkers();
+
+	const FtpServerConfig m_config;
+	char* m_pStoreBuf;							///< 帧数据环形缓冲, 按m_slotRing分配的偏移使用
+	size_t m_nStoreSize;
+
+	FtpClientUtils m_utils;
+
+	std::vector<std::unique_ptr<FtpSession>> m_sessions;
+	std::unique_ptr<FtpSession> m_standby;		///< 备用连接, 与m_sessions的交换由m_sessionMutex保护
+	std::mutex m_sessionMutex;
+	bool m_bStandbyBusy;						///< 备用线程正在登录或检测, 此时不能被接替
+	std::atomic<int> m_nConnectionCount;		///< 各模块配置的上传连接数的最大值
+	std::atomic<bool> m_bStandbyEnable;
+	std::atomic<bool> m_bStandbyStarted;
+	std::atomic<int> m_nConnectTimeoutMs;		///< 各模块配置的连接超时的最大值
+	std::atomic<int> m_nStartedWorkers;		///< 已启动的附加上传线程数
+	std::atomic<int> m_nRunningWorkers;		///< 仍在运行的附加上传线程数
+	std::atomic<bool> m_bLogIdSet;				///< 连接日志只按第一个模块的日志号打开一次
+
+	struct FtpFifoParam* m_fifoArray;
+	std::unique_ptr<SlotOwner[]> m_slotOwners;	///< 各槽位所属模块
+	FtpSlotRing m_slotRing;						///< 生产者侧由m_produceMutex串行化, 入队不取m_queueMutex
+	size_t m_nReplayCursor;						///< 各模块spool轮流回放的起点, 仅主连接线程使用
+
+	std::atomic<bool> m_bRunning;
+	std::atomic<bool> m_bEnd;
+
+	FtpWakeup m_wakeup;							///< 入队/任务/配置变化时唤醒上传线程, 替代空闲轮询
+	FtpWakeup m_spaceWakeup;					///< 槽位完成或模块退出时唤醒阻塞策略下等待空间的入队
+
+	std::mutex m_produceMutex;					///< 串行化槽位的预留和发布, 保护m_producers; 帧拷贝在锁外
+	std::vector<FtpClientManager*> m_producers;	///< 可以入队的模块, 公平份额按它们计算
+	std::mutex m_queueMutex;					///< 串行化各上传连接对m_slotRing的出队操作, 入队线程不取
+	std::mutex m_tenantMutex;
+	std::condition_variable m_tenantCond;		///< 模块使用计数归零时通知detach
+	std::vector<Tenant> m_tenants;
+
+	std::mutex m_taskMutex;
+	std::queue<std::function<void(FtpSession&)>> m_taskQueue;
+};
+
+#endif // FTP_CONNECTION_HUB_H
@@ -0,0 +1,88 @@
+#include "FtpDirCache.h"
+
+FtpDirCache::FtpDirCache(size_t capacity)
+    : m_capacity(capacity == 0 ? 1 : capacity), m_hits(0), m_misses(0) {}
+
+bool FtpDirCache::lookup(const std::string &path) {
+  std::unordered_map<std::string, LruList::iterator>::iterator it = m_index.find(path);
+  if (it == m_index.end()) {
+    m_misses.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  m_lru.splice(m_lru.begin(), m_lru, it->second);
+  m_hits.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+bool FtpDirCache::contains(const std::string &path) const {
+  return m_index.find(path) != m_index.end();
+}
+
+void FtpDirCache::insert(const std::string &path) {
+  std::unordered_map<std::string, LruList::iterator>::iterator it = m_index.find(path);
+  if (it != m_index.end()) {
+    m_lru.splice(m_lru.begin(), m_lru, it->second);
+    return;
+  }
+
+  m_lru.push_front(path);
+  m_index[path] = m_lru.begin();
+  while (m_lru.size() > m_capacity) {
+    m_index.erase(m_lru.back());
+    m_lru.pop_back();
+  }
+}
+
+void FtpDirCache::clear() {
+  m_lru.clear();
+  m_index.clear();
+}
+
+size_t FtpDirCache::size() const {
+  return m_lru.size();
+}
+
+uint64_t FtpDirCache::hits() const {
+  return m_hits.load(std::memory_order_relaxed);
+}
+
+uint64_t FtpDirCache::misses() const {
+  return m_misses.load(std::memory_order_relaxed);
+}
+
+std::string FtpDirCache::joinPath(const std::string &base, const std::string &relative) {
+  std::string joined = base.empty() ? "/" : base;
+  size_t pos = 0;
+  while (pos <= relative.size()) {
+    size_t end = relative.find('/', pos);
+    if (end == std::string::npos) {
+      end = relative.size();
+    }
+
+    const std::string segment = relative.substr(pos, end - pos);
+    if (!segment.empty() && segment != ".") {
+      if (joined[joined.size() - 1] != '/') {
+        joined += '/';
+      }
+      joined += segment;
+    }
+    pos = end + 1;
+  }
+
+  while (joined.size() > 1 && joined[joined.size() - 1] == '/') {
+    joined.erase(joined.size() - 1);
+  }
+  return joined;
+}
+
+std::string FtpDirCache::parentPath(const std::string &path) {
+  const size_t slash = path.find_last_of('/');
+  if (slash == std::string::npos) {
+    return std::string();
+  }
+  if (slash == 0) {
+    return "/";
+  }
+  return path.substr(0, slash);
+}
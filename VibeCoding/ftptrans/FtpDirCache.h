@@ -0,0 +1,41 @@
+#ifndef FTP_DIR_CACHE_H
+#define FTP_DIR_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+// LRU set of absolute remote directories known to exist on the server for
+// one FTP login. Contents are owned by the connection thread; the hit/miss
+// counters may be read from any thread.
+class FtpDirCache {
+ public:
+  explicit FtpDirCache(size_t capacity = 64);
+
+  bool lookup(const std::string &path);
+  bool contains(const std::string &path) const;
+  void insert(const std::string &path);
+  void clear();
+  size_t size() const;
+
+  uint64_t hits() const;
+  uint64_t misses() const;
+
+  static std::string joinPath(const std::string &base, const std::string &relative);
+  static std::string parentPath(const std::string &path);
+
+ private:
+  typedef std::list<std::string> LruList;
+
+  size_t m_capacity;
+  LruList m_lru;
+  std::unordered_map<std::string, LruList::iterator> m_index;
+  std::atomic<uint64_t> m_hits;
+  std::atomic<uint64_t> m_misses;
+};
+
+#endif
@@ -23,6 +23,7 @@
 #include "thread/ThreadApi.h"
 #include "FtpClientManager.h"
 #include "FtpLogManager.h"
+#include "FtpZipReader.h"
 #include "log_record/log_record_file.h"
 #include "log/log.h"
 
@@ -65,11 +66,12 @@ bool FtpLogManager::enable(FtpClientManager* pClientInstance, int nLogId)
 
 	start();
 
-	if (!osal_is_dir_exist(LOG_RECORD_UNZIP_PATH))
+	// 日志直接从归档解压上传, 清理旧版本遗留的解压目录
+	if (osal_is_dir_exist(LOG_RECORD_UNZIP_PATH))
 	{
-		if (osal_create_dir(LOG_RECORD_UNZIP_PATH) < 0)
+		if (osal_remove_dir(LOG_RECORD_UNZIP_PATH) < 0)
 		{
-			LOGW("create dir %s error\n", LOG_RECORD_UNZIP_PATH);
+			LOGW("remove dir %s error\n", LOG_RECORD_UNZIP_PATH);
 		}
 	}
 
@@ -83,10 +85,6 @@ void FtpLogManager::disable(FtpClientManager* pClientInstance)
 	if (m_pMessageObj == pClientInstance) 
 	{
 		stop();
-		if (osal_remove_dir(LOG_RECORD_UNZIP_PATH) < 0)
-		{
-			LOGW("remove dir %s error\n", LOG_RECORD_UNZIP_PATH);
-		}
 		m_pMessageObj = nullptr;
 	}
 }
@@ -157,24 +155,11 @@ void FtpLogManager::triggerLogTransfer()
 {
 	FUNCTION_ENTER(I);
 
-	if (!osal_is_dir_exist(LOG_RECORD_UNZIP_PATH))
-	{
-		LOGE("log dir %s is not found!\n", LOG_RECORD_UNZIP_PATH);
-		return;
-	}
-
-	std::string strCmd = "rm -rf " + std::string(LOG_RECORD_UNZIP_PATH) + "*";
-	if (utils_do_shell_cmd((char*)strCmd.c_str()) < 0)
-	{
-		LOGE("strCmd %s run failed!\n", strCmd.c_str());
-		return;
-	}
-
-	std::string unzipCmd = "unzip -o " + std::string(LOG_RECORD_ZIP_PATH) 
-							+ " -d " + std::string(LOG_RECORD_UNZIP_PATH);
-	if (utils_do_shell_cmd((char*)unzipCmd.c_str()) < 0)
+	// 只读取中央目录, 条目在上传时才从归档中解压
+	FtpZipArchive archive;
+	if (!archive.open(LOG_RECORD_ZIP_PATH))
 	{
-		LOGE("unzipCmd %s run failed!\n", unzipCmd.c_str());
+		LOGE("open log archive %s failed!\n", LOG_RECORD_ZIP_PATH);
 		return;
 	}
 
@@ -192,10 +177,10 @@ void FtpLogManager::triggerLogTransfer()
 	{
 		if (m_transferredLogs.find(logFile) == m_transferredLogs.end())
 		{
-			std::string logFilePath = LOG_RECORD_UNZIP_PATH + logFile;
-			if (osal_is_file_exist((char*)logFilePath.c_str()))
+			if (nullptr != archive.find(logFile))
 			{
-				m_logQueue.push(logFilePath);
+				// "<归档路径>/<条目名>", 由makeIstreamByFormat拆分
+				m_logQueue.push(std::string(LOG_RECORD_ZIP_PATH) + "/" + logFile);
 				m_transferredLogs.insert(logFile);
 			}
 		}
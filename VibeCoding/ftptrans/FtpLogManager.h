@@ -15,7 +15,7 @@
 #define LOG_RECORD_ZIP    "log_record_file.zip"
 #define LOG_RECORD_INDEX_PATH  LOG_RECORD_DIR LOG_RECORD_INDEX
 #define LOG_RECORD_ZIP_PATH    LOG_RECORD_DIR LOG_RECORD_ZIP
-#define LOG_RECORD_UNZIP_PATH  "/mnt/data/log_tmp/"
+#define LOG_RECORD_UNZIP_PATH  "/mnt/data/log_tmp/"	// 旧版本的解压目录, 仅用于清理
 
 class FtpLogManager
 {
@@ -0,0 +1,505 @@
+#include "FtpLosslessCodec.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define FTP_FLI_USE_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define FTP_FLI_USE_SSE2 1
+#endif
+
+const size_t FtpLosslessStreamBuf::kStripBytes;
+
+namespace {
+
+const uint8_t kVersion = 1;
+const uint32_t kBlock = 16;
+// Blocks are coded in pairs so that two 4-bit widths share one byte.
+const uint32_t kBlockPair = 2 * kBlock;
+const uint32_t kPairMaxBytes = 1 + 2 * kBlock;
+
+void PutLe16(uint8_t *dst, uint16_t value) {
+  dst[0] = static_cast<uint8_t>(value & 0xff);
+  dst[1] = static_cast<uint8_t>(value >> 8);
+}
+
+void PutLe32(uint8_t *dst, uint32_t value) {
+  PutLe16(dst, static_cast<uint16_t>(value & 0xffff));
+  PutLe16(dst + 2, static_cast<uint16_t>(value >> 16));
+}
+
+uint32_t GetLe32(const uint8_t *src) {
+  return static_cast<uint32_t>(src[0]) | (static_cast<uint32_t>(src[1]) << 8) |
+         (static_cast<uint32_t>(src[2]) << 16) | (static_cast<uint32_t>(src[3]) << 24);
+}
+
+uint64_t PaddedCount(uint64_t count) {
+  return (count + kBlockPair - 1) / kBlockPair * kBlockPair;
+}
+
+uint64_t StripMaxSize(uint64_t pixels, uint32_t channels) {
+  return 4 + channels * (PaddedCount(pixels) / kBlockPair) * kPairMaxBytes;
+}
+
+uint32_t RowsPerStrip(uint32_t width, uint32_t height, uint32_t channels) {
+  const uint64_t row_bytes = static_cast<uint64_t>(width) * channels;
+  const uint64_t rows = std::max<uint64_t>(1, FtpLosslessStreamBuf::kStripBytes / row_bytes);
+  return static_cast<uint32_t>(std::min<uint64_t>(rows, height));
+}
+
+// Maps the signed difference d (mod 256) to 0, -1, 1, -2, ... -> 0, 1, 2, 3, ...
+inline uint8_t Zigzag(uint32_t d) {
+  d &= 0xff;
+  return static_cast<uint8_t>((d << 1) ^ (0u - (d >> 7)));
+}
+
+inline uint8_t Unzigzag(uint32_t z) {
+  return static_cast<uint8_t>((z >> 1) ^ (0u - (z & 1)));
+}
+
+// LOCO-I median edge detector: a left, b up, c up-left.
+inline uint32_t Predict(int a, int b, int c) {
+  const int lo = std::min(a, b);
+  const int hi = std::max(a, b);
+  return static_cast<uint32_t>(std::min(std::max(a + b - c, lo), hi));
+}
+
+#if defined(FTP_FLI_USE_NEON)
+// Median prediction and zigzag of 16 pixels. Works on bytes: when c lies
+// strictly between lo and hi, lo + hi - c does not wrap.
+inline uint8x16_t ResidualBlock(uint8x16_t x, uint8x16_t a, uint8x16_t b, uint8x16_t c) {
+  const uint8x16_t lo = vminq_u8(a, b);
+  const uint8x16_t hi = vmaxq_u8(a, b);
+  uint8x16_t p = vsubq_u8(vaddq_u8(lo, hi), c);
+  p = vbslq_u8(vcgeq_u8(c, hi), lo, p);
+  p = vbslq_u8(vcleq_u8(c, lo), hi, p);
+  const int8x16_t d = vreinterpretq_s8_u8(vsubq_u8(x, p));
+  return vreinterpretq_u8_s8(veorq_s8(vshlq_n_s8(d, 1), vshrq_n_s8(d, 7)));
+}
+#elif defined(FTP_FLI_USE_SSE2)
+inline __m128i ResidualBlock(__m128i x, __m128i a, __m128i b, __m128i c) {
+  const __m128i lo = _mm_min_epu8(a, b);
+  const __m128i hi = _mm_max_epu8(a, b);
+  const __m128i mid = _mm_sub_epi8(_mm_add_epi8(lo, hi), c);
+  const __m128i c_ge_hi = _mm_cmpeq_epi8(_mm_max_epu8(c, hi), c);
+  const __m128i c_le_lo = _mm_cmpeq_epi8(_mm_min_epu8(c, lo), c);
+  __m128i p = _mm_or_si128(_mm_and_si128(c_ge_hi, lo), _mm_andnot_si128(c_ge_hi, mid));
+  p = _mm_or_si128(_mm_and_si128(c_le_lo, hi), _mm_andnot_si128(c_le_lo, p));
+  const __m128i d = _mm_sub_epi8(x, p);
+  return _mm_xor_si128(_mm_add_epi8(d, d), _mm_cmpgt_epi8(_mm_setzero_si128(), d));
+}
+#endif
+
+// The first row predicts from the left, the first column from above. Pixels
+// do not depend on each other's residuals, so the encoder codes 16 at a time.
+void ResidualRow(const uint8_t *cur, const uint8_t *prev, uint32_t width, uint8_t *z) {
+  if (prev == nullptr) {
+    z[0] = Zigzag(cur[0]);
+    for (uint32_t x = 1; x < width; ++x) {
+      z[x] = Zigzag(static_cast<uint32_t>(cur[x]) - cur[x - 1]);
+    }
+    return;
+  }
+  z[0] = Zigzag(static_cast<uint32_t>(cur[0]) - prev[0]);
+  uint32_t x = 1;
+#if defined(FTP_FLI_USE_NEON)
+  for (; x + 16 <= width; x += 16) {
+    vst1q_u8(z + x, ResidualBlock(vld1q_u8(cur + x), vld1q_u8(cur + x - 1), vld1q_u8(prev + x),
+                                  vld1q_u8(prev + x - 1)));
+  }
+#elif defined(FTP_FLI_USE_SSE2)
+  for (; x + 16 <= width; x += 16) {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(z + x),
+                     ResidualBlock(_mm_loadu_si128(reinterpret_cast<const __m128i *>(cur + x)),
+                                   _mm_loadu_si128(reinterpret_cast<const __m128i *>(cur + x - 1)),
+                                   _mm_loadu_si128(reinterpret_cast<const __m128i *>(prev + x)),
+                                   _mm_loadu_si128(reinterpret_cast<const __m128i *>(prev + x - 1))));
+  }
+#endif
+  for (; x < width; ++x) {
+    z[x] = Zigzag(static_cast<uint32_t>(cur[x]) - Predict(cur[x - 1], prev[x], prev[x - 1]));
+  }
+}
+
+void ReconstructRow(const uint8_t *z, const uint8_t *prev, uint32_t width, uint8_t *cur) {
+  if (prev == nullptr) {
+    cur[0] = Unzigzag(z[0]);
+    for (uint32_t x = 1; x < width; ++x) {
+      cur[x] = static_cast<uint8_t>(cur[x - 1] + Unzigzag(z[x]));
+    }
+    return;
+  }
+  cur[0] = static_cast<uint8_t>(prev[0] + Unzigzag(z[0]));
+  for (uint32_t x = 1; x < width; ++x) {
+    cur[x] = static_cast<uint8_t>(Predict(cur[x - 1], prev[x], prev[x - 1]) + Unzigzag(z[x]));
+  }
+}
+
+void DiffRow(const uint8_t *plane, const uint8_t *green, uint32_t width, uint8_t *dst) {
+  uint32_t x = 0;
+#if defined(FTP_FLI_USE_NEON)
+  for (; x + 16 <= width; x += 16) {
+    vst1q_u8(dst + x, vsubq_u8(vld1q_u8(plane + x), vld1q_u8(green + x)));
+  }
+#elif defined(FTP_FLI_USE_SSE2)
+  for (; x + 16 <= width; x += 16) {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x),
+                     _mm_sub_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(plane + x)),
+                                  _mm_loadu_si128(reinterpret_cast<const __m128i *>(green + x))));
+  }
+#endif
+  for (; x < width; ++x) {
+    dst[x] = static_cast<uint8_t>(plane[x] - green[x]);
+  }
+}
+
+uint32_t BlockBits(const uint8_t *values) {
+#if defined(FTP_FLI_USE_NEON)
+  const uint8x16_t v = vld1q_u8(values);
+  uint8x8_t folded = vorr_u8(vget_low_u8(v), vget_high_u8(v));
+  folded = vpmax_u8(folded, folded);
+  folded = vpmax_u8(folded, folded);
+  folded = vpmax_u8(folded, folded);
+  const uint32_t bits = vget_lane_u8(folded, 0);
+#elif defined(FTP_FLI_USE_SSE2)
+  __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(values));
+  v = _mm_or_si128(v, _mm_srli_si128(v, 8));
+  v = _mm_or_si128(v, _mm_srli_si128(v, 4));
+  v = _mm_or_si128(v, _mm_srli_si128(v, 2));
+  v = _mm_or_si128(v, _mm_srli_si128(v, 1));
+  const uint32_t bits = static_cast<uint32_t>(_mm_cvtsi128_si32(v)) & 0xff;
+#else
+  uint32_t bits = 0;
+  for (uint32_t i = 0; i < kBlock; ++i) {
+    bits |= values[i];
+  }
+#endif
+  return bits == 0 ? 0 : 32 - static_cast<uint32_t>(__builtin_clz(bits));
+}
+
+uint8_t *PackResiduals(const uint8_t *values, uint64_t count, uint8_t *dst) {
+  for (uint64_t i = 0; i < count; i += kBlockPair) {
+    const uint32_t bits0 = BlockBits(values + i);
+    const uint32_t bits1 = BlockBits(values + i + kBlock);
+    *dst++ = static_cast<uint8_t>(bits0 | (bits1 << 4));
+    dst = FtpLosslessPackBlock(values + i, bits0, dst);
+    dst = FtpLosslessPackBlock(values + i + kBlock, bits1, dst);
+  }
+  return dst;
+}
+
+// Returns the end of the consumed input, or nullptr if it is malformed.
+const uint8_t *UnpackResiduals(const uint8_t *src, const uint8_t *end, uint64_t count,
+                               uint8_t *values) {
+  for (uint64_t i = 0; i < count; i += kBlockPair) {
+    if (src >= end) {
+      return nullptr;
+    }
+    const uint32_t bits[2] = {static_cast<uint32_t>(*src & 0x0f), static_cast<uint32_t>(*src >> 4)};
+    ++src;
+    if (bits[0] > 8 || bits[1] > 8 || static_cast<size_t>(end - src) < 2 * (bits[0] + bits[1])) {
+      return nullptr;
+    }
+    for (uint32_t half = 0; half < 2; ++half) {
+      uint8_t *out = values + i + half * kBlock;
+      memset(out, 0, kBlock);
+      for (uint32_t k = 0; k < bits[half]; ++k, src += 2) {
+        const uint32_t mask = static_cast<uint32_t>(src[0]) | (static_cast<uint32_t>(src[1]) << 8);
+        for (uint32_t j = 0; j < kBlock; ++j) {
+          out[j] = static_cast<uint8_t>(out[j] | (((mask >> j) & 1) << k));
+        }
+      }
+    }
+  }
+  return src;
+}
+
+}  // namespace
+
+uint8_t *FtpLosslessPackBlock(const uint8_t *values, uint32_t bits, uint8_t *dst) {
+#if defined(FTP_FLI_USE_NEON)
+  static const uint8_t kWeights[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+  const uint8x16_t v = vld1q_u8(values);
+  const uint8x16_t weights = vld1q_u8(kWeights);
+  for (uint32_t k = 0; k < bits; ++k, dst += 2) {
+    const uint8x16_t set = vandq_u8(vtstq_u8(v, vdupq_n_u8(static_cast<uint8_t>(1u << k))), weights);
+    uint8x8_t sum = vpadd_u8(vget_low_u8(set), vget_high_u8(set));
+    sum = vpadd_u8(sum, sum);
+    sum = vpadd_u8(sum, sum);
+    dst[0] = vget_lane_u8(sum, 0);
+    dst[1] = vget_lane_u8(sum, 1);
+  }
+#elif defined(FTP_FLI_USE_SSE2)
+  const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(values));
+  for (uint32_t k = 0; k < bits; ++k, dst += 2) {
+    // Moves bit k of every byte to bit 7; the 16-bit shift only carries bits
+    // into the low bits of the neighbouring byte.
+    PutLe16(dst, static_cast<uint16_t>(_mm_movemask_epi8(_mm_slli_epi16(v, static_cast<int>(7 - k)))));
+  }
+#else
+  for (uint32_t k = 0; k < bits; ++k, dst += 2) {
+    uint32_t mask = 0;
+    for (uint32_t j = 0; j < kBlock; ++j) {
+      mask |= ((values[j] >> k) & 1u) << j;
+    }
+    PutLe16(dst, static_cast<uint16_t>(mask));
+  }
+#endif
+  return dst;
+}
+
+uint64_t FtpLosslessMaxSize(uint32_t width, uint32_t height, uint32_t channels,
+                            uint32_t rows_per_strip) {
+  if (width == 0 || height == 0 || rows_per_strip == 0 || (channels != 1 && channels != 3)) {
+    return 0;
+  }
+  const uint64_t full = height / rows_per_strip;
+  const uint64_t rest = height % rows_per_strip;
+  uint64_t size = kFtpLosslessHeaderSize +
+                  full * StripMaxSize(static_cast<uint64_t>(width) * rows_per_strip, channels);
+  if (rest != 0) {
+    size += StripMaxSize(static_cast<uint64_t>(width) * rest, channels);
+  }
+  return size;
+}
+
+bool FtpLosslessReadHeader(const uint8_t *data, size_t len, FtpLosslessInfo *info) {
+  if (data == nullptr || len < kFtpLosslessHeaderSize || memcmp(data, kFtpLosslessMagic, 4) != 0 ||
+      data[4] != kVersion || (data[5] != 1 && data[5] != 3) ||
+      (static_cast<uint32_t>(data[6]) | (static_cast<uint32_t>(data[7]) << 8)) != kFtpLosslessHeaderSize) {
+    return false;
+  }
+  info->channels = data[5];
+  info->width = GetLe32(data + 8);
+  info->height = GetLe32(data + 12);
+  info->rows_per_strip = GetLe32(data + 16);
+  return info->width != 0 && info->height != 0 && info->rows_per_strip != 0;
+}
+
+bool FtpLosslessDecode(const uint8_t *data, size_t len, FtpLosslessInfo *info,
+                       std::vector<uint8_t> *pixels) {
+  if (!FtpLosslessReadHeader(data, len, info)) {
+    return false;
+  }
+  const uint32_t width = info->width;
+  const uint32_t height = info->height;
+  const uint64_t plane = static_cast<uint64_t>(width) * height;
+  if (plane * info->channels > (1ULL << 32)) {
+    return false;
+  }
+  pixels->assign(static_cast<size_t>(plane * info->channels), 0);
+  std::vector<uint8_t> residuals(static_cast<size_t>(
+      PaddedCount(static_cast<uint64_t>(width) * std::min(info->rows_per_strip, height))));
+
+  // Colour planes in coding order: G, then R-G and B-G kept as differences
+  // until every strip is decoded.
+  static const uint32_t kPlaneOrder[3] = {1, 0, 2};
+  const uint8_t *src = data + kFtpLosslessHeaderSize;
+  const uint8_t *end = data + len;
+  for (uint32_t first_row = 0; first_row < height; first_row += info->rows_per_strip) {
+    const uint32_t rows = std::min(info->rows_per_strip, height - first_row);
+    const uint64_t count = static_cast<uint64_t>(width) * rows;
+    if (end - src < 4 || static_cast<uint64_t>(end - src - 4) < GetLe32(src)) {
+      return false;
+    }
+    const uint8_t *strip_end = src + 4 + GetLe32(src);
+    src += 4;
+    for (uint32_t ch = 0; ch < info->channels; ++ch) {
+      src = UnpackResiduals(src, strip_end, PaddedCount(count), &residuals[0]);
+      if (src == nullptr) {
+        return false;
+      }
+      uint8_t *out = &(*pixels)[0] + (info->channels == 3 ? kPlaneOrder[ch] : 0) * plane;
+      for (uint32_t i = 0; i < rows; ++i) {
+        const uint64_t y = first_row + i;
+        ReconstructRow(&residuals[0] + static_cast<size_t>(i) * width,
+                       y == 0 ? nullptr : out + (y - 1) * width, width, out + y * width);
+      }
+    }
+    if (src != strip_end) {
+      return false;
+    }
+  }
+  if (src != end) {
+    return false;
+  }
+
+  if (info->channels == 3) {
+    uint8_t *r = &(*pixels)[0];
+    const uint8_t *g = r + plane;
+    uint8_t *b = r + 2 * plane;
+    for (uint64_t i = 0; i < plane; ++i) {
+      r[i] = static_cast<uint8_t>(r[i] + g[i]);
+      b[i] = static_cast<uint8_t>(b[i] + g[i]);
+    }
+  }
+  return true;
+}
+
+FtpLosslessStreamBuf::FtpLosslessStreamBuf()
+    : m_data(nullptr),
+      m_next_row(0),
+      m_header_sent(false),
+      m_base(0),
+      m_max_size(0),
+      m_encode_ns(0) {
+  memset(&m_info, 0, sizeof(m_info));
+}
+
+bool FtpLosslessStreamBuf::reset(const uint8_t *data, size_t len, uint32_t width, uint32_t height,
+                                 bool planar_rgb) {
+  m_data = nullptr;
+  m_max_size = 0;
+  m_encode_ns = 0;
+  m_next_row = 0;
+  m_header_sent = false;
+  m_base = 0;
+  setg(nullptr, nullptr, nullptr);
+
+  const uint32_t channels = planar_rgb ? 3 : 1;
+  if (data == nullptr || width == 0 || height == 0 ||
+      len < static_cast<uint64_t>(width) * height * channels) {
+    return false;
+  }
+
+  m_data = data;
+  m_info.width = width;
+  m_info.height = height;
+  m_info.channels = channels;
+  m_info.rows_per_strip = RowsPerStrip(width, height, channels);
+  m_max_size = FtpLosslessMaxSize(width, height, channels, m_info.rows_per_strip);
+
+  m_header.assign(kFtpLosslessHeaderSize, 0);
+  uint8_t *h = reinterpret_cast<uint8_t *>(&m_header[0]);
+  memcpy(h, kFtpLosslessMagic, 4);
+  h[4] = kVersion;
+  h[5] = static_cast<uint8_t>(channels);
+  PutLe16(h + 6, static_cast<uint16_t>(kFtpLosslessHeaderSize));
+  PutLe32(h + 8, width);
+  PutLe32(h + 12, height);
+  PutLe32(h + 16, m_info.rows_per_strip);
+
+  const uint64_t strip_pixels = static_cast<uint64_t>(width) * m_info.rows_per_strip;
+  const size_t strip_size = static_cast<size_t>(StripMaxSize(strip_pixels, channels));
+  if (m_strip.size() < strip_size) {
+    m_strip.resize(strip_size);
+  }
+  if (m_residuals.size() < PaddedCount(strip_pixels)) {
+    m_residuals.resize(static_cast<size_t>(PaddedCount(strip_pixels)));
+  }
+  if (planar_rgb && m_rows.size() < 2 * static_cast<size_t>(width)) {
+    m_rows.resize(2 * static_cast<size_t>(width));
+  }
+  return true;
+}
+
+uint64_t FtpLosslessStreamBuf::maxFileSize() const {
+  return m_max_size;
+}
+
+uint64_t FtpLosslessStreamBuf::encodeNs() const {
+  return m_encode_ns;
+}
+
+FtpLosslessStreamBuf::int_type FtpLosslessStreamBuf::underflow() {
+  if (gptr() < egptr()) {
+    return traits_type::to_int_type(*gptr());
+  }
+  if (m_data == nullptr) {
+    return traits_type::eof();
+  }
+
+  m_base += static_cast<uint64_t>(egptr() - eback());
+  if (!m_header_sent) {
+    m_header_sent = true;
+    char *begin = &m_header[0];
+    setg(begin, begin, begin + m_header.size());
+  } else if (m_next_row < m_info.height) {
+    const uint32_t rows = std::min(m_info.rows_per_strip, m_info.height - m_next_row);
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const size_t size = encodeStrip(m_next_row, rows, reinterpret_cast<uint8_t *>(&m_strip[0]));
+    m_encode_ns += static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+    m_next_row += rows;
+    char *begin = &m_strip[0];
+    setg(begin, begin, begin + size);
+  } else {
+    setg(nullptr, nullptr, nullptr);
+    return traits_type::eof();
+  }
+  return traits_type::to_int_type(*gptr());
+}
+
+FtpLosslessStreamBuf::pos_type FtpLosslessStreamBuf::seekoff(off_type off, std::ios_base::seekdir dir,
+                                                             std::ios_base::openmode which) {
+  if ((which & std::ios_base::in) == 0 || m_data == nullptr || off != 0) {
+    return pos_type(off_type(-1));
+  }
+  if (dir == std::ios_base::cur) {
+    return pos_type(static_cast<off_type>(m_base + static_cast<uint64_t>(gptr() - eback())));
+  }
+  if (dir == std::ios_base::beg) {
+    rewind();
+    return pos_type(off_type(0));
+  }
+  return pos_type(off_type(-1));
+}
+
+FtpLosslessStreamBuf::pos_type FtpLosslessStreamBuf::seekpos(pos_type pos,
+                                                             std::ios_base::openmode which) {
+  return seekoff(off_type(pos), std::ios_base::beg, which);
+}
+
+void FtpLosslessStreamBuf::rewind() {
+  m_next_row = 0;
+  m_header_sent = false;
+  m_base = 0;
+  setg(nullptr, nullptr, nullptr);
+}
+
+size_t FtpLosslessStreamBuf::encodeStrip(uint32_t first_row, uint32_t rows, uint8_t *dst) {
+  const uint32_t width = m_info.width;
+  const size_t plane = static_cast<size_t>(width) * m_info.height;
+  const uint64_t count = static_cast<uint64_t>(width) * rows;
+  const uint64_t padded = PaddedCount(count);
+  uint8_t *residuals = &m_residuals[0];
+  uint8_t *out = dst + 4;
+
+  for (uint32_t ch = 0; ch < m_info.channels; ++ch) {
+    if (ch == 0) {
+      // Mono, or the green plane of a colour frame.
+      const uint8_t *src = m_data + (m_info.channels == 3 ? plane : 0);
+      for (uint32_t i = 0; i < rows; ++i) {
+        const size_t y = static_cast<size_t>(first_row) + i;
+        ResidualRow(src + y * width, y == 0 ? nullptr : src + (y - 1) * width, width,
+                    residuals + static_cast<size_t>(i) * width);
+      }
+    } else {
+      const uint8_t *src = m_data + (ch == 1 ? 0 : 2 * plane);
+      const uint8_t *green = m_data + plane;
+      uint8_t *cur = &m_rows[0];
+      uint8_t *prev = cur + width;
+      if (first_row > 0) {
+        const size_t y = static_cast<size_t>(first_row) - 1;
+        DiffRow(src + y * width, green + y * width, width, prev);
+      }
+      for (uint32_t i = 0; i < rows; ++i) {
+        const size_t y = static_cast<size_t>(first_row) + i;
+        DiffRow(src + y * width, green + y * width, width, cur);
+        ResidualRow(cur, y == 0 ? nullptr : prev, width, residuals + static_cast<size_t>(i) * width);
+        std::swap(cur, prev);
+      }
+    }
+    memset(residuals + count, 0, static_cast<size_t>(padded - count));
+    out = PackResiduals(residuals, padded, out);
+  }
+
+  const size_t size = static_cast<size_t>(out - dst);
+  PutLe32(dst, static_cast<uint32_t>(size - 4));
+  return size;
+}
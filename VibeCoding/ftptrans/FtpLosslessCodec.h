@@ -0,0 +1,110 @@
+#ifndef FTP_LOSSLESS_CODEC_H
+#define FTP_LOSSLESS_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <istream>
+#include <streambuf>
+#include <vector>
+
+// Lossless frame format (".fli") for mono8 and planar RGB frames.
+//
+// File: a 20-byte header, then one record per strip of `rows_per_strip` rows:
+// a u32 payload length followed by the coded planes of the strip. Colour
+// frames code G, then R-G and B-G (mod 256). Each pixel is predicted with the
+// LOCO-I median predictor and the zigzagged residuals are bit-packed in blocks
+// of 16: one 4-bit width per block (two per byte), then one 16-bit mask per
+// bit plane. Flat areas cost half a byte per 16 pixels; the worst case is
+// 33/32 of the raw size plus the headers. Integers are little endian.
+struct FtpLosslessInfo {
+  uint32_t width;
+  uint32_t height;
+  uint32_t channels;  // 1 mono, 3 planar R, G, B
+  uint32_t rows_per_strip;
+};
+
+static const char kFtpLosslessMagic[4] = {'F', 'L', 'I', '1'};
+static const size_t kFtpLosslessHeaderSize = 20;
+
+// Upper bound of the coded size of a frame, or 0 if the arguments are invalid.
+uint64_t FtpLosslessMaxSize(uint32_t width, uint32_t height, uint32_t channels,
+                            uint32_t rows_per_strip);
+
+// Parses the header. Returns false if it is not a supported .fli header.
+bool FtpLosslessReadHeader(const uint8_t *data, size_t len, FtpLosslessInfo *info);
+
+// Decodes a whole file into `pixels` (planar for colour, same layout as the
+// frame that was encoded). Returns false on truncated or malformed input.
+bool FtpLosslessDecode(const uint8_t *data, size_t len, FtpLosslessInfo *info,
+                       std::vector<uint8_t> *pixels);
+
+// Read-only streambuf that codes a raw frame while it is read, one strip of
+// about kStripBytes raw bytes per underflow. The coded size is only known at
+// the end; seeking is limited to tellg and a rewind to 0 (which codes the
+// frame again). The caller must keep the frame alive until the stream is reset.
+class FtpLosslessStreamBuf : public std::streambuf {
+ public:
+  static const size_t kStripBytes = 64 * 1024;
+
+  FtpLosslessStreamBuf();
+
+  // Same frame description as FtpBmpStreamBuf::reset.
+  bool reset(const uint8_t *data, size_t len, uint32_t width, uint32_t height, bool planar_rgb);
+
+  uint64_t maxFileSize() const;
+  // Time spent coding strips since the last reset, for upload telemetry.
+  uint64_t encodeNs() const;
+
+ protected:
+  int_type underflow() override;
+  pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                   std::ios_base::openmode which) override;
+  pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+
+ private:
+  void rewind();
+  size_t encodeStrip(uint32_t first_row, uint32_t rows, uint8_t *dst);
+
+  const uint8_t *m_data;
+  FtpLosslessInfo m_info;
+  uint32_t m_next_row;  // first row of the next strip, height once all are coded
+  bool m_header_sent;
+  uint64_t m_base;      // stream offset of eback()
+  uint64_t m_max_size;
+  uint64_t m_encode_ns;
+  std::vector<char> m_header;
+  std::vector<char> m_strip;
+  std::vector<uint8_t> m_residuals;
+  std::vector<uint8_t> m_rows;  // R-G / B-G rows of the current and previous line
+};
+
+class FtpLosslessIStream : public std::istream {
+ public:
+  FtpLosslessIStream() : std::istream(nullptr) {
+    rdbuf(&m_buf);
+  }
+
+  bool reset(const uint8_t *data, size_t len, uint32_t width, uint32_t height, bool planar_rgb) {
+    const bool ok = m_buf.reset(data, len, width, height, planar_rgb);
+    clear();
+    return ok;
+  }
+
+  uint64_t maxFileSize() const {
+    return m_buf.maxFileSize();
+  }
+
+  uint64_t encodeNs() const {
+    return m_buf.encodeNs();
+  }
+
+ private:
+  FtpLosslessStreamBuf m_buf;
+};
+
+// Packs 16 residuals of `bits` bits as bit-plane masks; returns the end of the
+// output. Exposed for the unit test.
+uint8_t *FtpLosslessPackBlock(const uint8_t *values, uint32_t bits, uint8_t *dst);
+
+#endif
@@ -0,0 +1,412 @@
+#include "FtpSlotRing.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+const size_t FtpSlotRing::kInvalidSlot;
+const size_t FtpSlotRing::kByteAlign;
+
+FtpSlotRing::FtpSlotRing(size_t depth, size_t capacity)
+    : m_depth(0),
+      m_capacity(0),
+      m_byte_head(0),
+      m_reserved(0),
+      m_head(0),
+      m_tail(0),
+      m_high_water(0),
+      m_high_water_bytes(0),
+      m_enqueued(0),
+      m_dropped_newest(0),
+      m_dropped_oldest(0),
+      m_block_timeouts(0) {
+  reset(depth, capacity);
+}
+
+void FtpSlotRing::reset(size_t depth, size_t capacity) {
+  m_depth = depth;
+  m_capacity = (depth == 0) ? 0 : capacity;
+  m_states.reset(depth == 0 ? nullptr : new std::atomic<uint64_t>[depth]);
+  m_keys.reset(depth == 0 ? nullptr : new std::atomic<uint32_t>[depth]);
+  m_offsets.reset(depth == 0 ? nullptr : new std::atomic<size_t>[depth]);
+  m_lengths.reset(depth == 0 ? nullptr : new std::atomic<size_t>[depth]);
+  for (size_t slot = 0; slot < depth; ++slot) {
+    m_states[slot].store(makeWord(0, SLOT_FREE), std::memory_order_relaxed);
+    m_keys[slot].store(0, std::memory_order_relaxed);
+    m_offsets[slot].store(0, std::memory_order_relaxed);
+    m_lengths[slot].store(0, std::memory_order_relaxed);
+  }
+  m_byte_head.store(0, std::memory_order_relaxed);
+  m_filled.assign(depth, false);
+  m_blocked_keys.clear();
+  m_blocked_keys.reserve(depth);
+  m_reserved.store(0, std::memory_order_relaxed);
+  m_head.store(0, std::memory_order_relaxed);
+  m_tail.store(0, std::memory_order_relaxed);
+  m_high_water.store(0, std::memory_order_relaxed);
+  m_high_water_bytes.store(0, std::memory_order_relaxed);
+  m_enqueued.store(0, std::memory_order_relaxed);
+  m_dropped_newest.store(0, std::memory_order_relaxed);
+  m_dropped_oldest.store(0, std::memory_order_relaxed);
+  m_block_timeouts.store(0, std::memory_order_relaxed);
+}
+
+size_t FtpSlotRing::depth() const {
+  return m_depth;
+}
+
+size_t FtpSlotRing::capacity() const {
+  return m_capacity;
+}
+
+size_t FtpSlotRing::size() const {
+  const uint64_t tail = m_tail.load(std::memory_order_acquire);
+  const uint64_t head = m_head.load(std::memory_order_acquire);
+  return static_cast<size_t>(head - tail);
+}
+
+bool FtpSlotRing::empty() const {
+  return size() == 0;
+}
+
+bool FtpSlotRing::full() const {
+  // Reserved slots are taken even though consumers cannot see them yet.
+  const uint64_t tail = m_tail.load(std::memory_order_acquire);
+  return m_depth == 0 || m_reserved.load(std::memory_order_acquire) - tail >= m_depth;
+}
+
+size_t FtpSlotRing::usedBytes() const {
+  if (m_capacity == 0) {
+    return 0;
+  }
+  const uint64_t tail = m_tail.load(std::memory_order_acquire);
+  if (tail == m_reserved.load(std::memory_order_acquire)) {
+    return 0;
+  }
+  const size_t tail_offset = m_offsets[indexOf(tail)].load(std::memory_order_relaxed);
+  const size_t head_offset = m_byte_head.load(std::memory_order_relaxed);
+  return head_offset > tail_offset ? head_offset - tail_offset : m_capacity - tail_offset + head_offset;
+}
+
+bool FtpSlotRing::fits(size_t bytes) const {
+  size_t offset = 0;
+  return findSpan(m_capacity == 0 ? 0 : allocationSize(bytes), &offset);
+}
+
+size_t FtpSlotRing::beginWrite(FtpOverflowPolicy policy, int block_timeout_ms, size_t bytes) {
+  size_t slot = reserve(bytes);
+  if (slot != kInvalidSlot) {
+    return slot;
+  }
+
+  if (policy == FTP_OVERFLOW_DROP_OLDEST) {
+    while (evictOldest()) {
+      slot = reserve(bytes);
+      if (slot != kInvalidSlot) {
+        return slot;
+      }
+    }
+  }
+
+  // A payload larger than the whole buffer can never be written; drop it
+  // instead of waiting.
+  const bool can_fit = m_capacity == 0 || allocationSize(bytes) <= m_capacity;
+  if (policy == FTP_OVERFLOW_BLOCK && m_depth > 0 && can_fit) {
+    const std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max(block_timeout_ms, 0));
+    while ((slot = reserve(bytes)) == kInvalidSlot) {
+      if (std::chrono::steady_clock::now() >= deadline) {
+        m_block_timeouts.fetch_add(1, std::memory_order_relaxed);
+        return kInvalidSlot;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return slot;
+  }
+
+  m_dropped_newest.fetch_add(1, std::memory_order_relaxed);
+  return kInvalidSlot;
+}
+
+void FtpSlotRing::commitWrite(uint32_t order_key) {
+  const uint64_t head = m_head.load(std::memory_order_relaxed);
+  if (head == m_reserved.load(std::memory_order_relaxed)) {
+    // Only a payload reserved by beginWrite can be published.
+    if (m_capacity != 0 || reserve(0) == kInvalidSlot) {
+      return;
+    }
+  }
+  commitWrite(indexOf(head), order_key);
+}
+
+void FtpSlotRing::commitWrite(size_t slot, uint32_t order_key) {
+  const uint64_t head = m_head.load(std::memory_order_relaxed);
+  const uint64_t reserved = m_reserved.load(std::memory_order_relaxed);
+  if (slot >= m_depth || head == reserved) {
+    return;
+  }
+  // Reservations are consecutive from the head, so the slot's distance from
+  // the head slot names its sequence.
+  const uint64_t sequence = head + (slot + m_depth - indexOf(head)) % m_depth;
+  if (sequence >= reserved || m_filled[slot]) {
+    return;
+  }
+  m_keys[slot].store(order_key, std::memory_order_relaxed);
+  m_filled[slot] = true;
+
+  uint64_t published = head;
+  while (published < reserved && m_filled[indexOf(published)]) {
+    const size_t ready = indexOf(published);
+    m_filled[ready] = false;
+    m_states[ready].store(makeWord(published, SLOT_READY), std::memory_order_release);
+    m_head.store(++published, std::memory_order_release);
+    m_enqueued.fetch_add(1, std::memory_order_relaxed);
+  }
+  if (published == head) {
+    return;
+  }
+
+  const size_t used = size();
+  if (used > m_high_water.load(std::memory_order_relaxed)) {
+    m_high_water.store(used, std::memory_order_relaxed);
+  }
+  const size_t used_bytes = usedBytes();
+  if (used_bytes > m_high_water_bytes.load(std::memory_order_relaxed)) {
+    m_high_water_bytes.store(used_bytes, std::memory_order_relaxed);
+  }
+}
+
+size_t FtpSlotRing::offsetOf(size_t slot) const {
+  if (slot >= m_depth) {
+    return 0;
+  }
+  return m_offsets[slot].load(std::memory_order_relaxed);
+}
+
+size_t FtpSlotRing::claim() {
+  m_blocked_keys.clear();
+  const uint64_t head = m_head.load(std::memory_order_acquire);
+  for (uint64_t sequence = m_tail.load(std::memory_order_acquire); sequence < head; ++sequence) {
+    const size_t slot = indexOf(sequence);
+    uint64_t word = m_states[slot].load(std::memory_order_acquire);
+    if (sequenceOf(word) != sequence) {
+      continue;
+    }
+
+    const uint32_t key = m_keys[slot].load(std::memory_order_relaxed);
+    if (stateOf(word) == SLOT_BUSY) {
+      m_blocked_keys.push_back(key);
+    } else if (stateOf(word) == SLOT_READY && !isBlocked(key)) {
+      if (m_states[slot].compare_exchange_strong(word, makeWord(sequence, SLOT_BUSY),
+                                                 std::memory_order_acq_rel)) {
+        return slot;
+      }
+      // Evicted by the producer under the drop-oldest policy.
+    }
+  }
+  return kInvalidSlot;
+}
+
+void FtpSlotRing::complete(size_t slot) {
+  if (slot >= m_depth) {
+    return;
+  }
+  const uint64_t word = m_states[slot].load(std::memory_order_acquire);
+  if (stateOf(word) != SLOT_BUSY) {
+    return;
+  }
+  m_states[slot].store(makeWord(sequenceOf(word), SLOT_DONE));
+  retire();
+}
+
+void FtpSlotRing::release(size_t slot) {
+  if (slot >= m_depth) {
+    return;
+  }
+  const uint64_t word = m_states[slot].load(std::memory_order_acquire);
+  if (stateOf(word) != SLOT_BUSY) {
+    return;
+  }
+  m_states[slot].store(makeWord(sequenceOf(word), SLOT_READY), std::memory_order_release);
+}
+
+size_t FtpSlotRing::drainReady() {
+  size_t drained = 0;
+  const uint64_t head = m_head.load(std::memory_order_acquire);
+  for (uint64_t sequence = m_tail.load(std::memory_order_acquire); sequence < head; ++sequence) {
+    uint64_t expected = makeWord(sequence, SLOT_READY);
+    if (m_states[indexOf(sequence)].compare_exchange_strong(expected, makeWord(sequence, SLOT_DONE))) {
+      ++drained;
+    }
+  }
+  retire();
+  return drained;
+}
+
+size_t FtpSlotRing::inFlight() const {
+  size_t busy = 0;
+  for (size_t slot = 0; slot < m_depth; ++slot) {
+    if (stateOf(m_states[slot].load(std::memory_order_relaxed)) == SLOT_BUSY) {
+      ++busy;
+    }
+  }
+  return busy;
+}
+
+size_t FtpSlotRing::oldest() const {
+  const uint64_t tail = m_tail.load(std::memory_order_acquire);
+  if (m_depth == 0 || tail == m_head.load(std::memory_order_acquire)) {
+    return kInvalidSlot;
+  }
+  return indexOf(tail);
+}
+
+FtpSlotRingStats FtpSlotRing::stats() const {
+  FtpSlotRingStats stats;
+  stats.depth = m_depth;
+  stats.used = size();
+  stats.in_flight = inFlight();
+  stats.high_water = m_high_water.load(std::memory_order_relaxed);
+  stats.capacity_bytes = m_capacity;
+  stats.used_bytes = usedBytes();
+  stats.high_water_bytes = m_high_water_bytes.load(std::memory_order_relaxed);
+  stats.enqueued = m_enqueued.load(std::memory_order_relaxed);
+  stats.dropped_newest = m_dropped_newest.load(std::memory_order_relaxed);
+  stats.dropped_oldest = m_dropped_oldest.load(std::memory_order_relaxed);
+  stats.block_timeouts = m_block_timeouts.load(std::memory_order_relaxed);
+  return stats;
+}
+
+uint32_t FtpSlotRing::orderKey(const char *name) {
+  // FNV-1a; a collision only serializes two directories, it never reorders.
+  uint32_t hash = 2166136261u;
+  if (name == nullptr) {
+    return hash;
+  }
+  for (const unsigned char *ch = reinterpret_cast<const unsigned char *>(name); *ch != '\0'; ++ch) {
+    hash ^= *ch;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+uint64_t FtpSlotRing::makeWord(uint64_t sequence, SlotState state) {
+  return (sequence << 2) | static_cast<uint64_t>(state);
+}
+
+FtpSlotRing::SlotState FtpSlotRing::stateOf(uint64_t word) {
+  return static_cast<SlotState>(word & 0x3);
+}
+
+uint64_t FtpSlotRing::sequenceOf(uint64_t word) {
+  return word >> 2;
+}
+
+size_t FtpSlotRing::allocationSize(size_t bytes) {
+  return std::max(kByteAlign, (bytes + kByteAlign - 1) / kByteAlign * kByteAlign);
+}
+
+size_t FtpSlotRing::indexOf(uint64_t sequence) const {
+  return static_cast<size_t>(sequence % m_depth);
+}
+
+bool FtpSlotRing::isBlocked(uint32_t order_key) const {
+  return std::find(m_blocked_keys.begin(), m_blocked_keys.end(), order_key) != m_blocked_keys.end();
+}
+
+bool FtpSlotRing::findSpan(size_t bytes, size_t *offset) const {
+  if (full()) {
+    return false;
+  }
+  *offset = 0;
+  if (m_capacity == 0) {
+    return true;
+  }
+  if (bytes > m_capacity) {
+    return false;
+  }
+
+  // The tail payload cannot move while the producer reads it: its slot is only
+  // rewritten by this thread. A tail retired meanwhile only makes the answer
+  // conservative.
+  const uint64_t tail = m_tail.load(std::memory_order_acquire);
+  if (tail == m_reserved.load(std::memory_order_relaxed)) {
+    return true;
+  }
+  const size_t tail_offset = m_offsets[indexOf(tail)].load(std::memory_order_relaxed);
+  const size_t head_offset = m_byte_head.load(std::memory_order_relaxed);
+  if (head_offset > tail_offset) {
+    // Free space is [head, capacity) plus [0, tail); a payload never straddles
+    // the end of the buffer.
+    if (bytes <= m_capacity - head_offset) {
+      *offset = head_offset;
+      return true;
+    }
+    return bytes <= tail_offset;
+  }
+  // Wrapped: free space is [head, tail); equal offsets mean the buffer is full.
+  if (bytes <= tail_offset - head_offset) {
+    *offset = head_offset;
+    return true;
+  }
+  return false;
+}
+
+size_t FtpSlotRing::reserve(size_t bytes) {
+  const size_t length = (m_capacity == 0) ? 0 : allocationSize(bytes);
+  size_t offset = 0;
+  if (!findSpan(length, &offset)) {
+    return kInvalidSlot;
+  }
+  const uint64_t sequence = m_reserved.load(std::memory_order_relaxed);
+  const size_t slot = indexOf(sequence);
+  m_offsets[slot].store(offset, std::memory_order_relaxed);
+  m_lengths[slot].store(length, std::memory_order_relaxed);
+  if (m_capacity != 0) {
+    m_byte_head.store(offset + length, std::memory_order_relaxed);
+  }
+  m_filled[slot] = false;
+  m_reserved.store(sequence + 1, std::memory_order_release);
+  return slot;
+}
+
+bool FtpSlotRing::evictOldest(size_t slot) {
+  // Only the slot at the tail can free space; an upload in flight there is
+  // never interrupted, the new frame is dropped instead.
+  const uint64_t tail = m_tail.load(std::memory_order_acquire);
+  if (tail == m_head.load(std::memory_order_relaxed)) {
+    return false;
+  }
+  // The tail only moves forward and cannot wrap onto the same index while the
+  // producer (the caller) publishes nothing, so equal indexes mean the same slot.
+  if (slot != kInvalidSlot && indexOf(tail) != slot) {
+    return false;
+  }
+
+  uint64_t expected = makeWord(tail, SLOT_READY);
+  if (!m_states[indexOf(tail)].compare_exchange_strong(expected, makeWord(tail, SLOT_DONE))) {
+    return false;
+  }
+
+  m_dropped_oldest.fetch_add(1, std::memory_order_relaxed);
+  retire();
+  return true;
+}
+
+void FtpSlotRing::retire() {
+  // Whoever moves a slot from DONE to FREE owns the matching tail increment,
+  // so the producer and a consumer may both call this concurrently. Sequential
+  // consistency keeps a DONE store that raced with a tail increment visible to
+  // the thread that made the increment.
+  for (;;) {
+    const uint64_t tail = m_tail.load();
+    if (tail == m_head.load()) {
+      return;
+    }
+    uint64_t expected = makeWord(tail, SLOT_DONE);
+    if (!m_states[indexOf(tail)].compare_exchange_strong(expected, makeWord(tail, SLOT_FREE))) {
+      return;
+    }
+    m_tail.store(tail + 1);
+  }
+}
@@ -0,0 +1,156 @@
+#ifndef FTP_SLOT_RING_H
+#define FTP_SLOT_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+enum FtpOverflowPolicy {
+  FTP_OVERFLOW_DROP_NEWEST = 0,
+  FTP_OVERFLOW_DROP_OLDEST = 1,
+  FTP_OVERFLOW_BLOCK = 2
+};
+
+struct FtpSlotRingStats {
+  size_t depth;
+  size_t used;
+  size_t in_flight;
+  size_t high_water;
+  size_t capacity_bytes;
+  size_t used_bytes;
+  size_t high_water_bytes;
+  uint64_t enqueued;
+  uint64_t dropped_newest;
+  uint64_t dropped_oldest;
+  uint64_t block_timeouts;
+};
+
+// Index bookkeeping for the fixed FTP slot array.
+//
+// With a byte capacity the ring also allocates each slot's payload from one
+// contiguous buffer, sized by the frame instead of the worst case. Payloads are
+// carved from the head in enqueue order and freed as slots retire, so the free
+// space is always one span; a payload that does not fit before the end of the
+// buffer starts again at offset 0. Free slots then only bound the number of
+// small frames, the byte capacity bounds their total size.
+//
+// Producer side (beginWrite/commitWrite) is lock-free towards the consumers;
+// producer calls must be serialized by the caller. Several reservations may be
+// outstanding at once, so producers can fill their payloads without holding
+// that serialization, and may commit in any order. Slots are still published
+// in reservation order and retired in order, but consumers may claim and
+// complete them out of order. Every slot carries an
+// order key (the remote directory); a slot is only handed out when no earlier
+// slot with the same key is pending or in flight, so uploads into one
+// directory keep their enqueue order while different directories proceed in
+// parallel.
+//
+// Consumer methods (claim/complete/release/drainReady) never block the
+// producer, but must be serialized among consumers by the caller.
+//
+// Each slot state word is tagged with the sequence number it belongs to, so a
+// late retire or eviction of an old sequence can never hit a reused slot.
+class FtpSlotRing {
+ public:
+  static const size_t kInvalidSlot = static_cast<size_t>(-1);
+  // Payload offsets are rounded up to this; every payload takes at least one
+  // unit so a full buffer is never mistaken for an empty one.
+  static const size_t kByteAlign = 64;
+
+  explicit FtpSlotRing(size_t depth = 0, size_t capacity = 0);
+
+  // capacity 0 keeps slot-only bookkeeping; payload offsets are then all 0.
+  void reset(size_t depth, size_t capacity = 0);
+  size_t depth() const;
+  size_t capacity() const;
+  size_t size() const;
+  bool empty() const;
+  bool full() const;
+  // Payload bytes held by queued slots, including the unused end of the
+  // buffer skipped by a payload that wrapped to offset 0.
+  size_t usedBytes() const;
+  // True when a free slot and a contiguous span for |bytes| are available.
+  // Producer only.
+  bool fits(size_t bytes) const;
+
+  // Reserves the next slot after any outstanding reservation and, with a byte
+  // capacity, |bytes| of payload at offsetOf(slot). Drop-oldest evicts as many
+  // waiting slots as needed. Every reservation must be committed.
+  size_t beginWrite(FtpOverflowPolicy policy = FTP_OVERFLOW_DROP_NEWEST, int block_timeout_ms = 0,
+                    size_t bytes = 0);
+  // Marks a reserved slot as filled, then publishes every filled slot from the
+  // oldest reservation on; a slot committed ahead of an older reservation
+  // waits for it.
+  void commitWrite(size_t slot, uint32_t order_key);
+  // Commits the oldest outstanding reservation. A slot-only ring may also
+  // publish its next slot without beginWrite.
+  void commitWrite(uint32_t order_key);
+  // Payload offset of a slot between beginWrite and its retirement.
+  size_t offsetOf(size_t slot) const;
+  // Evicts the tail slot if it is waiting (not being uploaded). Producer only.
+  // With |slot| the eviction only happens while that slot is still the tail,
+  // so a caller can decide on the slot's owner first without locking out the
+  // consumers.
+  bool evictOldest(size_t slot = kInvalidSlot);
+
+  size_t claim();
+  void complete(size_t slot);
+  void release(size_t slot);
+  size_t drainReady();
+  size_t inFlight() const;
+  // Slot at the tail, i.e. the one drop-oldest would evict; kInvalidSlot when
+  // the ring is empty.
+  size_t oldest() const;
+
+  FtpSlotRingStats stats() const;
+
+  static uint32_t orderKey(const char *name);
+
+ private:
+  enum SlotState {
+    SLOT_FREE = 0,
+    SLOT_READY,
+    SLOT_BUSY,
+    SLOT_DONE
+  };
+
+  static uint64_t makeWord(uint64_t sequence, SlotState state);
+  static SlotState stateOf(uint64_t word);
+  static uint64_t sequenceOf(uint64_t word);
+
+  static size_t allocationSize(size_t bytes);
+
+  size_t indexOf(uint64_t sequence) const;
+  bool isBlocked(uint32_t order_key) const;
+  bool findSpan(size_t bytes, size_t *offset) const;
+  size_t reserve(size_t bytes);
+  void retire();
+
+  size_t m_depth;
+  size_t m_capacity;
+  std::unique_ptr<std::atomic<uint64_t>[]> m_states;
+  std::unique_ptr<std::atomic<uint32_t>[]> m_keys;
+  // Written by the producer for free slots only; read by stats.
+  std::unique_ptr<std::atomic<size_t>[]> m_offsets;
+  std::unique_ptr<std::atomic<size_t>[]> m_lengths;
+  std::atomic<size_t> m_byte_head;
+  // Producer only: reserved slots whose payload has been filled.
+  std::vector<bool> m_filled;
+  std::vector<uint32_t> m_blocked_keys;
+  // Slots [m_head, m_reserved) are reserved but not yet visible to consumers.
+  std::atomic<uint64_t> m_reserved;
+  std::atomic<uint64_t> m_head;
+  std::atomic<uint64_t> m_tail;
+
+  std::atomic<size_t> m_high_water;
+  std::atomic<size_t> m_high_water_bytes;
+  std::atomic<uint64_t> m_enqueued;
+  std::atomic<uint64_t> m_dropped_newest;
+  std::atomic<uint64_t> m_dropped_oldest;
+  std::atomic<uint64_t> m_block_timeouts;
+};
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef FTP_SLOT_STREAM_H
+#define FTP_SLOT_STREAM_H
+
+#include <stddef.h>
+
+#include <istream>
+#include <streambuf>
+
+// Read-only streambuf over memory owned by someone else (a FIFO slot or a
+// serialized text buffer). Nothing is copied; the caller must keep the
+// memory alive and unmodified until the stream is reset or destroyed.
+class FtpSlotStreamBuf : public std::streambuf {
+ public:
+  FtpSlotStreamBuf() {}
+
+  void reset(const char *data, size_t len) {
+    char *begin = const_cast<char *>(data);
+    setg(begin, begin, begin + (data == nullptr ? 0 : len));
+  }
+
+ protected:
+  std::streamsize showmanyc() override {
+    return egptr() - gptr();
+  }
+
+  pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                   std::ios_base::openmode which) override {
+    if ((which & std::ios_base::in) == 0) {
+      return pos_type(off_type(-1));
+    }
+
+    off_type base = 0;
+    if (dir == std::ios_base::cur) {
+      base = gptr() - eback();
+    } else if (dir == std::ios_base::end) {
+      base = egptr() - eback();
+    }
+
+    const off_type target = base + off;
+    if (target < 0 || target > egptr() - eback()) {
+      return pos_type(off_type(-1));
+    }
+
+    setg(eback(), eback() + target, egptr());
+    return pos_type(target);
+  }
+
+  pos_type seekpos(pos_type pos, std::ios_base::openmode which) override {
+    return seekoff(off_type(pos), std::ios_base::beg, which);
+  }
+};
+
+// istream bound to an FtpSlotStreamBuf. Intended to be kept as a member and
+// re-pointed per upload so the hot path performs no heap allocation.
+class FtpSlotIStream : public std::istream {
+ public:
+  FtpSlotIStream() : std::istream(nullptr) {
+    rdbuf(&m_buf);
+  }
+
+  void reset(const char *data, size_t len) {
+    m_buf.reset(data, len);
+    clear();
+  }
+
+ private:
+  FtpSlotStreamBuf m_buf;
+};
+
+#endif
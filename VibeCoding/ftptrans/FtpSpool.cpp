@@ -0,0 +1,619 @@
+#include "FtpSpool.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "FtpZipReader.h"
+
+namespace {
+
+// Record layout, little endian:
+//   magic u32 | crc32 u32 | payload_len u64 | dir_len u16 | file_len u16 | reserved u32
+//   dir_name | file_name | payload
+// The magic is written last, so a record torn by power loss never parses.
+const uint32_t kRecordMagic = 0x4c505346;  // "FSPL"
+const size_t kRecordHeaderSize = 24;
+const size_t kMaxNameLen = 0xffff;
+const size_t kCursorSize = 16;
+const size_t kCopyBufferSize = 64 * 1024;
+const size_t kStreamBufferSize = 64 * 1024;
+const uint64_t kMinSegmentBytes = 64 * 1024;
+const uint64_t kMaxSegmentBytes = 64ULL * 1024 * 1024;
+
+const char kSegmentPrefix[] = "seg_";
+const char kSegmentSuffix[] = ".spool";
+const char kCursorName[] = "cursor";
+
+struct RecordHeader {
+  uint32_t magic;
+  uint32_t crc32;
+  uint64_t payload_len;
+  uint16_t dir_len;
+  uint16_t file_len;
+
+  uint64_t size() const { return kRecordHeaderSize + dir_len + file_len + payload_len; }
+};
+
+void PutLe(uint8_t *p, uint64_t value, int bytes) {
+  for (int i = 0; i < bytes; ++i) {
+    p[i] = static_cast<uint8_t>(value >> (8 * i));
+  }
+}
+
+uint64_t GetLe(const uint8_t *p, int bytes) {
+  uint64_t value = 0;
+  for (int i = bytes - 1; i >= 0; --i) {
+    value = (value << 8) | p[i];
+  }
+  return value;
+}
+
+void EncodeHeader(const RecordHeader &header, uint8_t *out) {
+  memset(out, 0, kRecordHeaderSize);
+  PutLe(out, header.magic, 4);
+  PutLe(out + 4, header.crc32, 4);
+  PutLe(out + 8, header.payload_len, 8);
+  PutLe(out + 16, header.dir_len, 2);
+  PutLe(out + 18, header.file_len, 2);
+}
+
+void DecodeHeader(const uint8_t *in, RecordHeader *header) {
+  header->magic = static_cast<uint32_t>(GetLe(in, 4));
+  header->crc32 = static_cast<uint32_t>(GetLe(in + 4, 4));
+  header->payload_len = GetLe(in + 8, 8);
+  header->dir_len = static_cast<uint16_t>(GetLe(in + 16, 2));
+  header->file_len = static_cast<uint16_t>(GetLe(in + 18, 2));
+}
+
+bool ReadAt(int fd, void *buf, size_t len, uint64_t offset) {
+  uint8_t *out = static_cast<uint8_t *>(buf);
+  while (len > 0) {
+    const ssize_t n = pread(fd, out, len, static_cast<off_t>(offset));
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    out += n;
+    len -= static_cast<size_t>(n);
+    offset += static_cast<uint64_t>(n);
+  }
+  return true;
+}
+
+bool WriteAt(int fd, const void *buf, size_t len, uint64_t offset) {
+  const uint8_t *in = static_cast<const uint8_t *>(buf);
+  while (len > 0) {
+    const ssize_t n = pwrite(fd, in, len, static_cast<off_t>(offset));
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    in += n;
+    len -= static_cast<size_t>(n);
+    offset += static_cast<uint64_t>(n);
+  }
+  return true;
+}
+
+bool MakeDirs(const std::string &path) {
+  for (size_t pos = 1; pos <= path.size(); ++pos) {
+    if (pos == path.size() || path[pos] == '/') {
+      const std::string part = path.substr(0, pos);
+      if (mkdir(part.c_str(), 0755) != 0 && errno != EEXIST) {
+        return false;
+      }
+    }
+  }
+  struct stat st;
+  return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+}  // namespace
+
+FtpSpoolStreamBuf::FtpSpoolStreamBuf()
+    : m_file(nullptr),
+      m_left(0),
+      m_expected_crc(0),
+      m_crc(0),
+      m_produced(0),
+      m_verified(false),
+      m_buffer(kStreamBufferSize) {
+  setg(&m_buffer[0], &m_buffer[0], &m_buffer[0]);
+}
+
+FtpSpoolStreamBuf::~FtpSpoolStreamBuf() {
+  close();
+}
+
+bool FtpSpoolStreamBuf::open(const std::string &path, uint64_t offset, uint64_t length, uint32_t crc32) {
+  close();
+  m_file = fopen(path.c_str(), "rb");
+  if (m_file == nullptr) {
+    return false;
+  }
+  if (fseeko(m_file, static_cast<off_t>(offset), SEEK_SET) != 0) {
+    close();
+    return false;
+  }
+  m_left = length;
+  m_expected_crc = crc32;
+  return true;
+}
+
+void FtpSpoolStreamBuf::close() {
+  if (m_file != nullptr) {
+    fclose(m_file);
+    m_file = nullptr;
+  }
+  m_left = 0;
+  m_crc = 0;
+  m_produced = 0;
+  m_verified = false;
+  setg(&m_buffer[0], &m_buffer[0], &m_buffer[0]);
+}
+
+FtpSpoolStreamBuf::int_type FtpSpoolStreamBuf::underflow() {
+  if (gptr() < egptr()) {
+    return traits_type::to_int_type(*gptr());
+  }
+  if (m_file == nullptr) {
+    return traits_type::eof();
+  }
+
+  const size_t want = static_cast<size_t>(std::min<uint64_t>(m_left, m_buffer.size()));
+  const size_t len = want == 0 ? 0 : fread(&m_buffer[0], 1, want, m_file);
+  if (len == 0) {
+    m_verified = m_left == 0 && m_crc == m_expected_crc;
+    setg(&m_buffer[0], &m_buffer[0], &m_buffer[0]);
+    return traits_type::eof();
+  }
+
+  m_crc = FtpZipCrc32(m_crc, reinterpret_cast<const uint8_t *>(&m_buffer[0]), len);
+  m_left -= len;
+  m_produced += len;
+  setg(&m_buffer[0], &m_buffer[0], &m_buffer[0] + len);
+  return traits_type::to_int_type(*gptr());
+}
+
+FtpSpoolStreamBuf::pos_type FtpSpoolStreamBuf::seekoff(off_type off, std::ios_base::seekdir dir,
+                                                       std::ios_base::openmode which) {
+  // Only position queries are supported; the payload is read forward once.
+  if ((which & std::ios_base::in) == 0 || dir != std::ios_base::cur || off != 0) {
+    return pos_type(off_type(-1));
+  }
+  return pos_type(static_cast<off_type>(m_produced) - (egptr() - gptr()));
+}
+
+FtpSpool::FtpSpool()
+    : m_max_bytes(0),
+      m_segment_bytes(kMinSegmentBytes),
+      m_next_seq(1),
+      m_read_offset(0),
+      m_front_size(0),
+      m_disk_bytes(0),
+      m_write_fd(-1),
+      m_cursor_fd(-1),
+      m_records(0),
+      m_bytes(0),
+      m_disk_bytes_published(0),
+      m_max_bytes_published(0),
+      m_appended(0),
+      m_replayed(0),
+      m_evicted(0),
+      m_corrupted(0),
+      m_append_failures(0) {}
+
+FtpSpool::~FtpSpool() {
+  close();
+}
+
+std::string FtpSpool::segmentPath(uint64_t seq) const {
+  char name[64];
+  snprintf(name, sizeof(name), "%s%020llu%s", kSegmentPrefix, static_cast<unsigned long long>(seq),
+           kSegmentSuffix);
+  return m_dir + "/" + name;
+}
+
+bool FtpSpool::open(const std::string &dir, uint64_t max_bytes) {
+  close();
+  if (dir.empty() || max_bytes == 0 || !MakeDirs(dir)) {
+    return false;
+  }
+
+  m_dir = dir;
+  m_max_bytes = max_bytes;
+  m_segment_bytes = std::min(std::max(max_bytes / 16, kMinSegmentBytes), kMaxSegmentBytes);
+  m_copy_buffer.resize(kCopyBufferSize);
+
+  std::vector<uint64_t> seqs;
+  DIR *handle = opendir(dir.c_str());
+  if (handle == nullptr) {
+    m_dir.clear();
+    return false;
+  }
+  const size_t prefix_len = sizeof(kSegmentPrefix) - 1;
+  const size_t suffix_len = sizeof(kSegmentSuffix) - 1;
+  for (struct dirent *entry = readdir(handle); entry != nullptr; entry = readdir(handle)) {
+    const std::string name(entry->d_name);
+    if (name.size() <= prefix_len + suffix_len || name.compare(0, prefix_len, kSegmentPrefix) != 0 ||
+        name.compare(name.size() - suffix_len, suffix_len, kSegmentSuffix) != 0) {
+      continue;
+    }
+    const std::string digits = name.substr(prefix_len, name.size() - prefix_len - suffix_len);
+    if (digits.find_first_not_of("0123456789") != std::string::npos) {
+      continue;
+    }
+    seqs.push_back(strtoull(digits.c_str(), nullptr, 10));
+  }
+  closedir(handle);
+  std::sort(seqs.begin(), seqs.end());
+
+  uint64_t cursor_seq = 0;
+  uint64_t cursor_offset = 0;
+  m_cursor_fd = ::open((dir + "/" + kCursorName).c_str(), O_RDWR | O_CREAT, 0644);
+  uint8_t cursor[kCursorSize];
+  if (m_cursor_fd >= 0 && ReadAt(m_cursor_fd, cursor, sizeof(cursor), 0)) {
+    cursor_seq = GetLe(cursor, 8);
+    cursor_offset = GetLe(cursor + 8, 8);
+  }
+
+  for (size_t i = 0; i < seqs.size(); ++i) {
+    if (seqs[i] < cursor_seq) {
+      // Replayed completely before the restart.
+      unlink(segmentPath(seqs[i]).c_str());
+      continue;
+    }
+    Segment segment = {seqs[i], 0, 0};
+    const uint64_t from = (seqs[i] == cursor_seq) ? cursor_offset : 0;
+    const bool last = (i + 1 == seqs.size());
+    if (!scanSegment(&segment, from, last)) {
+      unlink(segmentPath(seqs[i]).c_str());
+      continue;
+    }
+    if (m_segments.empty()) {
+      m_read_offset = std::min(from, segment.end);
+    }
+    m_segments.push_back(segment);
+    m_disk_bytes += segment.end;
+    m_next_seq = seqs[i] + 1;
+  }
+  if (!seqs.empty()) {
+    m_next_seq = std::max(m_next_seq, seqs.back() + 1);
+  }
+
+  saveCursor();
+  publishCounts();
+  return true;
+}
+
+bool FtpSpool::scanSegment(Segment *segment, uint64_t from, bool truncate_tail) {
+  const std::string path = segmentPath(segment->seq);
+  const int fd = ::open(path.c_str(), O_RDWR);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat st;
+  const uint64_t file_size = (fstat(fd, &st) == 0) ? static_cast<uint64_t>(st.st_size) : 0;
+  uint64_t offset = 0;
+  uint64_t records = 0;
+  uint64_t queued_bytes = 0;
+  while (offset + kRecordHeaderSize <= file_size) {
+    uint8_t raw[kRecordHeaderSize];
+    RecordHeader header;
+    if (!ReadAt(fd, raw, sizeof(raw), offset)) {
+      break;
+    }
+    DecodeHeader(raw, &header);
+    if (header.magic != kRecordMagic || header.size() > file_size - offset) {
+      break;
+    }
+    if (offset >= from) {
+      ++records;
+      queued_bytes += header.size();
+    }
+    offset += header.size();
+  }
+
+  if (offset < file_size) {
+    if (truncate_tail) {
+      // A torn append; appends continue from the last complete record.
+      if (ftruncate(fd, static_cast<off_t>(offset)) != 0) {
+        ::close(fd);
+        return false;
+      }
+    } else {
+      m_corrupted.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+  ::close(fd);
+
+  segment->end = offset;
+  segment->records = records;
+  m_records.fetch_add(records, std::memory_order_relaxed);
+  m_bytes.fetch_add(queued_bytes, std::memory_order_relaxed);
+  return true;
+}
+
+void FtpSpool::close() {
+  closeWriteSegment();
+  if (m_cursor_fd >= 0) {
+    ::close(m_cursor_fd);
+    m_cursor_fd = -1;
+  }
+  m_dir.clear();
+  m_segments.clear();
+  m_next_seq = 1;
+  m_read_offset = 0;
+  m_front_size = 0;
+  m_disk_bytes = 0;
+  m_records.store(0, std::memory_order_relaxed);
+  m_bytes.store(0, std::memory_order_relaxed);
+  publishCounts();
+}
+
+bool FtpSpool::openWriteSegment() {
+  if (m_write_fd >= 0 && !m_segments.empty() && m_segments.back().end < m_segment_bytes) {
+    return true;
+  }
+  closeWriteSegment();
+
+  if (!m_segments.empty() && m_segments.back().end < m_segment_bytes) {
+    // Reopen the tail segment left by the previous run.
+    m_write_fd = ::open(segmentPath(m_segments.back().seq).c_str(), O_WRONLY);
+    return m_write_fd >= 0;
+  }
+
+  const Segment segment = {m_next_seq, 0, 0};
+  m_write_fd = ::open(segmentPath(segment.seq).c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (m_write_fd < 0) {
+    return false;
+  }
+  if (m_segments.empty()) {
+    m_read_offset = 0;
+  }
+  m_segments.push_back(segment);
+  m_next_seq++;
+  saveCursor();
+  return true;
+}
+
+void FtpSpool::closeWriteSegment() {
+  if (m_write_fd >= 0) {
+    ::close(m_write_fd);
+    m_write_fd = -1;
+  }
+}
+
+void FtpSpool::dropFrontSegment(bool evicted) {
+  if (m_segments.empty()) {
+    return;
+  }
+  const Segment front = m_segments.front();
+  if (m_segments.size() == 1) {
+    closeWriteSegment();
+  }
+  unlink(segmentPath(front.seq).c_str());
+
+  if (evicted) {
+    m_evicted.fetch_add(front.records, std::memory_order_relaxed);
+  } else {
+    m_corrupted.fetch_add(front.records, std::memory_order_relaxed);
+  }
+  m_records.fetch_sub(front.records, std::memory_order_relaxed);
+  m_bytes.fetch_sub(front.end - m_read_offset, std::memory_order_relaxed);
+  m_disk_bytes -= front.end;
+
+  m_segments.pop_front();
+  m_read_offset = 0;
+  m_front_size = 0;
+  saveCursor();
+}
+
+bool FtpSpool::append(const std::string &dir_name, const std::string &file_name, std::istream &payload,
+                      uint64_t length) {
+  return appendRecord(dir_name, file_name, payload, length, true);
+}
+
+bool FtpSpool::appendUpTo(const std::string &dir_name, const std::string &file_name,
+                          std::istream &payload, uint64_t max_length) {
+  return appendRecord(dir_name, file_name, payload, max_length, false);
+}
+
+bool FtpSpool::appendRecord(const std::string &dir_name, const std::string &file_name,
+                            std::istream &payload, uint64_t length, bool exact) {
+  RecordHeader header;
+  header.magic = 0;
+  header.crc32 = 0;
+  header.payload_len = length;
+  header.dir_len = static_cast<uint16_t>(dir_name.size());
+  header.file_len = static_cast<uint16_t>(file_name.size());
+
+  const uint64_t record_size = header.size();
+  if (!isOpen() || dir_name.size() > kMaxNameLen || file_name.size() > kMaxNameLen ||
+      record_size > m_max_bytes) {
+    m_append_failures.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  while (!m_segments.empty() && m_disk_bytes + record_size > m_max_bytes) {
+    dropFrontSegment(true);
+  }
+  if (!openWriteSegment()) {
+    m_append_failures.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  Segment &segment = m_segments.back();
+  const uint64_t start = segment.end;
+  uint8_t raw[kRecordHeaderSize];
+  EncodeHeader(header, raw);
+
+  bool ok = WriteAt(m_write_fd, raw, sizeof(raw), start) &&
+            WriteAt(m_write_fd, dir_name.data(), dir_name.size(), start + kRecordHeaderSize) &&
+            WriteAt(m_write_fd, file_name.data(), file_name.size(),
+                    start + kRecordHeaderSize + dir_name.size());
+
+  uint64_t offset = start + kRecordHeaderSize + dir_name.size() + file_name.size();
+  uint64_t left = length;
+  uint32_t crc = 0;
+  while (ok && left > 0) {
+    const size_t chunk = static_cast<size_t>(std::min<uint64_t>(left, m_copy_buffer.size()));
+    payload.read(&m_copy_buffer[0], static_cast<std::streamsize>(chunk));
+    const size_t got = static_cast<size_t>(payload.gcount());
+    if (got != chunk && exact) {
+      ok = false;
+      break;
+    }
+    crc = FtpZipCrc32(crc, reinterpret_cast<const uint8_t *>(&m_copy_buffer[0]), got);
+    ok = WriteAt(m_write_fd, &m_copy_buffer[0], got, offset);
+    offset += got;
+    left -= got;
+    if (got != chunk) {
+      break;
+    }
+  }
+  if (ok && !exact && left == 0 && payload.peek() != std::istream::traits_type::eof()) {
+    // Longer than the promised bound.
+    ok = false;
+  }
+
+  if (ok) {
+    header.payload_len = length - left;
+    header.magic = kRecordMagic;
+    header.crc32 = crc;
+    EncodeHeader(header, raw);
+    ok = WriteAt(m_write_fd, raw, sizeof(raw), start);
+  }
+  if (!ok) {
+    if (ftruncate(m_write_fd, static_cast<off_t>(start)) != 0) {
+      // The torn record keeps a zero magic and is cut off on the next open.
+      closeWriteSegment();
+    }
+    m_append_failures.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  const uint64_t written = header.size();
+  segment.end += written;
+  segment.records++;
+  m_disk_bytes += written;
+  m_records.fetch_add(1, std::memory_order_relaxed);
+  m_bytes.fetch_add(written, std::memory_order_relaxed);
+  m_appended.fetch_add(1, std::memory_order_relaxed);
+  publishCounts();
+  return true;
+}
+
+bool FtpSpool::openFront(FtpSpoolIStream *stream, std::string *dir_name, std::string *file_name,
+                         uint64_t *length) {
+  m_front_size = 0;
+  while (!m_segments.empty()) {
+    const Segment &front = m_segments.front();
+    if (m_read_offset >= front.end) {
+      if (m_segments.size() == 1) {
+        return false;
+      }
+      dropFrontSegment(false);
+      continue;
+    }
+
+    const std::string path = segmentPath(front.seq);
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    uint8_t raw[kRecordHeaderSize];
+    RecordHeader header;
+    bool ok = fd >= 0 && ReadAt(fd, raw, sizeof(raw), m_read_offset);
+    if (ok) {
+      DecodeHeader(raw, &header);
+      ok = header.magic == kRecordMagic && header.size() <= front.end - m_read_offset;
+    }
+    if (ok) {
+      dir_name->resize(header.dir_len);
+      file_name->resize(header.file_len);
+      ok = (header.dir_len == 0 || ReadAt(fd, &(*dir_name)[0], header.dir_len, m_read_offset + kRecordHeaderSize)) &&
+           (header.file_len == 0 ||
+            ReadAt(fd, &(*file_name)[0], header.file_len, m_read_offset + kRecordHeaderSize + header.dir_len));
+    }
+    if (fd >= 0) {
+      ::close(fd);
+    }
+    const uint64_t payload_offset = m_read_offset + kRecordHeaderSize + header.dir_len + header.file_len;
+    if (ok && stream->open(path, payload_offset, header.payload_len, header.crc32)) {
+      m_front_size = header.size();
+      *length = header.payload_len;
+      return true;
+    }
+
+    // The rest of this segment cannot be walked any more.
+    dropFrontSegment(false);
+  }
+  return false;
+}
+
+void FtpSpool::popFront() {
+  if (m_segments.empty() || m_front_size == 0) {
+    return;
+  }
+
+  Segment &front = m_segments.front();
+  m_read_offset += m_front_size;
+  front.records--;
+  m_records.fetch_sub(1, std::memory_order_relaxed);
+  m_bytes.fetch_sub(m_front_size, std::memory_order_relaxed);
+  m_replayed.fetch_add(1, std::memory_order_relaxed);
+  m_front_size = 0;
+
+  if (m_read_offset >= front.end && (m_segments.size() > 1 || front.end >= m_segment_bytes)) {
+    // Fully replayed: count nothing as lost.
+    if (m_segments.size() == 1) {
+      closeWriteSegment();
+    }
+    unlink(segmentPath(front.seq).c_str());
+    m_disk_bytes -= front.end;
+    m_segments.pop_front();
+    m_read_offset = 0;
+  }
+  saveCursor();
+  publishCounts();
+}
+
+void FtpSpool::saveCursor() {
+  if (m_cursor_fd < 0) {
+    return;
+  }
+  uint8_t cursor[kCursorSize];
+  PutLe(cursor, m_segments.empty() ? m_next_seq : m_segments.front().seq, 8);
+  PutLe(cursor + 8, m_segments.empty() ? 0 : m_read_offset, 8);
+  // No fsync: after a crash a few records may be replayed twice, which only
+  // overwrites the same remote files.
+  WriteAt(m_cursor_fd, cursor, sizeof(cursor), 0);
+}
+
+void FtpSpool::publishCounts() {
+  m_disk_bytes_published.store(m_disk_bytes, std::memory_order_relaxed);
+  m_max_bytes_published.store(isOpen() ? m_max_bytes : 0, std::memory_order_relaxed);
+}
+
+FtpSpoolStats FtpSpool::stats() const {
+  FtpSpoolStats stats;
+  stats.records = m_records.load(std::memory_order_relaxed);
+  stats.bytes = m_bytes.load(std::memory_order_relaxed);
+  stats.disk_bytes = m_disk_bytes_published.load(std::memory_order_relaxed);
+  stats.max_bytes = m_max_bytes_published.load(std::memory_order_relaxed);
+  stats.appended = m_appended.load(std::memory_order_relaxed);
+  stats.replayed = m_replayed.load(std::memory_order_relaxed);
+  stats.evicted = m_evicted.load(std::memory_order_relaxed);
+  stats.corrupted = m_corrupted.load(std::memory_order_relaxed);
+  stats.append_failures = m_append_failures.load(std::memory_order_relaxed);
+  return stats;
+}
@@ -0,0 +1,161 @@
+#ifndef FTP_SPOOL_H
+#define FTP_SPOOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <deque>
+#include <istream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+struct FtpSpoolStats {
+  uint64_t records;          // queued, not yet replayed
+  uint64_t bytes;            // queued record bytes
+  uint64_t disk_bytes;       // segment bytes on disk, counts toward max_bytes
+  uint64_t max_bytes;
+  uint64_t appended;
+  uint64_t replayed;
+  uint64_t evicted;          // dropped oldest-first to stay under max_bytes
+  uint64_t corrupted;        // unreadable on open or replay
+  uint64_t append_failures;  // short read, write error or record too large
+};
+
+// Read-only streambuf over the payload of one spooled record. The CRC-32 is
+// checked when the payload has been read to the end.
+class FtpSpoolStreamBuf : public std::streambuf {
+ public:
+  FtpSpoolStreamBuf();
+  ~FtpSpoolStreamBuf() override;
+
+  bool open(const std::string &path, uint64_t offset, uint64_t length, uint32_t crc32);
+  void close();
+  bool isOpen() const { return m_file != nullptr; }
+
+  // True once the whole payload was read with a matching CRC.
+  bool ok() const { return m_verified; }
+  uint64_t bytesProduced() const { return m_produced; }
+
+ protected:
+  int_type underflow() override;
+  pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                   std::ios_base::openmode which) override;
+
+ private:
+  FtpSpoolStreamBuf(const FtpSpoolStreamBuf &) = delete;
+  FtpSpoolStreamBuf &operator=(const FtpSpoolStreamBuf &) = delete;
+
+  FILE *m_file;
+  uint64_t m_left;
+  uint32_t m_expected_crc;
+  uint32_t m_crc;
+  uint64_t m_produced;
+  bool m_verified;
+  std::vector<char> m_buffer;
+};
+
+class FtpSpoolIStream : public std::istream {
+ public:
+  FtpSpoolIStream() : std::istream(nullptr) {
+    rdbuf(&m_buf);
+  }
+
+  bool open(const std::string &path, uint64_t offset, uint64_t length, uint32_t crc32) {
+    const bool opened = m_buf.open(path, offset, length, crc32);
+    clear();
+    return opened;
+  }
+
+  void close() { m_buf.close(); }
+  bool isOpen() const { return m_buf.isOpen(); }
+  bool ok() const { return m_buf.ok(); }
+  uint64_t bytesProduced() const { return m_buf.bytesProduced(); }
+
+ private:
+  FtpSpoolStreamBuf m_buf;
+};
+
+// Log-structured spool of pending uploads in one directory. Records are
+// appended to segment files; when the size limit is reached whole segments are
+// evicted oldest first. Replayed records are released from the front and a
+// small cursor file keeps the replay position across restarts. A torn record
+// at the tail (power loss during append) is cut off on open.
+//
+// Only stats() may be called concurrently with the other methods.
+class FtpSpool {
+ public:
+  FtpSpool();
+  ~FtpSpool();
+
+  bool open(const std::string &dir, uint64_t max_bytes);
+  void close();
+  bool isOpen() const { return !m_dir.empty(); }
+  bool empty() const { return m_records.load(std::memory_order_relaxed) == 0; }
+  const std::string &dir() const { return m_dir; }
+
+  // Copies `length` bytes of `payload` into a new record. On failure the
+  // spool is left unchanged.
+  bool append(const std::string &dir_name, const std::string &file_name, std::istream &payload,
+              uint64_t length);
+  // Same, for streams whose size is only known at the end (compressed
+  // frames): copies until end of stream, failing beyond `max_length`. Space
+  // for `max_length` is made before the copy.
+  bool appendUpTo(const std::string &dir_name, const std::string &file_name, std::istream &payload,
+                  uint64_t max_length);
+
+  // Opens the payload of the oldest record. Records that fail to parse are
+  // dropped (counted as corrupted). Returns false when the spool is empty.
+  bool openFront(FtpSpoolIStream *stream, std::string *dir_name, std::string *file_name,
+                 uint64_t *length);
+  // Releases the oldest record once it was uploaded or found unreadable.
+  void popFront();
+
+  FtpSpoolStats stats() const;
+
+ private:
+  struct Segment {
+    uint64_t seq;
+    uint64_t end;      // bytes of valid records
+    uint64_t records;  // records not yet replayed
+  };
+
+  FtpSpool(const FtpSpool &) = delete;
+  FtpSpool &operator=(const FtpSpool &) = delete;
+
+  bool appendRecord(const std::string &dir_name, const std::string &file_name, std::istream &payload,
+                    uint64_t length, bool exact);
+  std::string segmentPath(uint64_t seq) const;
+  bool scanSegment(Segment *segment, uint64_t from, bool truncate_tail);
+  bool openWriteSegment();
+  void closeWriteSegment();
+  void dropFrontSegment(bool evicted);
+  void saveCursor();
+  void publishCounts();
+
+  std::string m_dir;
+  uint64_t m_max_bytes;
+  uint64_t m_segment_bytes;
+  std::deque<Segment> m_segments;
+  uint64_t m_next_seq;
+  uint64_t m_read_offset;  // inside the front segment
+  uint64_t m_front_size;   // size of the record opened by openFront, 0 if none
+  uint64_t m_disk_bytes;
+  int m_write_fd;
+  int m_cursor_fd;
+  std::vector<char> m_copy_buffer;
+
+  std::atomic<uint64_t> m_records;
+  std::atomic<uint64_t> m_bytes;
+  std::atomic<uint64_t> m_disk_bytes_published;
+  std::atomic<uint64_t> m_max_bytes_published;
+  std::atomic<uint64_t> m_appended;
+  std::atomic<uint64_t> m_replayed;
+  std::atomic<uint64_t> m_evicted;
+  std::atomic<uint64_t> m_corrupted;
+  std::atomic<uint64_t> m_append_failures;
+};
+
+#endif
@@ -0,0 +1,185 @@
+#include "FtpUploadStats.h"
+
+#include <stdio.h>
+
+#include <chrono>
+
+const size_t FtpHistogram::kBuckets;
+
+namespace {
+
+const char *const kStageNames[FTP_STAGE_COUNT] = {
+    "queue_wait_us",
+    "dir_us",
+    "encode_us",
+    "transfer_us",
+};
+
+const char *const kCounterNames[FTP_COUNTER_COUNT] = {
+    "uploads",
+    "failures",
+    "bytes",
+    "retries",
+    "relogins",
+    "login_failures",
+    "noop_failures",
+    "failovers",
+};
+
+// Advances *pos past an snprintf result, keeping it inside the buffer so a
+// short buffer truncates instead of overflowing.
+void Advance(size_t size, size_t *pos, int written) {
+  if (written > 0) {
+    *pos += static_cast<size_t>(written);
+  }
+  if (*pos >= size) {
+    *pos = size - 1;
+  }
+}
+
+}  // namespace
+
+FtpHistogram::FtpHistogram() {
+  reset();
+}
+
+size_t FtpHistogram::bucketOf(uint64_t value) {
+  size_t bucket = 0;
+  while (value != 0 && bucket + 1 < kBuckets) {
+    value >>= 1;
+    ++bucket;
+  }
+  return bucket;
+}
+
+void FtpHistogram::record(uint64_t value) {
+  m_buckets[bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+  m_sum.fetch_add(value, std::memory_order_relaxed);
+
+  uint64_t current = m_max.load(std::memory_order_relaxed);
+  while (value > current &&
+         !m_max.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+  }
+}
+
+void FtpHistogram::reset() {
+  for (size_t i = 0; i < kBuckets; ++i) {
+    m_buckets[i].store(0, std::memory_order_relaxed);
+  }
+  m_sum.store(0, std::memory_order_relaxed);
+  m_max.store(0, std::memory_order_relaxed);
+}
+
+FtpHistogramSummary FtpHistogram::summary() const {
+  // Buckets are read one by one while writers may still add; the count is
+  // summed from the same bucket reads so the percentiles stay consistent.
+  uint64_t buckets[kBuckets];
+  uint64_t count = 0;
+  for (size_t i = 0; i < kBuckets; ++i) {
+    buckets[i] = m_buckets[i].load(std::memory_order_relaxed);
+    count += buckets[i];
+  }
+
+  FtpHistogramSummary result;
+  result.count = count;
+  result.sum = m_sum.load(std::memory_order_relaxed);
+  result.max = m_max.load(std::memory_order_relaxed);
+
+  const uint64_t targets[3] = {(count * 50 + 99) / 100, (count * 90 + 99) / 100, (count * 99 + 99) / 100};
+  uint64_t *outputs[3] = {&result.p50, &result.p90, &result.p99};
+  for (size_t t = 0; t < 3; ++t) {
+    *outputs[t] = 0;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBuckets && targets[t] > 0; ++i) {
+      seen += buckets[i];
+      if (seen >= targets[t]) {
+        const uint64_t upper = i == 0 ? 0 : (uint64_t(1) << i) - 1;
+        *outputs[t] = upper < result.max ? upper : result.max;
+        break;
+      }
+    }
+  }
+  return result;
+}
+
+int FtpHistogram::formatJson(char *buf, size_t size) const {
+  const FtpHistogramSummary s = summary();
+  return snprintf(buf, size, "{\"count\":%llu,\"avg\":%llu,\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,\"max\":%llu}",
+                  static_cast<unsigned long long>(s.count),
+                  static_cast<unsigned long long>(s.count == 0 ? 0 : s.sum / s.count),
+                  static_cast<unsigned long long>(s.p50), static_cast<unsigned long long>(s.p90),
+                  static_cast<unsigned long long>(s.p99), static_cast<unsigned long long>(s.max));
+}
+
+FtpUploadStats::FtpUploadStats() {
+  for (size_t i = 0; i < FTP_COUNTER_COUNT; ++i) {
+    m_counters[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+uint64_t FtpUploadStats::nowUs() {
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                                   std::chrono::steady_clock::now().time_since_epoch())
+                                   .count());
+}
+
+void FtpUploadStats::recordStage(FtpUploadStage stage, uint64_t micros) {
+  m_stages[stage].record(micros);
+}
+
+void FtpUploadStats::recordThroughput(uint64_t bytes, uint64_t micros) {
+  m_counters[FTP_COUNTER_BYTES].fetch_add(bytes, std::memory_order_relaxed);
+  m_throughput.record(bytes * 1000000 / (micros == 0 ? 1 : micros));
+}
+
+void FtpUploadStats::increment(FtpUploadCounter counter, uint64_t value) {
+  m_counters[counter].fetch_add(value, std::memory_order_relaxed);
+}
+
+uint64_t FtpUploadStats::counter(FtpUploadCounter counter) const {
+  return m_counters[counter].load(std::memory_order_relaxed);
+}
+
+const FtpHistogram &FtpUploadStats::stage(FtpUploadStage stage) const {
+  return m_stages[stage];
+}
+
+const FtpHistogram &FtpUploadStats::throughput() const {
+  return m_throughput;
+}
+
+void FtpUploadStats::reset() {
+  for (size_t i = 0; i < FTP_STAGE_COUNT; ++i) {
+    m_stages[i].reset();
+  }
+  m_throughput.reset();
+  for (size_t i = 0; i < FTP_COUNTER_COUNT; ++i) {
+    m_counters[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+int FtpUploadStats::formatJson(char *buf, size_t size) const {
+  if (buf == nullptr || size == 0) {
+    return 0;
+  }
+
+  size_t pos = 0;
+  buf[0] = '\0';
+  Advance(size, &pos, snprintf(buf + pos, size - pos, "{"));
+  for (size_t i = 0; i < FTP_COUNTER_COUNT; ++i) {
+    Advance(size, &pos,
+            snprintf(buf + pos, size - pos, "%s\"%s\":%llu", i == 0 ? "" : ",", kCounterNames[i],
+                     static_cast<unsigned long long>(counter(static_cast<FtpUploadCounter>(i)))));
+  }
+  for (size_t i = 0; i < FTP_STAGE_COUNT; ++i) {
+    Advance(size, &pos, snprintf(buf + pos, size - pos, ",\"%s\":", kStageNames[i]));
+    Advance(size, &pos, m_stages[i].formatJson(buf + pos, size - pos));
+  }
+  Advance(size, &pos, snprintf(buf + pos, size - pos, ",\"throughput_bps\":"));
+  Advance(size, &pos, m_throughput.formatJson(buf + pos, size - pos));
+  if (pos + 1 < size) {
+    buf[pos++] = '}';
+    buf[pos] = '\0';
+  }
+  return static_cast<int>(pos);
+}
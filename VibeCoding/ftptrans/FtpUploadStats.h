@@ -0,0 +1,88 @@
+#ifndef FTP_UPLOAD_STATS_H
+#define FTP_UPLOAD_STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+struct FtpHistogramSummary {
+  uint64_t count;
+  uint64_t sum;
+  uint64_t max;
+  uint64_t p50;
+  uint64_t p90;
+  uint64_t p99;
+};
+
+// Lock-free histogram with power-of-two buckets: bucket 0 holds 0, bucket i
+// holds [2^(i-1), 2^i). Percentiles are reported as the upper bound of their
+// bucket (clamped to max), i.e. within a factor of two.
+class FtpHistogram {
+ public:
+  static const size_t kBuckets = 48;
+
+  FtpHistogram();
+
+  void record(uint64_t value);
+  void reset();
+  FtpHistogramSummary summary() const;
+
+  // Writes {"count":..,"avg":..,"p50":..,"p90":..,"p99":..,"max":..}.
+  int formatJson(char *buf, size_t size) const;
+
+ private:
+  static size_t bucketOf(uint64_t value);
+
+  std::atomic<uint64_t> m_buckets[kBuckets];
+  std::atomic<uint64_t> m_sum;
+  std::atomic<uint64_t> m_max;
+};
+
+enum FtpUploadStage {
+  FTP_STAGE_QUEUE_WAIT = 0,  // enqueue to dequeue
+  FTP_STAGE_DIRECTORY,       // MKD / directory cache
+  FTP_STAGE_ENCODE,          // BMP/FLI encoding while streaming
+  FTP_STAGE_TRANSFER,        // STOR minus encoding: network and server
+  FTP_STAGE_COUNT
+};
+
+enum FtpUploadCounter {
+  FTP_COUNTER_UPLOADS = 0,
+  FTP_COUNTER_FAILURES,
+  FTP_COUNTER_BYTES,
+  FTP_COUNTER_RETRIES,
+  FTP_COUNTER_RELOGINS,
+  FTP_COUNTER_LOGIN_FAILURES,
+  FTP_COUNTER_NOOP_FAILURES,
+  FTP_COUNTER_FAILOVERS,
+  FTP_COUNTER_COUNT
+};
+
+// Upload telemetry shared by all connections. Every method is lock-free and
+// safe to call from any thread.
+class FtpUploadStats {
+ public:
+  FtpUploadStats();
+
+  static uint64_t nowUs();
+
+  void recordStage(FtpUploadStage stage, uint64_t micros);
+  // Records one finished transfer for the bytes/s histogram and byte counter.
+  void recordThroughput(uint64_t bytes, uint64_t micros);
+  void increment(FtpUploadCounter counter, uint64_t value = 1);
+
+  uint64_t counter(FtpUploadCounter counter) const;
+  const FtpHistogram &stage(FtpUploadStage stage) const;
+  const FtpHistogram &throughput() const;
+
+  void reset();
+  int formatJson(char *buf, size_t size) const;
+
+ private:
+  FtpHistogram m_stages[FTP_STAGE_COUNT];
+  FtpHistogram m_throughput;
+  std::atomic<uint64_t> m_counters[FTP_COUNTER_COUNT];
+};
+
+#endif
@@ -0,0 +1,45 @@
+#include "FtpWakeup.h"
+
+#include <chrono>
+
+const uint64_t FtpWakeup::kNoDeadline;
+
+FtpWakeup::FtpWakeup() : m_epoch(0), m_waiters(0) {}
+
+uint64_t FtpWakeup::epoch() const {
+  return m_epoch.load(std::memory_order_seq_cst);
+}
+
+void FtpWakeup::notify() {
+  // Both sides use seq_cst: either this load sees the waiter, or the waiter's
+  // epoch check under the lock sees the increment.
+  m_epoch.fetch_add(1, std::memory_order_seq_cst);
+  if (m_waiters.load(std::memory_order_seq_cst) > 0) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_cond.notify_all();
+  }
+}
+
+bool FtpWakeup::waitUntil(uint64_t seen, uint64_t deadline_us) {
+  typedef std::chrono::steady_clock Clock;
+
+  m_waiters.fetch_add(1, std::memory_order_seq_cst);
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (deadline_us == kNoDeadline) {
+      while (m_epoch.load(std::memory_order_seq_cst) == seen) {
+        m_cond.wait(lock);
+      }
+    } else {
+      const Clock::time_point deadline(
+          std::chrono::duration_cast<Clock::duration>(std::chrono::microseconds(deadline_us)));
+      while (m_epoch.load(std::memory_order_seq_cst) == seen) {
+        if (m_cond.wait_until(lock, deadline) == std::cv_status::timeout) {
+          break;
+        }
+      }
+    }
+  }
+  m_waiters.fetch_sub(1, std::memory_order_seq_cst);
+  return m_epoch.load(std::memory_order_seq_cst) != seen;
+}
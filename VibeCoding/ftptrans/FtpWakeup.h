@@ -0,0 +1,39 @@
+#ifndef FTP_WAKEUP_H
+#define FTP_WAKEUP_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+// Wakes the FTP threads when work arrives. Waiters take epoch() before they
+// look for work and pass it to waitUntil(), so a notify() that lands between
+// the check and the wait is never lost. notify() only takes the lock when a
+// thread is actually waiting; otherwise it costs one atomic increment and one
+// load, cheap enough for the lock-free image producer to call per frame.
+class FtpWakeup {
+ public:
+  static const uint64_t kNoDeadline = UINT64_MAX;
+
+  FtpWakeup();
+
+  uint64_t epoch() const;
+  void notify();
+
+  // Blocks until notify() was called after `seen` was taken or until
+  // `deadline_us` (steady clock in microseconds, the FtpUploadStats::nowUs()
+  // base) passes. Returns true if woken by notify().
+  bool waitUntil(uint64_t seen, uint64_t deadline_us);
+
+ private:
+  FtpWakeup(const FtpWakeup &) = delete;
+  FtpWakeup &operator=(const FtpWakeup &) = delete;
+
+  std::atomic<uint64_t> m_epoch;
+  std::atomic<int> m_waiters;
+  std::mutex m_mutex;
+  std::condition_variable m_cond;
+};
+
+#endif
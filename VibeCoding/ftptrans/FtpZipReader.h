@@ -0,0 +1,159 @@
+#ifndef FTP_ZIP_READER_H
+#define FTP_ZIP_READER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <istream>
+#include <memory>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+struct FtpZipEntry {
+  std::string name;
+  uint16_t method;  // 0 stored, 8 deflate
+  uint32_t crc32;
+  uint32_t compressed_size;
+  uint32_t uncompressed_size;
+  uint32_t local_header_offset;
+};
+
+// Central directory of a ZIP archive. Only what the log archive uses is
+// supported: stored and deflate entries, no ZIP64, no encryption.
+class FtpZipArchive {
+ public:
+  bool open(const std::string &path);
+
+  const std::vector<FtpZipEntry> &entries() const { return m_entries; }
+  const FtpZipEntry *find(const std::string &name) const;
+
+  // Splits "<dir>/<archive>.zip/<entry>" into archive path and entry name.
+  static bool splitPath(const std::string &path, std::string *archive, std::string *entry);
+
+ private:
+  std::vector<FtpZipEntry> m_entries;
+};
+
+// Streaming raw DEFLATE (RFC 1951) decoder. Input is pulled from a FILE
+// limited to `input_len` bytes; output is produced on demand into a 32 KB
+// window, so memory stays constant whatever the entry size.
+class FtpInflater {
+ public:
+  FtpInflater();
+
+  void reset(FILE *input, uint32_t input_len);
+  // Returns the number of bytes written to `out`; 0 once the stream ended or
+  // failed (see done() / failed()).
+  size_t read(uint8_t *out, size_t len);
+
+  bool done() const { return m_state == STATE_DONE; }
+  bool failed() const { return m_state == STATE_ERROR; }
+
+  struct Huffman {
+    uint16_t count[16];
+    uint16_t symbol[288];
+    uint16_t fast[512];  // (len << 12) | symbol for codes of up to 9 bits
+  };
+
+ private:
+  enum State {
+    STATE_HEADER = 0,
+    STATE_STORED,
+    STATE_HUFFMAN,
+    STATE_DONE,
+    STATE_ERROR
+  };
+
+  int nextByte();
+  bool need(int bits);
+  uint32_t bits(int count);
+  int decode(const Huffman &huffman);
+  bool readHeader();
+  bool readDynamicTables();
+
+  FILE *m_input;
+  uint32_t m_input_left;
+  uint8_t m_in_buf[4096];
+  size_t m_in_pos;
+  size_t m_in_len;
+  uint32_t m_padded_bits;
+
+  uint64_t m_bit_buf;
+  int m_bit_count;
+
+  State m_state;
+  bool m_last_block;
+  uint32_t m_stored_left;
+  uint32_t m_match_left;
+  uint32_t m_match_dist;
+
+  std::vector<uint8_t> m_window;
+  uint32_t m_window_pos;
+  uint64_t m_total_out;
+
+  Huffman m_lencode;
+  Huffman m_distcode;
+};
+
+// Read-only streambuf that decompresses one archive entry while it is read
+// and checks its size and CRC-32 at the end.
+class FtpZipEntryStreamBuf : public std::streambuf {
+ public:
+  FtpZipEntryStreamBuf();
+  ~FtpZipEntryStreamBuf() override;
+
+  bool open(const std::string &archive_path, const std::string &entry_name);
+  void close();
+  bool isOpen() const { return m_file != nullptr; }
+
+  // True once the whole entry was produced with a matching size and CRC.
+  bool ok() const { return m_verified; }
+  uint64_t bytesProduced() const { return m_produced; }
+
+ protected:
+  int_type underflow() override;
+  pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                   std::ios_base::openmode which) override;
+
+ private:
+  FtpZipEntryStreamBuf(const FtpZipEntryStreamBuf &) = delete;
+  FtpZipEntryStreamBuf &operator=(const FtpZipEntryStreamBuf &) = delete;
+
+  size_t fill(uint8_t *out, size_t len);
+
+  FILE *m_file;
+  FtpZipEntry m_entry;
+  std::unique_ptr<FtpInflater> m_inflater;
+  uint32_t m_stored_left;
+  uint32_t m_crc;
+  uint64_t m_produced;
+  bool m_verified;
+  std::vector<char> m_buffer;
+};
+
+class FtpZipEntryIStream : public std::istream {
+ public:
+  FtpZipEntryIStream() : std::istream(nullptr) {
+    rdbuf(&m_buf);
+  }
+
+  bool open(const std::string &archive_path, const std::string &entry_name) {
+    const bool opened = m_buf.open(archive_path, entry_name);
+    clear();
+    return opened;
+  }
+
+  void close() { m_buf.close(); }
+  bool isOpen() const { return m_buf.isOpen(); }
+  bool ok() const { return m_buf.ok(); }
+  uint64_t bytesProduced() const { return m_buf.bytesProduced(); }
+
+ private:
+  FtpZipEntryStreamBuf m_buf;
+};
+
+uint32_t FtpZipCrc32(uint32_t crc, const uint8_t *data, size_t len);
+
+#endif
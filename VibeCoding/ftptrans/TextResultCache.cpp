@@ -1,7 +1,26 @@
 #include "TextResultCache.h"
 
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+
+const size_t TextResultCache::kSegmentRecords;
+const size_t TextResultCache::kSegmentItems;
+const size_t TextResultCache::kSegmentBytes;
+
+namespace {
+
+bool ItemSequenceLess(const std::pair<uint64_t, size_t> &entry, uint64_t sequence) {
+  return entry.first < sequence;
+}
+
+}  // namespace
+
 TextResultCache::TextResultCache(size_t hard_limit)
-    : m_hard_limit(hard_limit),
+    : m_first_sequence(0),
+      m_next_sequence(0),
+      m_hard_limit(hard_limit),
       m_retention_count(hard_limit),
       m_retention_time_range_sec(0),
       m_policy(TEXT_RETENTION_BY_COUNT) {}
@@ -20,55 +39,157 @@ void TextResultCache::setRetentionTimeRangeSec(int64_t retention_time_range_sec)
   trimByHardLimit();
 }
 
-void TextResultCache::clear() { m_records.clear(); }
+void TextResultCache::clear() {
+  while (!empty()) {
+    popFront();
+  }
+}
 
 void TextResultCache::addRecord(const TextRecord &record) {
-  TextRecord normalized = record;
-  normalized.items = splitItems(normalized.raw_text);
-  m_records.push_back(normalized);
+  const std::string &raw = record.raw_text;
+  const size_t item_count = static_cast<size_t>(std::count(raw.begin(), raw.end(), ';')) + 1;
+  const size_t byte_count = record.timestamp_text.size() + raw.size();
+
+  TextSegment &segment = *segmentFor(item_count, byte_count);
+  const size_t slot = segment.record_count.load(std::memory_order_relaxed);
+  const uint32_t text_offset = static_cast<uint32_t>(segment.byte_count);
+  const uint32_t raw_offset = text_offset + static_cast<uint32_t>(record.timestamp_text.size());
+  memcpy(&segment.bytes[0] + text_offset, record.timestamp_text.data(), record.timestamp_text.size());
+  memcpy(&segment.bytes[0] + raw_offset, raw.data(), raw.size());
+
+  segment.timestamp_sec[slot] = record.timestamp_sec;
+  segment.text_offset[slot] = text_offset;
+  segment.timestamp_length[slot] = static_cast<uint32_t>(record.timestamp_text.size());
+  segment.raw_length[slot] = static_cast<uint32_t>(raw.size());
+  segment.item_begin[slot] = static_cast<uint32_t>(segment.item_count);
+  segment.item_length_count[slot] = static_cast<uint32_t>(item_count);
+
+  // Items are split on ';' and stored as spans into the raw text.
+  size_t item = segment.item_count;
+  size_t start = 0;
+  for (size_t idx = 0; idx <= raw.size(); ++idx) {
+    if (idx == raw.size() || raw[idx] == ';') {
+      segment.item_offset[item] = raw_offset + static_cast<uint32_t>(start);
+      segment.item_length[item] = static_cast<uint32_t>(idx - start);
+      ++item;
+      start = idx + 1;
+    }
+  }
+  segment.item_count = item;
+  segment.byte_count += byte_count;
+  segment.record_count.store(slot + 1, std::memory_order_release);
+
+  const uint64_t sequence = m_next_sequence++;
+  while (!m_item_max.empty() && m_item_max.back().second <= item_count) {
+    m_item_max.pop_back();
+  }
+  m_item_max.push_back(std::make_pair(sequence, item_count));
+
   trimByPolicy();
   trimByHardLimit();
 }
 
 TextSnapshot TextResultCache::snapshot() const {
-  TextSnapshot snapshot;
-  for (std::deque<TextRecord>::const_iterator it = m_records.begin();
-       it != m_records.end(); ++it) {
-    snapshot.records.push_back(*it);
-    if (it->items.size() > snapshot.max_item_count) {
-      snapshot.max_item_count = it->items.size();
-    }
+  return snapshotFrom(m_first_sequence);
+}
+
+TextSnapshot TextResultCache::snapshotFrom(uint64_t sequence) const {
+  const uint64_t begin = std::min(std::max(sequence, m_first_sequence), m_next_sequence);
+  if (begin == m_next_sequence) {
+    return TextSnapshot(SegmentPtr(), begin, begin, 0);
   }
-  return snapshot;
+
+  std::deque<std::pair<uint64_t, size_t> >::const_iterator max_it =
+      std::lower_bound(m_item_max.begin(), m_item_max.end(), begin, ItemSequenceLess);
+  const size_t max_item_count = max_it == m_item_max.end() ? 0 : max_it->second;
+  return TextSnapshot(segmentOf(begin), begin, m_next_sequence, max_item_count);
 }
 
-bool TextResultCache::empty() const { return m_records.empty(); }
+bool TextResultCache::empty() const { return m_first_sequence == m_next_sequence; }
+
+size_t TextResultCache::size() const { return static_cast<size_t>(m_next_sequence - m_first_sequence); }
 
-std::vector<std::string> TextResultCache::splitItems(const std::string &raw_text) {
-  std::vector<std::string> items;
-  std::string current;
+uint64_t TextResultCache::firstSequence() const { return m_first_sequence; }
 
-  for (size_t idx = 0; idx < raw_text.size(); ++idx) {
-    if (raw_text[idx] == ';') {
-      items.push_back(current);
-      current.clear();
-      continue;
+uint64_t TextResultCache::endSequence() const { return m_next_sequence; }
+
+size_t TextResultCache::maxItemCount() const {
+  return m_item_max.empty() ? 0 : m_item_max.front().second;
+}
+
+TextResultCache::SegmentPtr TextResultCache::segmentFor(size_t item_count, size_t byte_count) {
+  if (!m_segments.empty()) {
+    const SegmentPtr &tail = m_segments.back();
+    if (tail->record_count.load(std::memory_order_relaxed) < tail->timestamp_sec.size() &&
+        tail->item_count + item_count <= tail->item_offset.size() &&
+        tail->byte_count + byte_count <= tail->bytes.size()) {
+      return tail;
     }
-    current.push_back(raw_text[idx]);
   }
 
-  items.push_back(current);
-  return items;
+  SegmentPtr segment;
+  if (m_spare && item_count <= kSegmentItems && byte_count <= kSegmentBytes) {
+    segment.swap(m_spare);
+    segment->record_count.store(0, std::memory_order_relaxed);
+    segment->item_count = 0;
+    segment->byte_count = 0;
+    segment->next.reset();
+  } else {
+    segment = std::make_shared<TextSegment>(kSegmentRecords, std::max(item_count, kSegmentItems),
+                                            std::max(byte_count, kSegmentBytes));
+  }
+  segment->first_sequence = m_next_sequence;
+  if (!m_segments.empty()) {
+    m_segments.back()->next = segment;
+  }
+  m_segments.push_back(segment);
+  return segment;
+}
+
+const TextResultCache::SegmentPtr &TextResultCache::segmentOf(uint64_t sequence) const {
+  size_t idx = m_segments.size() - 1;
+  while (idx > 0 && m_segments[idx]->first_sequence > sequence) {
+    --idx;
+  }
+  return m_segments[idx];
+}
+
+int64_t TextResultCache::timestampOf(uint64_t sequence) const {
+  const TextSegment &segment = *segmentOf(sequence);
+  return segment.timestamp_sec[static_cast<size_t>(sequence - segment.first_sequence)];
+}
+
+void TextResultCache::popFront() {
+  ++m_first_sequence;
+  if (!m_item_max.empty() && m_item_max.front().first < m_first_sequence) {
+    m_item_max.pop_front();
+  }
+
+  const SegmentPtr &front = m_segments.front();
+  const uint64_t front_end = front->first_sequence + front->record_count.load(std::memory_order_relaxed);
+  if (m_first_sequence < front_end && m_first_sequence != m_next_sequence) {
+    return;
+  }
+
+  // Only recycle default-sized segments no snapshot (or predecessor) refers to.
+  if (front.use_count() == 1 && front->bytes.size() == kSegmentBytes &&
+      front->item_offset.size() == kSegmentItems) {
+    // Pairs with the release in the last snapshot's reference drop.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    m_spare = front;
+    m_spare->next.reset();
+  }
+  m_segments.pop_front();
 }
 
 void TextResultCache::trimByPolicy() {
   if (m_policy == TEXT_RETENTION_BY_COUNT) {
     if (m_retention_count == 0) {
-      m_records.clear();
+      clear();
       return;
     }
-    while (m_records.size() > m_retention_count) {
-      m_records.pop_front();
+    while (size() > m_retention_count) {
+      popFront();
     }
     return;
   }
@@ -77,25 +198,25 @@ void TextResultCache::trimByPolicy() {
     if (m_retention_time_range_sec <= 0) {
       return;
     }
-    if (m_records.empty()) {
+    if (empty()) {
       return;
     }
 
-    const int64_t latest_timestamp = m_records.back().timestamp_sec;
+    const int64_t latest_timestamp = timestampOf(m_next_sequence - 1);
     const int64_t cutoff = latest_timestamp - m_retention_time_range_sec;
-    while (!m_records.empty() && m_records.front().timestamp_sec < cutoff) {
-      m_records.pop_front();
+    while (!empty() && timestampOf(m_first_sequence) < cutoff) {
+      popFront();
     }
   }
 }
 
 void TextResultCache::trimByHardLimit() {
   if (m_hard_limit == 0) {
-    m_records.clear();
+    clear();
     return;
   }
 
-  while (m_records.size() > m_hard_limit) {
-    m_records.pop_front();
+  while (size() > m_hard_limit) {
+    popFront();
   }
 }
@@ -4,9 +4,15 @@
 #include "TextResultTypes.h"
 
 #include <deque>
+#include <memory>
+#include <utility>
 
 class TextResultCache {
  public:
+  static const size_t kSegmentRecords = 512;
+  static const size_t kSegmentItems = 4096;
+  static const size_t kSegmentBytes = 32 * 1024;
+
   explicit TextResultCache(size_t hard_limit = 10000);
 
   void setPolicy(TextRetentionPolicy policy);
@@ -15,14 +21,33 @@ class TextResultCache {
   void clear();
   void addRecord(const TextRecord &record);
   TextSnapshot snapshot() const;
+  TextSnapshot snapshotFrom(uint64_t sequence) const;
   bool empty() const;
+  size_t size() const;
+
+  // Records carry increasing sequence numbers that survive trimming and
+  // clear(), so [firstSequence, endSequence) identifies the cached range.
+  uint64_t firstSequence() const;
+  uint64_t endSequence() const;
+  size_t maxItemCount() const;
 
  private:
-  static std::vector<std::string> splitItems(const std::string &raw_text);
+  typedef std::shared_ptr<TextSegment> SegmentPtr;
+
+  SegmentPtr segmentFor(size_t item_count, size_t byte_count);
+  const SegmentPtr &segmentOf(uint64_t sequence) const;
+  int64_t timestampOf(uint64_t sequence) const;
+  void popFront();
   void trimByPolicy();
   void trimByHardLimit();
 
-  std::deque<TextRecord> m_records;
+  std::deque<SegmentPtr> m_segments;
+  SegmentPtr m_spare;
+  // Item counts of the cached window, decreasing from front to back, so the
+  // maximum of any suffix is the first entry at or after its sequence.
+  std::deque<std::pair<uint64_t, size_t> > m_item_max;
+  uint64_t m_first_sequence;
+  uint64_t m_next_sequence;
   size_t m_hard_limit;
   size_t m_retention_count;
   int64_t m_retention_time_range_sec;
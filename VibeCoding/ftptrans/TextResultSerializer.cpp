@@ -1,157 +1,289 @@
 #include "TextResultSerializer.h"
 
-#include <sstream>
+#include <stdio.h>
 
-std::string TextResultSerializer::serialize(const TextSnapshot &snapshot,
-                                            TextFileFormat format,
-                                            bool include_timestamp) {
-  if (format == TEXT_FILE_FORMAT_CSV) {
-    return serializeCsv(snapshot, include_timestamp);
-  }
-  if (format == TEXT_FILE_FORMAT_JSON) {
-    return serializeJson(snapshot, include_timestamp);
+#include <iterator>
+
+const size_t TextResultStreamBuf::kBlockBytes;
+
+namespace {
+
+enum EscapeClass {
+  ESCAPE_NONE = 0,
+  ESCAPE_CSV = 1,   // forces the CSV field to be quoted
+  ESCAPE_JSON = 2   // needs a JSON escape sequence
+};
+
+struct EscapeTable {
+  unsigned char cls[256];
+
+  EscapeTable() {
+    for (int ch = 0; ch < 256; ++ch) {
+      cls[ch] = ch < 0x20 ? ESCAPE_JSON : ESCAPE_NONE;
+    }
+    cls[static_cast<unsigned char>('"')] = ESCAPE_CSV | ESCAPE_JSON;
+    cls[static_cast<unsigned char>('\\')] = ESCAPE_JSON;
+    cls[static_cast<unsigned char>(',')] = ESCAPE_CSV;
+    cls[static_cast<unsigned char>('\r')] = ESCAPE_CSV | ESCAPE_JSON;
+    cls[static_cast<unsigned char>('\n')] = ESCAPE_CSV | ESCAPE_JSON;
   }
-  return serializeTxt(snapshot, include_timestamp);
+};
+
+const EscapeTable kEscapeTable;
+
+void AppendSpan(std::string &out, const TextSpan &value) {
+  out.append(value.data, value.size);
 }
 
-std::string TextResultSerializer::extension(TextFileFormat format) {
-  if (format == TEXT_FILE_FORMAT_CSV) {
-    return ".csv";
+void AppendCsvField(std::string &out, const TextSpan &value) {
+  size_t idx = 0;
+  while (idx < value.size &&
+         (kEscapeTable.cls[static_cast<unsigned char>(value.data[idx])] & ESCAPE_CSV) == 0) {
+    ++idx;
   }
-  if (format == TEXT_FILE_FORMAT_JSON) {
-    return ".json";
+  if (idx == value.size) {
+    AppendSpan(out, value);
+    return;
   }
-  return ".txt";
-}
 
-std::string TextResultSerializer::serializeTxt(const TextSnapshot &snapshot,
-                                               bool include_timestamp) {
-  std::ostringstream oss;
-  for (size_t idx = 0; idx < snapshot.records.size(); ++idx) {
-    const TextRecord &record = snapshot.records[idx];
-    if (include_timestamp) {
-      oss << record.timestamp_text << " ";
+  out.push_back('"');
+  size_t run = 0;
+  for (idx = 0; idx < value.size; ++idx) {
+    if (value.data[idx] == '"') {
+      out.append(value.data + run, idx + 1 - run);
+      out.push_back('"');
+      run = idx + 1;
     }
-    oss << record.raw_text << "\r\n";
   }
-  return oss.str();
+  out.append(value.data + run, value.size - run);
+  out.push_back('"');
 }
 
-std::string TextResultSerializer::serializeCsv(const TextSnapshot &snapshot,
-                                               bool include_timestamp) {
-  std::ostringstream oss;
-  bool need_header = include_timestamp || snapshot.max_item_count > 0;
-  if (need_header) {
-    bool first = true;
-    if (include_timestamp) {
-      oss << "timestamp";
-      first = false;
+void AppendJsonString(std::string &out, const TextSpan &value) {
+  out.push_back('"');
+  size_t run = 0;
+  for (size_t idx = 0; idx < value.size; ++idx) {
+    const unsigned char ch = static_cast<unsigned char>(value.data[idx]);
+    if ((kEscapeTable.cls[ch] & ESCAPE_JSON) == 0) {
+      continue;
     }
-    for (size_t idx = 0; idx < snapshot.max_item_count; ++idx) {
-      if (!first) {
-        oss << ",";
+
+    out.append(value.data + run, idx - run);
+    run = idx + 1;
+    switch (ch) {
+      case '\\':
+        out += "\\\\";
+        break;
+      case '"':
+        out += "\\\"";
+        break;
+      case '\r':
+        out += "\\r";
+        break;
+      case '\n':
+        out += "\\n";
+        break;
+      case '\t':
+        out += "\\t";
+        break;
+      default: {
+        char escaped[8];
+        snprintf(escaped, sizeof(escaped), "\\u%04x", ch);
+        out += escaped;
+        break;
       }
-      oss << "col" << (idx + 1);
-      first = false;
     }
-    oss << "\r\n";
   }
+  out.append(value.data + run, value.size - run);
+  out.push_back('"');
+}
+
+void AppendNumber(std::string &out, size_t value) {
+  char digits[24];
+  char *end = digits + sizeof(digits);
+  char *begin = end;
+  do {
+    *--begin = static_cast<char>('0' + value % 10);
+    value /= 10;
+  } while (value != 0);
+  out.append(begin, static_cast<size_t>(end - begin));
+}
+
+}  // namespace
+
+TextResultStreamBuf::TextResultStreamBuf(const TextSnapshot &snapshot,
+                                         const TextSerializeOptions &options)
+    : m_snapshot(snapshot),
+      m_options(options),
+      m_next(m_snapshot.begin()),
+      m_stage(STAGE_PROLOGUE),
+      m_first_record(true),
+      m_bytes_produced(0) {
+  // One block plus a typical CSV/JSON row so a block rarely reallocates.
+  m_block.reserve(kBlockBytes + 64 + options.column_count * 24);
+  setg(nullptr, nullptr, nullptr);
+}
+
+uint64_t TextResultStreamBuf::bytesProduced() const {
+  return m_bytes_produced;
+}
+
+TextResultStreamBuf::int_type TextResultStreamBuf::underflow() {
+  if (gptr() < egptr()) {
+    return traits_type::to_int_type(*gptr());
+  }
+
+  m_block.clear();
+  while (m_stage != STAGE_DONE && m_block.size() < kBlockBytes) {
+    emitNext();
+  }
+  if (m_block.empty()) {
+    return traits_type::eof();
+  }
+
+  m_bytes_produced += m_block.size();
+  char *begin = &m_block[0];
+  setg(begin, begin, begin + m_block.size());
+  return traits_type::to_int_type(*gptr());
+}
+
+void TextResultStreamBuf::emitNext() {
+  if (m_stage == STAGE_PROLOGUE) {
+    m_stage = STAGE_RECORDS;
+    if (m_options.format == TEXT_FILE_FORMAT_JSON && !m_options.appendable) {
+      m_block.push_back('[');
+    } else if (m_options.format == TEXT_FILE_FORMAT_CSV && m_options.with_header &&
+               (m_options.include_timestamp || m_options.column_count > 0)) {
+      bool first = true;
+      if (m_options.include_timestamp) {
+        m_block += "timestamp";
+        first = false;
+      }
+      for (size_t idx = 0; idx < m_options.column_count; ++idx) {
+        if (!first) {
+          m_block.push_back(',');
+        }
+        m_block += "col";
+        AppendNumber(m_block, idx + 1);
+        first = false;
+      }
+      m_block += "\r\n";
+    }
+    return;
+  }
+
+  if (m_stage == STAGE_RECORDS) {
+    if (m_next == m_snapshot.end()) {
+      m_stage = STAGE_EPILOGUE;
+      return;
+    }
+    emitRecord(*m_next);
+    ++m_next;
+    return;
+  }
+
+  if (m_stage == STAGE_EPILOGUE) {
+    if (m_options.format == TEXT_FILE_FORMAT_JSON && !m_options.appendable) {
+      m_block.push_back(']');
+    }
+    m_stage = STAGE_DONE;
+  }
+}
 
-  for (size_t row = 0; row < snapshot.records.size(); ++row) {
-    const TextRecord &record = snapshot.records[row];
+void TextResultStreamBuf::emitRecord(const TextRecordView &record) {
+  if (m_options.format == TEXT_FILE_FORMAT_CSV) {
     bool first = true;
-    if (include_timestamp) {
-      oss << escapeCsv(record.timestamp_text);
+    if (m_options.include_timestamp) {
+      AppendCsvField(m_block, record.timestampText());
       first = false;
     }
-    for (size_t col = 0; col < snapshot.max_item_count; ++col) {
+    for (size_t col = 0; col < m_options.column_count; ++col) {
       if (!first) {
-        oss << ",";
+        m_block.push_back(',');
       }
-      if (col < record.items.size()) {
-        oss << escapeCsv(record.items[col]);
+      if (col < record.itemCount()) {
+        AppendCsvField(m_block, record.item(col));
       }
       first = false;
     }
-    oss << "\r\n";
+    m_block += "\r\n";
+    return;
   }
-  return oss.str();
-}
 
-std::string TextResultSerializer::serializeJson(const TextSnapshot &snapshot,
-                                                bool include_timestamp) {
-  std::ostringstream oss;
-  oss << "[";
-  for (size_t idx = 0; idx < snapshot.records.size(); ++idx) {
-    const TextRecord &record = snapshot.records[idx];
-    if (idx > 0) {
-      oss << ",";
+  if (m_options.format == TEXT_FILE_FORMAT_JSON) {
+    if (!m_options.appendable && !m_first_record) {
+      m_block.push_back(',');
     }
-    oss << "{";
+    m_first_record = false;
+
+    m_block.push_back('{');
     bool first_field = true;
-    if (include_timestamp) {
-      oss << "\"timestamp\":\"" << escapeJson(record.timestamp_text) << "\"";
+    if (m_options.include_timestamp) {
+      m_block += "\"timestamp\":";
+      AppendJsonString(m_block, record.timestampText());
       first_field = false;
     }
-    for (size_t item_idx = 0; item_idx < record.items.size(); ++item_idx) {
+    for (size_t item_idx = 0; item_idx < record.itemCount(); ++item_idx) {
       if (!first_field) {
-        oss << ",";
+        m_block.push_back(',');
       }
-      oss << "\"item" << (item_idx + 1) << "\":\""
-          << escapeJson(record.items[item_idx]) << "\"";
+      m_block += "\"item";
+      AppendNumber(m_block, item_idx + 1);
+      m_block += "\":";
+      AppendJsonString(m_block, record.item(item_idx));
       first_field = false;
     }
-    oss << "}";
-  }
-  oss << "]";
-  return oss.str();
-}
-
-std::string TextResultSerializer::escapeCsv(const std::string &value) {
-  bool need_quotes = false;
-  std::string escaped;
-  for (size_t idx = 0; idx < value.size(); ++idx) {
-    const char ch = value[idx];
-    if (ch == '"' || ch == ',' || ch == '\r' || ch == '\n') {
-      need_quotes = true;
-    }
-    if (ch == '"') {
-      escaped.push_back('"');
+    m_block.push_back('}');
+    if (m_options.appendable) {
+      m_block.push_back('\n');
     }
-    escaped.push_back(ch);
+    return;
   }
 
-  if (!need_quotes) {
-    return escaped;
+  if (m_options.include_timestamp) {
+    AppendSpan(m_block, record.timestampText());
+    m_block.push_back(' ');
   }
+  AppendSpan(m_block, record.rawText());
+  m_block += "\r\n";
+}
+
+std::string TextResultSerializer::serialize(const TextSnapshot &snapshot,
+                                            TextFileFormat format,
+                                            bool include_timestamp) {
+  TextSerializeOptions options;
+  options.format = format;
+  options.include_timestamp = include_timestamp;
+  options.column_count = snapshot.maxItemCount();
+  return serialize(snapshot, options);
+}
 
-  return std::string("\"") + escaped + "\"";
+std::string TextResultSerializer::serializeAppendable(const TextSnapshot &snapshot,
+                                                      TextFileFormat format,
+                                                      bool include_timestamp,
+                                                      size_t column_count,
+                                                      bool with_header) {
+  TextSerializeOptions options;
+  options.format = format;
+  options.include_timestamp = include_timestamp;
+  options.column_count = column_count;
+  options.appendable = true;
+  options.with_header = with_header;
+  return serialize(snapshot, options);
 }
 
-std::string TextResultSerializer::escapeJson(const std::string &value) {
-  std::string escaped;
-  for (size_t idx = 0; idx < value.size(); ++idx) {
-    const char ch = value[idx];
-    switch (ch) {
-      case '\\':
-        escaped += "\\\\";
-        break;
-      case '"':
-        escaped += "\\\"";
-        break;
-      case '\r':
-        escaped += "\\r";
-        break;
-      case '\n':
-        escaped += "\\n";
-        break;
-      case '\t':
-        escaped += "\\t";
-        break;
-      default:
-        escaped.push_back(ch);
-        break;
-    }
+std::string TextResultSerializer::serialize(const TextSnapshot &snapshot,
+                                            const TextSerializeOptions &options) {
+  TextResultStreamBuf buf(snapshot, options);
+  return std::string(std::istreambuf_iterator<char>(&buf), std::istreambuf_iterator<char>());
+}
+
+std::string TextResultSerializer::extension(TextFileFormat format, TextUploadMode mode) {
+  if (format == TEXT_FILE_FORMAT_CSV) {
+    return ".csv";
   }
-  return escaped;
+  if (format == TEXT_FILE_FORMAT_JSON) {
+    return mode == TEXT_UPLOAD_APPEND ? ".jsonl" : ".json";
+  }
+  return ".txt";
 }
@@ -3,24 +3,91 @@
 
 #include "TextResultTypes.h"
 
+#include <istream>
+#include <streambuf>
 #include <string>
 
+struct TextSerializeOptions {
+  TextFileFormat format;
+  bool include_timestamp;
+  size_t column_count;  // CSV columns, rows are padded to this width
+  bool appendable;      // JSON Lines instead of a JSON array
+  bool with_header;     // CSV header row
+
+  TextSerializeOptions()
+      : format(TEXT_FILE_FORMAT_TXT),
+        include_timestamp(false),
+        column_count(0),
+        appendable(false),
+        with_header(true) {}
+};
+
+// Serializes a snapshot on demand while it is read. Output is produced one
+// block (kBlockBytes, or one record if larger) at a time, so memory stays
+// bounded by the block size regardless of the file size and an upload can
+// start as soon as the first block is ready.
+class TextResultStreamBuf : public std::streambuf {
+ public:
+  static const size_t kBlockBytes = 16 * 1024;
+
+  TextResultStreamBuf(const TextSnapshot &snapshot, const TextSerializeOptions &options);
+
+  uint64_t bytesProduced() const;
+
+ protected:
+  int_type underflow() override;
+
+ private:
+  enum Stage {
+    STAGE_PROLOGUE = 0,
+    STAGE_RECORDS,
+    STAGE_EPILOGUE,
+    STAGE_DONE
+  };
+
+  void emitNext();
+  void emitRecord(const TextRecordView &record);
+
+  TextSnapshot m_snapshot;
+  TextSerializeOptions m_options;
+  TextSnapshot::const_iterator m_next;
+  Stage m_stage;
+  bool m_first_record;
+  std::string m_block;
+  uint64_t m_bytes_produced;
+};
+
+class TextResultIStream : public std::istream {
+ public:
+  TextResultIStream(const TextSnapshot &snapshot, const TextSerializeOptions &options)
+      : std::istream(nullptr), m_buf(snapshot, options) {
+    rdbuf(&m_buf);
+  }
+
+  uint64_t bytesProduced() const {
+    return m_buf.bytesProduced();
+  }
+
+ private:
+  TextResultStreamBuf m_buf;
+};
+
 class TextResultSerializer {
  public:
   static std::string serialize(const TextSnapshot &snapshot,
                                TextFileFormat format,
                                bool include_timestamp);
-  static std::string extension(TextFileFormat format);
-
- private:
-  static std::string serializeTxt(const TextSnapshot &snapshot,
-                                  bool include_timestamp);
-  static std::string serializeCsv(const TextSnapshot &snapshot,
-                                  bool include_timestamp);
-  static std::string serializeJson(const TextSnapshot &snapshot,
-                                   bool include_timestamp);
-  static std::string escapeCsv(const std::string &value);
-  static std::string escapeJson(const std::string &value);
+  // Framing that stays valid when appended to an existing file: TXT and CSV
+  // rows are padded to `column_count`, JSON is written as JSON Lines.
+  static std::string serializeAppendable(const TextSnapshot &snapshot,
+                                         TextFileFormat format,
+                                         bool include_timestamp,
+                                         size_t column_count,
+                                         bool with_header);
+  static std::string serialize(const TextSnapshot &snapshot,
+                               const TextSerializeOptions &options);
+  static std::string extension(TextFileFormat format,
+                               TextUploadMode mode = TEXT_UPLOAD_FULL_REWRITE);
 };
 
 #endif
@@ -1,8 +1,11 @@
 #ifndef TEXT_RESULT_TYPES_H
 #define TEXT_RESULT_TYPES_H
 
+#include <stddef.h>
 #include <stdint.h>
 
+#include <atomic>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -12,25 +15,162 @@ enum TextFileFormat {
   TEXT_FILE_FORMAT_JSON = 2
 };
 
+enum TextUploadMode {
+  TEXT_UPLOAD_FULL_REWRITE = 0,
+  TEXT_UPLOAD_APPEND = 1
+};
+
 enum TextRetentionPolicy {
   TEXT_RETENTION_BY_COUNT = 0,
   TEXT_RETENTION_BY_TIME_RANGE = 1
 };
 
+// Input record handed to TextResultCache::addRecord.
 struct TextRecord {
   int64_t timestamp_sec;
   std::string timestamp_text;
   std::string raw_text;
-  std::vector<std::string> items;
 
   TextRecord() : timestamp_sec(0) {}
 };
 
-struct TextSnapshot {
-  std::vector<TextRecord> records;
-  size_t max_item_count;
+// Non-owning view of bytes stored in a TextSegment.
+struct TextSpan {
+  const char *data;
+  size_t size;
+
+  TextSpan() : data(nullptr), size(0) {}
+  TextSpan(const char *span_data, size_t span_size) : data(span_data), size(span_size) {}
+
+  std::string str() const { return std::string(data, size); }
+  bool operator==(const std::string &other) const {
+    return other.size() == size && other.compare(0, size, data, size) == 0;
+  }
+};
+
+// Columnar, append-only block of cached records. Text bytes live in one
+// arena; per-record and per-item columns hold offsets into it. Slots below
+// record_count are never modified again, so snapshots may read them without
+// the cache lock while the writer appends behind them; record_count is the
+// only field both sides touch.
+struct TextSegment {
+  TextSegment(size_t record_capacity, size_t item_capacity, size_t byte_capacity)
+      : first_sequence(0),
+        record_count(0),
+        item_count(0),
+        byte_count(0),
+        timestamp_sec(record_capacity),
+        text_offset(record_capacity),
+        timestamp_length(record_capacity),
+        raw_length(record_capacity),
+        item_begin(record_capacity),
+        item_length_count(record_capacity),
+        item_offset(item_capacity),
+        item_length(item_capacity),
+        bytes(byte_capacity) {}
+
+  uint64_t first_sequence;
+  std::atomic<size_t> record_count;
+  size_t item_count;
+  size_t byte_count;
+
+  std::vector<int64_t> timestamp_sec;
+  std::vector<uint32_t> text_offset;  // timestamp text, immediately followed by raw text
+  std::vector<uint32_t> timestamp_length;
+  std::vector<uint32_t> raw_length;
+  std::vector<uint32_t> item_begin;
+  std::vector<uint32_t> item_length_count;
+  std::vector<uint32_t> item_offset;
+  std::vector<uint32_t> item_length;
+  std::vector<char> bytes;
+
+  // Set once when the next segment is started; keeps later segments alive
+  // for snapshots that began in this one.
+  std::shared_ptr<TextSegment> next;
+};
+
+class TextRecordView {
+ public:
+  TextRecordView(const TextSegment *segment, size_t index) : m_segment(segment), m_index(index) {}
+
+  int64_t timestampSec() const { return m_segment->timestamp_sec[m_index]; }
+  TextSpan timestampText() const {
+    return TextSpan(&m_segment->bytes[0] + m_segment->text_offset[m_index],
+                    m_segment->timestamp_length[m_index]);
+  }
+  TextSpan rawText() const {
+    return TextSpan(&m_segment->bytes[0] + m_segment->text_offset[m_index] +
+                        m_segment->timestamp_length[m_index],
+                    m_segment->raw_length[m_index]);
+  }
+  size_t itemCount() const { return m_segment->item_length_count[m_index]; }
+  TextSpan item(size_t item_idx) const {
+    const size_t slot = m_segment->item_begin[m_index] + item_idx;
+    return TextSpan(&m_segment->bytes[0] + m_segment->item_offset[slot], m_segment->item_length[slot]);
+  }
+
+ private:
+  const TextSegment *m_segment;
+  size_t m_index;
+};
+
+// Immutable, reference-counted view of records [begin, end) of the cache.
+// Taking or copying one is O(1); it stays valid after the cache trims,
+// clears or appends.
+class TextSnapshot {
+ public:
+  class const_iterator {
+   public:
+    const_iterator(const TextSegment *segment, size_t index, uint64_t sequence, uint64_t end)
+        : m_segment(segment), m_index(index), m_sequence(sequence), m_end(end) {}
+
+    TextRecordView operator*() const { return TextRecordView(m_segment, m_index); }
+    const_iterator &operator++() {
+      // Only step into the next segment while still inside the snapshot; the
+      // segment holding the last record may still be growing.
+      ++m_index;
+      if (++m_sequence != m_end &&
+          m_index == m_segment->record_count.load(std::memory_order_acquire)) {
+        m_segment = m_segment->next.get();
+        m_index = 0;
+      }
+      return *this;
+    }
+    bool operator!=(const const_iterator &other) const { return m_sequence != other.m_sequence; }
+    bool operator==(const const_iterator &other) const { return m_sequence == other.m_sequence; }
+
+   private:
+    const TextSegment *m_segment;
+    size_t m_index;
+    uint64_t m_sequence;
+    uint64_t m_end;
+  };
+
+  TextSnapshot() : m_begin(0), m_end(0), m_max_item_count(0) {}
+  TextSnapshot(const std::shared_ptr<const TextSegment> &first, uint64_t begin, uint64_t end,
+               size_t max_item_count)
+      : m_first(first), m_begin(begin), m_end(end), m_max_item_count(max_item_count) {}
+
+  size_t size() const { return static_cast<size_t>(m_end - m_begin); }
+  bool empty() const { return m_begin == m_end; }
+  uint64_t beginSequence() const { return m_begin; }
+  uint64_t endSequence() const { return m_end; }
+  size_t maxItemCount() const { return m_max_item_count; }
+
+  const_iterator begin() const {
+    if (empty()) {
+      return end();
+    }
+    return const_iterator(m_first.get(), static_cast<size_t>(m_begin - m_first->first_sequence), m_begin,
+                          m_end);
+  }
+  const_iterator end() const { return const_iterator(nullptr, 0, m_end, m_end); }
 
-  TextSnapshot() : max_item_count(0) {}
+ private:
+  std::shared_ptr<const TextSegment> m_first;
+  uint64_t m_begin;
+  uint64_t m_end;
+  size_t m_max_item_count;
 };
 
 #endif
@@ -1,6 +1,15 @@
 #include "TextUploadController.h"
 
-TextUploadController::TextUploadController() : m_refresh_step(1), m_pending_count(0) {}
+TextUploadController::TextUploadController()
+    : m_refresh_step(1),
+      m_pending_count(0),
+      m_mode(TEXT_UPLOAD_FULL_REWRITE),
+      m_generation(0),
+      m_remote_valid(false),
+      m_remote_first_sequence(0),
+      m_remote_end_sequence(0),
+      m_remote_column_count(0),
+      m_remote_include_timestamp(false) {}
 
 void TextUploadController::setRefreshStep(size_t refresh_step) {
   m_refresh_step = refresh_step;
@@ -9,7 +18,14 @@ void TextUploadController::setRefreshStep(size_t refresh_step) {
   }
 }
 
-void TextUploadController::reset() { m_pending_count = 0; }
+void TextUploadController::setUploadMode(TextUploadMode mode) { m_mode = mode; }
+
+TextUploadMode TextUploadController::uploadMode() const { return m_mode; }
+
+void TextUploadController::reset() {
+  m_pending_count = 0;
+  invalidateRemote();
+}
 
 bool TextUploadController::onRecordAccepted() {
   ++m_pending_count;
@@ -29,3 +45,55 @@ bool TextUploadController::onStopRequested() {
   m_pending_count = 0;
   return true;
 }
+
+TextUploadPlan TextUploadController::planUpload(const std::string &remote_file,
+                                                TextFileFormat format,
+                                                bool include_timestamp,
+                                                uint64_t first_sequence,
+                                                uint64_t end_sequence,
+                                                size_t max_item_count) const {
+  TextUploadPlan plan;
+  plan.format = format;
+  plan.appendable = m_mode == TEXT_UPLOAD_APPEND;
+  plan.begin_sequence = first_sequence;
+  plan.end_sequence = end_sequence;
+  plan.column_count = max_item_count;
+  plan.include_timestamp = include_timestamp;
+  plan.generation = m_generation;
+
+  if (m_mode != TEXT_UPLOAD_APPEND || !m_remote_valid || remote_file != m_remote_file ||
+      include_timestamp != m_remote_include_timestamp ||
+      first_sequence != m_remote_first_sequence || end_sequence < m_remote_end_sequence) {
+    return plan;
+  }
+  if (format == TEXT_FILE_FORMAT_CSV && max_item_count > m_remote_column_count) {
+    return plan;
+  }
+
+  plan.append = true;
+  plan.begin_sequence = m_remote_end_sequence;
+  plan.column_count = m_remote_column_count;
+  return plan;
+}
+
+void TextUploadController::onUploadCommitted(const std::string &remote_file,
+                                             const TextUploadPlan &plan) {
+  // A reset after the plan was made means the remote file is being replaced.
+  if (plan.generation != m_generation) {
+    return;
+  }
+
+  if (!plan.append) {
+    m_remote_file = remote_file;
+    m_remote_first_sequence = plan.begin_sequence;
+    m_remote_column_count = plan.column_count;
+    m_remote_include_timestamp = plan.include_timestamp;
+  }
+  m_remote_end_sequence = plan.end_sequence;
+  m_remote_valid = true;
+}
+
+void TextUploadController::invalidateRemote() {
+  ++m_generation;
+  m_remote_valid = false;
+}
@@ -2,19 +2,69 @@
 #define TEXT_UPLOAD_CONTROLLER_H
 
 #include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "TextResultTypes.h"
+
+struct TextUploadPlan {
+  TextFileFormat format;
+  bool appendable;  // appendable framing (upload mode is TEXT_UPLOAD_APPEND)
+  bool append;
+  uint64_t begin_sequence;
+  uint64_t end_sequence;
+  size_t column_count;
+  bool include_timestamp;
+  uint64_t generation;
+
+  TextUploadPlan()
+      : format(TEXT_FILE_FORMAT_TXT),
+        appendable(false),
+        append(false),
+        begin_sequence(0),
+        end_sequence(0),
+        column_count(0),
+        include_timestamp(false),
+        generation(0) {}
+};
 
 class TextUploadController {
  public:
   TextUploadController();
 
   void setRefreshStep(size_t refresh_step);
+  void setUploadMode(TextUploadMode mode);
+  TextUploadMode uploadMode() const;
   void reset();
   bool onRecordAccepted();
   bool onStopRequested();
 
+  // Decides between appending [remote end, end_sequence) and rewriting the
+  // whole cache. Append is only planned while the remote file still starts
+  // at first_sequence and was written with the same name, timestamp layout
+  // and (for CSV) a header at least max_item_count wide.
+  TextUploadPlan planUpload(const std::string &remote_file,
+                            TextFileFormat format,
+                            bool include_timestamp,
+                            uint64_t first_sequence,
+                            uint64_t end_sequence,
+                            size_t max_item_count) const;
+  void onUploadCommitted(const std::string &remote_file, const TextUploadPlan &plan);
+  void invalidateRemote();
+
  private:
   size_t m_refresh_step;
   size_t m_pending_count;
+  TextUploadMode m_mode;
+
+  uint64_t m_generation;
+  bool m_remote_valid;
+  std::string m_remote_file;
+  uint64_t m_remote_first_sequence;
+  uint64_t m_remote_end_sequence;
+  size_t m_remote_column_count;
+  bool m_remote_include_timestamp;
 };
 
 #endif
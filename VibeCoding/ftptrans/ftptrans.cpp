@@ -19,6 +19,20 @@
 #define FTPTRANS_TEXT_RETENTION_COUNT "TextRetentionCount"
 #define FTPTRANS_TEXT_RETENTION_TIME_RANGE_SEC "TextRetentionTimeRangeSec"
 #define FTPTRANS_TEXT_REFRESH_STEP "TextRefreshStep"
+#define FTPTRANS_TEXT_UPLOAD_MODE "TextUploadMode"
+#define FTPTRANS_CONNECTION_COUNT "ConnectionCount"
+#define FTPTRANS_QUEUE_OVERFLOW_POLICY "QueueOverflowPolicy"
+#define FTPTRANS_QUEUE_BLOCK_TIMEOUT_MS "QueueBlockTimeoutMs"
+#define FTPTRANS_QUEUE_STATS "QueueStats"
+#define FTPTRANS_DIR_CACHE_STATS "DirCacheStats"
+#define FTPTRANS_UPLOAD_STATS "UploadStats"
+#define FTPTRANS_SPOOL_ENABLE "SpoolEnable"
+#define FTPTRANS_SPOOL_MEDIA "SpoolMedia"
+#define FTPTRANS_SPOOL_MAX_SIZE_MB "SpoolMaxSizeMB"
+#define FTPTRANS_SPOOL_REPLAY_RATE_KB "SpoolReplayRateKB"
+#define FTPTRANS_SPOOL_STATS "SpoolStats"
+#define FTPTRANS_STANDBY_ENABLE "StandbyEnable"
+#define FTPTRANS_CONNECT_TIMEOUT_MS "ConnectTimeoutMs"
 #define FTP_TRANS_ROOT_DIR_REGULAR_EXP        "^((./){1}[0-9A-Za-z/_]{0,29})$"
 
 #define I_FTP_SUB_STATUS        "SINGLE_ftp_sub_status"
@@ -196,7 +210,7 @@ int CFtptransModule::Process(IN void* hInput, IN void* hOutput)
 		}
 
 		if ((NULL == imageData) || (imageDataLen > (int)(SENSOR_SIZE + BMP_EXTRA_SIZE))
-			|| (false == m_pMessageObj->isConnect()))
+			|| (false == m_pMessageObj->acceptsFrames()))
 		{
 			LOGE("ftp connect:%d, imageDataLen:%d\r\n", m_pMessageObj->isConnect(), imageDataLen);
 			status = IMVS_EC_ALGORITHM_DATA_SIZE;
@@ -254,6 +268,27 @@ int CFtptransModule::GetParam(IN const char* szParamName, OUT char* pBuff, IN in
 		return IMVS_EC_PARAM;
 	}
 
+	if (strstr(szParamName, ALGO_DEBUG_INFO_PARAM_STR))
+	{
+		return (nullptr == m_pMessageObj) ? IMVS_EC_NULL_PTR : m_pMessageObj->getDebugInfo(pBuff, nBuffSize, pDataLen);
+	}
+	if (0 == strcmp(szParamName, FTPTRANS_QUEUE_STATS))
+	{
+		return (nullptr == m_pMessageObj) ? IMVS_EC_NULL_PTR : m_pMessageObj->getQueueStats(pBuff, nBuffSize, pDataLen);
+	}
+	if (0 == strcmp(szParamName, FTPTRANS_DIR_CACHE_STATS))
+	{
+		return (nullptr == m_pMessageObj) ? IMVS_EC_NULL_PTR : m_pMessageObj->getDirCacheStats(pBuff, nBuffSize, pDataLen);
+	}
+	if (0 == strcmp(szParamName, FTPTRANS_UPLOAD_STATS))
+	{
+		return (nullptr == m_pMessageObj) ? IMVS_EC_NULL_PTR : m_pMessageObj->getUploadStats(pBuff, nBuffSize, pDataLen);
+	}
+	if (0 == strcmp(szParamName, FTPTRANS_SPOOL_STATS))
+	{
+		return (nullptr == m_pMessageObj) ? IMVS_EC_NULL_PTR : m_pMessageObj->getSpoolStats(pBuff, nBuffSize, pDataLen);
+	}
+
 	auto value = m_paramManage->GetParam(szParamName);
 	snprintf(pBuff, nBuffSize, "%s", value.c_str());
 	*pDataLen = strlen(pBuff);
@@ -547,6 +582,46 @@ int CFtptransModule::SetmoduParaHandle(IN const char* szParamName, IN const char
 	{
 		m_pMessageObj->setTextRefreshStep(strtoull(pData, nullptr, 10));
 	}
+	else if (0 == strcmp(szParamName, FTPTRANS_TEXT_UPLOAD_MODE))
+	{
+		m_pMessageObj->setTextUploadMode(atoi(pData));
+	}
+	else if (0 == strcmp(szParamName, FTPTRANS_CONNECTION_COUNT))
+	{
+		m_pMessageObj->setConnectionCount(atoi(pData));
+	}
+	else if (0 == strcmp(szParamName, FTPTRANS_QUEUE_OVERFLOW_POLICY))
+	{
+		m_pMessageObj->setQueueOverflowPolicy(atoi(pData));
+	}
+	else if (0 == strcmp(szParamName, FTPTRANS_QUEUE_BLOCK_TIMEOUT_MS))
+	{
+		m_pMessageObj->setQueueBlockTimeoutMs(atoi(pData));
+	}
+	else if (0 == strcmp(szParamName, FTPTRANS_SPOOL_ENABLE))
+	{
+		m_pMessageObj->setSpoolEnable(atoi(pData) != 0);
+	}
+	else if (0 == strcmp(szParamName, FTPTRANS_SPOOL_MEDIA))
+	{
+		m_pMessageObj->setSpoolMedia(atoi(pData));
+	}
+	else if (0 == strcmp(szParamName, FTPTRANS_SPOOL_MAX_SIZE_MB))
+	{
+		m_pMessageObj->setSpoolMaxSizeMB(atoi(pData));
+	}
+	else if (0 == strcmp(szParamName, FTPTRANS_SPOOL_REPLAY_RATE_KB))
+	{
+		m_pMessageObj->setSpoolReplayRateKB(atoi(pData));
+	}
+	else if (0 == strcmp(szParamName, FTPTRANS_STANDBY_ENABLE))
+	{
+		m_pMessageObj->setStandbyEnable(atoi(pData) != 0);
+	}
+	else if (0 == strcmp(szParamName, FTPTRANS_CONNECT_TIMEOUT_MS))
+	{
+		m_pMessageObj->setConnectTimeoutMs(atoi(pData));
+	}
 	else
 	{
 		nErrCode = IMVS_EC_ALGO_PARAM_NOT_FOUND;
@@ -630,8 +705,16 @@ int CFtptransModule::PrepareFileName(IN char pFileName[], IN int nFileLen, IN ch
 		snprintf(pFileName + strlen(pFileName), nFileLen - strlen(pFileName), "%s", m_strStartEnd.c_str());
 	}
 
-	snprintf(pFileName + strlen(pFileName), nFileLen - strlen(pFileName), 
-			"%s", (TO_JPG == m_nTransportType) ? ".jpg" : ".bmp");
+	const char* szExt = ".bmp";
+	if (TO_JPG == m_nTransportType)
+	{
+		szExt = ".jpg";
+	}
+	else if (TO_FLI == m_nTransportType)
+	{
+		szExt = ".fli";
+	}
+	snprintf(pFileName + strlen(pFileName), nFileLen - strlen(pFileName), "%s", szExt);
 
     while (*pFileName) {
         if (strchr(m_szSpecialCharSet, *pFileName))
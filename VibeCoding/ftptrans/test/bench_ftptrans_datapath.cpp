@@ -0,0 +1,472 @@
+// Microbenchmarks for the ftptrans data path. Prints one JSON document to
+// stdout (or --out FILE) and a short table to stderr.
+//
+//   --filter SUBSTR   only run cases whose name contains SUBSTR
+//   --min-time MS     minimum measured time per case (default 300)
+//   --out FILE        write JSON to FILE instead of stdout
+
+#include "../FtpBmpStream.h"
+#include "../FtpLosslessCodec.h"
+#include "../FtpSlotStream.h"
+#include "../TextResultCache.h"
+#include "../TextResultSerializer.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::atomic<uint64_t> g_alloc_count(0);
+
+}  // namespace
+
+void *operator new(size_t size) {
+  g_alloc_count.fetch_add(1, std::memory_order_relaxed);
+  void *ptr = std::malloc(size == 0 ? 1 : size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void *operator new[](size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void *ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+  std::free(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept {
+  std::free(ptr);
+}
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct BenchResult {
+  std::string name;
+  uint64_t iterations;
+  double ns_per_op;
+  double bytes_per_op;
+  double allocs_per_op;
+};
+
+struct BenchConfig {
+  std::string filter;
+  double min_time_ms;
+  std::string out_path;
+
+  BenchConfig() : min_time_ms(300) {}
+};
+
+// Runs `op` in growing batches until min_time_ms is spent, then reports the
+// last batch. `op` returns the payload bytes it processed.
+BenchResult Run(const BenchConfig &config, const std::string &name,
+                const std::function<uint64_t()> &op) {
+  op();  // warm up caches and lazily sized buffers
+
+  uint64_t iterations = 1;
+  for (;;) {
+    uint64_t bytes = 0;
+    const uint64_t allocs_before = g_alloc_count.load(std::memory_order_relaxed);
+    const Clock::time_point start = Clock::now();
+    for (uint64_t i = 0; i < iterations; ++i) {
+      bytes += op();
+    }
+    const double elapsed_ns =
+        static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+    const uint64_t allocs = g_alloc_count.load(std::memory_order_relaxed) - allocs_before;
+
+    if (elapsed_ns >= config.min_time_ms * 1e6 || iterations >= (1ULL << 30)) {
+      BenchResult result;
+      result.name = name;
+      result.iterations = iterations;
+      result.ns_per_op = elapsed_ns / iterations;
+      result.bytes_per_op = static_cast<double>(bytes) / iterations;
+      result.allocs_per_op = static_cast<double>(allocs) / iterations;
+      return result;
+    }
+
+    const double scale = elapsed_ns > 0 ? config.min_time_ms * 1e6 * 1.2 / elapsed_ns : 10.0;
+    iterations = static_cast<uint64_t>(iterations * std::min(10.0, std::max(2.0, scale)));
+  }
+}
+
+// Reads a stream to the end through a fixed buffer, the way the FTP client
+// feeds its data connection.
+uint64_t Drain(std::istream &stream) {
+  static char buffer[64 * 1024];
+  uint64_t total = 0;
+  while (stream.read(buffer, sizeof(buffer)) || stream.gcount() > 0) {
+    total += static_cast<uint64_t>(stream.gcount());
+  }
+  return total;
+}
+
+// Stand-in for an FTP server on 127.0.0.1: every upload opens a new data
+// connection, streams the file, half-closes, and waits for the server to
+// acknowledge the received byte count (the 226 reply).
+class LoopbackServer {
+ public:
+  LoopbackServer() : m_listen_fd(-1), m_port(0), m_stop(false) {}
+  ~LoopbackServer() { stop(); }
+
+  bool start() {
+    m_listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (m_listen_fd < 0) {
+      return false;
+    }
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    socklen_t addr_len = sizeof(addr);
+    if (bind(m_listen_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+        listen(m_listen_fd, 4) != 0 ||
+        getsockname(m_listen_fd, reinterpret_cast<sockaddr *>(&addr), &addr_len) != 0) {
+      close(m_listen_fd);
+      m_listen_fd = -1;
+      return false;
+    }
+
+    m_port = ntohs(addr.sin_port);
+    m_thread = std::thread(&LoopbackServer::serve, this);
+    return true;
+  }
+
+  void stop() {
+    if (m_listen_fd < 0) {
+      return;
+    }
+    m_stop = true;
+    shutdown(m_listen_fd, SHUT_RDWR);
+    close(m_listen_fd);
+    m_listen_fd = -1;
+    if (m_thread.joinable()) {
+      m_thread.join();
+    }
+  }
+
+  // Returns the number of bytes the server acknowledged, 0 on failure.
+  uint64_t upload(std::istream &stream) {
+    const int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+      return 0;
+    }
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(m_port);
+    if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+      close(fd);
+      return 0;
+    }
+
+    static char buffer[64 * 1024];
+    uint64_t sent = 0;
+    bool ok = true;
+    while (ok && (stream.read(buffer, sizeof(buffer)) || stream.gcount() > 0)) {
+      const size_t len = static_cast<size_t>(stream.gcount());
+      size_t offset = 0;
+      while (offset < len) {
+        const ssize_t written = send(fd, buffer + offset, len - offset, MSG_NOSIGNAL);
+        if (written <= 0) {
+          ok = false;
+          break;
+        }
+        offset += static_cast<size_t>(written);
+      }
+      sent += offset;
+    }
+
+    shutdown(fd, SHUT_WR);
+    uint64_t received = 0;
+    const bool acked = ok && recv(fd, &received, sizeof(received), MSG_WAITALL) == sizeof(received);
+    close(fd);
+    return acked && received == sent ? sent : 0;
+  }
+
+ private:
+  void serve() {
+    std::vector<char> buffer(256 * 1024);
+    while (!m_stop) {
+      const int fd = accept(m_listen_fd, nullptr, nullptr);
+      if (fd < 0) {
+        continue;
+      }
+
+      uint64_t received = 0;
+      for (;;) {
+        const ssize_t len = recv(fd, &buffer[0], buffer.size(), 0);
+        if (len <= 0) {
+          break;
+        }
+        received += static_cast<uint64_t>(len);
+      }
+      send(fd, &received, sizeof(received), MSG_NOSIGNAL);
+      close(fd);
+    }
+  }
+
+  int m_listen_fd;
+  uint16_t m_port;
+  std::atomic<bool> m_stop;
+  std::thread m_thread;
+};
+
+struct FrameSize {
+  const char *label;
+  uint32_t width;
+  uint32_t height;
+};
+
+const FrameSize kFrameSizes[] = {
+    {"1.3mp", 1280, 1024},
+    {"5mp", 2448, 2048},
+    {"12mp", 4024, 3036},
+};
+
+std::vector<uint8_t> MakeFrame(size_t len) {
+  std::vector<uint8_t> frame(len);
+  uint32_t state = 0x12345678u;
+  for (size_t i = 0; i < len; ++i) {
+    state = state * 1664525u + 1013904223u;
+    frame[i] = static_cast<uint8_t>(state >> 24);
+  }
+  return frame;
+}
+
+// Grey background with +-2 sensor noise and a bright rectangle, for the
+// lossless codec; random bytes would only measure its worst case.
+std::vector<uint8_t> MakeSceneFrame(uint32_t width, uint32_t height, uint32_t planes) {
+  std::vector<uint8_t> frame(static_cast<size_t>(width) * height * planes);
+  uint32_t state = 0x12345678u;
+  for (size_t i = 0; i < frame.size(); ++i) {
+    const uint32_t x = static_cast<uint32_t>(i % width);
+    const uint32_t y = static_cast<uint32_t>(i / width % height);
+    state = state * 1664525u + 1013904223u;
+    const bool bright = x > width / 3 && x < width / 2 && y > height / 4 && y < height / 2;
+    frame[i] = static_cast<uint8_t>((bright ? 200 : 40 + x * 64 / width) + (state >> 24) % 5 - 2);
+  }
+  return frame;
+}
+
+TextRecord MakeTextRecord(int64_t index) {
+  TextRecord record;
+  record.timestamp_sec = index;
+  record.timestamp_text = "2026_04_24_10_00_00";
+  record.raw_text = "OK;" + std::to_string(index) + ";12.345;-0.25;CODE-128;\"A,B\";line2;end";
+  return record;
+}
+
+void FillCache(TextResultCache &cache, size_t records) {
+  for (size_t i = 0; i < records; ++i) {
+    cache.addRecord(MakeTextRecord(static_cast<int64_t>(i)));
+  }
+}
+
+TextSerializeOptions TextOptions(TextFileFormat format, const TextSnapshot &snapshot) {
+  TextSerializeOptions options;
+  options.format = format;
+  options.include_timestamp = true;
+  options.column_count = snapshot.maxItemCount();
+  return options;
+}
+
+bool Selected(const BenchConfig &config, const std::string &name) {
+  return config.filter.empty() || name.find(config.filter) != std::string::npos;
+}
+
+void WriteJson(std::ostream &out, const std::vector<BenchResult> &results) {
+  out << "{\"suite\":\"ftptrans_datapath\",\"results\":[";
+  for (size_t i = 0; i < results.size(); ++i) {
+    const BenchResult &r = results[i];
+    const double bytes_per_sec = r.ns_per_op > 0 ? r.bytes_per_op * 1e9 / r.ns_per_op : 0;
+    char line[512];
+    snprintf(line, sizeof(line),
+             "%s\n{\"name\":\"%s\",\"iterations\":%llu,\"ns_per_op\":%.1f,"
+             "\"bytes_per_op\":%.0f,\"bytes_per_sec\":%.0f,\"allocs_per_op\":%.2f}",
+             i == 0 ? "" : ",", r.name.c_str(), static_cast<unsigned long long>(r.iterations),
+             r.ns_per_op, r.bytes_per_op, bytes_per_sec, r.allocs_per_op);
+    out << line;
+  }
+  out << "\n]}\n";
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  BenchConfig config;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    const std::string arg = argv[i];
+    if (arg == "--filter") {
+      config.filter = argv[i + 1];
+    } else if (arg == "--min-time") {
+      config.min_time_ms = atof(argv[i + 1]);
+    } else if (arg == "--out") {
+      config.out_path = argv[i + 1];
+    } else {
+      std::cerr << "unknown option " << arg << std::endl;
+      return 2;
+    }
+  }
+
+  std::vector<BenchResult> results;
+  const auto add = [&](const std::string &name, const std::function<uint64_t()> &op) {
+    if (!Selected(config, name)) {
+      return;
+    }
+    results.push_back(Run(config, name, op));
+    const BenchResult &r = results.back();
+    fprintf(stderr, "%-36s %14.1f ns/op %10.1f MB/s %8.2f allocs/op\n", r.name.c_str(), r.ns_per_op,
+            r.ns_per_op > 0 ? r.bytes_per_op * 1e3 / r.ns_per_op : 0.0, r.allocs_per_op);
+  };
+
+  // Text cache: steady state with a full window, so every add also trims.
+  const size_t kTextRecords = 10000;
+  TextResultCache add_cache(kTextRecords);
+  add_cache.setRetentionCount(kTextRecords);
+  FillCache(add_cache, kTextRecords);
+  int64_t next_index = kTextRecords;
+  TextRecord sample = MakeTextRecord(0);
+  add("text_cache/add_record", [&]() -> uint64_t {
+    sample.timestamp_sec = next_index++;
+    add_cache.addRecord(sample);
+    return sample.timestamp_text.size() + sample.raw_text.size();
+  });
+
+  TextResultCache text_cache(kTextRecords);
+  text_cache.setRetentionCount(kTextRecords);
+  FillCache(text_cache, kTextRecords);
+  add("text_cache/snapshot", [&]() -> uint64_t {
+    return text_cache.snapshot().empty() ? 1 : 0;
+  });
+
+  const TextSnapshot text_snapshot = text_cache.snapshot();
+  const struct {
+    const char *name;
+    TextFileFormat format;
+  } kTextFormats[] = {
+      {"txt", TEXT_FILE_FORMAT_TXT},
+      {"csv", TEXT_FILE_FORMAT_CSV},
+      {"json", TEXT_FILE_FORMAT_JSON},
+  };
+  for (size_t i = 0; i < sizeof(kTextFormats) / sizeof(kTextFormats[0]); ++i) {
+    const TextSerializeOptions options = TextOptions(kTextFormats[i].format, text_snapshot);
+    add(std::string("text_serialize/") + kTextFormats[i].name + "_10k", [&]() -> uint64_t {
+      TextResultIStream stream(text_snapshot, options);
+      return Drain(stream);
+    });
+  }
+
+  // Image streams, built the same way makeIstreamByFormat does: JPG bytes are
+  // read in place from the slot, BMP and FLI are encoded while they are read.
+  FtpSlotIStream slot_stream;
+  FtpBmpIStream bmp_stream;
+  FtpLosslessIStream fli_stream;
+  for (size_t i = 0; i < sizeof(kFrameSizes) / sizeof(kFrameSizes[0]); ++i) {
+    const FrameSize &size = kFrameSizes[i];
+    const size_t pixels = static_cast<size_t>(size.width) * size.height;
+    const std::vector<uint8_t> frame = MakeFrame(pixels * 3);
+    const char *data = reinterpret_cast<const char *>(&frame[0]);
+    const size_t jpg_len = pixels / 8;  // typical JPEG at quality ~90
+
+    add(std::string("istream/jpg_") + size.label, [&]() -> uint64_t {
+      slot_stream.reset(data, jpg_len);
+      return Drain(slot_stream);
+    });
+    add(std::string("istream/bmp_mono_") + size.label, [&]() -> uint64_t {
+      bmp_stream.reset(&frame[0], pixels, size.width, size.height, false);
+      return Drain(bmp_stream);
+    });
+    add(std::string("istream/bmp_rgb_") + size.label, [&]() -> uint64_t {
+      bmp_stream.reset(&frame[0], pixels * 3, size.width, size.height, true);
+      return Drain(bmp_stream);
+    });
+    const std::vector<uint8_t> scene = MakeSceneFrame(size.width, size.height, 3);
+    add(std::string("istream/fli_mono_") + size.label, [&]() -> uint64_t {
+      fli_stream.reset(&scene[0], pixels, size.width, size.height, false);
+      return Drain(fli_stream);
+    });
+    add(std::string("istream/fli_rgb_") + size.label, [&]() -> uint64_t {
+      fli_stream.reset(&scene[0], pixels * 3, size.width, size.height, true);
+      return Drain(fli_stream);
+    });
+  }
+
+  // End to end: stream into a loopback data connection.
+  LoopbackServer server;
+  if (!server.start()) {
+    std::cerr << "loopback server unavailable, skipping upload cases" << std::endl;
+  } else {
+    const FrameSize &size = kFrameSizes[1];
+    const size_t pixels = static_cast<size_t>(size.width) * size.height;
+    const std::vector<uint8_t> frame = MakeFrame(pixels * 3);
+    const char *data = reinterpret_cast<const char *>(&frame[0]);
+
+    add(std::string("upload/jpg_") + size.label, [&]() -> uint64_t {
+      slot_stream.reset(data, pixels / 8);
+      return server.upload(slot_stream);
+    });
+    add(std::string("upload/bmp_mono_") + size.label, [&]() -> uint64_t {
+      bmp_stream.reset(&frame[0], pixels, size.width, size.height, false);
+      return server.upload(bmp_stream);
+    });
+    add(std::string("upload/bmp_rgb_") + size.label, [&]() -> uint64_t {
+      bmp_stream.reset(&frame[0], pixels * 3, size.width, size.height, true);
+      return server.upload(bmp_stream);
+    });
+    const std::vector<uint8_t> scene = MakeSceneFrame(size.width, size.height, 1);
+    add(std::string("upload/fli_mono_") + size.label, [&]() -> uint64_t {
+      fli_stream.reset(&scene[0], pixels, size.width, size.height, false);
+      return server.upload(fli_stream);
+    });
+    const TextSerializeOptions csv_options = TextOptions(TEXT_FILE_FORMAT_CSV, text_snapshot);
+    add("upload/csv_10k", [&]() -> uint64_t {
+      TextResultIStream stream(text_snapshot, csv_options);
+      return server.upload(stream);
+    });
+    server.stop();
+  }
+
+  if (config.out_path.empty()) {
+    WriteJson(std::cout, results);
+  } else {
+    std::ofstream out(config.out_path.c_str());
+    WriteJson(out, results);
+    if (!out) {
+      std::cerr << "failed to write " << config.out_path << std::endl;
+      return 1;
+    }
+  }
+  return 0;
+}
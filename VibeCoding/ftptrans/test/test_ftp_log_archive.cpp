@@ -0,0 +1,244 @@
+#include "../FtpZipReader.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// zip archive written by Python's zipfile: stored.log (stored), fixed.log,
+// big.log (77850 bytes, dynamic Huffman), level0.log (deflate stored block)
+// and empty.log (deflate).
+const unsigned char kArchive[] = {
+    0x50, 0x4b, 0x03, 0x04, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x21, 0x00, 0x36, 0x7b,
+    0x08, 0x26, 0x0e, 0x00, 0x00, 0x00, 0x0e, 0x00, 0x00, 0x00, 0x0a, 0x00, 0x00, 0x00, 0x73, 0x74,
+    0x6f, 0x72, 0x65, 0x64, 0x2e, 0x6c, 0x6f, 0x67, 0x73, 0x74, 0x6f, 0x72, 0x65, 0x64, 0x20, 0x65,
+    0x6e, 0x74, 0x72, 0x79, 0x0d, 0x0a, 0x50, 0x4b, 0x03, 0x04, 0x14, 0x00, 0x00, 0x00, 0x08, 0x00,
+    0x18, 0xb8, 0x51, 0x5d, 0x00, 0x88, 0x59, 0x0b, 0x0b, 0x00, 0x00, 0x00, 0x18, 0x00, 0x00, 0x00,
+    0x09, 0x00, 0x00, 0x00, 0x66, 0x69, 0x78, 0x65, 0x64, 0x2e, 0x6c, 0x6f, 0x67, 0xcb, 0x48, 0xcd,
+    0xc9, 0xc9, 0x57, 0xc8, 0x40, 0x27, 0xb9, 0x00, 0x50, 0x4b, 0x03, 0x04, 0x14, 0x00, 0x00, 0x00,
+    0x08, 0x00, 0x18, 0xb8, 0x51, 0x5d, 0x6e, 0x4a, 0x4d, 0x11, 0x12, 0x06, 0x00, 0x00, 0x1a, 0x30,
+    0x01, 0x00, 0x07, 0x00, 0x00, 0x00, 0x62, 0x69, 0x67, 0x2e, 0x6c, 0x6f, 0x67, 0xed, 0xdb, 0x3d,
+    0x6a, 0xa4, 0x57, 0x10, 0x46, 0xe1, 0xdc, 0xab, 0xe8, 0x0d, 0x0c, 0xf4, 0xad, 0xfb, 0xef, 0x1d,
+    0x78, 0x0d, 0x83, 0x03, 0x63, 0xcb, 0x89, 0x31, 0x63, 0x34, 0x81, 0xb7, 0x6f, 0x9c, 0x0d, 0xa8,
+    0xe8, 0x42, 0x27, 0x3e, 0x30, 0xe9, 0x0d, 0x3e, 0xf4, 0x52, 0xcc, 0x41, 0x7a, 0xe2, 0x19, 0xeb,
+    0xcb, 0x73, 0x7c, 0x89, 0xf1, 0x68, 0xcf, 0x9f, 0x9f, 0xff, 0xff, 0x7b, 0x7c, 0xfd, 0xe5, 0xd7,
+    0xc7, 0xbf, 0xdf, 0xde, 0xff, 0x7a, 0x7b, 0x7f, 0x3c, 0x1f, 0xff, 0xbc, 0x7f, 0xfb, 0xfd, 0xed,
+    0xfb, 0xf7, 0xb7, 0x3f, 0x1e, 0x7f, 0xbe, 0xff, 0xf6, 0xf7, 0xdb, 0xe3, 0xf9, 0x53, 0x7c, 0x78,
+    0xd2, 0x7e, 0x7c, 0xd2, 0x3e, 0x3c, 0x69, 0xc9, 0x93, 0xf8, 0xf1, 0x49, 0x7c, 0x78, 0x12, 0xc9,
+    0x93, 0xfe, 0xe3, 0x93, 0xfe, 0xe1, 0x49, 0x4f, 0x9e, 0x8c, 0xd7, 0xdf, 0x32, 0x92, 0x27, 0xf3,
+    0xf5, 0xb7, 0xcc, 0xe4, 0xc9, 0x7a, 0xfd, 0x2d, 0x2b, 0x79, 0xb2, 0x5f, 0x7f, 0xcb, 0x4e, 0x9e,
+    0x9c, 0xd7, 0xdf, 0x72, 0x92, 0x27, 0xf7, 0xf5, 0xb7, 0xdc, 0x8f, 0x4f, 0xda, 0xf3, 0xf5, 0xb7,
+    0xb4, 0xe4, 0xc7, 0xdf, 0xda, 0xeb, 0x8f, 0x69, 0xc9, 0xcf, 0xbf, 0xc5, 0xeb, 0xaf, 0x69, 0xc9,
+    0x00, 0x5a, 0x2f, 0x66, 0x96, 0x2c, 0xa0, 0x8d, 0xe2, 0x7b, 0x92, 0x09, 0xb4, 0x59, 0x7c, 0x4f,
+    0xb2, 0x81, 0xb6, 0x8a, 0xef, 0x49, 0x46, 0xd0, 0x76, 0xf1, 0x3d, 0xc9, 0x0a, 0xda, 0x29, 0xbe,
+    0x27, 0x99, 0x41, 0xbb, 0xc5, 0xf7, 0x24, 0x3b, 0x88, 0xe2, 0x0a, 0x44, 0xb2, 0x83, 0x28, 0xce,
+    0x40, 0x24, 0x3b, 0x88, 0xea, 0x0e, 0x24, 0x3b, 0x88, 0xe2, 0x10, 0x44, 0xb2, 0x83, 0x28, 0x2e,
+    0x41, 0x24, 0x3b, 0x88, 0xe2, 0x14, 0x44, 0xb2, 0x83, 0x28, 0x6e, 0x41, 0x24, 0x3b, 0x88, 0xe2,
+    0x18, 0x44, 0xb2, 0x83, 0x28, 0xae, 0x41, 0x24, 0x3b, 0x88, 0xe2, 0x1c, 0x44, 0xb2, 0x83, 0x5e,
+    0xdc, 0x83, 0x9e, 0xec, 0xa0, 0x17, 0xf7, 0xa0, 0x27, 0x3b, 0xe8, 0xc5, 0x3d, 0xe8, 0xc9, 0x0e,
+    0x7a, 0x71, 0x0f, 0x7a, 0xb2, 0x83, 0x5e, 0xdc, 0x83, 0x9e, 0xec, 0xa0, 0x17, 0xf7, 0xa0, 0x27,
+    0x3b, 0xe8, 0xc5, 0x3d, 0xe8, 0xc9, 0x0e, 0x7a, 0x71, 0x0f, 0x7a, 0xb2, 0x83, 0x5e, 0xdc, 0x83,
+    0x9e, 0xec, 0xa0, 0x17, 0xf7, 0xa0, 0x27, 0x3b, 0x18, 0xc5, 0x3d, 0x18, 0xc9, 0x0e, 0x46, 0x71,
+    0x0f, 0x46, 0xb2, 0x83, 0x51, 0xdc, 0x83, 0x91, 0xec, 0x60, 0x14, 0xf7, 0x60, 0x24, 0x3b, 0x18,
+    0xd5, 0xff, 0x0c, 0x92, 0x1d, 0x8c, 0xe2, 0x1e, 0x8c, 0x64, 0x07, 0xa3, 0xb8, 0x07, 0x23, 0xd9,
+    0xc1, 0x28, 0xee, 0xc1, 0x48, 0x76, 0x30, 0x8a, 0x7b, 0x30, 0x92, 0x1d, 0x8c, 0xe2, 0x1e, 0x8c,
+    0x64, 0x07, 0xb3, 0xb8, 0x07, 0x33, 0xd9, 0xc1, 0x2c, 0xee, 0xc1, 0x4c, 0x76, 0x30, 0x8b, 0x7b,
+    0x30, 0x93, 0x1d, 0xcc, 0xe2, 0x1e, 0xcc, 0x64, 0x07, 0xb3, 0xb8, 0x07, 0x33, 0xd9, 0xc1, 0x2c,
+    0xee, 0xc1, 0x4c, 0x76, 0x30, 0x8b, 0x7b, 0x30, 0x93, 0x1d, 0xcc, 0xe2, 0x1e, 0xcc, 0x64, 0x07,
+    0xb3, 0xb8, 0x07, 0x33, 0xd9, 0xc1, 0x2c, 0xee, 0xc1, 0x4c, 0x76, 0x50, 0x55, 0xc2, 0x02, 0x99,
+    0xb0, 0x40, 0x27, 0x2c, 0x10, 0x0a, 0x0b, 0x94, 0xc2, 0x02, 0xa9, 0xb0, 0x48, 0x2b, 0x80, 0x58,
+    0x58, 0xa0, 0x16, 0x16, 0xc8, 0x85, 0x05, 0x7a, 0x61, 0x83, 0x5e, 0xd8, 0xa0, 0x17, 0x36, 0xe8,
+    0x85, 0x0d, 0x7a, 0x61, 0x83, 0x5e, 0xd8, 0xa0, 0x17, 0x36, 0xe8, 0x85, 0x0d, 0x7a, 0x61, 0x83,
+    0x5e, 0xd8, 0xa0, 0x17, 0x0e, 0xe8, 0x85, 0x03, 0x7a, 0xe1, 0x80, 0x5e, 0x38, 0xa0, 0x17, 0x0e,
+    0xe8, 0x85, 0x03, 0x7a, 0xe1, 0x80, 0x5e, 0x38, 0xa0, 0x17, 0x0e, 0xe8, 0x85, 0x03, 0x7a, 0xe1,
+    0x82, 0x5e, 0xb8, 0xa0, 0x17, 0x2e, 0xe8, 0x85, 0x0b, 0x7a, 0xe1, 0x82, 0x5e, 0xb8, 0xa0, 0x17,
+    0x2e, 0xe8, 0x85, 0x0b, 0x7a, 0xe1, 0x82, 0x5e, 0xb8, 0xa0, 0x17, 0x40, 0x2e, 0x80, 0x5a, 0x00,
+    0xb1, 0x40, 0x5a, 0xe1, 0xf3, 0xa9, 0x00, 0x4a, 0x01, 0x84, 0x02, 0xe8, 0x04, 0x90, 0x09, 0xa0,
+    0x12, 0x1a, 0xa8, 0x84, 0x06, 0x2a, 0xa1, 0x81, 0x4a, 0x68, 0xa0, 0x12, 0x1a, 0xa8, 0x84, 0x06,
+    0x2a, 0xa1, 0x81, 0x4a, 0x68, 0xa0, 0x12, 0x1a, 0xa8, 0x84, 0x06, 0x2a, 0x21, 0x40, 0x25, 0x04,
+    0xf9, 0x6d, 0x02, 0xa8, 0x84, 0x00, 0x95, 0x10, 0xa0, 0x12, 0x02, 0x54, 0x42, 0x80, 0x4a, 0x08,
+    0x50, 0x09, 0x01, 0x2a, 0x21, 0x40, 0x25, 0x74, 0x50, 0x09, 0x1d, 0x54, 0x42, 0x07, 0x95, 0xd0,
+    0x41, 0x25, 0x74, 0x50, 0x09, 0x1d, 0x54, 0x42, 0x07, 0x95, 0xd0, 0x41, 0x25, 0x74, 0x50, 0x09,
+    0x1d, 0x54, 0xc2, 0x00, 0x95, 0x30, 0x40, 0x25, 0x0c, 0x50, 0x09, 0x03, 0x54, 0xc2, 0x00, 0x95,
+    0x30, 0x40, 0x25, 0x0c, 0x50, 0x09, 0x03, 0x54, 0xc2, 0x00, 0x95, 0x30, 0x40, 0x25, 0x4c, 0x50,
+    0x09, 0x13, 0x54, 0xc2, 0x04, 0x95, 0x30, 0x41, 0x25, 0x4c, 0x50, 0x09, 0x13, 0x54, 0xc2, 0x04,
+    0x95, 0x30, 0x41, 0x25, 0x4c, 0x50, 0x09, 0x13, 0x54, 0xc2, 0x02, 0x99, 0xb0, 0x40, 0x27, 0x2c,
+    0x10, 0x0a, 0x0b, 0x94, 0xc2, 0x02, 0xa9, 0xb0, 0x48, 0x2b, 0x80, 0x58, 0x58, 0xa0, 0x16, 0x16,
+    0xc8, 0x85, 0x05, 0x7a, 0x61, 0x83, 0x5e, 0xd8, 0xa0, 0x17, 0x36, 0xe8, 0x85, 0x0d, 0x7a, 0x61,
+    0x83, 0x5e, 0xd8, 0xa0, 0x17, 0x36, 0xe8, 0x85, 0x0d, 0x7a, 0x61, 0x83, 0x5e, 0xd8, 0xa0, 0x17,
+    0x0e, 0xe8, 0x85, 0x03, 0x7a, 0xe1, 0x80, 0x5e, 0x38, 0xa0, 0x17, 0x0e, 0xe8, 0x85, 0x03, 0x7a,
+    0xe1, 0x80, 0x5e, 0x38, 0xe4, 0x6f, 0x90, 0x40, 0x2f, 0x1c, 0xd0, 0x0b, 0x17, 0xf4, 0xc2, 0x05,
+    0xbd, 0x70, 0x41, 0x2f, 0x5c, 0xd0, 0x0b, 0x17, 0xf4, 0xc2, 0x05, 0xbd, 0x70, 0x41, 0x2f, 0x5c,
+    0xd0, 0x0b, 0x17, 0xf4, 0xc2, 0x05, 0xbd, 0x00, 0x72, 0x81, 0xfc, 0x0d, 0xd2, 0xe7, 0x63, 0x81,
+    0xb4, 0xc2, 0xe7, 0x53, 0x01, 0x94, 0x02, 0x08, 0x05, 0xf2, 0xdb, 0x84, 0xcf, 0x67, 0x02, 0xa8,
+    0x84, 0x06, 0x2a, 0xa1, 0x81, 0x4a, 0x68, 0xa0, 0x12, 0x1a, 0xa8, 0x84, 0x06, 0x2a, 0xa1, 0x81,
+    0x4a, 0x68, 0xa0, 0x12, 0x1a, 0xa8, 0x84, 0x06, 0x2a, 0xa1, 0x81, 0x4a, 0x08, 0x50, 0x09, 0x41,
+    0x7e, 0x9b, 0x00, 0x2a, 0x21, 0x40, 0x25, 0x04, 0xa8, 0x84, 0x00, 0x95, 0x10, 0xa0, 0x12, 0x02,
+    0x54, 0x42, 0x80, 0x4a, 0x08, 0x50, 0x09, 0x1d, 0x54, 0x42, 0x07, 0x95, 0xd0, 0x41, 0x25, 0x74,
+    0x50, 0x09, 0x1d, 0x54, 0x42, 0x07, 0x95, 0xd0, 0x41, 0x25, 0x74, 0x50, 0x09, 0x1d, 0x54, 0x42,
+    0x07, 0x95, 0x30, 0x40, 0x25, 0x0c, 0x50, 0x09, 0x03, 0x54, 0xc2, 0x20, 0x4a, 0x01, 0x54, 0xc2,
+    0x00, 0x95, 0x30, 0x40, 0x25, 0x0c, 0x50, 0x09, 0x03, 0x54, 0xc2, 0x00, 0x95, 0x30, 0x41, 0x25,
+    0x4c, 0x50, 0x09, 0x13, 0x54, 0xc2, 0x04, 0x95, 0x30, 0x41, 0x25, 0x4c, 0x50, 0x09, 0x13, 0x54,
+    0xc2, 0x04, 0x95, 0x30, 0x41, 0x25, 0x4c, 0x50, 0x09, 0x0b, 0x64, 0xc2, 0x02, 0x9d, 0xb0, 0x40,
+    0x28, 0x2c, 0x50, 0x0a, 0x0b, 0xa4, 0xc2, 0x22, 0xad, 0x00, 0x62, 0x61, 0x81, 0x5a, 0x58, 0x20,
+    0x17, 0x16, 0xe8, 0x85, 0x0d, 0x7a, 0x61, 0x83, 0x5e, 0xd8, 0xa0, 0x17, 0x36, 0xe8, 0x85, 0x0d,
+    0x7a, 0x61, 0x83, 0x5e, 0xd8, 0xa0, 0x17, 0x36, 0xe8, 0x85, 0x0d, 0x7a, 0x61, 0x83, 0x5e, 0x38,
+    0xa0, 0x17, 0x0e, 0xe8, 0x85, 0x03, 0x7a, 0xe1, 0x80, 0x5e, 0x38, 0xa0, 0x17, 0x0e, 0xe8, 0x85,
+    0x03, 0x7a, 0xe1, 0x90, 0xbf, 0x41, 0x02, 0xbd, 0x70, 0x40, 0x2f, 0x5c, 0xd0, 0x0b, 0x17, 0xf4,
+    0xc2, 0x05, 0xbd, 0x70, 0x41, 0x2f, 0x5c, 0xd0, 0x0b, 0x17, 0xf4, 0xc2, 0x05, 0xbd, 0x70, 0x41,
+    0x2f, 0x5c, 0xd0, 0x0b, 0x17, 0xf4, 0x82, 0xa2, 0x59, 0xd1, 0xac, 0x68, 0x56, 0x34, 0x2b, 0x9a,
+    0x15, 0xcd, 0x8a, 0x66, 0x45, 0xb3, 0xa2, 0x59, 0xd1, 0xac, 0x68, 0x56, 0x34, 0x2b, 0x9a, 0x15,
+    0xcd, 0x8a, 0x66, 0x45, 0xb3, 0xa2, 0x59, 0xd1, 0xac, 0x68, 0x56, 0x34, 0x2b, 0x9a, 0x15, 0xcd,
+    0x8a, 0x66, 0x45, 0xb3, 0xa2, 0x59, 0xd1, 0xac, 0x68, 0x56, 0x34, 0x2b, 0x9a, 0x15, 0xcd, 0x8a,
+    0x66, 0x45, 0xb3, 0xa2, 0x59, 0xd1, 0xac, 0x68, 0x56, 0x34, 0x2b, 0x9a, 0x15, 0xcd, 0x8a, 0x66,
+    0x45, 0xb3, 0xa2, 0x59, 0xd1, 0xac, 0x68, 0x56, 0x34, 0x2b, 0x9a, 0x15, 0xcd, 0x8a, 0x66, 0x45,
+    0xb3, 0xa2, 0x59, 0xd1, 0xac, 0x68, 0x56, 0x34, 0x2b, 0x9a, 0x15, 0xcd, 0x8a, 0x66, 0x45, 0xb3,
+    0xa2, 0x59, 0xd1, 0xac, 0x68, 0x56, 0x34, 0x2b, 0x9a, 0x15, 0xcd, 0x8a, 0x66, 0x45, 0xb3, 0xa2,
+    0x59, 0xd1, 0xac, 0x68, 0x56, 0x34, 0x2b, 0x9a, 0x15, 0xcd, 0x8a, 0x66, 0x45, 0xb3, 0xa2, 0x59,
+    0xd1, 0xac, 0x68, 0x56, 0x34, 0x2b, 0x9a, 0x15, 0xcd, 0x8a, 0x66, 0x45, 0xb3, 0xa2, 0x59, 0xd1,
+    0xac, 0x68, 0x56, 0x34, 0x2b, 0x9a, 0x15, 0xcd, 0x8a, 0x66, 0x45, 0xb3, 0xa2, 0x59, 0xd1, 0xac,
+    0x68, 0x56, 0x34, 0x2b, 0x9a, 0x15, 0xcd, 0x8a, 0x66, 0x45, 0xb3, 0xa2, 0x59, 0xd1, 0xac, 0x68,
+    0x56, 0x34, 0x2b, 0x9a, 0x15, 0xcd, 0x8a, 0x66, 0x45, 0xb3, 0xa2, 0x59, 0xd1, 0xac, 0x68, 0x56,
+    0x34, 0x2b, 0x9a, 0x15, 0xcd, 0x8a, 0x66, 0x45, 0xb3, 0xa2, 0x59, 0xd1, 0xac, 0x68, 0x56, 0x34,
+    0x2b, 0x9a, 0x15, 0xcd, 0x8a, 0x66, 0x45, 0xb3, 0xa2, 0x59, 0xd1, 0xac, 0x68, 0x56, 0x34, 0x2b,
+    0x9a, 0x15, 0xcd, 0x8a, 0x66, 0x45, 0xb3, 0xa2, 0x59, 0xd1, 0xac, 0x68, 0x56, 0x34, 0x2b, 0x9a,
+    0x15, 0xcd, 0x8a, 0x66, 0x45, 0xb3, 0xa2, 0x59, 0xd1, 0xac, 0x68, 0x56, 0x34, 0x2b, 0x9a, 0x15,
+    0xcd, 0x8a, 0x66, 0x45, 0xb3, 0xa2, 0x59, 0xd1, 0xac, 0x68, 0x56, 0x34, 0x2b, 0x9a, 0x15, 0xcd,
+    0x8a, 0x66, 0x45, 0xb3, 0xa2, 0x59, 0xd1, 0xac, 0x68, 0x56, 0x34, 0x2b, 0x9a, 0x15, 0xcd, 0x8a,
+    0x66, 0x45, 0xb3, 0xa2, 0x59, 0xd1, 0xac, 0x68, 0x56, 0x34, 0x2b, 0x9a, 0x15, 0xcd, 0x8a, 0x66,
+    0x45, 0xb3, 0xa2, 0x59, 0xd1, 0xac, 0x68, 0x56, 0x34, 0x2b, 0x9a, 0x15, 0xcd, 0x8a, 0x66, 0x45,
+    0xb3, 0xa2, 0x59, 0xd1, 0xac, 0x68, 0x56, 0x34, 0x2b, 0x9a, 0x15, 0xcd, 0x8a, 0x66, 0x45, 0xb3,
+    0xa2, 0x59, 0xd1, 0xac, 0x68, 0x56, 0x34, 0x2b, 0x9a, 0x15, 0xcd, 0x8a, 0x66, 0x45, 0xb3, 0xa2,
+    0x59, 0xd1, 0xac, 0x68, 0x56, 0x34, 0x2b, 0x9a, 0x15, 0xcd, 0x8a, 0x66, 0x45, 0xb3, 0xa2, 0x59,
+    0xd1, 0xac, 0x68, 0x56, 0x34, 0x2b, 0x9a, 0x15, 0xcd, 0x8a, 0x66, 0x45, 0xb3, 0xa2, 0x59, 0xd1,
+    0xac, 0x68, 0x56, 0x34, 0x2b, 0x9a, 0x15, 0xcd, 0x8a, 0x66, 0x45, 0xb3, 0xa2, 0x59, 0xd1, 0xac,
+    0x68, 0x56, 0x34, 0x2b, 0x9a, 0x15, 0xcd, 0x8a, 0x66, 0x45, 0xb3, 0xa2, 0x59, 0xd1, 0xac, 0x68,
+    0x56, 0x34, 0x2b, 0x9a, 0x15, 0xcd, 0x8a, 0x66, 0x45, 0xb3, 0xa2, 0x59, 0xd1, 0xac, 0x68, 0x56,
+    0x34, 0x2b, 0x9a, 0x15, 0xcd, 0x8a, 0x66, 0x45, 0xb3, 0xa2, 0x19, 0x89, 0xe6, 0xff, 0x00, 0x50,
+    0x4b, 0x03, 0x04, 0x14, 0x00, 0x00, 0x00, 0x08, 0x00, 0x18, 0xb8, 0x51, 0x5d, 0x0f, 0x68, 0xae,
+    0xb0, 0x19, 0x00, 0x00, 0x00, 0x14, 0x00, 0x00, 0x00, 0x0a, 0x00, 0x00, 0x00, 0x6c, 0x65, 0x76,
+    0x65, 0x6c, 0x30, 0x2e, 0x6c, 0x6f, 0x67, 0x01, 0x14, 0x00, 0xeb, 0xff, 0x6e, 0x6f, 0x20, 0x63,
+    0x6f, 0x6d, 0x70, 0x72, 0x65, 0x73, 0x73, 0x69, 0x6f, 0x6e, 0x20, 0x68, 0x65, 0x72, 0x65, 0x0a,
+    0x50, 0x4b, 0x03, 0x04, 0x14, 0x00, 0x00, 0x00, 0x08, 0x00, 0x18, 0xb8, 0x51, 0x5d, 0x00, 0x00,
+    0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 0x65, 0x6d,
+    0x70, 0x74, 0x79, 0x2e, 0x6c, 0x6f, 0x67, 0x03, 0x00, 0x50, 0x4b, 0x01, 0x02, 0x14, 0x03, 0x14,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x21, 0x00, 0x36, 0x7b, 0x08, 0x26, 0x0e, 0x00, 0x00,
+    0x00, 0x0e, 0x00, 0x00, 0x00, 0x0a, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x80, 0x01, 0x00, 0x00, 0x00, 0x00, 0x73, 0x74, 0x6f, 0x72, 0x65, 0x64, 0x2e, 0x6c, 0x6f,
+    0x67, 0x50, 0x4b, 0x01, 0x02, 0x14, 0x03, 0x14, 0x00, 0x00, 0x00, 0x08, 0x00, 0x18, 0xb8, 0x51,
+    0x5d, 0x00, 0x88, 0x59, 0x0b, 0x0b, 0x00, 0x00, 0x00, 0x18, 0x00, 0x00, 0x00, 0x09, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x01, 0x36, 0x00, 0x00, 0x00, 0x66,
+    0x69, 0x78, 0x65, 0x64, 0x2e, 0x6c, 0x6f, 0x67, 0x50, 0x4b, 0x01, 0x02, 0x14, 0x03, 0x14, 0x00,
+    0x00, 0x00, 0x08, 0x00, 0x18, 0xb8, 0x51, 0x5d, 0x6e, 0x4a, 0x4d, 0x11, 0x12, 0x06, 0x00, 0x00,
+    0x1a, 0x30, 0x01, 0x00, 0x07, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x80, 0x01, 0x68, 0x00, 0x00, 0x00, 0x62, 0x69, 0x67, 0x2e, 0x6c, 0x6f, 0x67, 0x50, 0x4b, 0x01,
+    0x02, 0x14, 0x03, 0x14, 0x00, 0x00, 0x00, 0x08, 0x00, 0x18, 0xb8, 0x51, 0x5d, 0x0f, 0x68, 0xae,
+    0xb0, 0x19, 0x00, 0x00, 0x00, 0x14, 0x00, 0x00, 0x00, 0x0a, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x01, 0x9f, 0x06, 0x00, 0x00, 0x6c, 0x65, 0x76, 0x65, 0x6c,
+    0x30, 0x2e, 0x6c, 0x6f, 0x67, 0x50, 0x4b, 0x01, 0x02, 0x14, 0x03, 0x14, 0x00, 0x00, 0x00, 0x08,
+    0x00, 0x18, 0xb8, 0x51, 0x5d, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x09, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x01, 0xe0,
+    0x06, 0x00, 0x00, 0x65, 0x6d, 0x70, 0x74, 0x79, 0x2e, 0x6c, 0x6f, 0x67, 0x50, 0x4b, 0x05, 0x06,
+    0x00, 0x00, 0x00, 0x00, 0x05, 0x00, 0x05, 0x00, 0x13, 0x01, 0x00, 0x00, 0x09, 0x07, 0x00, 0x00,
+    0x00, 0x00,
+};
+
+void Expect(bool condition, const std::string &message) {
+  if (!condition) {
+    std::cerr << "[FAIL] " << message << std::endl;
+    std::exit(1);
+  }
+}
+
+std::string WriteArchive(const std::vector<unsigned char> &bytes) {
+  char path[] = "/tmp/ftptrans_zip_XXXXXX";
+  const int fd = mkstemp(path);
+  Expect(fd >= 0, "temp archive should be created");
+  Expect(write(fd, &bytes[0], bytes.size()) == static_cast<ssize_t>(bytes.size()), "temp archive should be written");
+  close(fd);
+  return path;
+}
+
+std::string BigLog() {
+  std::string text;
+  char line[96];
+  for (int i = 0; i < 1500; ++i) {
+    snprintf(line, sizeof(line), "2026-04-24 10:00:%02d [I] worker %d processed frame %d\n", i % 60, i % 4, i % 100);
+    text += line;
+  }
+  return text;
+}
+
+std::string ReadEntry(const std::string &archive, const std::string &name, bool *ok) {
+  FtpZipEntryIStream stream;
+  Expect(stream.open(archive, name), "entry " + name + " should open");
+
+  std::string text;
+  char chunk[1000];
+  while (stream.read(chunk, sizeof(chunk)) || stream.gcount() > 0) {
+    text.append(chunk, static_cast<size_t>(stream.gcount()));
+  }
+  *ok = stream.ok();
+  return text;
+}
+
+void TestCentralDirectory() {
+  const std::string path = WriteArchive(std::vector<unsigned char>(kArchive, kArchive + sizeof(kArchive)));
+  FtpZipArchive archive;
+  Expect(archive.open(path), "archive should open");
+  Expect(archive.entries().size() == 5, "archive should list every entry");
+  Expect(archive.find("big.log") != nullptr && archive.find("big.log")->uncompressed_size == 77850,
+         "central directory should carry sizes");
+  Expect(archive.find("missing.log") == nullptr, "unknown entries should not be found");
+  unlink(path.c_str());
+
+  std::string zip;
+  std::string entry;
+  Expect(FtpZipArchive::splitPath("/mnt/log/app/log_record_file.zip/a_1.log", &zip, &entry) &&
+             zip == "/mnt/log/app/log_record_file.zip" && entry == "a_1.log",
+         "archive paths should split at .zip/");
+  Expect(!FtpZipArchive::splitPath("/mnt/data/log_tmp/a_1.log", &zip, &entry), "plain paths should not split");
+}
+
+void TestEntriesDecompress() {
+  const std::string path = WriteArchive(std::vector<unsigned char>(kArchive, kArchive + sizeof(kArchive)));
+  bool ok = false;
+
+  Expect(ReadEntry(path, "stored.log", &ok) == "stored entry\r\n" && ok, "stored entry should read verbatim");
+  Expect(ReadEntry(path, "fixed.log", &ok) == "hello hello hello hello\n" && ok, "fixed huffman entry should inflate");
+  Expect(ReadEntry(path, "big.log", &ok) == BigLog() && ok, "dynamic huffman entry should inflate across the window");
+  Expect(ReadEntry(path, "level0.log", &ok) == "no compression here\n" && ok, "stored deflate block should inflate");
+  Expect(ReadEntry(path, "empty.log", &ok).empty() && ok, "empty entry should verify");
+
+  FtpZipEntryIStream stream;
+  Expect(!stream.open(path, "missing.log"), "missing entry should not open");
+  unlink(path.c_str());
+}
+
+void TestCorruptEntryFailsVerification() {
+  std::vector<unsigned char> bytes(kArchive, kArchive + sizeof(kArchive));
+  // Flip a byte inside big.log's compressed data (local header at 104).
+  bytes[104 + 30 + 7 + 800] ^= 0x5a;
+  const std::string path = WriteArchive(bytes);
+
+  bool ok = true;
+  const std::string text = ReadEntry(path, "big.log", &ok);
+  Expect(!ok, "corrupt data should fail size/crc verification");
+  Expect(text.size() <= 77850 + 258, "corrupt data should not run away");
+  unlink(path.c_str());
+}
+
+}  // namespace
+
+int main() {
+  TestCentralDirectory();
+  TestEntriesDecompress();
+  TestCorruptEntryFailsVerification();
+  std::cout << "[PASS] ftptrans log archive tests" << std::endl;
+  return 0;
+}
@@ -0,0 +1,179 @@
+#include "../FtpLosslessCodec.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace {
+
+void Expect(bool condition, const std::string &message) {
+  if (!condition) {
+    std::cerr << "[FAIL] " << message << std::endl;
+    std::exit(1);
+  }
+}
+
+uint32_t NextRandom(uint32_t *state) {
+  *state = *state * 1664525u + 1013904223u;
+  return *state >> 8;
+}
+
+// Grey background with sensor noise, a bright part and a few sharp edges,
+// roughly what an inspection camera sees.
+std::vector<uint8_t> MonoScene(uint32_t width, uint32_t height, uint32_t seed) {
+  std::vector<uint8_t> image(static_cast<size_t>(width) * height);
+  uint32_t state = seed;
+  for (uint32_t y = 0; y < height; ++y) {
+    for (uint32_t x = 0; x < width; ++x) {
+      int value = 40 + static_cast<int>(x / 8);
+      if (x > width / 3 && x < width / 2 && y > height / 4 && y < height / 2) {
+        value = 200;
+      }
+      value += static_cast<int>(NextRandom(&state) % 5) - 2;
+      image[static_cast<size_t>(y) * width + x] = static_cast<uint8_t>(std::min(255, std::max(0, value)));
+    }
+  }
+  return image;
+}
+
+std::vector<uint8_t> Noise(size_t size, uint32_t seed) {
+  std::vector<uint8_t> data(size);
+  uint32_t state = seed;
+  for (size_t i = 0; i < size; ++i) {
+    data[i] = static_cast<uint8_t>(NextRandom(&state));
+  }
+  return data;
+}
+
+std::string Encode(FtpLosslessIStream *stream, const std::vector<uint8_t> &frame, uint32_t width,
+                   uint32_t height, bool planar_rgb) {
+  Expect(stream->reset(&frame[0], frame.size(), width, height, planar_rgb), "stream reset should succeed");
+  return std::string(std::istreambuf_iterator<char>(*stream), std::istreambuf_iterator<char>());
+}
+
+void ExpectRoundTrip(const std::vector<uint8_t> &frame, uint32_t width, uint32_t height, bool planar_rgb,
+                     const std::string &name) {
+  FtpLosslessIStream stream;
+  const std::string coded = Encode(&stream, frame, width, height, planar_rgb);
+  Expect(coded.size() <= stream.maxFileSize(), name + ": coded size should stay within the bound");
+
+  FtpLosslessInfo info;
+  std::vector<uint8_t> decoded;
+  Expect(FtpLosslessDecode(reinterpret_cast<const uint8_t *>(coded.data()), coded.size(), &info, &decoded),
+         name + ": decode should succeed");
+  Expect(info.width == width && info.height == height && info.channels == (planar_rgb ? 3u : 1u),
+         name + ": header should describe the frame");
+  Expect(decoded == frame, name + ": decoded frame should match the source");
+}
+
+void TestPackBlockMatchesBitPlanes() {
+  const std::vector<uint8_t> values = Noise(16, 7);
+  for (uint32_t bits = 0; bits <= 8; ++bits) {
+    uint8_t packed[16];
+    uint8_t *end = FtpLosslessPackBlock(&values[0], bits, packed);
+    Expect(end == packed + 2 * bits, "a block should take two bytes per bit plane");
+    for (uint32_t k = 0; k < bits; ++k) {
+      for (uint32_t j = 0; j < 16; ++j) {
+        const uint32_t bit = (packed[2 * k + j / 8] >> (j % 8)) & 1;
+        Expect(bit == ((values[j] >> k) & 1u), "bit plane k should hold bit k of every value");
+      }
+    }
+  }
+}
+
+void TestRoundTripShapes() {
+  ExpectRoundTrip(MonoScene(640, 480, 1), 640, 480, false, "mono 640x480");
+  ExpectRoundTrip(MonoScene(1, 1, 2), 1, 1, false, "mono 1x1");
+  ExpectRoundTrip(MonoScene(17, 3, 3), 17, 3, false, "mono 17x3");
+  ExpectRoundTrip(Noise(70000 * 2, 4), 70000, 2, false, "row wider than a strip");
+  ExpectRoundTrip(Noise(333 * 211, 5), 333, 211, false, "mono noise");
+
+  std::vector<uint8_t> rgb;
+  for (uint32_t c = 0; c < 3; ++c) {
+    const std::vector<uint8_t> plane = MonoScene(321, 123, 10 + c);
+    rgb.insert(rgb.end(), plane.begin(), plane.end());
+  }
+  ExpectRoundTrip(rgb, 321, 123, true, "planar rgb");
+  ExpectRoundTrip(Noise(5 * 7 * 3, 6), 5, 7, true, "planar rgb noise");
+}
+
+void TestCompressesInspectionImage() {
+  const uint32_t width = 1280;
+  const uint32_t height = 1024;
+  const std::vector<uint8_t> frame = MonoScene(width, height, 11);
+  FtpLosslessIStream stream;
+  const std::string coded = Encode(&stream, frame, width, height, false);
+  Expect(coded.size() * 2 < frame.size(), "a noisy mono scene should compress at least 2x");
+
+  // Identical planes code the colour differences as zero.
+  std::vector<uint8_t> grey_rgb(frame);
+  grey_rgb.insert(grey_rgb.end(), frame.begin(), frame.end());
+  grey_rgb.insert(grey_rgb.end(), frame.begin(), frame.end());
+  const std::string coded_rgb = Encode(&stream, grey_rgb, width, height, true);
+  // Zero blocks cost one byte per 32 pixels in each difference plane.
+  Expect(coded_rgb.size() < coded.size() + frame.size() / 15, "grey rgb should cost little more than mono");
+}
+
+void TestStreamTellAndRewind() {
+  const std::vector<uint8_t> frame = MonoScene(800, 600, 12);
+  FtpLosslessIStream stream;
+  const std::string first = Encode(&stream, frame, 800, 600, false);
+  stream.clear();
+  Expect(stream.tellg() == static_cast<std::streamoff>(first.size()), "tellg should report the coded bytes");
+  Expect(stream.encodeNs() > 0, "encoding time should be measured");
+
+  stream.seekg(0);
+  std::vector<char> chunk(1000);
+  std::string second;
+  while (stream.read(&chunk[0], static_cast<std::streamsize>(chunk.size())) || stream.gcount() > 0) {
+    second.append(&chunk[0], static_cast<size_t>(stream.gcount()));
+  }
+  Expect(second == first, "a rewound stream should produce the same bytes");
+
+  stream.clear();
+  stream.seekg(10);
+  Expect(stream.fail(), "seeking into the middle should be refused");
+
+  Expect(!stream.reset(&frame[0], frame.size() - 1, 800, 600, false), "short frame should be rejected");
+  Expect(!stream.reset(&frame[0], frame.size(), 800, 600, true), "short rgb frame should be rejected");
+}
+
+void TestRejectsMalformedInput() {
+  const std::vector<uint8_t> frame = MonoScene(200, 150, 13);
+  FtpLosslessIStream stream;
+  const std::string coded = Encode(&stream, frame, 200, 150, false);
+  const uint8_t *data = reinterpret_cast<const uint8_t *>(coded.data());
+  FtpLosslessInfo info;
+  std::vector<uint8_t> decoded;
+
+  for (size_t len = 0; len < coded.size(); len += 97) {
+    Expect(!FtpLosslessDecode(data, len, &info, &decoded), "truncated input should be rejected");
+  }
+  std::string extra = coded + "x";
+  Expect(!FtpLosslessDecode(reinterpret_cast<const uint8_t *>(extra.data()), extra.size(), &info, &decoded),
+         "trailing bytes should be rejected");
+  std::string bad_magic = coded;
+  bad_magic[0] = 'X';
+  Expect(!FtpLosslessDecode(reinterpret_cast<const uint8_t *>(bad_magic.data()), bad_magic.size(), &info,
+                            &decoded),
+         "a wrong magic should be rejected");
+  std::string bad_width = coded;
+  bad_width[kFtpLosslessHeaderSize + 4] = static_cast<char>(0x9f);
+  Expect(!FtpLosslessDecode(reinterpret_cast<const uint8_t *>(bad_width.data()), bad_width.size(), &info,
+                            &decoded),
+         "a block width above 8 bits should be rejected");
+}
+
+}  // namespace
+
+int main() {
+  TestPackBlockMatchesBitPlanes();
+  TestRoundTripShapes();
+  TestCompressesInspectionImage();
+  TestStreamTellAndRewind();
+  TestRejectsMalformedInput();
+  std::cout << "[PASS] ftptrans lossless codec tests" << std::endl;
+  return 0;
+}
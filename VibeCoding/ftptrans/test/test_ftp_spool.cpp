@@ -0,0 +1,246 @@
+#include "../FtpSpool.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+void Expect(bool condition, const std::string &message) {
+  if (!condition) {
+    std::cerr << "[FAIL] " << message << std::endl;
+    std::exit(1);
+  }
+}
+
+std::string MakeTempDir() {
+  char path[] = "/tmp/ftptrans_spool_XXXXXX";
+  Expect(mkdtemp(path) != nullptr, "temp dir should be created");
+  return path;
+}
+
+void RemoveDir(const std::string &dir) {
+  DIR *handle = opendir(dir.c_str());
+  if (handle == nullptr) {
+    return;
+  }
+  for (struct dirent *entry = readdir(handle); entry != nullptr; entry = readdir(handle)) {
+    const std::string name(entry->d_name);
+    if (name != "." && name != "..") {
+      unlink((dir + "/" + name).c_str());
+    }
+  }
+  closedir(handle);
+  rmdir(dir.c_str());
+}
+
+std::string Payload(size_t size, int seed) {
+  std::string data(size, '\0');
+  for (size_t i = 0; i < size; ++i) {
+    data[i] = static_cast<char>((i * 131 + seed * 7) & 0xff);
+  }
+  return data;
+}
+
+bool Append(FtpSpool *spool, const std::string &file, const std::string &data) {
+  std::istringstream in(data);
+  return spool->append("2026/10/17", file, in, data.size());
+}
+
+// Reads the front record; returns false when the spool is empty.
+bool ReadFront(FtpSpool *spool, std::string *file, std::string *data, bool *ok) {
+  FtpSpoolIStream stream;
+  std::string dir;
+  uint64_t length = 0;
+  if (!spool->openFront(&stream, &dir, file, &length)) {
+    return false;
+  }
+  data->assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+  *ok = stream.ok() && dir == "2026/10/17" && data->size() == length;
+  return true;
+}
+
+void TestAppendReplayInOrder() {
+  const std::string dir = MakeTempDir();
+  FtpSpool spool;
+  Expect(spool.open(dir + "/a/b", 4 * 1024 * 1024), "spool should create its directory");
+  Expect(spool.empty(), "new spool should be empty");
+
+  for (int i = 0; i < 20; ++i) {
+    Expect(Append(&spool, "img" + std::to_string(i) + ".jpg", Payload(30000 + i, i)), "append should succeed");
+  }
+  Expect(spool.stats().records == 20 && spool.stats().appended == 20, "stats should count appends");
+
+  for (int i = 0; i < 20; ++i) {
+    std::string file;
+    std::string data;
+    bool ok = false;
+    Expect(ReadFront(&spool, &file, &data, &ok), "front should be readable");
+    Expect(ok && file == "img" + std::to_string(i) + ".jpg" && data == Payload(30000 + i, i),
+           "records should replay in append order with their payload");
+    spool.popFront();
+  }
+  std::string file;
+  std::string data;
+  bool ok = false;
+  Expect(!ReadFront(&spool, &file, &data, &ok), "replayed spool should be empty");
+  Expect(spool.stats().replayed == 20 && spool.stats().bytes == 0, "stats should count replays");
+
+  std::istringstream short_input("abc");
+  Expect(!spool.append("d", "short.bin", short_input, 10), "short payload should fail");
+  Expect(spool.empty() && spool.stats().append_failures == 1, "failed append should leave the spool unchanged");
+  spool.close();
+  RemoveDir(dir + "/a/b");
+  RemoveDir(dir + "/a");
+  RemoveDir(dir);
+}
+
+void TestEvictsOldestWhenFull() {
+  const std::string dir = MakeTempDir();
+  FtpSpool spool;
+  // 64 KB segments, 256 KB total: eight 30 KB records fill it.
+  Expect(spool.open(dir, 256 * 1024), "spool should open");
+  for (int i = 0; i < 40; ++i) {
+    Expect(Append(&spool, "f" + std::to_string(i), Payload(30000, i)), "append should evict instead of failing");
+    Expect(spool.stats().disk_bytes <= 256 * 1024, "spool should stay under its size limit");
+  }
+  const FtpSpoolStats stats = spool.stats();
+  Expect(stats.evicted > 0 && stats.evicted + stats.records == 40, "evicted plus queued should equal appended");
+
+  std::string file;
+  std::string data;
+  bool ok = false;
+  Expect(ReadFront(&spool, &file, &data, &ok) && ok, "front should be readable after eviction");
+  Expect(file == "f" + std::to_string(stats.evicted), "eviction should drop the oldest records first");
+
+  std::istringstream big(Payload(300 * 1024, 1));
+  Expect(!spool.append("d", "big", big, 300 * 1024), "a record larger than the spool should be rejected");
+  spool.close();
+  RemoveDir(dir);
+}
+
+void TestRecoversCursorAndTornTail() {
+  const std::string dir = MakeTempDir();
+  {
+    FtpSpool spool;
+    Expect(spool.open(dir, 1024 * 1024), "spool should open");
+    for (int i = 0; i < 6; ++i) {
+      Expect(Append(&spool, "r" + std::to_string(i), Payload(5000, i)), "append should succeed");
+    }
+    std::string file;
+    std::string data;
+    bool ok = false;
+    for (int i = 0; i < 2; ++i) {
+      Expect(ReadFront(&spool, &file, &data, &ok) && ok, "front should be readable");
+      spool.popFront();
+    }
+  }
+
+  // Simulate power loss in the middle of an append: a zero-magic header and
+  // part of its payload after the last complete record.
+  std::string segment;
+  DIR *handle = opendir(dir.c_str());
+  for (struct dirent *entry = readdir(handle); entry != nullptr; entry = readdir(handle)) {
+    if (std::string(entry->d_name).compare(0, 4, "seg_") == 0) {
+      segment = dir + "/" + entry->d_name;
+    }
+  }
+  closedir(handle);
+  struct stat before;
+  Expect(stat(segment.c_str(), &before) == 0, "segment file should exist");
+  FILE *tail = fopen(segment.c_str(), "ab");
+  const std::string garbage(24 + 700, '\0');
+  fwrite(garbage.data(), 1, garbage.size(), tail);
+  fclose(tail);
+
+  FtpSpool spool;
+  Expect(spool.open(dir, 1024 * 1024), "spool should reopen");
+  Expect(spool.stats().records == 4, "reopen should resume after the replayed records");
+  struct stat after;
+  Expect(stat(segment.c_str(), &after) == 0 && after.st_size == before.st_size, "torn tail should be cut off");
+
+  Expect(Append(&spool, "r6", Payload(5000, 6)), "append after recovery should succeed");
+  for (int i = 2; i <= 6; ++i) {
+    std::string file;
+    std::string data;
+    bool ok = false;
+    Expect(ReadFront(&spool, &file, &data, &ok) && ok && file == "r" + std::to_string(i) &&
+               data == Payload(5000, i),
+           "recovered records should replay intact");
+    spool.popFront();
+  }
+  Expect(spool.empty(), "spool should be drained");
+  spool.close();
+  RemoveDir(dir);
+}
+
+void TestCorruptPayloadFailsVerification() {
+  const std::string dir = MakeTempDir();
+  FtpSpool spool;
+  Expect(spool.open(dir, 1024 * 1024), "spool should open");
+  Expect(Append(&spool, "bad", Payload(8000, 3)), "append should succeed");
+  Expect(Append(&spool, "good", Payload(8000, 4)), "append should succeed");
+
+  DIR *handle = opendir(dir.c_str());
+  for (struct dirent *entry = readdir(handle); entry != nullptr; entry = readdir(handle)) {
+    if (std::string(entry->d_name).compare(0, 4, "seg_") == 0) {
+      FILE *file = fopen((dir + "/" + entry->d_name).c_str(), "r+b");
+      fseek(file, 24 + 10 + 3 + 4000, SEEK_SET);
+      fputc(0x5a, file);
+      fclose(file);
+    }
+  }
+  closedir(handle);
+
+  std::string file;
+  std::string data;
+  bool ok = true;
+  Expect(ReadFront(&spool, &file, &data, &ok) && file == "bad" && !ok, "a flipped byte should fail the crc check");
+  spool.popFront();
+  Expect(ReadFront(&spool, &file, &data, &ok) && file == "good" && ok, "the next record should be intact");
+  spool.close();
+  RemoveDir(dir);
+}
+
+void TestAppendUpToStreamEnd() {
+  const std::string dir = MakeTempDir();
+  FtpSpool spool;
+  Expect(spool.open(dir, 1024 * 1024), "spool should open");
+
+  std::istringstream coded(Payload(7000, 5));
+  Expect(spool.appendUpTo("2026/10/17", "frame.fli", coded, 20000), "a shorter stream should be accepted");
+  std::istringstream too_long(Payload(7000, 6));
+  Expect(!spool.appendUpTo("2026/10/17", "long.fli", too_long, 6999), "a stream past its bound should fail");
+  Expect(spool.stats().records == 1 && spool.stats().append_failures == 1, "only the bounded record is kept");
+
+  std::string file;
+  std::string data;
+  bool ok = false;
+  Expect(ReadFront(&spool, &file, &data, &ok) && ok && file == "frame.fli" && data == Payload(7000, 5),
+         "the record should hold the bytes actually read");
+  spool.popFront();
+  Expect(spool.stats().disk_bytes < 20000, "only the written bytes should count toward the limit");
+  spool.close();
+  RemoveDir(dir);
+}
+
+}  // namespace
+
+int main() {
+  TestAppendReplayInOrder();
+  TestEvictsOldestWhenFull();
+  TestRecoversCursorAndTornTail();
+  TestCorruptPayloadFailsVerification();
+  TestAppendUpToStreamEnd();
+  std::cout << "[PASS] ftptrans spool tests" << std::endl;
+  return 0;
+}
@@ -0,0 +1,753 @@
+#include "../FtpBackoff.h"
+#include "../FtpBmpStream.h"
+#include "../FtpConnectProbe.h"
+#include "../FtpDirCache.h"
+#include "../FtpSlotRing.h"
+#include "../FtpSlotStream.h"
+#include "../FtpUploadStats.h"
+#include "../FtpWakeup.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+void Expect(bool condition, const std::string &message) {
+  if (!condition) {
+    std::cerr << "[FAIL] " << message << std::endl;
+    std::exit(1);
+  }
+}
+
+void TestSlotStreamReadsInPlace() {
+  const char slot[] = "JPEGDATA";
+  FtpSlotIStream stream;
+  stream.reset(slot, 8);
+
+  char out[8] = {0};
+  stream.read(out, 5);
+  Expect(stream.gcount() == 5, "slot stream should read requested bytes");
+  Expect(std::string(out, 5) == "JPEGD", "slot stream should return slot bytes in order");
+
+  stream.read(out, 8);
+  Expect(stream.gcount() == 3, "slot stream should stop at used length");
+  Expect(stream.eof(), "slot stream should report eof after used length");
+}
+
+void TestSlotStreamSeekAndReuse() {
+  const char first[] = "0123456789";
+  FtpSlotIStream stream;
+  stream.reset(first, 10);
+
+  stream.seekg(0, std::ios_base::end);
+  Expect(stream.tellg() == std::streampos(10), "seek to end should report used length");
+  stream.seekg(4);
+  Expect(stream.get() == '4', "absolute seek should reposition inside slot");
+  stream.seekg(11);
+  Expect(stream.fail(), "seek past used length should fail");
+
+  const char second[] = "ab";
+  stream.reset(second, 2);
+  Expect(stream.good(), "reset should clear previous stream state");
+  Expect(stream.get() == 'a', "reset should rebind stream to new slot");
+}
+
+void TestSlotRingKeepsOrderPerDirectory() {
+  FtpSlotRing ring(4);
+  const uint32_t dir_a = FtpSlotRing::orderKey("2026_04_24");
+  const uint32_t dir_b = FtpSlotRing::orderKey("custom");
+
+  ring.commitWrite(dir_a);
+  ring.commitWrite(dir_a);
+  ring.commitWrite(dir_b);
+
+  const size_t first = ring.claim();
+  const size_t second = ring.claim();
+  Expect(first == 0, "first claim should take the oldest slot");
+  Expect(second == 2, "second claim should skip the busy directory and take another directory");
+  Expect(ring.claim() == FtpSlotRing::kInvalidSlot, "same directory should wait for its in-flight upload");
+
+  ring.complete(second);
+  Expect(ring.size() == 3, "out-of-order completion should not retire slots before older ones");
+  ring.complete(first);
+  Expect(ring.size() == 2, "completing the oldest slot should retire it but keep the pending slot behind it");
+  Expect(ring.claim() == 1, "next slot of the directory should be claimable after the previous one finished");
+}
+
+void TestSlotRingReleaseRetriesAndDrain() {
+  FtpSlotRing ring(2);
+  ring.commitWrite(1);
+  ring.commitWrite(1);
+  Expect(ring.full(), "ring should be full at depth");
+  Expect(ring.beginWrite() == FtpSlotRing::kInvalidSlot, "full ring should reject writes");
+
+  const size_t slot = ring.claim();
+  ring.release(slot);
+  Expect(ring.claim() == slot, "released slot should be retried before newer slots of its directory");
+
+  Expect(ring.drainReady() == 1, "drain should only drop slots that are not in flight");
+  Expect(ring.size() == 2, "drained slot behind an in-flight slot should wait for in-order retirement");
+  ring.complete(slot);
+  Expect(ring.empty(), "ring should be empty after in-flight slot completes");
+  Expect(ring.beginWrite() == 0, "ring should wrap around after retirement");
+}
+
+void TestSlotRingOverflowPolicies() {
+  FtpSlotRing ring(2);
+  Expect(ring.oldest() == FtpSlotRing::kInvalidSlot, "an empty ring should have no oldest slot");
+  ring.commitWrite(1);
+  ring.commitWrite(2);
+  Expect(ring.oldest() == 0, "oldest should name the slot drop-oldest would evict");
+
+  Expect(ring.beginWrite(FTP_OVERFLOW_DROP_NEWEST) == FtpSlotRing::kInvalidSlot,
+         "drop-newest should reject the new frame when full");
+
+  const size_t slot = ring.beginWrite(FTP_OVERFLOW_DROP_OLDEST);
+  Expect(slot == 0, "drop-oldest should reuse the evicted oldest slot");
+  ring.commitWrite(3);
+  Expect(ring.claim() == 1, "evicted slot should never be handed to a consumer");
+  Expect(ring.oldest() == 1, "oldest should move past the evicted slot");
+
+  Expect(ring.beginWrite(FTP_OVERFLOW_DROP_OLDEST) == FtpSlotRing::kInvalidSlot,
+         "drop-oldest should not evict a slot that is being uploaded");
+  Expect(ring.beginWrite(FTP_OVERFLOW_BLOCK, 5) == FtpSlotRing::kInvalidSlot,
+         "block policy should give up after its timeout");
+
+  const FtpSlotRingStats stats = ring.stats();
+  Expect(stats.enqueued == 3, "stats should count published frames");
+  Expect(stats.dropped_newest == 2, "stats should count rejected frames");
+  Expect(stats.dropped_oldest == 1, "stats should count evicted frames");
+  Expect(stats.block_timeouts == 1, "stats should count block timeouts");
+  Expect(stats.high_water == 2, "stats should record the high-water mark");
+  Expect(stats.in_flight == 1, "stats should report slots being uploaded");
+}
+
+void TestSlotRingSpscConcurrent() {
+  const uint32_t kFrames = 20000;
+  FtpSlotRing ring(6);
+  std::vector<uint32_t> slots(6, 0);
+  std::atomic<bool> done(false);
+  uint32_t received = 0;
+  bool ordered = true;
+
+  std::thread consumer([&]() {
+    while (!done || !ring.empty()) {
+      const size_t slot = ring.claim();
+      if (slot == FtpSlotRing::kInvalidSlot) {
+        std::this_thread::yield();
+        continue;
+      }
+      if (slots[slot] != received) {
+        ordered = false;
+      }
+      ++received;
+      ring.complete(slot);
+    }
+  });
+
+  for (uint32_t frame = 0; frame < kFrames; ++frame) {
+    const size_t slot = ring.beginWrite(FTP_OVERFLOW_BLOCK, 1000);
+    Expect(slot != FtpSlotRing::kInvalidSlot, "blocking producer should get a slot while consumer drains");
+    slots[slot] = frame;
+    ring.commitWrite(7);
+  }
+  done = true;
+  consumer.join();
+
+  Expect(received == kFrames, "consumer should receive every frame");
+  Expect(ordered, "frames of one directory should arrive in enqueue order");
+}
+
+void TestSlotRingByteCapacity() {
+  FtpSlotRing ring(16, 1024);
+  Expect(!ring.fits(1025), "a payload larger than the buffer should never fit");
+  Expect(ring.beginWrite(FTP_OVERFLOW_BLOCK, 1000, 2000) == FtpSlotRing::kInvalidSlot,
+         "an oversized payload should be dropped without waiting");
+
+  for (size_t frame = 0; frame < 3; ++frame) {
+    const size_t slot = ring.beginWrite(FTP_OVERFLOW_DROP_NEWEST, 0, 300);
+    Expect(slot == frame, "payloads should take consecutive slots");
+    Expect(ring.offsetOf(slot) == frame * 320, "payloads should be packed at aligned offsets");
+    ring.commitWrite(static_cast<uint32_t>(frame));
+  }
+  Expect(ring.usedBytes() == 960, "used bytes should cover the aligned payloads");
+  Expect(!ring.full() && !ring.fits(100), "the buffer should run out before the slots do");
+  Expect(ring.beginWrite(FTP_OVERFLOW_DROP_NEWEST, 0, 100) == FtpSlotRing::kInvalidSlot,
+         "drop-newest should reject a payload that does not fit");
+
+  ring.complete(ring.claim());
+  size_t slot = ring.beginWrite(FTP_OVERFLOW_DROP_NEWEST, 0, 100);
+  Expect(slot == 3 && ring.offsetOf(slot) == 0, "a payload past the end of the buffer should wrap to 0");
+  ring.commitWrite(3);
+  Expect(ring.usedBytes() == 1024 - 320 + 128, "used bytes should include the skipped end of the buffer");
+
+  slot = ring.beginWrite(FTP_OVERFLOW_DROP_OLDEST, 0, 500);
+  Expect(slot == 4 && ring.offsetOf(slot) == 128, "drop-oldest should evict just enough payloads");
+  ring.commitWrite(4);
+
+  Expect(ring.claim() == 2, "the oldest remaining payload should be claimed first");
+  Expect(ring.beginWrite(FTP_OVERFLOW_DROP_OLDEST, 0, 1000) == FtpSlotRing::kInvalidSlot,
+         "drop-oldest should not evict a payload that is being uploaded");
+  ring.complete(2);
+  ring.complete(ring.claim());
+  ring.complete(ring.claim());
+  Expect(ring.empty() && ring.usedBytes() == 0, "retired payloads should free the buffer");
+  slot = ring.beginWrite(FTP_OVERFLOW_DROP_NEWEST, 0, 1000);
+  Expect(ring.offsetOf(slot) == 0, "an empty buffer should start again at offset 0");
+
+  const FtpSlotRingStats stats = ring.stats();
+  Expect(stats.capacity_bytes == 1024, "stats should report the buffer size");
+  Expect(stats.high_water_bytes == 1024, "stats should record a completely filled buffer");
+  Expect(stats.dropped_newest == 3 && stats.dropped_oldest == 1, "stats should count byte overflows");
+}
+
+void TestSlotRingBytesSpscConcurrent() {
+  const uint32_t kFrames = 20000;
+  const size_t kCapacity = 4096;
+  FtpSlotRing ring(32, kCapacity);
+  std::vector<uint8_t> buffer(kCapacity, 0);
+  std::vector<uint32_t> frames(32, 0);
+  std::vector<size_t> sizes(32, 0);
+  std::atomic<bool> done(false);
+  uint32_t received = 0;
+  bool intact = true;
+
+  std::thread consumer([&]() {
+    while (!done || !ring.empty()) {
+      const size_t slot = ring.claim();
+      if (slot == FtpSlotRing::kInvalidSlot) {
+        std::this_thread::yield();
+        continue;
+      }
+      const uint8_t *payload = &buffer[ring.offsetOf(slot)];
+      if (frames[slot] != received) {
+        intact = false;
+      }
+      for (size_t i = 0; i < sizes[slot]; ++i) {
+        if (payload[i] != static_cast<uint8_t>(frames[slot] + i)) {
+          intact = false;
+          break;
+        }
+      }
+      ++received;
+      ring.complete(slot);
+    }
+  });
+
+  for (uint32_t frame = 0; frame < kFrames; ++frame) {
+    const size_t bytes = (frame * 37) % 900 + 1;
+    const size_t slot = ring.beginWrite(FTP_OVERFLOW_BLOCK, 1000, bytes);
+    Expect(slot != FtpSlotRing::kInvalidSlot, "blocking producer should get payload space while consumer drains");
+    const size_t offset = ring.offsetOf(slot);
+    Expect(offset + bytes <= kCapacity, "a payload should lie inside the buffer");
+    for (size_t i = 0; i < bytes; ++i) {
+      buffer[offset + i] = static_cast<uint8_t>(frame + i);
+    }
+    frames[slot] = frame;
+    sizes[slot] = bytes;
+    ring.commitWrite(7);
+  }
+  done = true;
+  consumer.join();
+
+  Expect(received == kFrames, "consumer should receive every payload");
+  Expect(intact, "payloads should arrive in order and never be overwritten while queued");
+}
+
+void TestSlotRingEvictRacesClaim() {
+  FtpSlotRing ring(8, 1024);
+  for (uint32_t frame = 0; frame < 3; ++frame) {
+    ring.beginWrite(FTP_OVERFLOW_DROP_NEWEST, 0, 100);
+    ring.commitWrite(frame);
+  }
+  Expect(!ring.evictOldest(1), "eviction should refuse a slot that is no longer the tail");
+  Expect(ring.claim() == 0, "the tail should be claimable");
+  Expect(!ring.evictOldest(0), "eviction should refuse a tail that is being uploaded");
+  ring.complete(0);
+  Expect(ring.evictOldest(1) && ring.oldest() == 2, "eviction should take the named tail");
+
+  // The producer evicts the tail it saw while a consumer claims slots; every
+  // frame must end up either evicted or uploaded, never both.
+  const uint32_t kFrames = 20000;
+  FtpSlotRing shared(16, 4096);
+  std::vector<std::atomic<int>> outcome(kFrames);
+  std::vector<uint32_t> frames(16, 0);
+  std::atomic<bool> done(false);
+  for (auto &value : outcome) {
+    value = 0;
+  }
+
+  std::thread consumer([&]() {
+    while (!done || !shared.empty()) {
+      const size_t slot = shared.claim();
+      if (slot == FtpSlotRing::kInvalidSlot) {
+        std::this_thread::yield();
+        continue;
+      }
+      outcome[frames[slot]]++;
+      shared.complete(slot);
+    }
+  });
+
+  for (uint32_t frame = 0; frame < kFrames; ++frame) {
+    size_t slot = FtpSlotRing::kInvalidSlot;
+    while ((slot = shared.beginWrite(FTP_OVERFLOW_DROP_NEWEST, 0, 300)) == FtpSlotRing::kInvalidSlot) {
+      const size_t oldest = shared.oldest();
+      if (oldest != FtpSlotRing::kInvalidSlot) {
+        const uint32_t victim = frames[oldest];
+        if (shared.evictOldest(oldest)) {
+          outcome[victim]++;
+        }
+      }
+    }
+    frames[slot] = frame;
+    shared.commitWrite(frame % 5);
+  }
+  done = true;
+  consumer.join();
+
+  bool once = true;
+  for (const auto &value : outcome) {
+    once = once && value == 1;
+  }
+  Expect(once, "each frame should be either evicted or uploaded exactly once");
+}
+
+void TestSlotRingPublishesInReservationOrder() {
+  FtpSlotRing ring(4, 1024);
+  const size_t first = ring.beginWrite(FTP_OVERFLOW_DROP_NEWEST, 0, 100);
+  const size_t second = ring.beginWrite(FTP_OVERFLOW_DROP_NEWEST, 0, 100);
+  Expect(first == 0 && second == 1, "outstanding reservations should take consecutive slots");
+  Expect(ring.offsetOf(second) == 128, "a second reservation should not overlap the first payload");
+  Expect(ring.usedBytes() == 256, "reserved payloads should count as used bytes");
+
+  ring.commitWrite(second, 2);
+  Expect(ring.empty() && ring.claim() == FtpSlotRing::kInvalidSlot,
+         "a slot filled ahead of an older reservation should stay hidden");
+  ring.commitWrite(first, 1);
+  Expect(ring.size() == 2, "committing the oldest reservation should publish both slots");
+  Expect(ring.claim() == first && ring.claim() == second, "slots should be published in reservation order");
+  Expect(ring.stats().enqueued == 2, "stats should count each published frame once");
+
+  FtpSlotRing slots(2);
+  slots.beginWrite();
+  slots.beginWrite();
+  Expect(slots.full() && slots.beginWrite() == FtpSlotRing::kInvalidSlot,
+         "reservations should count against the depth");
+}
+
+void TestSlotRingProducersFillOutsideLock() {
+  // Producers reserve and commit under one mutex but fill their payloads
+  // outside it; every frame must arrive intact and in order per producer.
+  const uint32_t kProducers = 3;
+  const uint32_t kFrames = 10000;
+  const size_t kCapacity = 4096;
+  FtpSlotRing ring(16, kCapacity);
+  std::vector<uint8_t> buffer(kCapacity, 0);
+  std::vector<uint32_t> frames(16, 0);
+  std::vector<size_t> sizes(16, 0);
+  std::vector<uint32_t> next(kProducers, 0);
+  std::mutex produce;
+  std::atomic<uint32_t> finished(0);
+  uint32_t received = 0;
+  bool intact = true;
+
+  std::thread consumer([&]() {
+    while (finished < kProducers || !ring.empty()) {
+      const size_t slot = ring.claim();
+      if (slot == FtpSlotRing::kInvalidSlot) {
+        std::this_thread::yield();
+        continue;
+      }
+      const uint32_t producer = frames[slot] % kProducers;
+      const uint8_t *payload = &buffer[ring.offsetOf(slot)];
+      if (frames[slot] / kProducers != next[producer]++) {
+        intact = false;
+      }
+      for (size_t i = 0; i < sizes[slot]; ++i) {
+        if (payload[i] != static_cast<uint8_t>(frames[slot] + i)) {
+          intact = false;
+          break;
+        }
+      }
+      ++received;
+      ring.complete(slot);
+    }
+  });
+
+  std::vector<std::thread> producers;
+  for (uint32_t producer = 0; producer < kProducers; ++producer) {
+    producers.emplace_back([&, producer]() {
+      for (uint32_t index = 0; index < kFrames; ++index) {
+        const uint32_t frame = index * kProducers + producer;
+        const size_t bytes = (frame * 37) % 700 + 1;
+        size_t slot = FtpSlotRing::kInvalidSlot;
+        while (slot == FtpSlotRing::kInvalidSlot) {
+          {
+            std::lock_guard<std::mutex> lock(produce);
+            slot = ring.beginWrite(FTP_OVERFLOW_DROP_NEWEST, 0, bytes);
+          }
+          if (slot == FtpSlotRing::kInvalidSlot) {
+            std::this_thread::yield();
+          }
+        }
+        const size_t offset = ring.offsetOf(slot);
+        for (size_t i = 0; i < bytes; ++i) {
+          buffer[offset + i] = static_cast<uint8_t>(frame + i);
+        }
+        frames[slot] = frame;
+        sizes[slot] = bytes;
+        std::lock_guard<std::mutex> lock(produce);
+        ring.commitWrite(slot, producer);
+      }
+      finished++;
+    });
+  }
+  for (auto &thread : producers) {
+    thread.join();
+  }
+  consumer.join();
+
+  Expect(received == kProducers * kFrames, "consumer should receive every payload");
+  Expect(intact, "payloads filled outside the lock should arrive intact and in order per producer");
+}
+
+void TestDirCacheLruAndCounters() {
+  FtpDirCache cache(2);
+  Expect(!cache.lookup("/img/a"), "empty cache should miss");
+  cache.insert("/img/a");
+  cache.insert("/img/b");
+  Expect(cache.lookup("/img/a"), "inserted directory should hit");
+
+  cache.insert("/img/c");
+  Expect(cache.size() == 2, "cache should stay within capacity");
+  Expect(!cache.contains("/img/b"), "least recently used directory should be evicted");
+  Expect(cache.contains("/img/a") && cache.contains("/img/c"), "recently used directories should stay");
+  Expect(cache.hits() == 1 && cache.misses() == 1, "lookup should count hits and misses");
+
+  cache.clear();
+  Expect(cache.size() == 0 && !cache.contains("/img/a"), "clear should drop every directory");
+  Expect(cache.hits() == 1, "clear should keep the counters");
+}
+
+void TestDirCachePaths() {
+  Expect(FtpDirCache::joinPath("/home/ftp", "images/2026_04_24") == "/home/ftp/images/2026_04_24",
+         "join should append relative segments");
+  Expect(FtpDirCache::joinPath("/home/ftp/", "./a//b/") == "/home/ftp/a/b",
+         "join should skip empty and dot segments");
+  Expect(FtpDirCache::joinPath("/", "") == "/", "join of root should stay root");
+  Expect(FtpDirCache::joinPath("", "a") == "/a", "empty base should be treated as root");
+  Expect(FtpDirCache::parentPath("/home/ftp/a") == "/home/ftp", "parent should drop the last segment");
+  Expect(FtpDirCache::parentPath("/home") == "/", "parent of a top-level directory should be root");
+}
+
+uint32_t ReadLe32(const std::string &data, size_t offset) {
+  return static_cast<uint8_t>(data[offset]) | (static_cast<uint8_t>(data[offset + 1]) << 8) |
+         (static_cast<uint8_t>(data[offset + 2]) << 16) |
+         (static_cast<uint32_t>(static_cast<uint8_t>(data[offset + 3])) << 24);
+}
+
+std::string ReferenceBmpPixels(const std::vector<uint8_t> &frame, uint32_t width, uint32_t height,
+                               bool planar_rgb) {
+  const uint32_t channels = planar_rgb ? 3 : 1;
+  const uint32_t stride = (width * channels + 3) / 4 * 4;
+  const size_t plane = static_cast<size_t>(width) * height;
+  std::string pixels(static_cast<size_t>(stride) * height, '\0');
+  for (uint32_t row = 0; row < height; ++row) {
+    const size_t src = static_cast<size_t>(height - 1 - row) * width;
+    for (uint32_t x = 0; x < width; ++x) {
+      if (planar_rgb) {
+        pixels[row * stride + x * 3 + 0] = static_cast<char>(frame[2 * plane + src + x]);
+        pixels[row * stride + x * 3 + 1] = static_cast<char>(frame[plane + src + x]);
+        pixels[row * stride + x * 3 + 2] = static_cast<char>(frame[src + x]);
+      } else {
+        pixels[row * stride + x] = static_cast<char>(frame[src + x]);
+      }
+    }
+  }
+  return pixels;
+}
+
+std::string ReadAll(std::istream &stream, size_t chunk) {
+  std::string out;
+  std::vector<char> buf(chunk);
+  while (stream.read(&buf[0], chunk) || stream.gcount() > 0) {
+    out.append(&buf[0], static_cast<size_t>(stream.gcount()));
+  }
+  return out;
+}
+
+void TestBmpStreamMatchesReference() {
+  const uint32_t widths[] = {1, 15, 16, 17, 33, 333};
+  const uint32_t heights[] = {1, 3, 250};
+  for (size_t wi = 0; wi < sizeof(widths) / sizeof(widths[0]); ++wi) {
+    for (size_t hi = 0; hi < sizeof(heights) / sizeof(heights[0]); ++hi) {
+      for (int planar = 0; planar < 2; ++planar) {
+        const uint32_t width = widths[wi];
+        const uint32_t height = heights[hi];
+        std::vector<uint8_t> frame(static_cast<size_t>(width) * height * (planar ? 3 : 1));
+        for (size_t i = 0; i < frame.size(); ++i) {
+          frame[i] = static_cast<uint8_t>(i * 7 + i / 13);
+        }
+
+        FtpBmpIStream stream;
+        Expect(stream.reset(&frame[0], frame.size(), width, height, planar != 0),
+               "bmp stream should accept a complete frame");
+        const std::string bmp = ReadAll(stream, 4093);
+        const size_t header = 54 + (planar ? 0 : 1024);
+
+        Expect(bmp.size() == stream.fileSize(), "bmp stream should produce exactly fileSize bytes");
+        Expect(bmp[0] == 'B' && bmp[1] == 'M', "bmp stream should start with the BM signature");
+        Expect(ReadLe32(bmp, 2) == bmp.size(), "bmp header should carry the file size");
+        Expect(ReadLe32(bmp, 10) == header, "bmp header should point at the pixel data");
+        Expect(ReadLe32(bmp, 18) == width && ReadLe32(bmp, 22) == height,
+               "bmp header should carry the image size");
+        Expect(bmp.substr(header) == ReferenceBmpPixels(frame, width, height, planar != 0),
+               "bmp rows should be bottom-up, padded and BGR for planar input");
+      }
+    }
+  }
+}
+
+void TestBmpStreamSeekAndRetry() {
+  const uint32_t width = 301;
+  const uint32_t height = 240;
+  std::vector<uint8_t> frame(static_cast<size_t>(width) * height * 3);
+  for (size_t i = 0; i < frame.size(); ++i) {
+    frame[i] = static_cast<uint8_t>(i ^ (i >> 8));
+  }
+  const std::vector<uint8_t> original = frame;
+
+  FtpBmpIStream stream;
+  Expect(!stream.reset(&frame[0], frame.size() - 1, width, height, true),
+         "bmp stream should reject a short frame");
+  Expect(stream.reset(&frame[0], frame.size(), width, height, true), "bmp stream should reset after a failure");
+  const std::string first = ReadAll(stream, 65536);
+
+  stream.clear();
+  stream.seekg(0, std::ios_base::end);
+  Expect(stream.tellg() == std::streampos(first.size()), "seek to end should report the bmp size");
+  stream.seekg(100000);
+  Expect(stream.get() == static_cast<uint8_t>(first[100000]), "absolute seek should land inside a later strip");
+  stream.seekg(10);
+  Expect(stream.get() == static_cast<uint8_t>(first[10]), "seek back into the header should work");
+
+  stream.seekg(0);
+  Expect(ReadAll(stream, 777) == first, "rewound stream should reproduce the same bmp");
+  Expect(frame == original, "encoding should not modify the source frame");
+}
+
+void TestHistogramPercentiles() {
+  FtpHistogram histogram;
+  for (uint64_t value = 1; value <= 100; ++value) {
+    histogram.record(value);
+  }
+  histogram.record(0);
+
+  const FtpHistogramSummary summary = histogram.summary();
+  Expect(summary.count == 101, "histogram should count every sample");
+  Expect(summary.sum == 5050, "histogram should sum samples");
+  Expect(summary.max == 100, "histogram should track the max");
+  Expect(summary.p50 >= 50 && summary.p50 < 100, "p50 should land in the bucket holding the median");
+  Expect(summary.p99 == 100, "p99 should be clamped to the max");
+
+  histogram.reset();
+  Expect(histogram.summary().count == 0 && histogram.summary().p50 == 0, "reset should clear the histogram");
+}
+
+void TestUploadStatsConcurrentAndJson() {
+  FtpUploadStats stats;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.push_back(std::thread([&stats]() {
+      for (int i = 0; i < 10000; ++i) {
+        stats.recordStage(FTP_STAGE_TRANSFER, static_cast<uint64_t>(i));
+        stats.increment(FTP_COUNTER_UPLOADS);
+      }
+    }));
+  }
+  for (size_t t = 0; t < threads.size(); ++t) {
+    threads[t].join();
+  }
+  Expect(stats.counter(FTP_COUNTER_UPLOADS) == 40000, "counters should not lose concurrent increments");
+  Expect(stats.stage(FTP_STAGE_TRANSFER).summary().count == 40000,
+         "histograms should not lose concurrent samples");
+
+  stats.recordThroughput(1000000, 500000);
+  Expect(stats.counter(FTP_COUNTER_BYTES) == 1000000, "throughput should add to the byte counter");
+  Expect(stats.throughput().summary().max == 2000000, "throughput should be recorded in bytes per second");
+
+  char json[1024];
+  const int len = stats.formatJson(json, sizeof(json));
+  const std::string text(json, static_cast<size_t>(len));
+  Expect(text.find("\"uploads\":40000") != std::string::npos, "json should carry counters");
+  Expect(text.find("\"transfer_us\":{\"count\":40000") != std::string::npos, "json should carry stage histograms");
+  Expect(text.front() == '{' && text.back() == '}', "json should be one object");
+
+  char small[16];
+  Expect(stats.formatJson(small, sizeof(small)) == 15 && small[15] == '\0', "json should truncate safely");
+}
+
+void TestBmpStreamReportsEncodeTime() {
+  const uint32_t width = 640;
+  const uint32_t height = 480;
+  std::vector<uint8_t> frame(width * height * 3, 7);
+  FtpBmpIStream stream;
+  Expect(stream.reset(&frame[0], frame.size(), width, height, true), "bmp stream should accept frame");
+
+  std::vector<char> out(static_cast<size_t>(stream.fileSize()));
+  stream.read(&out[0], static_cast<std::streamsize>(out.size()));
+  Expect(stream.encodeNs() > 0, "bmp stream should accumulate encode time");
+
+  stream.reset(&frame[0], frame.size(), width, height, true);
+  Expect(stream.encodeNs() == 0, "reset should clear encode time");
+}
+
+void TestWakeupEpochAndTimeout() {
+  FtpWakeup wakeup;
+  const uint64_t seen = wakeup.epoch();
+  wakeup.notify();
+  Expect(wakeup.waitUntil(seen, FtpWakeup::kNoDeadline), "a notify after the epoch snapshot should not be lost");
+
+  const uint64_t idle = wakeup.epoch();
+  const uint64_t start = FtpUploadStats::nowUs();
+  Expect(!wakeup.waitUntil(idle, start + 20000), "wait should time out without notify");
+  const uint64_t waited = FtpUploadStats::nowUs() - start;
+  Expect(waited >= 20000 && waited < 1000000, "wait should end at the deadline");
+  Expect(!wakeup.waitUntil(idle, start), "a past deadline should return at once");
+}
+
+void TestWakeupCrossThread() {
+  FtpWakeup wakeup;
+  std::atomic<uint64_t> produced(0);
+  std::atomic<bool> timed_out(false);
+  const uint64_t kItems = 20000;
+
+  // The consumer only sleeps with an unbounded-looking deadline; a lost
+  // wakeup shows up as a timeout instead of a hang.
+  std::thread consumer([&]() {
+    uint64_t consumed = 0;
+    while (consumed < kItems) {
+      const uint64_t seen = wakeup.epoch();
+      const uint64_t available = produced.load();
+      if (consumed < available) {
+        consumed = available;
+        continue;
+      }
+      if (!wakeup.waitUntil(seen, FtpUploadStats::nowUs() + 5000000) && produced.load() == consumed) {
+        timed_out = true;
+        return;
+      }
+    }
+  });
+  for (uint64_t i = 0; i < kItems; ++i) {
+    produced.fetch_add(1);
+    wakeup.notify();
+    if (i % 1000 == 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+  consumer.join();
+  Expect(!timed_out, "consumer should see every notify");
+
+  const uint64_t seen = wakeup.epoch();
+  uint64_t woke_at = 0;
+  std::thread waiter([&]() {
+    wakeup.waitUntil(seen, FtpWakeup::kNoDeadline);
+    woke_at = FtpUploadStats::nowUs();
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  const uint64_t notified_at = FtpUploadStats::nowUs();
+  wakeup.notify();
+  waiter.join();
+  Expect(woke_at >= notified_at && woke_at - notified_at < 100000, "notify should wake a blocked waiter promptly");
+}
+
+void TestBackoffGrowsWithJitter() {
+  FtpBackoff backoff(100000, 1000000, 7);
+  uint64_t ceiling_us = 100000;
+  for (int attempt = 0; attempt < 8; ++attempt) {
+    const uint64_t delay = backoff.next();
+    Expect(delay >= ceiling_us / 2 && delay <= ceiling_us, "delay should lie in [d/2, d] of the doubled base");
+    ceiling_us = std::min<uint64_t>(ceiling_us * 2, 1000000);
+  }
+  Expect(backoff.failures() == 8, "backoff should count consecutive failures");
+
+  backoff.reset();
+  Expect(backoff.next() <= 100000, "a reset should start again at the base delay");
+
+  FtpBackoff a(100000, 1000000, 1);
+  FtpBackoff b(100000, 1000000, 2);
+  bool differ = false;
+  for (int attempt = 0; attempt < 4; ++attempt) {
+    differ = differ || a.next() != b.next();
+  }
+  Expect(differ, "sessions with different seeds should not retry in lockstep");
+}
+
+void TestConnectProbe() {
+  const int listener = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = 0;
+  socklen_t len = sizeof(addr);
+  Expect(listener >= 0 && bind(listener, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0 &&
+             listen(listener, 4) == 0 && getsockname(listener, reinterpret_cast<sockaddr *>(&addr), &len) == 0,
+         "loopback listener should start");
+  const unsigned short port = ntohs(addr.sin_port);
+
+  std::string error;
+  Expect(FtpProbeConnect("127.0.0.1", port, 1000, &error), "probe should reach a listening server");
+  close(listener);
+
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  Expect(!FtpProbeConnect("127.0.0.1", port, 1000, &error) && !error.empty(),
+         "probe should fail with a reason when nothing listens");
+  Expect(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(500),
+         "a refused connection should fail without waiting for the timeout");
+  Expect(!FtpProbeConnect("", 21, 1000, &error), "probe should reject an empty address");
+}
+
+}  // namespace
+
+int main() {
+  TestSlotStreamReadsInPlace();
+  TestSlotStreamSeekAndReuse();
+  TestSlotRingKeepsOrderPerDirectory();
+  TestSlotRingReleaseRetriesAndDrain();
+  TestSlotRingOverflowPolicies();
+  TestSlotRingSpscConcurrent();
+  TestSlotRingByteCapacity();
+  TestSlotRingBytesSpscConcurrent();
+  TestSlotRingEvictRacesClaim();
+  TestSlotRingPublishesInReservationOrder();
+  TestSlotRingProducersFillOutsideLock();
+  TestDirCacheLruAndCounters();
+  TestDirCachePaths();
+  TestBmpStreamMatchesReference();
+  TestBmpStreamSeekAndRetry();
+  TestHistogramPercentiles();
+  TestUploadStatsConcurrentAndJson();
+  TestBmpStreamReportsEncodeTime();
+  TestWakeupEpochAndTimeout();
+  TestWakeupCrossThread();
+  TestBackoffGrowsWithJitter();
+  TestConnectProbe();
+  std::cout << "[PASS] ftptrans transport logic tests" << std::endl;
+  return 0;
+}
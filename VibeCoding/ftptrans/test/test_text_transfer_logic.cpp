@@ -35,10 +35,13 @@ void TestCountRetentionAndFieldExpansion() {
   cache.addRecord(MakeRecord(3, "2026_04_24_10_00_03", "last"));
 
   const TextSnapshot snapshot = cache.snapshot();
-  Expect(snapshot.records.size() == 2, "count retention should keep last two records");
-  Expect(snapshot.max_item_count == 3, "snapshot should track max expanded field count");
-  Expect(snapshot.records[0].items.size() == 3, "first retained record should keep three split items");
-  Expect(snapshot.records[1].items.size() == 1, "second retained record should keep one split item");
+  TextSnapshot::const_iterator it = snapshot.begin();
+  Expect(snapshot.size() == 2, "count retention should keep last two records");
+  Expect(snapshot.maxItemCount() == 3, "snapshot should track max expanded field count");
+  Expect((*it).itemCount() == 3, "first retained record should keep three split items");
+  Expect((*it).item(2) == "z", "split items should reference the record text");
+  ++it;
+  Expect((*it).itemCount() == 1, "second retained record should keep one split item");
 }
 
 void TestTimeRangeRetention() {
@@ -51,9 +54,11 @@ void TestTimeRangeRetention() {
   cache.addRecord(MakeRecord(20, "2026_04_24_10_00_20", "keep2"));
 
   const TextSnapshot snapshot = cache.snapshot();
-  Expect(snapshot.records.size() == 2, "time range retention should drop expired records");
-  Expect(snapshot.records[0].raw_text == "keep1", "time range should keep newer record");
-  Expect(snapshot.records[1].raw_text == "keep2", "time range should keep latest record");
+  TextSnapshot::const_iterator it = snapshot.begin();
+  Expect(snapshot.size() == 2, "time range retention should drop expired records");
+  Expect((*it).rawText() == "keep1", "time range should keep newer record");
+  ++it;
+  Expect((*it).rawText() == "keep2", "time range should keep latest record");
 }
 
 void TestCsvSerializationWithTimestamp() {
@@ -107,6 +112,190 @@ void TestRefreshStepAndFinalFlush() {
   Expect(!controller.onStopRequested(), "second stop without new records should not trigger upload");
 }
 
+TextUploadPlan PlanFor(const TextUploadController &controller, const TextResultCache &cache,
+                       TextFileFormat format) {
+  return controller.planUpload("result.csv", format, false, cache.firstSequence(),
+                               cache.endSequence(), cache.maxItemCount());
+}
+
+void TestAppendPlanOnlySerializesNewRecords() {
+  TextResultCache cache(10);
+  TextUploadController controller;
+  controller.setUploadMode(TEXT_UPLOAD_APPEND);
+  cache.addRecord(MakeRecord(1, "t1", "a;b"));
+
+  TextUploadPlan plan = PlanFor(controller, cache, TEXT_FILE_FORMAT_CSV);
+  Expect(!plan.append, "first upload should rewrite the whole file");
+  const std::string full = TextResultSerializer::serializeAppendable(
+      cache.snapshot(), TEXT_FILE_FORMAT_CSV, false, plan.column_count, true);
+  Expect(full == "col1,col2\r\na,b\r\n", "full appendable csv should carry the header");
+  controller.onUploadCommitted("result.csv", plan);
+
+  cache.addRecord(MakeRecord(2, "t2", "c"));
+  plan = PlanFor(controller, cache, TEXT_FILE_FORMAT_CSV);
+  Expect(plan.append && plan.begin_sequence == 1, "later uploads should append from the remote end");
+  const std::string tail = TextResultSerializer::serializeAppendable(
+      cache.snapshotFrom(plan.begin_sequence), TEXT_FILE_FORMAT_CSV, false, plan.column_count, false);
+  Expect(tail == "c,\r\n", "appended csv rows should be padded to the uploaded header width");
+  controller.onUploadCommitted("result.csv", plan);
+
+  cache.addRecord(MakeRecord(3, "t3", "x;y;z"));
+  Expect(!PlanFor(controller, cache, TEXT_FILE_FORMAT_CSV).append,
+         "a wider csv row should force a rewrite with a new header");
+  Expect(PlanFor(controller, cache, TEXT_FILE_FORMAT_TXT).append, "txt has no header to outgrow");
+  Expect(!controller.planUpload("other.csv", TEXT_FILE_FORMAT_TXT, false, cache.firstSequence(),
+                                cache.endSequence(), cache.maxItemCount()).append,
+         "a renamed remote file should be rewritten");
+  Expect(!controller.planUpload("result.csv", TEXT_FILE_FORMAT_TXT, true, cache.firstSequence(),
+                                cache.endSequence(), cache.maxItemCount()).append,
+         "a timestamp layout change should rewrite the file");
+}
+
+void TestAppendFallsBackAfterHeadTrim() {
+  TextResultCache cache(10);
+  cache.setRetentionCount(2);
+  TextUploadController controller;
+  controller.setUploadMode(TEXT_UPLOAD_APPEND);
+  cache.addRecord(MakeRecord(1, "t1", "a"));
+  cache.addRecord(MakeRecord(2, "t2", "b"));
+  controller.onUploadCommitted("result.csv", PlanFor(controller, cache, TEXT_FILE_FORMAT_TXT));
+
+  cache.addRecord(MakeRecord(3, "t3", "c"));
+  const TextUploadPlan plan = PlanFor(controller, cache, TEXT_FILE_FORMAT_TXT);
+  Expect(!plan.append && plan.begin_sequence == 1, "trimming the head should force a full rewrite");
+}
+
+void TestAppendCommitIgnoredAfterReset() {
+  TextResultCache cache(10);
+  TextUploadController controller;
+  controller.setUploadMode(TEXT_UPLOAD_APPEND);
+  cache.addRecord(MakeRecord(1, "t1", "a"));
+
+  const TextUploadPlan stale = PlanFor(controller, cache, TEXT_FILE_FORMAT_TXT);
+  controller.reset();
+  controller.onUploadCommitted("result.csv", stale);
+  Expect(!PlanFor(controller, cache, TEXT_FILE_FORMAT_TXT).append,
+         "an upload planned before a reset should not validate the remote file");
+
+  controller.onUploadCommitted("result.csv", PlanFor(controller, cache, TEXT_FILE_FORMAT_TXT));
+  controller.invalidateRemote();
+  cache.addRecord(MakeRecord(2, "t2", "b"));
+  Expect(!PlanFor(controller, cache, TEXT_FILE_FORMAT_TXT).append,
+         "a failed upload should force the next one to rewrite");
+
+  TextUploadController rewrite;
+  rewrite.onUploadCommitted("result.csv", PlanFor(rewrite, cache, TEXT_FILE_FORMAT_TXT));
+  Expect(!PlanFor(rewrite, cache, TEXT_FILE_FORMAT_TXT).append, "full rewrite mode should never append");
+}
+
+void TestJsonLinesFraming() {
+  TextResultCache cache(10);
+  cache.addRecord(MakeRecord(1, "t1", "a"));
+  cache.addRecord(MakeRecord(2, "t2", "b;c"));
+
+  const std::string lines = TextResultSerializer::serializeAppendable(
+      cache.snapshot(), TEXT_FILE_FORMAT_JSON, true, 0, true);
+  const std::string expected =
+      "{\"timestamp\":\"t1\",\"item1\":\"a\"}\n"
+      "{\"timestamp\":\"t2\",\"item1\":\"b\",\"item2\":\"c\"}\n";
+  Expect(lines == expected, "appendable json should be one object per line");
+  Expect(TextResultSerializer::extension(TEXT_FILE_FORMAT_JSON, TEXT_UPLOAD_APPEND) == ".jsonl",
+         "json lines should use the jsonl extension");
+  Expect(TextResultSerializer::extension(TEXT_FILE_FORMAT_JSON) == ".json",
+         "full rewrite json should keep the json extension");
+}
+
+void TestSnapshotIsImmutableAcrossSegments() {
+  TextResultCache cache(10000);
+  cache.setRetentionCount(1500);
+  for (int idx = 0; idx < 1200; ++idx) {
+    cache.addRecord(MakeRecord(idx, "ts", std::to_string(idx) + ";x"));
+  }
+
+  const TextSnapshot before = cache.snapshot();
+  for (int idx = 1200; idx < 3000; ++idx) {
+    cache.addRecord(MakeRecord(idx, "ts", std::to_string(idx)));
+  }
+  cache.clear();
+  cache.addRecord(MakeRecord(4000, "ts", "after"));
+
+  Expect(before.size() == 1200, "snapshot size should not change after the cache moves on");
+  int expected = 0;
+  bool ordered = true;
+  for (TextSnapshot::const_iterator it = before.begin(); it != before.end(); ++it, ++expected) {
+    ordered = ordered && (*it).rawText() == std::to_string(expected) + ";x" &&
+              (*it).timestampSec() == expected;
+  }
+  Expect(ordered && expected == 1200, "snapshot should keep its records across segment boundaries");
+  Expect(cache.size() == 1 && cache.firstSequence() == 3000, "sequences should continue after clear");
+}
+
+void TestMaxItemCountFollowsWindow() {
+  TextResultCache cache(10);
+  cache.setRetentionCount(2);
+  cache.addRecord(MakeRecord(1, "t1", "a;b;c;d"));
+  cache.addRecord(MakeRecord(2, "t2", "a;b"));
+  Expect(cache.maxItemCount() == 4, "max item count should include the widest cached record");
+  cache.addRecord(MakeRecord(3, "t3", "a"));
+  Expect(cache.maxItemCount() == 2, "max item count should drop once the widest record is trimmed");
+  Expect(cache.snapshotFrom(2).maxItemCount() == 1, "suffix snapshot should report its own max");
+  Expect(cache.snapshotFrom(0).size() == 2, "snapshotFrom should clamp to the cached range");
+}
+
+void TestOversizedRecordGetsItsOwnSegment() {
+  TextResultCache cache(10);
+  const std::string big(TextResultCache::kSegmentBytes * 2, 'q');
+  cache.addRecord(MakeRecord(1, "t1", "small"));
+  cache.addRecord(MakeRecord(2, "t2", big));
+  cache.addRecord(MakeRecord(3, "t3", "tail"));
+
+  const std::string txt = TextResultSerializer::serialize(cache.snapshot(), TEXT_FILE_FORMAT_TXT, false);
+  Expect(txt == "small\r\n" + big + "\r\ntail\r\n", "records larger than a segment should be kept intact");
+}
+
+void TestEscaping() {
+  TextResultCache cache(10);
+  cache.addRecord(MakeRecord(1, "t1", "a,b;say \"hi\";x\\y\tz\x01"));
+
+  const std::string csv = TextResultSerializer::serialize(cache.snapshot(), TEXT_FILE_FORMAT_CSV, false);
+  Expect(csv == "col1,col2,col3\r\n\"a,b\",\"say \"\"hi\"\"\",x\\y\tz\x01\r\n",
+         "csv should quote fields with separators and double embedded quotes");
+
+  const std::string json = TextResultSerializer::serialize(cache.snapshot(), TEXT_FILE_FORMAT_JSON, false);
+  Expect(json == "[{\"item1\":\"a,b\",\"item2\":\"say \\\"hi\\\"\",\"item3\":\"x\\\\y\\tz\\u0001\"}]",
+         "json should escape quotes, backslashes and control characters");
+}
+
+void TestStreamingProducesBoundedBlocks() {
+  TextResultCache cache(5000);
+  cache.setRetentionCount(5000);
+  for (int idx = 0; idx < 5000; ++idx) {
+    cache.addRecord(MakeRecord(idx, "2026_04_24_10_00_00", "value;" + std::to_string(idx)));
+  }
+
+  const TextSnapshot snapshot = cache.snapshot();
+  const std::string expected = TextResultSerializer::serialize(snapshot, TEXT_FILE_FORMAT_JSON, true);
+  Expect(expected.size() > TextResultStreamBuf::kBlockBytes * 4, "fixture should span several blocks");
+
+  TextSerializeOptions options;
+  options.format = TEXT_FILE_FORMAT_JSON;
+  options.include_timestamp = true;
+  options.column_count = snapshot.maxItemCount();
+  TextResultIStream stream(snapshot, options);
+
+  Expect(stream.peek() == '[', "stream should start with the json prologue");
+  Expect(stream.bytesProduced() < TextResultStreamBuf::kBlockBytes * 2,
+         "first read should only serialize one block");
+
+  std::string streamed;
+  char chunk[1000];
+  while (stream.read(chunk, sizeof(chunk)) || stream.gcount() > 0) {
+    streamed.append(chunk, static_cast<size_t>(stream.gcount()));
+  }
+  Expect(streamed == expected, "chunked reads should match one-shot serialization");
+  Expect(stream.bytesProduced() == expected.size(), "stream should count produced bytes");
+}
+
 }  // namespace
 
 int main() {
@@ -116,6 +305,15 @@ int main() {
   TestJsonSerializationWithoutTimestamp();
   TestTxtSerializationWithTimestamp();
   TestRefreshStepAndFinalFlush();
+  TestAppendPlanOnlySerializesNewRecords();
+  TestAppendFallsBackAfterHeadTrim();
+  TestAppendCommitIgnoredAfterReset();
+  TestJsonLinesFraming();
+  TestSnapshotIsImmutableAcrossSegments();
+  TestMaxItemCountFollowsWindow();
+  TestOversizedRecordGetsItsOwnSegment();
+  TestEscaping();
+  TestStreamingProducesBoundedBlocks();
   std::cout << "[PASS] ftptrans text transfer logic tests" << std::endl;
   return 0;
 }
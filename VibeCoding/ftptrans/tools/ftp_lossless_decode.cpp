@@ -0,0 +1,98 @@
+// Decodes .fli files uploaded with TransportType=fli on the receiving side.
+//
+//   ftp_lossless_decode [-o out.bmp] in.fli [more.fli ...]
+//
+// Each input is written next to it as .bmp (the same file TransportType=bmp
+// would have uploaded) unless -o names the output of a single input.
+
+#include "../FtpBmpStream.h"
+#include "../FtpLosslessCodec.h"
+
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace {
+
+bool ReadFile(const std::string &path, std::vector<uint8_t> *data) {
+  std::ifstream in(path.c_str(), std::ios_base::binary);
+  if (!in) {
+    return false;
+  }
+  data->assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  return !in.bad();
+}
+
+std::string BmpPath(const std::string &path) {
+  const std::string::size_type dot = path.rfind('.');
+  const std::string::size_type slash = path.rfind('/');
+  if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+    return path + ".bmp";
+  }
+  return path.substr(0, dot) + ".bmp";
+}
+
+bool Convert(const std::string &in_path, const std::string &out_path) {
+  std::vector<uint8_t> coded;
+  if (!ReadFile(in_path, &coded)) {
+    std::cerr << in_path << ": cannot read" << std::endl;
+    return false;
+  }
+
+  FtpLosslessInfo info;
+  std::vector<uint8_t> pixels;
+  if (!FtpLosslessDecode(coded.empty() ? nullptr : &coded[0], coded.size(), &info, &pixels)) {
+    std::cerr << in_path << ": not a valid .fli file" << std::endl;
+    return false;
+  }
+
+  FtpBmpIStream bmp;
+  if (!bmp.reset(&pixels[0], pixels.size(), info.width, info.height, info.channels == 3)) {
+    std::cerr << in_path << ": frame too large for BMP" << std::endl;
+    return false;
+  }
+  std::ofstream out(out_path.c_str(), std::ios_base::binary | std::ios_base::trunc);
+  out << bmp.rdbuf();
+  out.close();
+  if (!out) {
+    std::cerr << out_path << ": write failed" << std::endl;
+    return false;
+  }
+
+  std::cout << in_path << " -> " << out_path << " (" << info.width << "x" << info.height
+            << (info.channels == 3 ? " rgb, " : " mono, ") << coded.size() << " -> " << bmp.fileSize()
+            << " bytes)" << std::endl;
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  std::string out_path;
+  std::vector<std::string> inputs;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "-o" && i + 1 < argc) {
+      out_path = argv[++i];
+    } else if (!arg.empty() && arg[0] == '-') {
+      inputs.clear();
+      break;
+    } else {
+      inputs.push_back(arg);
+    }
+  }
+  if (inputs.empty() || (!out_path.empty() && inputs.size() != 1)) {
+    std::cerr << "usage: " << argv[0] << " [-o out.bmp] in.fli [more.fli ...]" << std::endl;
+    return 2;
+  }
+
+  int failures = 0;
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    if (!Convert(inputs[i], out_path.empty() ? BmpPath(inputs[i]) : out_path)) {
+      ++failures;
+    }
+  }
+  return failures == 0 ? 0 : 1;
+}
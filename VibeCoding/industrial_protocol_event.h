@@ -0,0 +1,145 @@
+/** @file
+ * @brief Wakeup and poll pacing helpers for the industrial protocol trigger threads.
+ *
+ * ind_proto_event_t wakes a trigger thread from another thread (e.g. the
+ * protocol stack's register write callback) through an eventfd, so the state
+ * machine reacts as soon as the PLC writes instead of on its next sleep tick.
+ * ind_proto_poll_t paces a thread that has to poll the PLC itself: short
+ * intervals while a handshake is moving, backing off to the configured
+ * interval once it has been quiet for a while.
+ */
+
+#ifndef __INDUSTRIAL_PROTOCOL_EVENT_H
+#define __INDUSTRIAL_PROTOCOL_EVENT_H
+
+#include <stdint.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct
+{
+	int fd;		/* -1 until ind_proto_event_open succeeds */
+} ind_proto_event_t;
+
+#define IND_PROTO_EVENT_INITIALIZER { -1 }
+
+static inline uint64_t ind_proto_monotonic_ms(void)
+{
+	struct timespec ts = {0, 0};
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)ts.tv_nsec / 1000000ULL;
+}
+
+/* Opens the eventfd once; later calls are no-ops. Returns 0 or -1. */
+static inline int ind_proto_event_open(ind_proto_event_t *ev)
+{
+	if (ev->fd >= 0)
+	{
+		return 0;
+	}
+	ev->fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	return (ev->fd >= 0) ? 0 : -1;
+}
+
+/* Wakes the waiter. Safe from any thread; signals before the wait are not lost. */
+static inline void ind_proto_event_signal(ind_proto_event_t *ev)
+{
+	uint64_t one = 1;
+	ssize_t ret = 0;
+
+	if (ev->fd >= 0)
+	{
+		ret = write(ev->fd, &one, sizeof(one));
+		(void)ret;
+	}
+}
+
+/*
+ * Waits up to timeout_ms for a signal and consumes all pending signals.
+ * Falls back to a plain sleep when the eventfd could not be opened.
+ * Returns 1 when signalled, 0 on timeout.
+ */
+static inline int ind_proto_event_wait(ind_proto_event_t *ev, int timeout_ms)
+{
+	struct pollfd pfd;
+	uint64_t value = 0;
+	int ret = 0;
+
+	if (ev->fd < 0)
+	{
+		usleep((useconds_t)timeout_ms * 1000);
+		return 0;
+	}
+
+	pfd.fd = ev->fd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	do
+	{
+		ret = poll(&pfd, 1, timeout_ms);
+	} while (ret < 0 && errno == EINTR);
+	if (ret <= 0)
+	{
+		return 0;
+	}
+	return (read(ev->fd, &value, sizeof(value)) == (ssize_t)sizeof(value)) ? 1 : 0;
+}
+
+typedef struct
+{
+	uint32_t active_ms;		/* interval while a handshake is in progress */
+	uint32_t hold_ms;		/* stay at active_ms this long after the last activity */
+	uint32_t current_ms;
+	uint64_t last_busy_ms;
+} ind_proto_poll_t;
+
+static inline void ind_proto_poll_init(ind_proto_poll_t *p, uint32_t active_ms, uint32_t hold_ms)
+{
+	p->active_ms = active_ms;
+	p->hold_ms = hold_ms;
+	p->current_ms = active_ms;
+	p->last_busy_ms = 0;
+}
+
+/*
+ * Returns the delay before the next poll. busy marks a handshake in progress
+ * or a register change seen by the last poll; the interval then drops to
+ * active_ms (never above idle_ms). After hold_ms without activity it doubles
+ * per poll up to idle_ms, the configured poll interval.
+ */
+static inline uint32_t ind_proto_poll_next(ind_proto_poll_t *p, int busy, uint64_t now_ms, uint32_t idle_ms)
+{
+	uint32_t active_ms = (p->active_ms < idle_ms) ? p->active_ms : idle_ms;
+
+	if (busy)
+	{
+		p->last_busy_ms = now_ms;
+		p->current_ms = active_ms;
+	}
+	else if (now_ms - p->last_busy_ms >= p->hold_ms)
+	{
+		p->current_ms = (p->current_ms == 0) ? 1 : p->current_ms * 2;
+	}
+	if (p->current_ms < active_ms)
+	{
+		p->current_ms = active_ms;
+	}
+	if (p->current_ms > idle_ms)
+	{
+		p->current_ms = idle_ms;
+	}
+	return p->current_ms;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __INDUSTRIAL_PROTOCOL_EVENT_H */
@@ -0,0 +1,381 @@
+/** @file
+ * @brief Result payload encoders shared by the industrial protocol modules.
+ *
+ * Result strings are turned into 16-bit register values in one pass over the
+ * text: numbers are scanned by hand (no regex, no allocation), converted to
+ * float and written straight into register layout in the configured order.
+ */
+
+#ifndef __INDUSTRIAL_PROTOCOL_PAYLOAD_H
+#define __INDUSTRIAL_PROTOCOL_PAYLOAD_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Byte order of a float over two registers, A being the most significant byte. */
+enum
+{
+	IND_PROTO_FLOAT_ORDER_BADC = 0,
+	IND_PROTO_FLOAT_ORDER_ABCD = 1,
+	IND_PROTO_FLOAT_ORDER_CDAB = 2,
+	IND_PROTO_FLOAT_ORDER_DCBA = 3,
+};
+
+#define IND_PROTO_PAYLOAD_ERR_PARAM (-1)
+#define IND_PROTO_PAYLOAD_ERR_RANGE (-4)
+
+#define IND_PROTO_NUMBER_MAX_LEN (64)
+
+static inline int ind_proto_is_digit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+/*
+ * Finds the next number "-?[0-9]+(.[0-9]+)?" in [*cursor, end) and converts
+ * it like strtof. Anything between numbers (separators, labels) is skipped.
+ * Returns 1 and advances *cursor past the number, 0 when no number is left,
+ * or IND_PROTO_PAYLOAD_ERR_RANGE when the value does not fit a float.
+ */
+static inline int ind_proto_scan_float(const char **cursor, const char *end, float *value)
+{
+	/* 10^k is exact in float up to k = 10 (5^10 < 2^24) */
+	static const float pow10_table[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+	const char *p = *cursor;
+	const char *start = NULL;
+	const char *int_end = NULL;
+	const char *q = NULL;
+	uint32_t mantissa = 0;
+	int frac_digits = 0;
+	int negative = 0;
+
+	while (p < end && !ind_proto_is_digit(*p)
+		&& !(*p == '-' && p + 1 < end && ind_proto_is_digit(p[1])))
+	{
+		p++;
+	}
+	if (p >= end)
+	{
+		*cursor = end;
+		return 0;
+	}
+
+	start = p;
+	if (*p == '-')
+	{
+		negative = 1;
+		p++;
+	}
+	for (; p < end && ind_proto_is_digit(*p); p++)
+	{
+		if (mantissa <= (1u << 24))
+		{
+			mantissa = mantissa * 10 + (uint32_t)(*p - '0');
+		}
+	}
+	int_end = p;
+	if (p + 1 < end && *p == '.' && ind_proto_is_digit(p[1]))
+	{
+		for (p++; p < end && ind_proto_is_digit(*p); p++, frac_digits++)
+		{
+			if (mantissa <= (1u << 24))
+			{
+				mantissa = mantissa * 10 + (uint32_t)(*p - '0');
+			}
+		}
+	}
+	*cursor = p;
+
+	/* Fast path: both operands are exact floats, so one IEEE division is correctly rounded */
+	if (mantissa <= (1u << 24) && frac_digits <= 10)
+	{
+		*value = (float)mantissa / pow10_table[frac_digits];
+		if (negative)
+		{
+			*value = -*value;
+		}
+		return 1;
+	}
+
+	/* Slow path: strtof on a bounded copy. Leading zeros are dropped and fraction digits
+	   beyond the buffer are cut; both are far below float precision. */
+	{
+		char number[IND_PROTO_NUMBER_MAX_LEN];
+		size_t len = 0;
+		float result = 0.0f;
+
+		q = start + negative;
+		while (q + 1 < int_end && *q == '0')
+		{
+			q++;
+		}
+		if (negative)
+		{
+			number[len++] = '-';
+		}
+		if ((size_t)(int_end - q) + len + 3 > sizeof(number))
+		{
+			return IND_PROTO_PAYLOAD_ERR_RANGE;
+		}
+		for (; q < p && len + 1 < sizeof(number); q++)
+		{
+			number[len++] = *q;
+		}
+		number[len] = '\0';
+
+		errno = 0;
+		result = strtof(number, NULL);
+		if (errno == ERANGE)
+		{
+			return IND_PROTO_PAYLOAD_ERR_RANGE;
+		}
+		*value = result;
+	}
+	return 1;
+}
+
+/* Writes one float as two register values in the given order. */
+static inline void ind_proto_float_to_regs(float value, int order, uint16_t *regs)
+{
+	uint32_t bits = 0;
+	uint16_t ab = 0;
+	uint16_t cd = 0;
+
+	memcpy(&bits, &value, sizeof(bits));
+	ab = (uint16_t)(bits >> 16);
+	cd = (uint16_t)bits;
+	switch (order)
+	{
+		case IND_PROTO_FLOAT_ORDER_ABCD:
+			regs[0] = ab;
+			regs[1] = cd;
+			break;
+
+		case IND_PROTO_FLOAT_ORDER_CDAB:
+			regs[0] = cd;
+			regs[1] = ab;
+			break;
+
+		case IND_PROTO_FLOAT_ORDER_BADC:
+			regs[0] = (uint16_t)((ab << 8) | (ab >> 8));
+			regs[1] = (uint16_t)((cd << 8) | (cd >> 8));
+			break;
+
+		case IND_PROTO_FLOAT_ORDER_DCBA:
+		default:
+			regs[0] = (uint16_t)((cd << 8) | (cd >> 8));
+			regs[1] = (uint16_t)((ab << 8) | (ab >> 8));
+			break;
+	}
+}
+
+/*
+ * Encodes every number of text[0, len) as a float over two registers, at most
+ * max_values floats (2 * max_values registers). *count receives the number of
+ * floats written. Returns 0 or a negative IND_PROTO_PAYLOAD_ERR_* code.
+ */
+static inline int ind_proto_encode_floats(const char *text, size_t len, int order,
+	uint16_t *regs, int max_values, int *count)
+{
+	const char *cursor = text;
+	const char *end = text + len;
+	float value = 0.0f;
+	int n = 0;
+	int ret = 0;
+
+	if (text == NULL || regs == NULL || count == NULL || max_values < 0)
+	{
+		return IND_PROTO_PAYLOAD_ERR_PARAM;
+	}
+
+	while (n < max_values && (ret = ind_proto_scan_float(&cursor, end, &value)) > 0)
+	{
+		ind_proto_float_to_regs(value, order, regs + n * 2);
+		n++;
+	}
+	*count = n;
+	return (ret < 0) ? ret : 0;
+}
+
+/*
+ * Packs a byte string into register values two bytes at a time: the first byte
+ * goes to the high half when swap is set, to the low half otherwise. An odd
+ * tail byte is padded with 0. Returns the number of registers written.
+ */
+static inline size_t ind_proto_pack_words(const char *src, size_t len, int swap, uint16_t *words)
+{
+	const uint8_t *s = (const uint8_t *)src;
+	size_t n = len / 2;
+	size_t i = 0;
+
+	if (swap)
+	{
+		for (i = 0; i < n; i++)
+		{
+			words[i] = (uint16_t)((s[2 * i] << 8) | s[2 * i + 1]);
+		}
+		if (len & 1)
+		{
+			words[n] = (uint16_t)(s[len - 1] << 8);
+		}
+	}
+	else
+	{
+		for (i = 0; i < n; i++)
+		{
+			words[i] = (uint16_t)(s[2 * i] | (s[2 * i + 1] << 8));
+		}
+		if (len & 1)
+		{
+			words[n] = (uint16_t)s[len - 1];
+		}
+	}
+	return n + (len & 1);
+}
+
+typedef struct
+{
+	uint32_t offset;	/* first register of the write, relative to the register image */
+	uint32_t count;
+} ind_proto_write_chunk_t;
+
+/*
+ * Splits a register image of count registers into the fewest writes of at most
+ * max_regs registers. The chunk holding register commit_index is ordered last,
+ * so the peer sees that register change only after the rest of the image is
+ * written. Returns the number of chunks, or -1 if max_chunks is too small.
+ */
+static inline int ind_proto_plan_writes(uint32_t count, uint32_t max_regs, uint32_t commit_index,
+	ind_proto_write_chunk_t *chunks, int max_chunks)
+{
+	uint32_t commit_offset = 0;
+	uint32_t offset = 0;
+	int n = 0;
+
+	if (count == 0 || max_regs == 0)
+	{
+		return 0;
+	}
+	if ((int)((count + max_regs - 1) / max_regs) > max_chunks)
+	{
+		return -1;
+	}
+
+	commit_offset = (commit_index < count) ? commit_index / max_regs * max_regs : count;
+	for (offset = 0; offset < count; offset += max_regs)
+	{
+		if (offset != commit_offset)
+		{
+			chunks[n].offset = offset;
+			chunks[n].count = (count - offset < max_regs) ? count - offset : max_regs;
+			n++;
+		}
+	}
+	if (commit_offset < count)
+	{
+		chunks[n].offset = commit_offset;
+		chunks[n].count = (count - commit_offset < max_regs) ? count - commit_offset : max_regs;
+		n++;
+	}
+	return n;
+}
+
+/*
+ * Marks the registers of image[0, count) that differ from shadow, the content
+ * the peer last received. A NULL shadow (content unknown, or a full refresh is
+ * due) marks every register. Returns the number of dirty registers.
+ */
+static inline uint32_t ind_proto_mark_dirty(const uint16_t *image, const uint16_t *shadow, uint32_t count,
+	uint8_t *dirty)
+{
+	uint32_t n = 0;
+	uint32_t i = 0;
+
+	for (i = 0; i < count; i++)
+	{
+		dirty[i] = (shadow == NULL) || (image[i] != shadow[i]);
+		n += dirty[i];
+	}
+	return n;
+}
+
+/*
+ * Plans writes that cover only the dirty registers of an image of count
+ * registers. Dirty runs separated by at most max_gap clean registers share one
+ * write, since rewriting a few unchanged registers is cheaper than another
+ * request; no write is longer than max_regs. Register commit_index is always
+ * written and its chunk is ordered last, as in ind_proto_plan_writes.
+ * Returns the number of chunks, or -1 if max_chunks is too small.
+ */
+static inline int ind_proto_plan_dirty_writes(const uint8_t *dirty, uint32_t count, uint32_t max_regs,
+	uint32_t max_gap, uint32_t commit_index, ind_proto_write_chunk_t *chunks, int max_chunks)
+{
+	ind_proto_write_chunk_t commit_chunk = {0, 0};
+	uint32_t start = 0;
+	uint32_t end = 0;
+	uint32_t i = 0;
+	int commit = -1;
+	int n = 0;
+
+	if (max_regs == 0)
+	{
+		return 0;
+	}
+
+	while (i < count)
+	{
+		if (!dirty[i] && (i != commit_index))
+		{
+			i++;
+			continue;
+		}
+
+		/* [start, end) ends at the last dirty register seen, i runs ahead over the gap */
+		start = i;
+		end = i + 1;
+		for (i++; (i < count) && (i - start < max_regs); i++)
+		{
+			if (dirty[i] || (i == commit_index))
+			{
+				end = i + 1;
+			}
+			else if (i - end + 1 > max_gap)
+			{
+				break;
+			}
+		}
+
+		if (n >= max_chunks)
+		{
+			return -1;
+		}
+		chunks[n].offset = start;
+		chunks[n].count = end - start;
+		if ((commit_index >= start) && (commit_index < end))
+		{
+			commit = n;
+		}
+		n++;
+	}
+
+	if ((commit >= 0) && (commit != n - 1))
+	{
+		commit_chunk = chunks[commit];
+		memmove(&chunks[commit], &chunks[commit + 1], (n - commit - 1) * sizeof(chunks[0]));
+		chunks[n - 1] = commit_chunk;
+	}
+	return n;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __INDUSTRIAL_PROTOCOL_PAYLOAD_H */
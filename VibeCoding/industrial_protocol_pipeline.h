@@ -0,0 +1,332 @@
+/** @file
+ * @brief Pipelined trigger/result handshake shared by the industrial protocol modules.
+ *
+ * In the classic handshake the PLC may only raise the next trigger after the
+ * result of the previous one was acknowledged. In pipelined mode up to depth
+ * triggers are outstanding at once: every accepted trigger gets a trigger_id,
+ * results come back from the vision task in trigger order and are queued in a
+ * FIFO, and the FIFO head is published one at a time tagged with
+ * result_id = the trigger_id it answers.
+ *
+ * All protocols use the same control/status bit numbers, so the handshake
+ * itself lives here; the modules only write the status word, the ids and the
+ * result payload to their own registers.
+ *
+ * Register layout (Modbus, FINS): the status area must be at least three
+ * registers long, status word, trigger_id, result_id, and must not overlap
+ * the control or the result area. The modules check this and run the
+ * classic handshake otherwise. EtherNet/IP carries the ids in the assembly.
+ *
+ *   PLC                                        device
+ *   TRIGGER 0->1 while READY         ->  trigger_id++, TRIGGER_ACK, acquire
+ *   TRIGGER 1->0                     ->  TRIGGER_ACK cleared
+ *                                    <-  READY while fewer than depth outstanding
+ *                                    <-  result_id, payload, RESULT_OK/NG (FIFO head)
+ *   RESULT_ACK 0->1                  ->  RESULT_OK/NG cleared, head dropped
+ *   RESULT_ACK 1->0                  ->  next result may be published
+ */
+
+#ifndef __INDUSTRIAL_PROTOCOL_PIPELINE_H
+#define __INDUSTRIAL_PROTOCOL_PIPELINE_H
+
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IND_PROTO_PIPELINE_MAX_DEPTH (8)
+#define IND_PROTO_PIPELINE_RESULT_BYTES (1280)
+
+/* Control/status bits, identical in the Modbus, FINS and EtherNet/IP register maps. */
+#define IND_PROTO_CTRL_TRIGGER_BIT (1)
+#define IND_PROTO_CTRL_RESULT_ACK_BIT (2)
+#define IND_PROTO_STAT_TRIGGER_READY_BIT (0)
+#define IND_PROTO_STAT_TRIGGER_ACK_BIT (1)
+#define IND_PROTO_STAT_ACQUIRING_BIT (2)
+#define IND_PROTO_STAT_DECODING_BIT (3)
+#define IND_PROTO_STAT_RESULT_OK_BIT (8)
+#define IND_PROTO_STAT_RESULT_NG_BIT (9)
+
+/* ind_proto_pipeline_step return flags */
+#define IND_PROTO_PIPELINE_TRIGGERED (0x1)	/* a trigger was accepted: start one acquisition */
+#define IND_PROTO_PIPELINE_PUBLISH (0x2)	/* write *result, then the status word and ids */
+#define IND_PROTO_PIPELINE_STATUS (0x4)		/* the status word or the ids changed */
+
+typedef struct
+{
+	uint16_t trigger_id;
+	uint64_t start_ms;
+} ind_proto_pipeline_trigger_t;
+
+typedef struct
+{
+	uint16_t result_id;		/* trigger_id of the trigger this result answers */
+	uint16_t len;			/* 0 for NG (empty or timed out) */
+	char data[IND_PROTO_PIPELINE_RESULT_BYTES];
+} ind_proto_pipeline_result_t;
+
+typedef struct
+{
+	pthread_mutex_t lock;
+	int depth;				/* in-flight window, <= 1 disables pipelining */
+	uint16_t trigger_id;	/* last trigger_id handed out */
+	uint16_t result_id;		/* result_id currently published */
+	int trigger_latched;	/* TRIGGER was accepted and has not dropped yet */
+	int published;			/* results[result_head] is published, waiting for RESULT_ACK */
+	uint32_t timeout_ms;	/* result timeout of the last ind_proto_pipeline_step */
+	uint64_t expired_ms[IND_PROTO_PIPELINE_MAX_DEPTH];	/* when each timed-out trigger expired */
+	int expired_head;
+	int expired;			/* timed-out triggers whose late results may still arrive */
+	ind_proto_pipeline_trigger_t triggers[IND_PROTO_PIPELINE_MAX_DEPTH];
+	int trigger_head;
+	int trigger_count;
+	ind_proto_pipeline_result_t results[IND_PROTO_PIPELINE_MAX_DEPTH];
+	int result_head;
+	int result_count;
+} ind_proto_pipeline_t;
+
+static inline void ind_proto_pipeline_reset_locked(ind_proto_pipeline_t *p)
+{
+	p->trigger_latched = 0;
+	p->published = 0;
+	p->expired_head = 0;
+	p->expired = 0;
+	p->trigger_head = 0;
+	p->trigger_count = 0;
+	p->result_head = 0;
+	p->result_count = 0;
+}
+
+/* Initializes an idle pipeline with pipelining off. Returns 0 or -1. */
+static inline int ind_proto_pipeline_init(ind_proto_pipeline_t *p)
+{
+	memset(p, 0, sizeof(*p));
+	return (pthread_mutex_init(&p->lock, NULL) == 0) ? 0 : -1;
+}
+
+/* Drops everything outstanding, e.g. on CLEAR_ERROR. The ids keep counting. */
+static inline void ind_proto_pipeline_reset(ind_proto_pipeline_t *p)
+{
+	pthread_mutex_lock(&p->lock);
+	ind_proto_pipeline_reset_locked(p);
+	pthread_mutex_unlock(&p->lock);
+}
+
+/* Sets the window; a changed window restarts the pipeline. */
+static inline void ind_proto_pipeline_set_depth(ind_proto_pipeline_t *p, int depth)
+{
+	if (depth < 0)
+	{
+		depth = 0;
+	}
+	if (depth > IND_PROTO_PIPELINE_MAX_DEPTH)
+	{
+		depth = IND_PROTO_PIPELINE_MAX_DEPTH;
+	}
+	pthread_mutex_lock(&p->lock);
+	if (p->depth != depth)
+	{
+		p->depth = depth;
+		ind_proto_pipeline_reset_locked(p);
+	}
+	pthread_mutex_unlock(&p->lock);
+}
+
+static inline int ind_proto_pipeline_enabled(ind_proto_pipeline_t *p)
+{
+	int depth = 0;
+
+	pthread_mutex_lock(&p->lock);
+	depth = p->depth;
+	pthread_mutex_unlock(&p->lock);
+	return depth > 1;
+}
+
+/* Triggers awaiting a result plus results not yet acknowledged by the PLC. */
+static inline int ind_proto_pipeline_outstanding(ind_proto_pipeline_t *p)
+{
+	int count = 0;
+
+	pthread_mutex_lock(&p->lock);
+	count = p->trigger_count + p->result_count;
+	pthread_mutex_unlock(&p->lock);
+	return count;
+}
+
+static inline void ind_proto_pipeline_push_result_locked(ind_proto_pipeline_t *p, uint16_t result_id,
+	const char *data, size_t len)
+{
+	ind_proto_pipeline_result_t *r = &p->results[(p->result_head + p->result_count) % IND_PROTO_PIPELINE_MAX_DEPTH];
+
+	if (len > sizeof(r->data))
+	{
+		len = sizeof(r->data);
+	}
+	r->result_id = result_id;
+	r->len = (uint16_t)len;
+	if (len > 0)
+	{
+		memcpy(r->data, data, len);
+	}
+	p->result_count++;
+}
+
+static inline void ind_proto_pipeline_pop_expired_locked(ind_proto_pipeline_t *p)
+{
+	p->expired_head = (p->expired_head + 1) % IND_PROTO_PIPELINE_MAX_DEPTH;
+	p->expired--;
+}
+
+/*
+ * Hands a result from the vision task to the oldest outstanding trigger.
+ * An empty result (len 0) is published as NG. A result arriving within one
+ * result timeout after a trigger expired is taken as that trigger's late
+ * result and dropped, so it cannot be taken for the next one. Expired
+ * triggers older than that are forgotten: their result was lost, and the
+ * next result belongs to a live trigger.
+ * Returns the result_id, 0 for a dropped result, or -1 when pipelining is off
+ * or no trigger is outstanding; the caller then publishes the result the
+ * classic way.
+ */
+static inline int ind_proto_pipeline_complete(ind_proto_pipeline_t *p, const char *data, size_t len,
+	uint64_t now_ms)
+{
+	int result_id = -1;
+
+	pthread_mutex_lock(&p->lock);
+	while (p->expired > 0 && now_ms - p->expired_ms[p->expired_head] > p->timeout_ms)
+	{
+		ind_proto_pipeline_pop_expired_locked(p);
+	}
+	if (p->depth > 1 && p->expired > 0)
+	{
+		ind_proto_pipeline_pop_expired_locked(p);
+		result_id = 0;
+	}
+	else if (p->depth > 1 && p->trigger_count > 0)
+	{
+		result_id = p->triggers[p->trigger_head].trigger_id;
+		p->trigger_head = (p->trigger_head + 1) % IND_PROTO_PIPELINE_MAX_DEPTH;
+		p->trigger_count--;
+		ind_proto_pipeline_push_result_locked(p, (uint16_t)result_id, data, (data != NULL) ? len : 0);
+	}
+	pthread_mutex_unlock(&p->lock);
+	return result_id;
+}
+
+/*
+ * One pass of the pipelined handshake: expires triggers older than timeout_ms
+ * as NG, handles RESULT_ACK and TRIGGER edges, picks the next result to publish
+ * (copied to *result) and updates READY/ACK/ACQUIRING/DECODING/OK/NG in *status.
+ * *trigger_id and *result_id receive the ids to show the PLC.
+ * Returns a combination of IND_PROTO_PIPELINE_* flags.
+ */
+static inline int ind_proto_pipeline_step(ind_proto_pipeline_t *p, uint16_t control, uint16_t *status,
+	uint16_t *trigger_id, uint16_t *result_id, ind_proto_pipeline_result_t *result,
+	uint64_t now_ms, uint32_t timeout_ms)
+{
+	const uint16_t ok_ng = (uint16_t)((1u << IND_PROTO_STAT_RESULT_OK_BIT) | (1u << IND_PROTO_STAT_RESULT_NG_BIT));
+	uint16_t prev_status = *status;
+	uint16_t prev_trigger_id = *trigger_id;
+	uint16_t prev_result_id = *result_id;
+	ind_proto_pipeline_result_t *head = NULL;
+	int flags = 0;
+	int slot = 0;
+
+	pthread_mutex_lock(&p->lock);
+
+	p->timeout_ms = timeout_ms;
+	while (p->trigger_count > 0 && now_ms - p->triggers[p->trigger_head].start_ms > timeout_ms)
+	{
+		ind_proto_pipeline_push_result_locked(p, p->triggers[p->trigger_head].trigger_id, NULL, 0);
+		p->trigger_head = (p->trigger_head + 1) % IND_PROTO_PIPELINE_MAX_DEPTH;
+		p->trigger_count--;
+		if (p->expired == IND_PROTO_PIPELINE_MAX_DEPTH)
+		{
+			ind_proto_pipeline_pop_expired_locked(p);
+		}
+		p->expired_ms[(p->expired_head + p->expired) % IND_PROTO_PIPELINE_MAX_DEPTH] = now_ms;
+		p->expired++;
+	}
+
+	if (p->published && (control & (1u << IND_PROTO_CTRL_RESULT_ACK_BIT)) && (*status & ok_ng))
+	{
+		*status &= (uint16_t)~ok_ng;
+		p->result_head = (p->result_head + 1) % IND_PROTO_PIPELINE_MAX_DEPTH;
+		p->result_count--;
+		p->published = 0;
+	}
+
+	if (control & (1u << IND_PROTO_CTRL_TRIGGER_BIT))
+	{
+		if (!p->trigger_latched && (*status & (1u << IND_PROTO_STAT_TRIGGER_READY_BIT))
+			&& p->trigger_count + p->result_count < p->depth)
+		{
+			p->trigger_id++;
+			if (p->trigger_id == 0)
+			{
+				p->trigger_id = 1;	/* 0 means "no trigger yet" to the PLC */
+			}
+			slot = (p->trigger_head + p->trigger_count) % IND_PROTO_PIPELINE_MAX_DEPTH;
+			p->triggers[slot].trigger_id = p->trigger_id;
+			p->triggers[slot].start_ms = now_ms;
+			p->trigger_count++;
+			p->trigger_latched = 1;
+			*status |= (uint16_t)(1u << IND_PROTO_STAT_TRIGGER_ACK_BIT);
+			flags |= IND_PROTO_PIPELINE_TRIGGERED;
+		}
+	}
+	else if (p->trigger_latched)
+	{
+		p->trigger_latched = 0;
+		*status &= (uint16_t)~(1u << IND_PROTO_STAT_TRIGGER_ACK_BIT);
+	}
+
+	if (!p->published && p->result_count > 0 && !(control & (1u << IND_PROTO_CTRL_RESULT_ACK_BIT)))
+	{
+		head = &p->results[p->result_head];
+		result->result_id = head->result_id;
+		result->len = head->len;
+		memcpy(result->data, head->data, head->len);
+		p->result_id = head->result_id;
+		p->published = 1;
+		*status |= (uint16_t)(1u << (head->len > 0 ? IND_PROTO_STAT_RESULT_OK_BIT : IND_PROTO_STAT_RESULT_NG_BIT));
+		flags |= IND_PROTO_PIPELINE_PUBLISH;
+	}
+
+	if (p->trigger_count + p->result_count < p->depth)
+	{
+		*status |= (uint16_t)(1u << IND_PROTO_STAT_TRIGGER_READY_BIT);
+	}
+	else
+	{
+		*status &= (uint16_t)~(1u << IND_PROTO_STAT_TRIGGER_READY_BIT);
+	}
+	if (p->trigger_count > 0)
+	{
+		*status |= (uint16_t)((1u << IND_PROTO_STAT_ACQUIRING_BIT) | (1u << IND_PROTO_STAT_DECODING_BIT));
+	}
+	else
+	{
+		*status &= (uint16_t)~((1u << IND_PROTO_STAT_ACQUIRING_BIT) | (1u << IND_PROTO_STAT_DECODING_BIT));
+	}
+	*trigger_id = p->trigger_id;
+	*result_id = p->result_id;
+
+	pthread_mutex_unlock(&p->lock);
+
+	if (*status != prev_status || *trigger_id != prev_trigger_id || *result_id != prev_result_id)
+	{
+		flags |= IND_PROTO_PIPELINE_STATUS;
+	}
+	return flags;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __INDUSTRIAL_PROTOCOL_PIPELINE_H */
@@ -0,0 +1,38 @@
+/* Stand-in for CapacityApi.h: no capability data, so the identity object keeps its defaults. */
+#ifndef __SIM_CAPACITYAPI_H
+#define __SIM_CAPACITYAPI_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct CapaEthernetipInfo
+{
+	uint16_t deviceProductCode;
+};
+
+struct CapaProtocolInfo
+{
+	CapaEthernetipInfo ethernetipInfo;
+};
+
+struct CapaDeviceInfo
+{
+	const char *deviceClass;
+};
+
+struct CapaBusinessInfo
+{
+	CapaDeviceInfo deviceInfo;
+};
+
+static inline const CapaProtocolInfo *Capa_GetProtocolInfo()
+{
+	return NULL;
+}
+
+static inline const CapaBusinessInfo *Capa_GetBusinessInfo()
+{
+	return NULL;
+}
+
+#endif /* __SIM_CAPACITYAPI_H */
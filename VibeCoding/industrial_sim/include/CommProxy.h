@@ -0,0 +1,33 @@
+/* Stand-in for CommProxy.h: PLC commands are not simulated, every command fails. */
+#ifndef __SIM_COMMPROXY_H
+#define __SIM_COMMPROXY_H
+
+#include <string>
+
+#define REG_SERVICE_INFO_LEN (128)
+
+class CCommProxy
+{
+public:
+	struct MessageInfo
+	{
+		char msg[REG_SERVICE_INFO_LEN];
+		int len;
+		int moduleId;
+	};
+
+	static CCommProxy *getInstance()
+	{
+		static CCommProxy instance;
+		return &instance;
+	}
+
+	int SyncRecv(const MessageInfo &info, std::string &result)
+	{
+		(void)info;
+		result.clear();
+		return -1;
+	}
+};
+
+#endif /* __SIM_COMMPROXY_H */
@@ -0,0 +1,17 @@
+/* Stand-in for VmModuleBase.h: the run state the trigger threads check and the IN annotation. */
+#ifndef __SIM_VMMODULEBASE_H
+#define __SIM_VMMODULEBASE_H
+
+#include <string>
+
+#ifndef IN
+#define IN
+#endif
+
+typedef enum
+{
+	ALGO_PLAY_STOP = 0,
+	ALGO_PLAY_CONTINUE = 1,
+} eALGO_PLAYCTRL;
+
+#endif /* __SIM_VMMODULEBASE_H */
@@ -0,0 +1,10 @@
+/* Stand-in for adapter/ScheErrorCodeDefine.h: only the codes the protocol modules return. */
+#ifndef __SIM_ADAPTER_SCHEERRORCODEDEFINE_H
+#define __SIM_ADAPTER_SCHEERRORCODEDEFINE_H
+
+#define IMVS_EC_OK (0)
+#define IMVS_EC_PARAM (-1)
+#define IMVS_EC_NULL_PTR (-2)
+#define IMVS_EC_SYSTEM_INNER_ERR (-3)
+
+#endif /* __SIM_ADAPTER_SCHEERRORCODEDEFINE_H */
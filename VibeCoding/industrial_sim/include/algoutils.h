@@ -0,0 +1,12 @@
+/* Stand-in for algoutils.h: triggers go to the simulated vision task in plc_sim.cpp. */
+#ifndef __SIM_ALGOUTILS_H
+#define __SIM_ALGOUTILS_H
+
+class CAlgoUtils
+{
+public:
+	static int IndustrialProtocolTriggerOnce();
+	static bool IsCommunicationOrSoftwareTrigger();
+};
+
+#endif /* __SIM_ALGOUTILS_H */
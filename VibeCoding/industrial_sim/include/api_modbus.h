@@ -0,0 +1,57 @@
+/* Stand-in for api_modbus.h, implemented by plc_sim_modbus.cpp on top of an in-process register bank. */
+#ifndef __SIM_API_MODBUS_H
+#define __SIM_API_MODBUS_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum
+{
+	ADDR_SPACE_COIL = 0,
+	ADDR_SPACE_DISCRETE_INPUT = 1,
+	ADDR_SPACE_INPUT_REGISTER = 2,
+	ADDR_SPACE_HOLDING_REGISTER = 3,
+};
+
+typedef struct
+{
+	int work_mode;
+	int communication_mode;
+	uint32_t server_ip;
+	uint32_t server_port;
+	int max_connection;
+	int idle_timeout_sec;
+	int idle_timeout_usec;
+	int max_coil_regs;
+	int max_discrete_input_regs;
+	int max_input_regs;
+	int max_holding_regs;
+	int ctrl_addr;
+	int status_addr;
+	int result_addr;
+	int ctrl_quantity;
+	int status_quantity;
+	int result_quantity;
+	int (*app_data_handle_function)(void);	/* called after a master wrote holding registers */
+	volatile int deinit;
+	volatile int inited;
+	volatile int modbus_exit;
+	int slave_id;
+} modbus_operator;
+
+int init_lib_modbus_params(modbus_operator *opt);
+int init_lib_modbus(void);		/* runs the stack until opt->deinit is set */
+int deinit_lib_modbus(void);
+int cfg_lib_modbus_slave_id(int slave_id);
+void *get_modbus_buffer_addr_space(int space);
+int lib_modbus_read_registers(int addr, int nb, uint16_t *dest);
+int lib_modbus_write_registers(int addr, int nb, uint16_t *src);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SIM_API_MODBUS_H */
@@ -0,0 +1,93 @@
+/* Stand-in for cip_application.h, implemented by plc_sim_eip.cpp; the simulated scanner drives the callbacks. */
+#ifndef __SIM_CIP_APPLICATION_H
+#define __SIM_CIP_APPLICATION_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct
+{
+	uint32_t length;
+	uint8_t *data;
+} CipByteArray;
+
+struct eip_revision
+{
+	uint8_t major_revision;
+	uint8_t minor_revision;
+};
+
+struct eip_identity_object
+{
+	uint16_t eip_vendor_id;
+	uint16_t eip_device_type;
+	uint16_t eip_product_code;
+	uint32_t eip_serial_number;
+	uint32_t eip_product_name_length;
+	uint8_t *eip_product_name;
+	struct eip_revision eip_revision;
+};
+
+struct eip_custom_object
+{
+	uint16_t class_id;
+	uint16_t *output_status;
+	uint16_t *input_status;
+	uint16_t *trigger_id;
+	uint16_t *result_id;
+	CipByteArray *result_array;
+};
+
+struct eip_assembly_parameter
+{
+	uint32_t app_input_assembly_num;
+	uint32_t app_output_assembly_num;
+	uint32_t app_config_assembly_num;
+	uint32_t app_input_heartbeat_assembly_num;
+	uint32_t app_listen_heartbeat_assembly_num;
+	uint32_t app_explict_assembly_num;
+	CipByteArray input_assembly_array;
+	CipByteArray output_assembly_array;
+	CipByteArray config_assembly_array;
+	CipByteArray explicit_assembly_array;
+	CipByteArray input_heartbeat_assembly_array;
+	CipByteArray listen_heartbeat_assembly_array;
+};
+
+struct eip_application_interface
+{
+	int32_t (*application_data_handle)(uint32_t instance_number);		/* O->T data arrived */
+	int32_t (*get_data_from_application)(uint32_t instance_number);		/* T->O data is due */
+	int32_t (*application_start_read)(void);
+	int32_t (*application_stop_read)(void);
+	int32_t (*application_trigger_once)(void);
+	int32_t (*set_explicit_output_status)(int16_t output_status);
+};
+
+struct eip_app_cfg_para
+{
+	struct eip_identity_object *identity_data;
+	struct eip_custom_object *custom_data;
+	struct eip_assembly_parameter eip_assembly_parameter;
+	struct eip_application_interface *app_interface;
+	volatile int eip_exit;
+};
+
+enum
+{
+	STACK_RUN = 0,
+	STACK_END = 1,
+};
+
+int configure_eip_para(struct eip_app_cfg_para *cfg);
+void *eip_init(void *ifname);	/* stack thread: runs until cfg_stack_run_status(STACK_END) */
+void cfg_stack_run_status(int status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SIM_CIP_APPLICATION_H */
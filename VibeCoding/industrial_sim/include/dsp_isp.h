@@ -0,0 +1,4 @@
+/* Stand-in for the platform header of the same name: the protocol modules include it but use nothing from it. */
+#ifndef __SIM_DSP_ISP_H
+#define __SIM_DSP_ISP_H
+#endif
@@ -0,0 +1,27 @@
+/* Stand-in for log/log.h: errors go to stderr, info/debug output is dropped. */
+#ifndef __SIM_LOG_LOG_H
+#define __SIM_LOG_LOG_H
+
+#include <stdarg.h>
+#include <stdio.h>
+
+/* No format attribute: the modules' log strings are not all printf-clean. */
+static inline void sim_log_error(const char *fmt, ...)
+{
+	va_list args;
+
+	va_start(args, fmt);
+	vfprintf(stderr, fmt, args);
+	va_end(args);
+}
+
+static inline void sim_log_drop(const char *fmt, ...)
+{
+	(void)fmt;
+}
+
+#define LOGE(...) sim_log_error(__VA_ARGS__)
+#define LOGI(...) sim_log_drop(__VA_ARGS__)
+#define LOGD(...) sim_log_drop(__VA_ARGS__)
+
+#endif /* __SIM_LOG_LOG_H */
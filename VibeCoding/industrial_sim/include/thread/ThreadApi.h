@@ -0,0 +1,36 @@
+/* Stand-in for thread/ThreadApi.h: plain detached pthreads, scheduling hints are ignored. */
+#ifndef __SIM_THREAD_THREADAPI_H
+#define __SIM_THREAD_THREADAPI_H
+
+#include <pthread.h>
+#include <sys/prctl.h>
+
+typedef void *(*start_routine)(void *);
+
+#define SCHED_POLICY_RR (2)
+#define SCHED_PRI_LOW_40 (40)
+#define SCHED_PRI_HIPRI_60 (60)
+
+static inline int thread_spawn_ex(pthread_t *tid, int scope, int policy, int priority, int stack_size,
+	start_routine routine, void *arg)
+{
+	pthread_attr_t attr;
+	int ret = 0;
+
+	(void)scope;
+	(void)policy;
+	(void)priority;
+	(void)stack_size;	/* the target sizes are too small for a host build */
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	ret = pthread_create(tid, &attr, routine, arg);
+	pthread_attr_destroy(&attr);
+	return ret;
+}
+
+static inline int thread_set_name(const char *name)
+{
+	return prctl(PR_SET_NAME, name, 0, 0, 0);
+}
+
+#endif /* __SIM_THREAD_THREADAPI_H */
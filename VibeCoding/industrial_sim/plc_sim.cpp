@@ -0,0 +1,483 @@
+// Shared part of the industrial protocol PLC simulators, see plc_sim.h.
+
+#include "plc_sim.h"
+
+#include "algoutils.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+namespace plc_sim {
+
+namespace {
+
+const uint64_t kStallUs = 5 * 1000 * 1000;
+
+struct Vision {
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::deque<uint64_t> triggers;  // trigger time of every queued acquisition
+  ResultSink sink;
+  uint32_t delay_us = 0;
+  std::string result;
+  bool started = false;
+};
+
+Vision &GetVision() {
+  static Vision vision;
+  return vision;
+}
+
+void VisionWorker() {
+  Vision &vision = GetVision();
+  for (;;) {
+    uint64_t triggered_us = 0;
+    uint32_t delay_us = 0;
+    std::string result;
+    {
+      std::unique_lock<std::mutex> lock(vision.mutex);
+      vision.cv.wait(lock, [&vision]() { return !vision.triggers.empty(); });
+      triggered_us = vision.triggers.front();
+      vision.triggers.pop_front();
+      delay_us = vision.delay_us;
+      result = vision.result;
+    }
+    const uint64_t due_us = triggered_us + delay_us;
+    const uint64_t now_us = NowUs();
+    if (due_us > now_us) {
+      SleepUs(static_cast<uint32_t>(due_us - now_us));
+    }
+    result.push_back('\0');
+    vision.sink(&result[0], static_cast<int>(result.size() - 1));
+  }
+}
+
+// Numbers separated by ';', cut to bytes, so the float encodings have work too.
+std::string MakeResult(int bytes) {
+  std::string result;
+  for (int i = 0; static_cast<int>(result.size()) < bytes; ++i) {
+    char number[16];
+    snprintf(number, sizeof(number), "%d.%d;", 100 + i % 900, i % 10);
+    result += number;
+  }
+  result.resize(bytes);
+  return result;
+}
+
+bool ParseList(const char *text, std::vector<int> *values) {
+  values->clear();
+  std::stringstream stream(text);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    char *end = NULL;
+    const long value = strtol(item.c_str(), &end, 10);
+    if (item.empty() || *end != '\0' || value < 0) {
+      return false;
+    }
+    values->push_back(static_cast<int>(value));
+  }
+  return !values->empty();
+}
+
+void PrintUsage(const std::vector<std::string> &modes) {
+  std::string mode_list;
+  for (size_t i = 0; i < modes.size(); ++i) {
+    mode_list += (i > 0 ? "|" : "") + modes[i];
+  }
+  fprintf(stderr,
+          "options:\n"
+          "  --mode %s\n"
+          "  --result-bytes LIST   result sizes, e.g. 16,256,1024 (default 64)\n"
+          "  --poll-ms LIST        device control poll intervals (default 10)\n"
+          "  --depth LIST          pipeline depths, 0/1 = classic (default 1)\n"
+          "  --cycles N            measured cycles per case (default 500)\n"
+          "  --warmup N            unmeasured cycles per case (default 20)\n"
+          "  --scan-us N           PLC scan time / EtherNet/IP RPI (default 1000)\n"
+          "  --link-us N           one-way transport delay per request (default 100)\n"
+          "  --vision-us N         trigger to result time of the vision task (default 5000)\n"
+          "  --max-p99-us N        fail when a trigger->result p99 is above N\n"
+          "  --out FILE            write JSON to FILE instead of stdout\n",
+          mode_list.c_str());
+}
+
+double Percentile(const std::vector<double> &sorted, double p) {
+  if (sorted.empty()) {
+    return 0.0;
+  }
+  size_t rank = static_cast<size_t>(ceil(p * sorted.size()));
+  rank = std::max<size_t>(rank, 1);
+  return sorted[std::min(rank, sorted.size()) - 1];
+}
+
+struct Summary {
+  double p50;
+  double p99;
+  double max;
+  double mean;
+};
+
+Summary Summarize(std::vector<double> samples) {
+  Summary summary = {0.0, 0.0, 0.0, 0.0};
+  if (samples.empty()) {
+    return summary;
+  }
+  std::sort(samples.begin(), samples.end());
+  double sum = 0.0;
+  for (size_t i = 0; i < samples.size(); ++i) {
+    sum += samples[i];
+  }
+  summary.p50 = Percentile(samples, 0.50);
+  summary.p99 = Percentile(samples, 0.99);
+  summary.max = samples.back();
+  summary.mean = sum / samples.size();
+  return summary;
+}
+
+bool HasBit(uint16_t value, int bit) {
+  return (value & (1u << bit)) != 0;
+}
+
+// Holds TRIGGER_ENABLE until the device reports READY with no handshake open.
+bool WaitIdle(PlcPort *port) {
+  const uint64_t start_us = NowUs();
+  uint16_t status = 0;
+  port->WriteControl(1u << kCtrlTriggerEnable);
+  while (NowUs() - start_us < kStallUs) {
+    const StatusWindow window = port->ReadStatus();
+    if (HasBit(window.status, kStatReady) && !HasBit(window.status, kStatTriggerAck) &&
+        !HasBit(window.status, kStatResultOk) && !HasBit(window.status, kStatResultNg)) {
+      return true;
+    }
+    status = window.status;
+    port->Scan();
+  }
+  fprintf(stderr, "device not ready: status 0x%04x\n", status);
+  return false;
+}
+
+struct Pending {
+  int seq;
+  uint16_t trigger_id;
+  uint64_t raised_us;
+};
+
+// The PLC program: raises TRIGGER whenever the device is READY, drops it on
+// TRIGGER_ACK, acknowledges every RESULT_OK/NG and releases RESULT_ACK when the
+// result bits clear. With depth > 1 results are matched by result_id.
+CaseResult RunHandshake(PlcPort *port, const CaseConfig &config, int cycles, int warmup) {
+  CaseResult result;
+  result.elapsed_us = 0.0;
+  result.ng = 0;
+  result.bad_len = 0;
+  result.lost = 0;
+  result.stalled = !WaitIdle(port);
+  if (result.stalled) {
+    return result;
+  }
+
+  const bool pipelined = config.depth > 1;
+  const int total = warmup + cycles;
+  uint16_t control = 1u << kCtrlTriggerEnable;
+  std::deque<Pending> pending;
+  bool trigger_high = false;
+  bool ack_high = false;
+  uint64_t raised_us = 0;
+  uint64_t first_measured_us = 0;
+  uint64_t last_done_us = 0;
+  uint64_t progress_us = NowUs();
+  int raised = 0;
+  int done = 0;
+
+  // RESULT_ACK of the last result is held until the device has seen it.
+  while (done < total || ack_high) {
+    const StatusWindow window = port->ReadStatus();
+    const uint64_t now_us = NowUs();
+    const bool result_bits = HasBit(window.status, kStatResultOk) || HasBit(window.status, kStatResultNg);
+
+    if (trigger_high && HasBit(window.status, kStatTriggerAck)) {
+      if (raised - 1 >= warmup) {
+        result.ack_us.push_back(static_cast<double>(now_us - raised_us));
+      }
+      const Pending item = {raised - 1, window.trigger_id, raised_us};
+      pending.push_back(item);
+      trigger_high = false;
+      control &= ~(1u << kCtrlTrigger);
+      port->WriteControl(control);
+      progress_us = now_us;
+    }
+
+    if (!ack_high && result_bits && !pending.empty()) {
+      bool matched = !pipelined;
+      if (pipelined) {
+        // Results arrive in trigger order; an id further on means results were skipped.
+        for (size_t i = 0; i < pending.size(); ++i) {
+          if (pending[i].trigger_id == window.result_id) {
+            result.lost += static_cast<int>(i);
+            pending.erase(pending.begin(), pending.begin() + i);
+            matched = true;
+            break;
+          }
+        }
+      }
+      if (matched) {
+        const Pending item = pending.front();
+        pending.pop_front();
+        if (item.seq >= warmup) {
+          if (item.seq == warmup) {
+            first_measured_us = item.raised_us;
+          }
+          result.result_us.push_back(static_cast<double>(now_us - item.raised_us));
+          // An NG result may leave the previous data in place, so only OK is checked.
+          if (HasBit(window.status, kStatResultNg)) {
+            result.ng++;
+          } else if (port->ReadResultLength() != config.expected_len) {
+            result.bad_len++;
+          }
+        }
+      } else {
+        result.lost++;
+      }
+      done++;
+      last_done_us = now_us;
+      ack_high = true;
+      control |= 1u << kCtrlResultAck;
+      port->WriteControl(control);
+      progress_us = now_us;
+    } else if (ack_high && !result_bits) {
+      ack_high = false;
+      control &= ~(1u << kCtrlResultAck);
+      port->WriteControl(control);
+      progress_us = now_us;
+    }
+
+    if (!trigger_high && raised < total && HasBit(window.status, kStatReady) &&
+        !HasBit(window.status, kStatTriggerAck)) {
+      trigger_high = true;
+      control |= 1u << kCtrlTrigger;
+      raised_us = NowUs();
+      port->WriteControl(control);
+      raised++;
+      progress_us = raised_us;
+    }
+
+    if (NowUs() - progress_us > kStallUs) {
+      fprintf(stderr, "%s stalled after %d/%d results: control 0x%04x status 0x%04x ids %u/%u, %zu pending\n",
+              config.name.c_str(), done, total, control, window.status, window.trigger_id, window.result_id,
+              pending.size());
+      result.stalled = true;
+      break;
+    }
+    port->Scan();
+  }
+
+  result.elapsed_us = (last_done_us > first_measured_us && first_measured_us > 0)
+                          ? static_cast<double>(last_done_us - first_measured_us)
+                          : 0.0;
+  return result;
+}
+
+std::string SummaryJson(const Summary &summary) {
+  char buffer[160];
+  snprintf(buffer, sizeof(buffer), "{\"p50\": %.1f, \"p99\": %.1f, \"max\": %.1f, \"mean\": %.1f}", summary.p50,
+           summary.p99, summary.max, summary.mean);
+  return buffer;
+}
+
+}  // namespace
+
+uint64_t NowUs() {
+  struct timespec ts = {0, 0};
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000ULL + static_cast<uint64_t>(ts.tv_nsec) / 1000ULL;
+}
+
+void SleepUs(uint32_t us) {
+  if (us > 0) {
+    usleep(us);
+  }
+}
+
+void Exit(int code) {
+  std::cout.flush();
+  fflush(NULL);
+  _exit(code);
+}
+
+void StartVision(const ResultSink &sink) {
+  Vision &vision = GetVision();
+  std::lock_guard<std::mutex> lock(vision.mutex);
+  vision.sink = sink;
+  if (!vision.started) {
+    vision.started = true;
+    std::thread(VisionWorker).detach();
+  }
+}
+
+void SetVisionDelayUs(uint32_t us) {
+  Vision &vision = GetVision();
+  std::lock_guard<std::mutex> lock(vision.mutex);
+  vision.delay_us = us;
+}
+
+void SetResultBytes(int bytes) {
+  Vision &vision = GetVision();
+  std::lock_guard<std::mutex> lock(vision.mutex);
+  vision.result = MakeResult(bytes);
+}
+
+bool ParseOptions(int argc, char **argv, const std::vector<std::string> &modes, Options *options) {
+  options->mode = modes.empty() ? std::string() : modes[0];
+  options->result_bytes.assign(1, 64);
+  options->poll_ms.assign(1, 10);
+  options->depth.assign(1, 1);
+  options->cycles = 500;
+  options->warmup = 20;
+  options->scan_us = 1000;
+  options->link_us = 100;
+  options->vision_us = 5000;
+  options->max_p99_us = 0.0;
+  options->out_path.clear();
+
+  for (int i = 1; i < argc; i += 2) {
+    const std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      PrintUsage(modes);
+      return false;
+    }
+    const char *value = argv[i + 1];
+    bool ok = true;
+    if (arg == "--mode") {
+      options->mode = value;
+      ok = std::find(modes.begin(), modes.end(), options->mode) != modes.end();
+    } else if (arg == "--result-bytes") {
+      ok = ParseList(value, &options->result_bytes);
+    } else if (arg == "--poll-ms") {
+      ok = ParseList(value, &options->poll_ms);
+    } else if (arg == "--depth") {
+      ok = ParseList(value, &options->depth);
+    } else if (arg == "--cycles") {
+      options->cycles = atoi(value);
+      ok = options->cycles > 0;
+    } else if (arg == "--warmup") {
+      options->warmup = atoi(value);
+      ok = options->warmup >= 0;
+    } else if (arg == "--scan-us") {
+      options->scan_us = static_cast<uint32_t>(strtoul(value, NULL, 10));
+    } else if (arg == "--link-us") {
+      options->link_us = static_cast<uint32_t>(strtoul(value, NULL, 10));
+    } else if (arg == "--vision-us") {
+      options->vision_us = static_cast<uint32_t>(strtoul(value, NULL, 10));
+    } else if (arg == "--max-p99-us") {
+      options->max_p99_us = atof(value);
+    } else if (arg == "--out") {
+      options->out_path = value;
+    } else {
+      ok = false;
+    }
+    if (!ok) {
+      std::cerr << "bad option " << arg << " " << value << std::endl;
+      PrintUsage(modes);
+      return false;
+    }
+  }
+  return true;
+}
+
+int RunBench(const char *protocol, const Options &options, PlcPort *port, const ApplyCase &apply) {
+  std::ostringstream json;
+  int exit_code = 0;
+  bool first = true;
+  bool stalled = false;
+
+  SetVisionDelayUs(options.vision_us);
+  json << "{\n  \"protocol\": \"" << protocol << "\",\n  \"mode\": \"" << options.mode << "\",\n"
+       << "  \"scan_us\": " << options.scan_us << ",\n  \"link_us\": " << options.link_us << ",\n"
+       << "  \"vision_us\": " << options.vision_us << ",\n  \"cycles\": " << options.cycles << ",\n"
+       << "  \"cases\": [";
+  fprintf(stderr, "%-46s %27s %30s %9s\n", "case", "trigger->ack p50/p99/max ms", "trigger->result p50/p99/max ms",
+          "cycles/s");
+
+  for (size_t d = 0; d < options.depth.size() && !stalled; ++d) {
+    for (size_t r = 0; r < options.result_bytes.size() && !stalled; ++r) {
+      for (size_t p = 0; p < options.poll_ms.size() && !stalled; ++p) {
+        CaseConfig config;
+        char name[96];
+        snprintf(name, sizeof(name), "%s/%s/depth%d/result%d/poll%d", protocol, options.mode.c_str(),
+                 options.depth[d], options.result_bytes[r], options.poll_ms[p]);
+        config.name = name;
+        config.depth = options.depth[d];
+        config.result_bytes = options.result_bytes[r];
+        config.poll_ms = options.poll_ms[p];
+        SetResultBytes(config.result_bytes);
+        config.expected_len = apply(config);
+
+        const CaseResult result = RunHandshake(port, config, options.cycles, options.warmup);
+        const Summary ack = Summarize(result.ack_us);
+        const Summary done = Summarize(result.result_us);
+        const double throughput =
+            result.elapsed_us > 0 ? result.result_us.size() * 1e6 / result.elapsed_us : 0.0;
+
+        fprintf(stderr, "%-46s %8.2f %8.2f %9.2f %9.2f %9.2f %10.2f %9.1f%s\n", config.name.c_str(), ack.p50 / 1e3,
+                ack.p99 / 1e3, ack.max / 1e3, done.p50 / 1e3, done.p99 / 1e3, done.max / 1e3, throughput,
+                result.stalled ? "  STALLED" : "");
+        if (result.ng > 0 || result.bad_len > 0 || result.lost > 0) {
+          fprintf(stderr, "%-46s ng %d, bad length %d, lost %d\n", "", result.ng, result.bad_len, result.lost);
+        }
+
+        json << (first ? "\n" : ",\n") << "    {\"name\": \"" << config.name
+             << "\", \"result_bytes\": " << config.result_bytes << ", \"poll_ms\": " << config.poll_ms
+             << ", \"depth\": " << config.depth << ", \"measured\": " << result.result_us.size()
+             << ",\n     \"trigger_ack_us\": " << SummaryJson(ack)
+             << ",\n     \"trigger_result_us\": " << SummaryJson(done)
+             << ",\n     \"throughput_per_s\": " << throughput << ", \"ng\": " << result.ng
+             << ", \"bad_length\": " << result.bad_len << ", \"lost\": " << result.lost
+             << ", \"stalled\": " << (result.stalled ? "true" : "false") << "}";
+        first = false;
+
+        if (result.stalled || result.bad_len > 0 || result.lost > 0 ||
+            (options.max_p99_us > 0 && done.p99 > options.max_p99_us)) {
+          exit_code = 1;
+        }
+        // A stuck device would only time out the later cases as well.
+        stalled = result.stalled;
+      }
+    }
+  }
+  json << "\n  ]\n}\n";
+
+  if (options.out_path.empty()) {
+    std::cout << json.str();
+  } else {
+    std::ofstream out(options.out_path.c_str());
+    out << json.str();
+  }
+  return exit_code;
+}
+
+}  // namespace plc_sim
+
+int CAlgoUtils::IndustrialProtocolTriggerOnce() {
+  plc_sim::Vision &vision = plc_sim::GetVision();
+  {
+    std::lock_guard<std::mutex> lock(vision.mutex);
+    vision.triggers.push_back(plc_sim::NowUs());
+  }
+  vision.cv.notify_one();
+  return 0;
+}
+
+bool CAlgoUtils::IsCommunicationOrSoftwareTrigger() {
+  return true;
+}
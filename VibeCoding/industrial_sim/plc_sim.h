@@ -0,0 +1,117 @@
+// Shared part of the industrial protocol PLC simulators: the PLC program that
+// runs the trigger/result handshake, the vision task stand-in behind
+// CAlgoUtils, latency statistics and the command line / JSON report.
+//
+// Each protocol driver (plc_sim_modbus.cpp, plc_sim_fins.cpp, plc_sim_eip.cpp)
+// links the unmodified protocol module, implements the stack API of the
+// platform library in-process and gives the PLC program a PlcPort to reach the
+// device's registers.
+
+#ifndef INDUSTRIAL_SIM_PLC_SIM_H
+#define INDUSTRIAL_SIM_PLC_SIM_H
+
+#include <stdint.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace plc_sim {
+
+// Control/status bits, the same in the Modbus, FINS and EtherNet/IP maps.
+enum {
+  kCtrlTriggerEnable = 0,
+  kCtrlTrigger = 1,
+  kCtrlResultAck = 2,
+};
+
+enum {
+  kStatReady = 0,
+  kStatTriggerAck = 1,
+  kStatResultOk = 8,
+  kStatResultNg = 9,
+};
+
+uint64_t NowUs();
+void SleepUs(uint32_t us);
+
+// Status register plus the pipelined trigger_id/result_id that follow it.
+struct StatusWindow {
+  uint16_t status;
+  uint16_t trigger_id;
+  uint16_t result_id;
+};
+
+// How the PLC program reaches the device. Calls include the transport delay
+// of the protocol (a master request, an I/O cycle, ...).
+class PlcPort {
+ public:
+  virtual ~PlcPort() {}
+  virtual void WriteControl(uint16_t control) = 0;
+  virtual StatusWindow ReadStatus() = 0;
+  // Length word of the result area, read after RESULT_OK/NG was seen.
+  virtual int ReadResultLength() = 0;
+  // Waits for the next PLC scan.
+  virtual void Scan() = 0;
+};
+
+// Vision task stand-in. Every trigger from a protocol module queues one
+// acquisition; a worker answers them in order, vision_us after the trigger,
+// by passing a result of the configured size to the sink.
+typedef std::function<int(char *result, int len)> ResultSink;
+void StartVision(const ResultSink &sink);
+void SetVisionDelayUs(uint32_t us);
+void SetResultBytes(int bytes);
+
+struct Options {
+  std::string mode;
+  std::vector<int> result_bytes;
+  std::vector<int> poll_ms;
+  std::vector<int> depth;
+  int cycles;
+  int warmup;
+  uint32_t scan_us;
+  uint32_t link_us;
+  uint32_t vision_us;
+  double max_p99_us;
+  std::string out_path;
+};
+
+// One measured combination of result size, device poll interval and depth.
+struct CaseConfig {
+  std::string name;
+  int result_bytes;
+  int poll_ms;
+  int depth;
+  int expected_len;  // result length the PLC should read back
+};
+
+struct CaseResult {
+  std::vector<double> ack_us;     // TRIGGER raised -> TRIGGER_ACK seen
+  std::vector<double> result_us;  // TRIGGER raised -> RESULT_OK/NG seen
+  double elapsed_us;
+  int ng;
+  int bad_len;
+  int lost;
+  bool stalled;
+};
+
+// Parses the options shared by all drivers. modes lists the accepted --mode
+// values, the first one being the default. Returns false after printing usage.
+bool ParseOptions(int argc, char **argv, const std::vector<std::string> &modes, Options *options);
+
+// Applies a case to the device (poll interval, depth, result area) and
+// returns the result length the PLC should read back.
+typedef std::function<int(const CaseConfig &config)> ApplyCase;
+
+// Enables triggering, runs every combination of the options through the
+// handshake and writes the report. Returns the process exit code.
+int RunBench(const char *protocol, const Options &options, PlcPort *port, const ApplyCase &apply);
+
+// Flushes the report and ends the process. Static destructors are skipped:
+// the module threads keep running and still use them.
+void Exit(int code);
+
+}  // namespace plc_sim
+
+#endif  // INDUSTRIAL_SIM_PLC_SIM_H
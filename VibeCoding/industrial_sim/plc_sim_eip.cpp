@@ -0,0 +1,161 @@
+// EtherNet/IP scanner simulator for ethernetip_msg.cpp. The CIP stack is
+// replaced by the simulated scanner, which calls the module's application
+// interface the way the stack does:
+//
+//   implicit  one I/O cycle per RPI (--scan-us): the output assembly (control
+//             word) is handed to application_data_handle, the input assembly
+//             (status, trigger_id, result_id, result) is read back through
+//             get_data_from_application; each direction costs --link-us.
+//   explicit  the control word goes through set_explicit_output_status and the
+//             status, ids and result are read from the custom object, one
+//             round trip per access. The module's explicit thread polls every
+//             10 ms on its own, so --poll-ms has no effect in either mode.
+
+#include "plc_sim.h"
+
+#include "ethernetip_msg.h"
+#include "cip_application.h"
+
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+const int kInputAssemblyBytes = 500;  // EIP_ASSEMBLY_INPUT_BUFFER_SIZE: 18 header + length + 480 result
+const int kResultCapacity = kInputAssemblyBytes - 20;
+
+struct EipStack {
+  struct eip_app_cfg_para *cfg;
+  volatile int end;
+  uint32_t link_us;
+};
+
+EipStack g_stack;
+
+uint16_t GetShort(const uint8_t *data) {
+  return static_cast<uint16_t>(data[0] | (data[1] << 8));
+}
+
+class ImplicitPort : public plc_sim::PlcPort {
+ public:
+  explicit ImplicitPort(uint32_t rpi_us) : rpi_us_(rpi_us), control_(0), input_(kInputAssemblyBytes, 0) {}
+
+  void WriteControl(uint16_t control) override { control_ = control; }
+
+  // One I/O cycle: O->T with the current control word, then T->O.
+  plc_sim::StatusWindow ReadStatus() override {
+    struct eip_assembly_parameter &assembly = g_stack.cfg->eip_assembly_parameter;
+    plc_sim::StatusWindow window;
+
+    plc_sim::SleepUs(g_stack.link_us);
+    memset(assembly.output_assembly_array.data, 0, assembly.output_assembly_array.length);
+    assembly.output_assembly_array.data[0] = static_cast<uint8_t>(control_);
+    assembly.output_assembly_array.data[1] = static_cast<uint8_t>(control_ >> 8);
+    g_stack.cfg->app_interface->application_data_handle(assembly.app_output_assembly_num);
+    g_stack.cfg->app_interface->get_data_from_application(assembly.app_input_assembly_num);
+    memcpy(&input_[0], assembly.input_assembly_array.data,
+           std::min<size_t>(input_.size(), assembly.input_assembly_array.length));
+    plc_sim::SleepUs(g_stack.link_us);
+
+    window.status = GetShort(&input_[2]);
+    window.trigger_id = GetShort(&input_[12]);
+    window.result_id = GetShort(&input_[14]);
+    return window;
+  }
+
+  int ReadResultLength() override { return GetShort(&input_[18]); }
+
+  void Scan() override { plc_sim::SleepUs(rpi_us_); }
+
+ private:
+  uint32_t rpi_us_;
+  uint16_t control_;
+  std::vector<uint8_t> input_;
+};
+
+class ExplicitPort : public plc_sim::PlcPort {
+ public:
+  explicit ExplicitPort(uint32_t scan_us) : scan_us_(scan_us) {}
+
+  void WriteControl(uint16_t control) override {
+    plc_sim::SleepUs(g_stack.link_us);
+    g_stack.cfg->app_interface->set_explicit_output_status(static_cast<int16_t>(control));
+    plc_sim::SleepUs(g_stack.link_us);
+  }
+
+  plc_sim::StatusWindow ReadStatus() override {
+    const struct eip_custom_object *custom = g_stack.cfg->custom_data;
+    plc_sim::StatusWindow window;
+    plc_sim::SleepUs(g_stack.link_us);
+    window.status = *custom->input_status;
+    window.trigger_id = *custom->trigger_id;
+    window.result_id = *custom->result_id;
+    plc_sim::SleepUs(g_stack.link_us);
+    return window;
+  }
+
+  int ReadResultLength() override {
+    plc_sim::SleepUs(2 * g_stack.link_us);
+    return static_cast<int>(g_stack.cfg->custom_data->result_array->length);
+  }
+
+  void Scan() override { plc_sim::SleepUs(scan_us_); }
+
+ private:
+  uint32_t scan_us_;
+};
+
+}  // namespace
+
+extern "C" {
+
+int configure_eip_para(struct eip_app_cfg_para *cfg) {
+  g_stack.cfg = cfg;
+  g_stack.end = 0;
+  return 0;
+}
+
+void *eip_init(void *ifname) {
+  (void)ifname;
+  while (!g_stack.end) {
+    usleep(10 * 1000);
+  }
+  g_stack.cfg->eip_exit = 1;
+  return NULL;
+}
+
+void cfg_stack_run_status(int status) {
+  if (status == STACK_END) {
+    g_stack.end = 1;
+  }
+}
+
+}  // extern "C"
+
+int main(int argc, char **argv) {
+  plc_sim::Options options;
+  if (!plc_sim::ParseOptions(argc, argv, {"implicit", "explicit"}, &options)) {
+    return 2;
+  }
+  g_stack.link_us = options.link_us;
+
+  plc_sim::StartVision([](char *result, int len) { return ethernetip_send_result(result, len); });
+  ethernetip_set_init_input_size(kInputAssemblyBytes);
+  ethernetip_set_module_enable(1);
+  if (ethernetip_msg_init() != 0) {
+    fprintf(stderr, "ethernetip_msg_init failed\n");
+    return 1;
+  }
+
+  ImplicitPort implicit(options.scan_us);
+  ExplicitPort explicit_port(options.scan_us);
+  plc_sim::PlcPort *port = (options.mode == "explicit") ? static_cast<plc_sim::PlcPort *>(&explicit_port) : &implicit;
+  const int code = plc_sim::RunBench("ethernetip", options, port, [](const plc_sim::CaseConfig &config) {
+    ethernetip_set_pipeline_depth(config.depth);
+    return std::min(config.result_bytes, kResultCapacity);
+  });
+  plc_sim::Exit(code);
+}
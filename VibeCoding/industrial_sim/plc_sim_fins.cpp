@@ -0,0 +1,389 @@
+// FINS PLC simulator for fins_msg.cpp. The simulated PLC node serves FINS/TCP
+// or FINS/UDP on a loopback port, so the module's own transport (fins_net.cpp)
+// is part of the measurement. A request is applied to the DM area --link-us
+// after it arrived and answered --link-us later; requests that are in flight
+// together overlap like on a real link. The PLC program reads its own memory
+// once per scan.
+//
+// DM map: control 0, status window 1..3, result 10 (length + data).
+
+#include "plc_sim.h"
+
+#include "fins_msg.h"
+#include "fins_net.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const int kDmWords = 32768;
+const int kCtrlOffset = 0;
+const int kStatusOffset = 1;
+const int kResultOffset = 10;
+const int kResultWords = MAX_FINS_PAYLOAD_LEN / 2 + 1;
+const int kInsOffset = 1000;
+const int kDmArea = 0x82;
+const int kTcpHeaderLen = 16;
+const uint8_t kServerNode = 1;
+const uint8_t kClientNode = 2;
+
+struct FinsNode {
+  uint16_t dm[kDmWords];
+  std::mutex mutex;
+  uint32_t link_us;
+};
+
+FinsNode g_node;
+
+class NodePort : public plc_sim::PlcPort {
+ public:
+  explicit NodePort(uint32_t scan_us) : scan_us_(scan_us) {}
+
+  void WriteControl(uint16_t control) override {
+    std::lock_guard<std::mutex> lock(g_node.mutex);
+    g_node.dm[kCtrlOffset] = control;
+  }
+
+  plc_sim::StatusWindow ReadStatus() override {
+    std::lock_guard<std::mutex> lock(g_node.mutex);
+    plc_sim::StatusWindow window;
+    window.status = g_node.dm[kStatusOffset];
+    window.trigger_id = g_node.dm[kStatusOffset + 1];
+    window.result_id = g_node.dm[kStatusOffset + 2];
+    return window;
+  }
+
+  int ReadResultLength() override {
+    std::lock_guard<std::mutex> lock(g_node.mutex);
+    return g_node.dm[kResultOffset];
+  }
+
+  void Scan() override { plc_sim::SleepUs(scan_us_); }
+
+ private:
+  uint32_t scan_us_;
+};
+
+uint16_t Get16(const uint8_t *p) { return static_cast<uint16_t>((p[0] << 8) | p[1]); }
+
+uint32_t Get32(const uint8_t *p) {
+  return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+         (static_cast<uint32_t>(p[2]) << 8) | p[3];
+}
+
+void Put16(std::vector<uint8_t> *out, uint16_t v) {
+  out->push_back(static_cast<uint8_t>(v >> 8));
+  out->push_back(static_cast<uint8_t>(v));
+}
+
+void Put32(std::vector<uint8_t> *out, uint32_t v) {
+  Put16(out, static_cast<uint16_t>(v >> 16));
+  Put16(out, static_cast<uint16_t>(v));
+}
+
+// Executes a multiple memory area read (0104) of DM words into rsp.
+void HandleMultiRead(const std::vector<uint8_t> &req, std::vector<uint8_t> *rsp) {
+  const size_t count = (req.size() - 12) / 4;
+  uint16_t end_code = 0;
+  if (count == 0 || (req.size() - 12) % 4 != 0) {
+    end_code = 0x1001;  // command too short
+  }
+  for (size_t i = 0; i < count && end_code == 0; ++i) {
+    if (req[12 + i * 4] != kDmArea || Get16(&req[13 + i * 4]) >= kDmWords) {
+      end_code = 0x1103;  // address range exceeded
+    }
+  }
+  Put16(rsp, end_code);
+  if (end_code != 0) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(g_node.mutex);
+  for (size_t i = 0; i < count; ++i) {
+    rsp->push_back(kDmArea);
+    Put16(rsp, g_node.dm[Get16(&req[13 + i * 4])]);
+  }
+}
+
+// Executes a memory area read (0101), write (0102) or multiple read (0104)
+// on the DM area and returns the response frame, empty when the request is
+// not a FINS command.
+std::vector<uint8_t> HandleFrame(const std::vector<uint8_t> &req) {
+  std::vector<uint8_t> rsp;
+  if (req.size() < 16 || (req[0] & 0x40) != 0) {
+    return rsp;
+  }
+  const uint8_t header[] = {0xC0, 0x00, 0x02, req[6], req[7], req[8], req[3], req[4], req[5], req[9], req[10], req[11]};
+  rsp.assign(header, header + sizeof(header));
+  if (req[10] == 0x01 && req[11] == 0x04) {
+    HandleMultiRead(req, &rsp);
+    return rsp;
+  }
+  if (req.size() < 18) {
+    Put16(&rsp, 0x1001);  // command too short
+    return rsp;
+  }
+
+  const bool read = req[10] == 0x01 && req[11] == 0x01;
+  const bool write = req[10] == 0x01 && req[11] == 0x02;
+  const int offset = Get16(&req[13]);
+  const int count = Get16(&req[16]);
+  uint16_t end_code = 0;
+  if (!read && !write) {
+    end_code = 0x0401;  // undefined command
+  } else if (req[12] != kDmArea || offset + count > kDmWords) {
+    end_code = 0x1103;  // address range exceeded
+  } else if (write && req.size() < 18 + static_cast<size_t>(count) * 2) {
+    end_code = 0x1001;  // command too short
+  }
+  Put16(&rsp, end_code);
+  if (end_code != 0) {
+    return rsp;
+  }
+
+  std::lock_guard<std::mutex> lock(g_node.mutex);
+  for (int i = 0; i < count; ++i) {
+    if (read) {
+      Put16(&rsp, g_node.dm[offset + i]);
+    } else {
+      g_node.dm[offset + i] = Get16(&req[18 + i * 2]);
+    }
+  }
+  return rsp;
+}
+
+struct Pending {
+  uint64_t apply_us;
+  uint64_t reply_us;
+  bool applied;
+  std::vector<uint8_t> request;
+  std::vector<uint8_t> response;
+  sockaddr_in peer;
+};
+
+// One connection (TCP) or socket (UDP) of the node. Received frames are
+// queued with their arrival time; the loop applies and answers them when due.
+class Session {
+ public:
+  Session(int fd, bool udp) : fd_(fd), udp_(udp) {}
+
+  // Returns when the TCP peer closed the connection.
+  void Run() {
+    for (;;) {
+      struct pollfd pfd = {fd_, POLLIN, 0};
+      const int64_t wait_us = NextEventUs();
+      struct timespec ts = {static_cast<time_t>(wait_us / 1000000), static_cast<long>(wait_us % 1000000) * 1000};
+      if (ppoll(&pfd, 1, wait_us < 0 ? NULL : &ts, NULL) > 0 && !Receive()) {
+        return;
+      }
+      Process();
+    }
+  }
+
+ private:
+  int64_t NextEventUs() const {
+    if (queue_.empty()) {
+      return -1;
+    }
+    uint64_t due = queue_.front().reply_us;
+    for (const Pending &item : queue_) {
+      if (!item.applied) {
+        due = std::min(due, item.apply_us);
+        break;
+      }
+    }
+    const uint64_t now = plc_sim::NowUs();
+    return due > now ? static_cast<int64_t>(due - now) : 0;
+  }
+
+  void Queue(const uint8_t *frame, size_t len, const sockaddr_in &peer) {
+    Pending item;
+    item.apply_us = plc_sim::NowUs() + g_node.link_us;
+    item.reply_us = item.apply_us + g_node.link_us;
+    item.applied = false;
+    item.request.assign(frame, frame + len);
+    item.peer = peer;
+    queue_.push_back(item);
+  }
+
+  bool Receive() {
+    uint8_t buf[4096];
+    sockaddr_in peer;
+    socklen_t peer_len = sizeof(peer);
+    memset(&peer, 0, sizeof(peer));
+    const ssize_t n = recvfrom(fd_, buf, sizeof(buf), 0, reinterpret_cast<sockaddr *>(&peer), &peer_len);
+    if (n <= 0) {
+      return udp_;
+    }
+    if (udp_) {
+      Queue(buf, static_cast<size_t>(n), peer);
+      return true;
+    }
+
+    rx_.insert(rx_.end(), buf, buf + n);
+    while (rx_.size() >= static_cast<size_t>(kTcpHeaderLen)) {
+      const size_t frame_len = Get32(&rx_[4]) + 8;
+      if (memcmp(&rx_[0], "FINS", 4) != 0 || frame_len < static_cast<size_t>(kTcpHeaderLen)) {
+        return false;
+      }
+      if (rx_.size() < frame_len) {
+        break;
+      }
+      const uint32_t command = Get32(&rx_[8]);
+      if (command == 0) {
+        // Node address exchange: assign the client node, report ours.
+        std::vector<uint8_t> rsp(rx_.begin(), rx_.begin() + 4);
+        Put32(&rsp, 16);
+        Put32(&rsp, 1);
+        Put32(&rsp, 0);
+        Put32(&rsp, kClientNode);
+        Put32(&rsp, kServerNode);
+        SendAll(rsp);
+      } else if (command == 2) {
+        Queue(&rx_[kTcpHeaderLen], frame_len - kTcpHeaderLen, peer);
+      }
+      rx_.erase(rx_.begin(), rx_.begin() + frame_len);
+    }
+    return true;
+  }
+
+  void Process() {
+    const uint64_t now = plc_sim::NowUs();
+    for (Pending &item : queue_) {
+      if (!item.applied && item.apply_us <= now) {
+        item.response = HandleFrame(item.request);
+        item.applied = true;
+      }
+    }
+    while (!queue_.empty() && queue_.front().applied && queue_.front().reply_us <= now) {
+      const Pending &item = queue_.front();
+      if (!item.response.empty()) {
+        if (udp_) {
+          sendto(fd_, &item.response[0], item.response.size(), 0, reinterpret_cast<const sockaddr *>(&item.peer),
+                 sizeof(item.peer));
+        } else {
+          std::vector<uint8_t> frame;
+          frame.assign({'F', 'I', 'N', 'S'});
+          Put32(&frame, static_cast<uint32_t>(item.response.size() + 8));
+          Put32(&frame, 2);
+          Put32(&frame, 0);
+          frame.insert(frame.end(), item.response.begin(), item.response.end());
+          SendAll(frame);
+        }
+      }
+      queue_.pop_front();
+    }
+  }
+
+  void SendAll(const std::vector<uint8_t> &data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+      const ssize_t n = send(fd_, &data[sent], data.size() - sent, MSG_NOSIGNAL);
+      if (n <= 0) {
+        return;
+      }
+      sent += static_cast<size_t>(n);
+    }
+  }
+
+  int fd_;
+  bool udp_;
+  std::vector<uint8_t> rx_;
+  std::deque<Pending> queue_;
+};
+
+// Binds the node to an ephemeral loopback port and serves it from a detached
+// thread. Returns the port, or -1.
+int StartNode(bool udp) {
+  const int fd = socket(AF_INET, udp ? SOCK_DGRAM : SOCK_STREAM, 0);
+  sockaddr_in addr;
+  socklen_t addr_len = sizeof(addr);
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (fd < 0 || bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || (!udp && listen(fd, 4) != 0) ||
+      getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &addr_len) != 0) {
+    return -1;
+  }
+
+  std::thread([fd, udp]() {
+    if (udp) {
+      Session(fd, true).Run();
+      return;
+    }
+    for (;;) {
+      const int conn = accept(fd, NULL, NULL);
+      if (conn < 0) {
+        continue;
+      }
+      const int one = 1;
+      setsockopt(conn, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      Session(conn, false).Run();
+      close(conn);
+    }
+  }).detach();
+  return ntohs(addr.sin_port);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  plc_sim::Options options;
+  if (!plc_sim::ParseOptions(argc, argv, {"tcp", "udp"}, &options)) {
+    return 2;
+  }
+  const bool udp = options.mode == "udp";
+  g_node.link_us = options.link_us;
+  const int port = StartNode(udp);
+  if (port < 0) {
+    fprintf(stderr, "cannot bind the FINS node\n");
+    return 1;
+  }
+
+  static fins_param_opt param;
+  memset(&param, 0, sizeof(param));
+  param.server_ip = htonl(INADDR_LOOPBACK);
+  param.server_port = port;
+  param.transport = udp ? FINS_NET_UDP : FINS_NET_TCP;
+  param.control_poll_interval = options.poll_ms[0];
+  param.control_space = kDmArea;
+  param.control_offset = kCtrlOffset;
+  param.control_size = 1;
+  param.status_space = kDmArea;
+  param.status_offset = kStatusOffset;
+  param.status_size = 3;
+  param.result_space = kDmArea;
+  param.result_offset = kResultOffset;
+  param.result_size = kResultWords;
+  param.result_timeout = 6;
+  param.ins_space = kDmArea;
+  param.ins_offset = kInsOffset;
+  param.ins_size = 64;
+
+  plc_sim::StartVision([](char *result, int len) { return fins_send_result(result, static_cast<unsigned int>(len)); });
+  if (fins_msg_init(&param) != 0) {
+    fprintf(stderr, "fins_msg_init failed\n");
+    return 1;
+  }
+
+  NodePort node_port(options.scan_us);
+  const int code = plc_sim::RunBench("fins", options, &node_port, [](const plc_sim::CaseConfig &config) {
+    // Both are read by the trigger thread on every poll.
+    param.control_poll_interval = config.poll_ms;
+    param.pipeline_depth = config.depth;
+    return std::min(config.result_bytes, kResultWords * 2 - 2);
+  });
+  plc_sim::Exit(code);
+}
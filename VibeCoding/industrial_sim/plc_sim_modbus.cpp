@@ -0,0 +1,221 @@
+// Modbus TCP PLC simulator for modbus_msg.cpp. The api_modbus.h stack is
+// replaced by two in-process register banks:
+//
+//   server mode  the device's holding registers; the simulated PLC is the
+//                master, each read/write costs a request round trip and a
+//                write calls the module's app_data_handle_function like the
+//                stack does.
+//   client mode  the registers of the simulated PLC slave; every
+//                lib_modbus_read/write_registers of the device costs a round
+//                trip, the PLC program reads its own memory once per scan.
+//
+// Register map: control 0, status window 1..3, result 10 (length + data).
+
+#include "plc_sim.h"
+
+#include "modbus_msg.h"
+
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <mutex>
+
+namespace {
+
+const int kRegisterCount = 65536;
+const int kCtrlAddr = 0;
+const int kStatusAddr = 1;
+const int kResultAddr = 10;
+const int kResultRegs = MAX_MODBUS_PAYLOAD_LEN / 2 + 1;
+const int kUserdataAddr = 1000;
+
+struct ModbusStack {
+  modbus_operator *opt;
+  uint16_t holding[kRegisterCount];  // server mode: the device's holding registers
+  uint16_t slave[kRegisterCount];    // client mode: the PLC's registers
+  std::mutex slave_mutex;
+  uint32_t link_us;
+};
+
+ModbusStack g_stack;
+
+uint16_t LoadRegister(const uint16_t *regs, int addr) {
+  return __atomic_load_n(&regs[addr], __ATOMIC_ACQUIRE);
+}
+
+void StoreRegister(uint16_t *regs, int addr, uint16_t value) {
+  __atomic_store_n(&regs[addr], value, __ATOMIC_RELEASE);
+}
+
+// The PLC as Modbus master polling the device's holding registers.
+class MasterPort : public plc_sim::PlcPort {
+ public:
+  explicit MasterPort(uint32_t scan_us) : scan_us_(scan_us) {}
+
+  void WriteControl(uint16_t control) override {
+    plc_sim::SleepUs(g_stack.link_us);
+    StoreRegister(g_stack.holding, kCtrlAddr, control);
+    g_stack.opt->app_data_handle_function();
+    plc_sim::SleepUs(g_stack.link_us);
+  }
+
+  plc_sim::StatusWindow ReadStatus() override {
+    plc_sim::StatusWindow window;
+    plc_sim::SleepUs(g_stack.link_us);
+    window.status = LoadRegister(g_stack.holding, kStatusAddr);
+    window.trigger_id = LoadRegister(g_stack.holding, kStatusAddr + 1);
+    window.result_id = LoadRegister(g_stack.holding, kStatusAddr + 2);
+    plc_sim::SleepUs(g_stack.link_us);
+    return window;
+  }
+
+  int ReadResultLength() override {
+    plc_sim::SleepUs(2 * g_stack.link_us);
+    return LoadRegister(g_stack.holding, kResultAddr);
+  }
+
+  void Scan() override { plc_sim::SleepUs(scan_us_); }
+
+ private:
+  uint32_t scan_us_;
+};
+
+// The PLC as Modbus slave; the device polls it.
+class SlavePort : public plc_sim::PlcPort {
+ public:
+  explicit SlavePort(uint32_t scan_us) : scan_us_(scan_us) {}
+
+  void WriteControl(uint16_t control) override {
+    std::lock_guard<std::mutex> lock(g_stack.slave_mutex);
+    g_stack.slave[kCtrlAddr] = control;
+  }
+
+  plc_sim::StatusWindow ReadStatus() override {
+    std::lock_guard<std::mutex> lock(g_stack.slave_mutex);
+    plc_sim::StatusWindow window;
+    window.status = g_stack.slave[kStatusAddr];
+    window.trigger_id = g_stack.slave[kStatusAddr + 1];
+    window.result_id = g_stack.slave[kStatusAddr + 2];
+    return window;
+  }
+
+  int ReadResultLength() override {
+    std::lock_guard<std::mutex> lock(g_stack.slave_mutex);
+    return g_stack.slave[kResultAddr];
+  }
+
+  void Scan() override { plc_sim::SleepUs(scan_us_); }
+
+ private:
+  uint32_t scan_us_;
+};
+
+}  // namespace
+
+extern "C" {
+
+int init_lib_modbus_params(modbus_operator *opt) {
+  g_stack.opt = opt;
+  return 0;
+}
+
+int init_lib_modbus(void) {
+  g_stack.opt->inited = 1;
+  while (!g_stack.opt->deinit) {
+    usleep(10 * 1000);
+  }
+  g_stack.opt->modbus_exit = 1;
+  return 0;
+}
+
+int deinit_lib_modbus(void) {
+  return 0;
+}
+
+int cfg_lib_modbus_slave_id(int slave_id) {
+  (void)slave_id;
+  return 0;
+}
+
+void *get_modbus_buffer_addr_space(int space) {
+  return (space == ADDR_SPACE_HOLDING_REGISTER) ? g_stack.holding : NULL;
+}
+
+int lib_modbus_read_registers(int addr, int nb, uint16_t *dest) {
+  if (addr < 0 || nb <= 0 || addr + nb > kRegisterCount) {
+    return -1;
+  }
+  plc_sim::SleepUs(g_stack.link_us);
+  {
+    std::lock_guard<std::mutex> lock(g_stack.slave_mutex);
+    memcpy(dest, &g_stack.slave[addr], nb * sizeof(uint16_t));
+  }
+  plc_sim::SleepUs(g_stack.link_us);
+  return nb;
+}
+
+int lib_modbus_write_registers(int addr, int nb, uint16_t *src) {
+  if (addr < 0 || nb <= 0 || addr + nb > kRegisterCount) {
+    return -1;
+  }
+  plc_sim::SleepUs(g_stack.link_us);
+  {
+    std::lock_guard<std::mutex> lock(g_stack.slave_mutex);
+    memcpy(&g_stack.slave[addr], src, nb * sizeof(uint16_t));
+  }
+  plc_sim::SleepUs(g_stack.link_us);
+  return nb;
+}
+
+}  // extern "C"
+
+int main(int argc, char **argv) {
+  plc_sim::Options options;
+  if (!plc_sim::ParseOptions(argc, argv, {"server", "client"}, &options)) {
+    return 2;
+  }
+  const bool client = options.mode == "client";
+
+  static eALGO_PLAYCTRL play = ALGO_PLAY_CONTINUE;
+  static modbus_para_opt para;
+  memset(&para, 0, sizeof(para));
+  para.iWorkMode = client ? MODBUS_CLIENT_MODE : MODBUS_SERVER_MODE;
+  para.iSlaveId = 1;
+  para.iCtrlAddrOffset = kCtrlAddr;
+  para.iStatusAddrOffset = kStatusAddr;
+  para.iInputAddrOffset = kResultAddr;
+  para.iOutputAddrOffset = kUserdataAddr;
+  para.iCtrlAddrQuantity = 1;
+  para.iStatusAddrQuantity = 3;
+  para.iInputAddrQuantity = kResultRegs;
+  para.iOutputAddrQuantity = 100;
+  para.sys_run_status = &play;
+  para.iModuleEnable = 1;
+  para.iControlPollInterval = options.poll_ms[0];
+  g_stack.link_us = options.link_us;
+
+  plc_sim::StartVision([](char *result, int len) { return modbus_send_result(result, len); });
+  if (init_modbus_msg(&para) != 0) {
+    fprintf(stderr, "init_modbus_msg failed\n");
+    return 1;
+  }
+  const uint64_t start_us = plc_sim::NowUs();
+  while (g_stack.opt == NULL || !g_stack.opt->inited) {
+    if (plc_sim::NowUs() - start_us > 5 * 1000 * 1000) {
+      fprintf(stderr, "modbus stack did not start\n");
+      plc_sim::Exit(1);
+    }
+    usleep(10 * 1000);
+  }
+
+  MasterPort master(options.scan_us);
+  SlavePort slave(options.scan_us);
+  plc_sim::PlcPort *port = client ? static_cast<plc_sim::PlcPort *>(&slave) : &master;
+  const int code = plc_sim::RunBench("modbus", options, port, [](const plc_sim::CaseConfig &config) {
+    para.iControlPollInterval = config.poll_ms;  // read by the client loop on every poll
+    modbus_set_pipeline_depth(config.depth);
+    return std::min(config.result_bytes, kResultRegs * 2 - 2);
+  });
+  plc_sim::Exit(code);
+}
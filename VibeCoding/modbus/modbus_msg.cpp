@@ -26,7 +26,6 @@
 #include <sys/prctl.h>
 #include <net/if.h>
 #include <netinet/in.h>
-#include <regex>
 
 #include "modbus_msg.h"
 #include "api_modbus.h"
@@ -46,14 +45,23 @@
 #include "calibrateapiwapper.h"
 #include "algoutils.h"
 #include "industrial_protocol_debug.h"
+#include "industrial_protocol_event.h"
+#include "industrial_protocol_payload.h"
+#include "industrial_protocol_pipeline.h"
 
 #define DEBUG_GLOBAL_MDC_STRING        "CModbusTransModule"
-#define FLOAT_REG_WITH_SEMICOLON       "(-?\\d+)(\\.\\d+)?(;{1})?"
-#define FLOAT_REG_WITH_COMMA           "(-?\\d+)(\\.\\d+)?(,{1})?"
 
 #define MODBUS_MAX_CONECTION          (6)
 #define MODBUS_MAX_HOLDING_REGS       (65535)
 #define MODBUS_RESULT_TIMEOUT         (6000)
+#define MODBUS_SERVER_IDLE_WAIT_MS    (100)   // 服务端无寄存器写入时的最长等待, 用于结果超时/运行状态检查
+#define MODBUS_CLIENT_ACTIVE_POLL_MS  (1)     // 客户端握手进行中的控制寄存器轮询间隔
+#define MODBUS_CLIENT_ACTIVE_HOLD_MS  (500)   // 握手结束后保持快速轮询的时间, 之后逐步放宽到iControlPollInterval
+#define MODBUS_STATUS_WINDOW_REGS     (3)     // 流水线模式的状态窗口: 状态寄存器、trigger_id、result_id
+#define MODBUS_RESULT_AREA_REGS       (MAX_MODBUS_PAYLOAD_LEN / 2 + 1)	// 客户端结果区最多写的寄存器数: 长度字加数据
+#define MODBUS_RESULT_MERGE_GAP       (8)     // 脏区间隔不超过这么多寄存器时合并成一次FC16写
+#define MODBUS_RESULT_FULL_REFRESH    (100)   // 每写这么多条结果整区重写一次, 0为不做整区刷新
+#define MODBUS_RESULT_MAX_WRITES      (32)
 
 #ifndef min
 #define min(a, b) ((a)<(b)) ? (a) : (b)
@@ -98,6 +106,18 @@ static uint16_t modbus_userdata_quantity = 100;
 static int m_nLogId = 0;
 static int m_nFrame = 0;
 static int m_nTrigger = 0;
+static ind_proto_event_t g_modbus_wakeup = IND_PROTO_EVENT_INITIALIZER;	// 服务端控制寄存器被写入时唤醒触发线程
+static ind_proto_pipeline_t g_modbus_pipeline;	// 流水线握手: 在途触发与待发布结果
+static int g_modbus_pipeline_inited = 0;
+static int g_modbus_pipeline_depth = 0;			// 配置的流水线深度, 状态区放不下状态窗口时按经典握手运行
+static uint16_t g_modbus_trigger_id = 0;		// 状态窗口中显示给PLC的id
+static uint16_t g_modbus_result_id = 0;
+static pthread_mutex_t g_modbus_result_lock = PTHREAD_MUTEX_INITIALIZER;	// 视觉线程与触发线程都会发布结果, 互斥结果区和影子
+static uint16_t g_modbus_result_shadow[MODBUS_RESULT_AREA_REGS];	// 客户端: PLC结果区的当前内容
+static int g_modbus_result_shadow_valid = 0;
+static int g_modbus_result_shadow_addr = 0;	// 影子对应的结果区位置和大小, 配置改变后整区重写
+static int g_modbus_result_shadow_regs = 0;
+static int g_modbus_result_writes = 0;		// 上次整区写之后写过的结果数
 
 static int msg_initialized = 0;
 static int modbus_process = 0;
@@ -283,16 +303,6 @@ static int32_t add_ushort_to_message(uint16_t data, uint8_t **buffer)
 	return 2;
 }
 
-static int32_t add_short_p_to_message(char *data, uint8_t **buffer)
-{
-	uint8_t *p = (uint8_t *) *buffer;
-	p[1] = (uint8_t) *(data);
-	data++;
-	p[0] = (uint8_t) *(data);
-	*buffer += 2;
-	return 2;
-}
-
 static int32_t add_short_to_message_x(char *data, uint8_t **buffer)
 {
 	uint8_t *p = (uint8_t *) *buffer;
@@ -348,27 +358,83 @@ static int modbus_trigger_once(void)
 	return CAlgoUtils::IndustrialProtocolTriggerOnce();
 }
 
+static int modbus_regs_overlap(int addr_a, int num_a, int addr_b, int num_b)
+{
+	return (addr_a < addr_b + num_b) && (addr_b < addr_a + num_a);
+}
+
+/*
+ * 流水线模式的状态窗口占状态区的前MODBUS_STATUS_WINDOW_REGS个寄存器:
+ * 状态寄存器、trigger_id、result_id. 状态区数量不够或窗口与控制区、结果区重叠时返回0
+ */
+static int modbus_pipeline_layout_ok(void)
+{
+	int ctrl_num = (modbus_opt.ctrl_quantity > 1) ? modbus_opt.ctrl_quantity : 1;
+	int result_num = (modbus_opt.result_quantity > 1) ? modbus_opt.result_quantity : 1;
+
+	return (modbus_opt.status_quantity >= MODBUS_STATUS_WINDOW_REGS)
+		&& !modbus_regs_overlap(modbus_opt.status_addr, MODBUS_STATUS_WINDOW_REGS, modbus_opt.ctrl_addr, ctrl_num)
+		&& !modbus_regs_overlap(modbus_opt.status_addr, MODBUS_STATUS_WINDOW_REGS, modbus_opt.result_addr, result_num);
+}
+
+/* 按配置的深度设置流水线, 地址或数量改变后重新检查布局 */
+static void modbus_pipeline_apply_depth(void)
+{
+	int depth = g_modbus_pipeline_depth;
+
+	if (!g_modbus_pipeline_inited)
+	{
+		return;
+	}
+	if ((depth > 1) && !modbus_pipeline_layout_ok())
+	{
+		LOGE("modbus pipeline depth %d disabled: status %d quantity %d must hold %d regs outside control %d(%d) and result %d(%d)\r\n",
+			depth, modbus_opt.status_addr, modbus_opt.status_quantity, MODBUS_STATUS_WINDOW_REGS,
+			modbus_opt.ctrl_addr, modbus_opt.ctrl_quantity, modbus_opt.result_addr, modbus_opt.result_quantity);
+		depth = 0;
+	}
+	ind_proto_pipeline_set_depth(&g_modbus_pipeline, depth);
+}
+
 int modbus_set_input_addr(int addr)
 {
 	modbus_opt.result_addr = addr;
+	modbus_pipeline_apply_depth();
 	return 0;
 }
 
 int modbus_set_control_addr(int addr)
 {
 	modbus_opt.ctrl_addr = addr;
+	modbus_pipeline_apply_depth();
 	return 0;
 }
 
 int modbus_set_status_addr(int addr)
 {
 	modbus_opt.status_addr = addr;
+	modbus_pipeline_apply_depth();
 	return 0;
 }
 
 int modbus_set_input_size(int reg_num)
 {
 	modbus_opt.result_quantity = reg_num;
+	modbus_pipeline_apply_depth();
+	return 0;
+}
+
+int modbus_set_control_size(int reg_num)
+{
+	modbus_opt.ctrl_quantity = reg_num;
+	modbus_pipeline_apply_depth();
+	return 0;
+}
+
+int modbus_set_status_size(int reg_num)
+{
+	modbus_opt.status_quantity = reg_num;
+	modbus_pipeline_apply_depth();
 	return 0;
 }
 
@@ -384,6 +450,28 @@ int modbus_set_output_size(int reg_num)
 	return 0;
 }
 
+static void modbus_pipeline_init_once(void)
+{
+	if (!g_modbus_pipeline_inited && (ind_proto_pipeline_init(&g_modbus_pipeline) == 0))
+	{
+		g_modbus_pipeline_inited = 1;
+	}
+}
+
+int modbus_set_pipeline_depth(int depth)
+{
+	modbus_pipeline_init_once();
+	if (!g_modbus_pipeline_inited)
+	{
+		return IMVS_EC_SYSTEM_INNER_ERR;
+	}
+
+	g_modbus_pipeline_depth = depth;
+	modbus_pipeline_apply_depth();
+	LOGI("modbus pipeline depth set to %d\r\n", depth);
+	return IMVS_EC_OK;
+}
+
 int modbus_set_debug_level(int level)
 {
 	int new_level = MODBUS_DEBUG_LEVEL_OFF;
@@ -427,6 +515,7 @@ int modbus_get_debug_info(char *buff, int buff_size, int *data_len)
 int modbus_deinit(void)
 {
 	modbus_algo_deinit = 1;  //算子释放信号
+	ind_proto_event_signal(&g_modbus_wakeup);
 	while (!modbus_trigger_exit)   //触发线程退出
 	{
 		usleep(10000);
@@ -472,107 +561,178 @@ void set_frame_and_trigger(int nFrame, int nTrigger, int nLogId)
 	m_nTrigger = nTrigger;
 }
 
-int transform_string(char *buf, const char * pattern, char *trans_buf, int *match_num)
+/*
+ * 状态窗口: 状态寄存器; 流水线模式下其后紧跟trigger_id、result_id两个寄存器(状态区的第2、3个寄存器,
+ * 由modbus_pipeline_layout_ok保证在状态区内). 返回寄存器个数
+ */
+static int modbus_status_window(uint16_t *regs)
 {
-	if (NULL == buf || NULL == pattern || NULL == trans_buf || 0 == strlen(buf))
+	regs[0] = modbus_status_event;
+	if (!ind_proto_pipeline_enabled(&g_modbus_pipeline))
 	{
-		return -1;
+		return 1;
 	}
+	regs[1] = g_modbus_trigger_id;
+	regs[2] = g_modbus_result_id;
+	return MODBUS_STATUS_WINDOW_REGS;
+}
 
-    try {
-        std::regex rgx(pattern);
-        std::cmatch cm;
-        const char *s = buf;
-        int n = 0;
-        while (std::regex_search(s, cm, rgx)) {
-            float f = std::stof(cm.str());
-			memcpy(trans_buf+n*4, &f, sizeof f); /* there is a portability issue */
-            s += cm.position() + cm.length();
-            n++;
-			LOGI("n:%d buf:%s f:%lf trans_buf:%s\n", n, buf, f, trans_buf);
-        }
-		*match_num = n;
-    } catch(const std::regex_error& e) {
-        LOGE("regex_error caught: %s\n", e.what());
-        return -2;
-    } catch(const std::invalid_argument& e) {
-        LOGE("invalid_argument caught: %s\n", e.what());
-        return -3;
-    } catch(const std::out_of_range& e) {
-        LOGE("out_of_range caught: %s\n", e.what());
-        return -4;
-    }
+static int modbus_write_status_window(void)
+{
+	uint16_t regs[MODBUS_STATUS_WINDOW_REGS] = {0};
+	uint8_t *status_buf_addr = NULL;
+	int nRegs = modbus_status_window(regs);
+	int ret = 0;
+	int i = 0;
+
+	if (MODBUS_SERVER_MODE == modbus_opt.work_mode)
+	{
+		if (get_modbus_buffer_addr_space(ADDR_SPACE_HOLDING_REGISTER) == NULL)
+		{
+			return -1;
+		}
+		// id先写, 状态寄存器最后写, PLC看到状态变化时id已经更新
+		for (i = nRegs - 1; i >= 0; i--)
+		{
+			status_buf_addr = (uint8_t *)get_modbus_buffer_addr_space(ADDR_SPACE_HOLDING_REGISTER) + (modbus_opt.status_addr + i) * 2;
+			add_ushort_to_message_ni(regs[i], &status_buf_addr);
+		}
+	}
+	else if (MODBUS_CLIENT_MODE == modbus_opt.work_mode)
+	{
+		ret = lib_modbus_write_registers(modbus_opt.status_addr, nRegs, regs);
+		if (ret < 0)
+		{
+			LOGE("[%s]%d ret %d\r\n", __func__, __LINE__, ret);
+			return ret;
+		}
+	}
 
 	return 0;
 }
 
-int character_sequence_handle_for_modbus(int type, char*console_buffer, int nMatchCnt)
+/*
+ * 客户端模式发布结果: 长度字、结果数据(其余寄存器清0)以及与结果区相邻的状态窗口拼成一段连续寄存器.
+ * 结果区只写与g_modbus_result_shadow不同的寄存器, 相近的脏区合并, 每次写不超过FC16上限;
+ * 长度字和状态窗口总是写出. 含长度字(状态窗口合并时为状态寄存器)的那次写最后发出,
+ * PLC看到新的长度/状态时数据已经写完. 影子无效、结果区配置改变或到了整区刷新周期时整区重写.
+ * 状态窗口不相邻时在数据之后单独写. nStatusRegs为0时不写状态. 调用方持有g_modbus_result_lock.
+ */
+static int modbus_client_publish(const uint16_t *payload, int nRegs, uint16_t nLenBytes,
+	const uint16_t *pStatus, int nStatusRegs)
 {
-	int32_t i = 0;
-	char  temp_data = 0;
-	char  temp_data1= 0;
+	uint16_t image[MODBUS_RESULT_AREA_REGS + MODBUS_STATUS_WINDOW_REGS] = {0};
+	uint8_t dirty[MODBUS_RESULT_AREA_REGS + MODBUS_STATUS_WINDOW_REGS] = {0};
+	ind_proto_write_chunk_t chunks[MODBUS_RESULT_MAX_WRITES];
+	int nAreaRegs = ((int)modbus_opt.result_quantity > 1) ? min((int)modbus_opt.result_quantity, MODBUS_RESULT_AREA_REGS) : 1;
+	int nImageLen = 0;
+	int nLenIndex = 0;
+	int nCommitIndex = 0;
+	int nChunks = 0;
+	int nWrittenRegs = 0;
+	int bStatusMerged = 0;
+	int bRefresh = 0;
+	int startAddr = modbus_opt.result_addr;
+	int ret = 0;
+	int i = 0;
 
-	switch(type)
+	if ((nRegs < 0) || (nRegs > nAreaRegs - 1)
+		|| (nStatusRegs < 0) || (nStatusRegs > MODBUS_STATUS_WINDOW_REGS))
 	{
-		case ORDER_CDAB: 
-			for (i = 0; i < nMatchCnt; i++)
-			{
-				temp_data = console_buffer[i*4];
-				console_buffer[i*4] = console_buffer[i*4+1];
-				console_buffer[i*4+1] = temp_data;
-				temp_data = console_buffer[i*4+2];
-				console_buffer[i*4+2] = console_buffer[i*4+3];
-				console_buffer[i*4+3] = temp_data;
-			}
-			break;
+		return -1;
+	}
 
-		case ORDER_DCBA: 
-			break;
+	if ((nStatusRegs > 0) && (modbus_opt.status_addr + nStatusRegs == modbus_opt.result_addr))
+	{
+		memcpy(image, pStatus, nStatusRegs * sizeof(uint16_t));
+		memset(dirty, 1, nStatusRegs);
+		nImageLen = nStatusRegs;
+		startAddr = modbus_opt.status_addr;
+		bStatusMerged = 1;
+	}
+	nLenIndex = nImageLen;
+	image[nLenIndex] = nLenBytes;
+	if (nRegs > 0)
+	{
+		memcpy(&image[nLenIndex + 1], payload, nRegs * sizeof(uint16_t));
+	}
+	nImageLen += nAreaRegs;
+	bRefresh = !g_modbus_result_shadow_valid
+		|| (g_modbus_result_shadow_addr != (int)modbus_opt.result_addr) || (g_modbus_result_shadow_regs != nAreaRegs)
+		|| ((MODBUS_RESULT_FULL_REFRESH > 0) && (g_modbus_result_writes + 1 >= MODBUS_RESULT_FULL_REFRESH));
+	ind_proto_mark_dirty(&image[nLenIndex], bRefresh ? NULL : g_modbus_result_shadow, nAreaRegs, &dirty[nLenIndex]);
+	nCommitIndex = bStatusMerged ? 0 : nLenIndex;
+	if ((nStatusRegs > 0) && !bStatusMerged && (modbus_opt.status_addr == modbus_opt.result_addr + nAreaRegs))
+	{
+		nCommitIndex = nImageLen;
+		memcpy(&image[nImageLen], pStatus, nStatusRegs * sizeof(uint16_t));
+		memset(&dirty[nImageLen], 1, nStatusRegs);
+		nImageLen += nStatusRegs;
+		bStatusMerged = 1;
+	}
+	// 长度字总是写出, 状态窗口合并时它与提交寄存器不是同一个
+	dirty[nLenIndex] = 1;
 
-		case ORDER_BADC: 
-			for (i = 0; i < nMatchCnt; i++)
-			{
-				temp_data = console_buffer[i*4];
-				temp_data1 = console_buffer[i*4+1];
-				console_buffer[i*4] = console_buffer[i*4+2];
-				console_buffer[i*4+1] = console_buffer[i*4+3];
-				console_buffer[i*4+2] = temp_data;
-				console_buffer[i*4+3] = temp_data1;
-			}
-			break;
+	nChunks = ind_proto_plan_dirty_writes(dirty, nImageLen, MODBUS_ONCE_WRIE_MAX_REG, MODBUS_RESULT_MERGE_GAP,
+		nCommitIndex, chunks, MODBUS_RESULT_MAX_WRITES);
+	if (nChunks < 0)
+	{
+		nChunks = ind_proto_plan_writes(nImageLen, MODBUS_ONCE_WRIE_MAX_REG, nCommitIndex,
+			chunks, MODBUS_RESULT_MAX_WRITES);
+	}
+	for (i = 0; i < nChunks; i++)
+	{
+		ret = lib_modbus_write_registers(startAddr + chunks[i].offset, chunks[i].count, &image[chunks[i].offset]);
+		if (ret < 0)
+		{
+			// 后续的写含长度/状态, 不再发出, PLC仍看到上一次的结果; 已写出的部分使结果区内容不再确定
+			g_modbus_result_shadow_valid = 0;
+			LOGE("[%s]%d write %d regs at %d ret %d\r\n", __func__, __LINE__,
+				(int)chunks[i].count, startAddr + (int)chunks[i].offset, ret);
+			return ret;
+		}
+		nWrittenRegs += chunks[i].count;
+	}
+	memcpy(g_modbus_result_shadow, &image[nLenIndex], nAreaRegs * sizeof(uint16_t));
+	g_modbus_result_shadow_valid = 1;
+	g_modbus_result_shadow_addr = modbus_opt.result_addr;
+	g_modbus_result_shadow_regs = nAreaRegs;
+	g_modbus_result_writes = bRefresh ? 0 : (g_modbus_result_writes + 1);
 
-		case ORDER_ABCD: 
-			for (i = 0; i < nMatchCnt; i++)
-			{
-				temp_data = console_buffer[i*4];
-				temp_data1 = console_buffer[i*4+1];
-				console_buffer[i*4] = console_buffer[i*4+3];
-				console_buffer[i*4+1] = console_buffer[i*4+2];
-				console_buffer[i*4+2] = temp_data1;
-				console_buffer[i*4+3] = temp_data;
-			}
-			break;
-		
-		default:
-			break;
+	if ((nStatusRegs > 0) && !bStatusMerged)
+	{
+		memcpy(image, pStatus, nStatusRegs * sizeof(uint16_t));
+		ret = lib_modbus_write_registers(modbus_opt.status_addr, nStatusRegs, image);
+		if (ret < 0)
+		{
+			LOGE("[%s]%d ret %d\r\n", __func__, __LINE__, ret);
+			return ret;
+		}
 	}
+	LOGD("published %d of %d regs in %d write(s)%s, status %s\n", nWrittenRegs, nImageLen,
+		nChunks + ((nStatusRegs > 0) && !bStatusMerged), bRefresh ? " (full refresh)" : "",
+		bStatusMerged ? "merged" : ((nStatusRegs > 0) ? "separate" : "none"));
 
 	return 0;
 }
 
-int modbus_send_result(char *result_ptr, int result_len)
+/*
+ * 写出一条结果: 服务端写入保持寄存器, 客户端经modbus_client_publish写到PLC.
+ * bWithStatus置位时再写状态窗口, 状态位由调用方事先更新. 结果为空时服务端不改结果区, 客户端写长度0.
+ * 调用方持有g_modbus_result_lock.
+ */
+static int modbus_publish_result_locked(char *result_ptr, int result_len, int bWithStatus)
 {
-	char strRexbuf[MAX_MODBUS_REGULAR_LEN] = {0};
-	char strTransBuf[MAX_MODBUS_PAYLOAD_LEN] = {0};
 	uint16_t tmp_result_buf[MAX_MODBUS_PAYLOAD_LEN / 2] = {0};
+	uint16_t status_regs[MODBUS_STATUS_WINDOW_REGS] = {0};
+	int nStatusRegs = 0;
 	int32_t nMatchCnt = 0;
+	int32_t nMaxFloats = 0;
+	size_t nTextLen = 0;
 	uint8_t *status_buf_addr = NULL;
 	uint8_t *result_buf_addr = NULL;
 	int32_t ret = 0;
 	int32_t i = 0;
-	int32_t write_cnt = 0;
-	int32_t write_rem = 0;
-	LOGI("work_mode:%d trigger_cnt: %d result_len %d, recv msg %s\r\n", modbus_opt.work_mode, m_nTrigger, result_len, result_ptr);
 
 	if (MODBUS_SERVER_MODE == modbus_opt.work_mode)
 	{
@@ -586,6 +746,7 @@ int modbus_send_result(char *result_ptr, int result_len)
 		if ((result_ptr != NULL) && (result_len > 0))
 		{
 			memset(result_buf_addr, 0x0, modbus_opt.result_quantity * 2);
+			nTextLen = strnlen(result_ptr, result_len);
 			
 			if (result_len > modbus_opt.result_quantity * 2 - 2)
 			{
@@ -595,31 +756,23 @@ int modbus_send_result(char *result_ptr, int result_len)
 			if ((modbus_para != NULL)
 				&& modbus_para->iByteOrderEnable)
 			{
-				if (SEMICOLON == modbus_para->iSpacer)
-				{
-					snprintf(strRexbuf, MAX_MODBUS_REGULAR_LEN, "%s", FLOAT_REG_WITH_SEMICOLON);
-				}
-				else if(COMMA == modbus_para->iSpacer)
-				{
-					snprintf(strRexbuf, MAX_MODBUS_REGULAR_LEN, "%s", FLOAT_REG_WITH_COMMA);
-				}
-				
-				if ((ret = transform_string(result_ptr, strRexbuf, strTransBuf, &nMatchCnt)) != 0)
+				// 结果中的数值逐个转为float并按字节序直接写成寄存器值, 每个float占两个寄存器
+				nMaxFloats = min(((int)modbus_opt.result_quantity - 1) / 2, MAX_MODBUS_PAYLOAD_LEN / 4);
+				if ((ret = ind_proto_encode_floats(result_ptr, nTextLen, modbus_para->iByteOrder,
+					tmp_result_buf, nMaxFloats, &nMatchCnt)) != 0)
 				{
 					LOGE("transform err : %d\n", ret);
 					return ret;
 				}
 				
-				character_sequence_handle_for_modbus(modbus_para->iByteOrder, strTransBuf, nMatchCnt);
-				
 				result_len = nMatchCnt * sizeof(float);
 				add_ushort_to_message((uint16_t)result_len, &result_buf_addr);
 
-				LOGI("result_len:%d nMatchCnt:%d buf:%s\n", result_len, nMatchCnt, strTransBuf);
+				LOGD("result_len:%d nMatchCnt:%d\n", result_len, nMatchCnt);
 
-				for (i = 0; i < result_len; i += 2)
+				for (i = 0; i < result_len / 2; i++)
 				{
-					add_short_p_to_message(&strTransBuf[i], &result_buf_addr);
+					add_ushort_to_message(tmp_result_buf[i], &result_buf_addr);
 				}
 			}
 			else
@@ -631,33 +784,22 @@ int modbus_send_result(char *result_ptr, int result_len)
 					add_short_to_message_x(&result_ptr[i], &result_buf_addr);
 				}
 			}
-			
-			if (modbus_waiting_result)
-			{
-				modbus_waiting_result = 0;
-				MB_SET_BIT(modbus_status_event, MBS_RESULT_OK_BIT);
-				MB_CLR_BIT(modbus_status_event, MBS_ACQUIRING_BIT);
-				MB_CLR_BIT(modbus_status_event, MBS_DECODING_BIT);
-				add_ushort_to_message_ni(modbus_status_event, &status_buf_addr);
-			}
 		}
-		else
+		
+		if (bWithStatus)
 		{
-			if (modbus_waiting_result)
-			{
-				modbus_waiting_result = 0;
-				MB_SET_BIT(modbus_status_event, MBS_RESULT_NG_BIT);
-				MB_CLR_BIT(modbus_status_event, MBS_ACQUIRING_BIT);
-				MB_CLR_BIT(modbus_status_event, MBS_DECODING_BIT);
-				add_ushort_to_message_ni(modbus_status_event, &status_buf_addr);
-			}
+			ret = modbus_write_status_window();
 		}
 	}
 	else if (MODBUS_CLIENT_MODE == modbus_opt.work_mode)
 	{
+		if (bWithStatus)
+		{
+			nStatusRegs = modbus_status_window(status_regs);
+		}
 		if ((result_ptr != NULL) && (result_len > 0))
 		{
-			memset(tmp_result_buf, 0x0, sizeof(tmp_result_buf));
+			nTextLen = strnlen(result_ptr, result_len);
 			
 			if (result_len > modbus_opt.result_quantity * 2 - 2)
 			{
@@ -667,129 +809,137 @@ int modbus_send_result(char *result_ptr, int result_len)
 			if ((modbus_para != NULL)
 				&& modbus_para->iByteOrderEnable)
 			{
-				if (SEMICOLON == modbus_para->iSpacer)
-				{
-					snprintf(strRexbuf, MAX_MODBUS_REGULAR_LEN, "%s", FLOAT_REG_WITH_SEMICOLON);
-				}
-				else if(COMMA == modbus_para->iSpacer)
-				{
-					snprintf(strRexbuf, MAX_MODBUS_REGULAR_LEN, "%s", FLOAT_REG_WITH_COMMA);
-				}
-				
-				if ((ret = transform_string(result_ptr, strRexbuf, strTransBuf, &nMatchCnt)) != 0)
+				// 数值直接编码进待写寄存器, 不再经过中间字节缓冲
+				nMaxFloats = min(((int)modbus_opt.result_quantity - 1) / 2, MAX_MODBUS_PAYLOAD_LEN / 4);
+				if ((ret = ind_proto_encode_floats(result_ptr, nTextLen, modbus_para->iByteOrder,
+					tmp_result_buf, nMaxFloats, &nMatchCnt)) != 0)
 				{
 					LOGE("transform err : %d\n", ret);
 					return ret;
 				}
 				
-				character_sequence_handle_for_modbus(modbus_para->iByteOrder, strTransBuf, nMatchCnt);
-				
 				result_len = nMatchCnt * sizeof(float);
-				lib_modbus_write_registers(modbus_opt.result_addr, 1, (uint16_t *)&result_len);
-				for (i = 0; i < result_len; i += 2)
-				{
-					tmp_result_buf[i/2] = strTransBuf[i + 1] | (strTransBuf[i] << 8);
-				}
 			}
 			else
 			{
-				ret = lib_modbus_write_registers(modbus_opt.result_addr, 1, (uint16_t *)&result_len);
-				if (ret < 0)
-				{
-					LOGE("[%s]%d ret %d\r\n", __func__, __LINE__, ret);
-				}
-				for (i = 0; i < result_len; i += 2)
-				{
-					tmp_result_buf[i/2] = result_ptr[i] | (result_ptr[i + 1] << 8);
-					
-				}
-			}
-
-			write_cnt = (result_len % 2 ? result_len / 2 + 1 : result_len / 2) / MODBUS_ONCE_WRIE_MAX_REG;
-			write_rem = (result_len % 2 ? result_len / 2 + 1 : result_len / 2) % MODBUS_ONCE_WRIE_MAX_REG;
-
-			for (i = 0; i < write_cnt; i++)
-			{
-				ret = lib_modbus_write_registers(modbus_opt.result_addr + 1 + i * MODBUS_ONCE_WRIE_MAX_REG,
-					MODBUS_ONCE_WRIE_MAX_REG, tmp_result_buf + i * MODBUS_ONCE_WRIE_MAX_REG);
-				if (ret < 0)
-				{
-					LOGE("[%s]%d ret %d\r\n", __func__, __LINE__, ret);
-				}
-			}
-			if(write_rem)
-			{
-				ret = lib_modbus_write_registers(modbus_opt.result_addr + 1 + write_cnt * MODBUS_ONCE_WRIE_MAX_REG,
-					write_rem, tmp_result_buf + write_cnt * MODBUS_ONCE_WRIE_MAX_REG);
-				if (ret < 0)
-				{
-					LOGE("[%s]%d ret %d\r\n", __func__, __LINE__, ret);
-				}
-			}
-			if (modbus_waiting_result)
-			{
-				modbus_waiting_result = 0;
-				MB_SET_BIT(modbus_status_event, MBS_RESULT_OK_BIT);
-				MB_CLR_BIT(modbus_status_event, MBS_ACQUIRING_BIT);
-				MB_CLR_BIT(modbus_status_event, MBS_DECODING_BIT);
-				lib_modbus_write_registers(modbus_opt.status_addr, 1, (uint16_t *)&modbus_status_event);
-			}
-		}
-		else if (0 == result_len)
-		{
-			memset(tmp_result_buf, 0x0, sizeof(tmp_result_buf));
-			ret = lib_modbus_write_registers(modbus_opt.result_addr, 1, (uint16_t *)&result_len);
-			if (ret < 0)
-			{
-				LOGE("[%s]%d ret %d\r\n", __func__, __LINE__, ret);
+				result_len = min(result_len, MAX_MODBUS_PAYLOAD_LEN);
+				ind_proto_pack_words(result_ptr, result_len, 0, tmp_result_buf);
 			}
-			write_cnt = (result_len % 2 ? result_len / 2 + 1 : result_len / 2) / MODBUS_ONCE_WRIE_MAX_REG;
-			write_rem = (result_len % 2 ? result_len / 2 + 1 : result_len / 2) % MODBUS_ONCE_WRIE_MAX_REG;
 
-			for (i = 0; i < write_cnt; i++)
-			{
-				ret = lib_modbus_write_registers(modbus_opt.result_addr + 1 + i * MODBUS_ONCE_WRIE_MAX_REG,
-					MODBUS_ONCE_WRIE_MAX_REG, tmp_result_buf + i * MODBUS_ONCE_WRIE_MAX_REG);
-				if (ret < 0)
-				{
-					LOGE("[%s]%d ret %d\r\n", __func__, __LINE__, ret);
-				}
-			}
-			if(write_rem)
-			{
-				ret = lib_modbus_write_registers(modbus_opt.result_addr + 1 + write_cnt * MODBUS_ONCE_WRIE_MAX_REG,
-					write_rem, tmp_result_buf + write_cnt * MODBUS_ONCE_WRIE_MAX_REG);
-				if (ret < 0)
-				{
-					LOGE("[%s]%d ret %d\r\n", __func__, __LINE__, ret);
-				}
-			}
-			
-			if (modbus_waiting_result)
-			{
-				modbus_waiting_result = 0;
-				MB_SET_BIT(modbus_status_event, MBS_RESULT_NG_BIT);
-				MB_CLR_BIT(modbus_status_event, MBS_ACQUIRING_BIT);
-				MB_CLR_BIT(modbus_status_event, MBS_DECODING_BIT);
-				lib_modbus_write_registers(modbus_opt.status_addr, 1, (uint16_t *)&modbus_status_event);
-			}
+			ret = modbus_client_publish(tmp_result_buf, (result_len + 1) / 2, (uint16_t)result_len, status_regs, nStatusRegs);
 		}
 		else
 		{
-			return -1;
+			ret = modbus_client_publish(NULL, 0, 0, status_regs, nStatusRegs);
 		}
 	}
-	else
+	
+	return (ret < 0) ? ret : 0;
+}
+
+static int modbus_publish_result(char *result_ptr, int result_len, int bWithStatus)
+{
+	int ret = 0;
+
+	pthread_mutex_lock(&g_modbus_result_lock);
+	ret = modbus_publish_result_locked(result_ptr, result_len, bWithStatus);
+	pthread_mutex_unlock(&g_modbus_result_lock);
+
+	return ret;
+}
+
+/* 连接可能已重建, PLC结果区内容未知, 下一次结果整区重写 */
+static void modbus_invalidate_result_shadow(void)
+{
+	pthread_mutex_lock(&g_modbus_result_lock);
+	g_modbus_result_shadow_valid = 0;
+	pthread_mutex_unlock(&g_modbus_result_lock);
+}
+
+/*
+ * 经典握手发布结果: 等待中的触发随之完成(RESULT_OK/NG). 指令应答直接走这里,
+ * 不进入流水线; 流水线只接收modbus_send_result送来的视觉结果
+ */
+static int modbus_send_classic_result(char *result_ptr, int result_len)
+{
+	int bResultOk = (result_ptr != NULL) && (result_len > 0);
+	int bWithStatus = 0;
+
+	if (modbus_waiting_result)
 	{
-		//not handle
+		modbus_waiting_result = 0;
+		MB_SET_BIT(modbus_status_event, bResultOk ? MBS_RESULT_OK_BIT : MBS_RESULT_NG_BIT);
+		MB_CLR_BIT(modbus_status_event, MBS_ACQUIRING_BIT);
+		MB_CLR_BIT(modbus_status_event, MBS_DECODING_BIT);
+		bWithStatus = 1;
 	}
 	
-	return 0;
+	return modbus_publish_result(result_ptr, result_len, bWithStatus);
+}
+
+int modbus_send_result(char *result_ptr, int result_len)
+{
+	int bResultOk = (result_ptr != NULL) && (result_len > 0);
+	LOGI("work_mode:%d trigger_cnt: %d result_len %d, recv msg %s\r\n", modbus_opt.work_mode, m_nTrigger, result_len, result_ptr);
+
+	if ((MODBUS_SERVER_MODE != modbus_opt.work_mode) && (MODBUS_CLIENT_MODE != modbus_opt.work_mode))
+	{
+		return 0;	//not handle
+	}
+	if ((MODBUS_CLIENT_MODE == modbus_opt.work_mode) && !bResultOk && (0 != result_len))
+	{
+		return -1;
+	}
+
+	// 流水线模式: 结果按触发顺序进入FIFO, 由触发线程按序发布
+	if (ind_proto_pipeline_complete(&g_modbus_pipeline, result_ptr, bResultOk ? result_len : 0,
+		ind_proto_monotonic_ms()) >= 0)
+	{
+		ind_proto_event_signal(&g_modbus_wakeup);
+		return 0;
+	}
+
+	return modbus_send_classic_result(result_ptr, result_len);
+}
+
+/*
+ * 流水线模式下的一次握手处理: 接受触发、发布FIFO头部的结果、处理结果应答, 更新状态窗口
+ */
+static void modbus_pipeline_process(void)
+{
+	static ind_proto_pipeline_result_t result;	// 单条结果较大, 不放在触发线程栈上
+	uint16_t status_event = modbus_status_event;
+	int flags = 0;
+	int ret = 0;
+
+	flags = ind_proto_pipeline_step(&g_modbus_pipeline, modbus_control_event, &status_event,
+		&g_modbus_trigger_id, &g_modbus_result_id, &result, ind_proto_monotonic_ms(), MODBUS_RESULT_TIMEOUT);
+	modbus_status_event = status_event;
+
+	if (flags & IND_PROTO_PIPELINE_TRIGGERED)
+	{
+		modbus_trigger_once();
+		modbus_debug_record_event("pipeline_trigger", 0, 0);
+	}
+	if (flags & IND_PROTO_PIPELINE_PUBLISH)
+	{
+		ret = modbus_publish_result(result.data, result.len, 1);
+		modbus_debug_record_event(result.len > 0 ? "pipeline_result_ok" : "pipeline_result_ng", 0, result.len == 0);
+	}
+	else if (flags & IND_PROTO_PIPELINE_STATUS)
+	{
+		ret = modbus_write_status_window();
+	}
+	if (ret != 0)
+	{
+		LOGE("modbus pipeline write error %d\r\n", ret);
+	}
 }
 
 int modbus_write_registers_callback(void)
 {
 	uint8_t *control_buf_addr = NULL;
+	uint16_t control_event = 0;
 	int ret = IMVS_EC_OK;
 	
 	control_buf_addr = (uint8_t *)get_modbus_buffer_addr_space(ADDR_SPACE_HOLDING_REGISTER) + modbus_opt.ctrl_addr * 2;
@@ -797,7 +947,12 @@ int modbus_write_registers_callback(void)
 	{
 		if (modbus_para->iModuleEnable)
 		{
-			modbus_control_event = get_ushort_from_message_ni(&control_buf_addr);
+			control_event = get_ushort_from_message_ni(&control_buf_addr);
+			if (control_event != modbus_control_event)
+			{
+				modbus_control_event = control_event;
+				ind_proto_event_signal(&g_modbus_wakeup);	// 触发线程立即处理, 不等下一个轮询周期
+			}
 		}
 	}
 	else
@@ -825,7 +980,13 @@ static void *modbus_trigger_process(void *args)
 	uint8_t prev_trigger_step = 0;
 	uint8_t prev_waiting_result = 0;
 	uint64_t last_heartbeat_ms = 0;
+	ind_proto_poll_t client_poll;
+	uint16_t poll_control_event = 0;
+	uint16_t poll_status_event = 0;
+	int poll_busy = 0;
 	char thread_name[16] = {0};
+
+	ind_proto_poll_init(&client_poll, MODBUS_CLIENT_ACTIVE_POLL_MS, MODBUS_CLIENT_ACTIVE_HOLD_MS);
 	if (modbus_opt.work_mode)
 	{
 		snprintf(thread_name, sizeof(thread_name), "modbus_client");
@@ -892,6 +1053,11 @@ static void *modbus_trigger_process(void *args)
 						break;
 				case 2:
 					{
+						if (ind_proto_pipeline_enabled(&g_modbus_pipeline))
+						{
+							modbus_pipeline_process();
+							break;
+						}
 						if (MB_CHK_BIT(modbus_control_event, MBC_TRIGGER_BIT)
 							&& MB_CHK_BIT(modbus_status_event, MBS_TRIGGER_READY_BIT))
 						{
@@ -1003,10 +1169,10 @@ static void *modbus_trigger_process(void *args)
 							modbus_debug_record_event("cmd_ng", trigger_elapsed_ms, 1);
 						}
 
-						ret = modbus_send_result(const_cast<char*>(result.c_str()), result.length());
+						ret = modbus_send_classic_result(const_cast<char*>(result.c_str()), result.length());
 						if (0 != ret)
 						{
-							LOGE("modbus_send_result error %d\r\n", ret);
+							LOGE("modbus_send_classic_result error %d\r\n", ret);
 						}
 					}
 					else
@@ -1036,6 +1202,7 @@ static void *modbus_trigger_process(void *args)
 					modbus_trigger_step = 1;
 					modbus_status_event = 0;				
 					modbus_waiting_result = 0;
+					ind_proto_pipeline_reset(&g_modbus_pipeline);
 					add_ushort_to_message(modbus_status_event, &status_buf_addr);
 					modbus_debug_record_event("clear_error", trigger_elapsed_ms, 1);
 				}
@@ -1057,15 +1224,24 @@ static void *modbus_trigger_process(void *args)
 				}
 			}
 			
-			usleep(10000);
+			// 控制寄存器变化由写回调唤醒; 超时只用于结果超时和运行状态的检查
+			ind_proto_event_wait(&g_modbus_wakeup, MODBUS_SERVER_IDLE_WAIT_MS);
 		}
 		else if (MODBUS_CLIENT_MODE == modbus_opt.work_mode)
 		{
-			usleep(modbus_para->iControlPollInterval * 1000);
+			// 握手进行中(已应答触发/等待结果/寄存器刚变化)时快速轮询, 空闲后逐步放宽到配置的轮询间隔
+			poll_busy = (modbus_trigger_step == 3) || modbus_waiting_result
+				|| (ind_proto_pipeline_outstanding(&g_modbus_pipeline) > 0)
+				|| (modbus_control_event != poll_control_event) || (modbus_status_event != poll_status_event);
+			poll_control_event = modbus_control_event;
+			poll_status_event = modbus_status_event;
+			usleep(ind_proto_poll_next(&client_poll, poll_busy, ind_proto_monotonic_ms(),
+				(modbus_para->iControlPollInterval > 0) ? (uint32_t)modbus_para->iControlPollInterval : 0) * 1000);
 
 			ret = lib_modbus_read_registers(modbus_opt.ctrl_addr, 1, &modbus_control_event);
 			if (ret < 0)
 			{
+				modbus_invalidate_result_shadow();
 				usleep(100000);
 				continue;
 			}
@@ -1088,6 +1264,11 @@ static void *modbus_trigger_process(void *args)
 					break;
 				case 2:
 					{
+						if (ind_proto_pipeline_enabled(&g_modbus_pipeline))
+						{
+							modbus_pipeline_process();
+							break;
+						}
 						if (MB_CHK_BIT(modbus_control_event, MBC_TRIGGER_BIT)
 							&& MB_CHK_BIT(modbus_status_event, MBS_TRIGGER_READY_BIT))
 						{
@@ -1204,10 +1385,10 @@ static void *modbus_trigger_process(void *args)
 							modbus_debug_record_event("cmd_ng", trigger_elapsed_ms, 1);
 						}
 
-						ret = modbus_send_result(const_cast<char*>(result.c_str()), result.length());
+						ret = modbus_send_classic_result(const_cast<char*>(result.c_str()), result.length());
 						if (0 != ret)
 						{
-							LOGE("modbus_send_result error %d\r\n", ret);
+							LOGE("modbus_send_classic_result error %d\r\n", ret);
 						}
 					}
 					else
@@ -1237,6 +1418,7 @@ static void *modbus_trigger_process(void *args)
 					modbus_trigger_step = 1;
 					modbus_status_event = 0;
 					modbus_waiting_result = 0;
+					ind_proto_pipeline_reset(&g_modbus_pipeline);
 					lib_modbus_write_registers(modbus_opt.status_addr, 1, &modbus_status_event);
 					modbus_debug_record_event("clear_error", trigger_elapsed_ms, 1);
 				}
@@ -1307,6 +1489,7 @@ static void modbus_stack_process(void *arg)
 	modbus_opt.status_quantity = modbus_para->iStatusAddrQuantity;
 	modbus_opt.result_quantity = modbus_para->iInputAddrQuantity;
 	modbus_userdata_quantity = modbus_para->iOutputAddrQuantity;
+	modbus_pipeline_apply_depth();
 	modbus_opt.app_data_handle_function = modbus_write_registers_callback;
 	modbus_opt.deinit = 0;
 	modbus_opt.inited = 0;
@@ -1320,6 +1503,7 @@ static void modbus_stack_process(void *arg)
 		modbus_opt.inited = 0;
 		modbus_opt.modbus_exit = 0;
 		LOGI("[prt param]: modbus_opt.slave_id  =%d, modbus_opt.server_ip = %d%\r\n", modbus_opt.slave_id, modbus_opt.server_ip);
+		modbus_invalidate_result_shadow();
 		ret = init_lib_modbus();
 		if (ret < 0)
 		{
@@ -1410,6 +1594,11 @@ int init_modbus_msg(modbus_para_opt *para)
 	int ret = -1;
 
 	modbus_debug_init_once();
+	modbus_pipeline_init_once();
+	if (ind_proto_event_open(&g_modbus_wakeup) != 0)
+	{
+		LOGE("modbus wakeup eventfd open failed, errno %d, fall back to polling\r\n", errno);
+	}
 	
 	if (msg_initialized)
 	{
@@ -32,9 +32,8 @@ extern "C" {
 		((unsigned char *)&(ip))[0]
 
 #define MAX_MODBUS_PAYLOAD_LEN (1280)
-#define MAX_MODBUS_REGULAR_LEN (128)
 #ifndef MODBUS_ONCE_WRIE_MAX_REG
-#define MODBUS_ONCE_WRIE_MAX_REG (100)
+#define MODBUS_ONCE_WRIE_MAX_REG (123)	// FC16单次最多写123个寄存器
 #endif
 enum modbus_byte_order
 {
@@ -86,6 +85,7 @@ typedef struct
 	enum modbus_spacer iSpacer;
 	int iModuleEnable;
 	int iControlPollInterval;
+	int iPipelineDepth;		// 流水线握手的在途触发数, 0/1为经典握手
 }modbus_para_opt;
 
 int init_modbus_msg(modbus_para_opt *para);
@@ -98,16 +98,17 @@ int modbus_set_slaveId(void);
 int modbus_set_input_addr(int addr);
 int modbus_set_control_addr(int addr);
 int modbus_set_status_addr(int addr);
+int modbus_set_control_size(int reg_num);
+int modbus_set_status_size(int reg_num);
 int modbus_set_output_addr(int addr);
 int modbus_set_debug_level(int level);
 int modbus_get_debug_level(void);
 int modbus_get_debug_info(char *buff, int buff_size, int *data_len);
+int modbus_set_pipeline_depth(int depth);
 
 void set_frame_and_trigger(int nFrame, int nTrigger, int nLogId);
 int set_procedure_name(const char* szProcedureName);
 
-int character_sequence_handle_for_modbus(int type,char*console_buffer);
-
 #ifdef __cplusplus
 }
 #endif
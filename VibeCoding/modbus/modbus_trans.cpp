@@ -125,6 +125,7 @@ CModbusTransModule::CModbusTransModule(void)
 	modbus_para.iByteOrderEnable = 0;
 	modbus_para.iSpacer = SEMICOLON;
 	modbus_para.iControlPollInterval = 0;
+	modbus_para.iPipelineDepth = 0;
 }
 
 CModbusTransModule::~CModbusTransModule(void)
@@ -198,6 +199,16 @@ int CModbusTransModule::SetModbusControlPollInterval(int nTimes)
 	return IMVS_EC_OK;
 }
 
+int CModbusTransModule::SetModbusPipelineDepth(int nDepth)
+{
+	int nRet = modbus_set_pipeline_depth(nDepth);
+	if (IMVS_EC_OK == nRet)
+	{
+		modbus_para.iPipelineDepth = nDepth;
+	}
+	return nRet;
+}
+
 
 int CModbusTransModule::SetByteOrderEnable(int nType)
 {
@@ -287,6 +298,7 @@ int CModbusTransModule::SetControlAddressQuantity(int nNum)
 {
 	int nErrCode = IMVS_EC_OK;
 	modbus_para.iCtrlAddrQuantity = nNum;
+	modbus_set_control_size(nNum);
 	
 	return nErrCode;
 }
@@ -295,6 +307,7 @@ int CModbusTransModule::SetStatusAddressQuantity(int nNum)
 {
 	int nErrCode = IMVS_EC_OK;
 	modbus_para.iStatusAddrQuantity = nNum;
+	modbus_set_status_size(nNum);
 
 	return nErrCode;
 }
@@ -393,6 +406,12 @@ int CModbusTransModule::GetModbusControlPollInterval(int* nTimes)
 	return IMVS_EC_OK;
 }
 
+int CModbusTransModule::GetModbusPipelineDepth(int* nDepth)
+{
+	*nDepth = modbus_para.iPipelineDepth;
+	return IMVS_EC_OK;
+}
+
 int CModbusTransModule::GetByteOrder(int *nType)
 {
 	int nErrCode = IMVS_EC_OK;
@@ -768,6 +787,11 @@ int CModbusTransModule::GetmoduParaHandle(IN const char* szParamName, OUT char*
 		nErrCode = GetModbusControlPollInterval(&nValue);
 		nValueType = 1;
 	}
+	else if (0 == strcmp(szParamName, "PipelineDepth"))
+	{
+		nErrCode = GetModbusPipelineDepth(&nValue);
+		nValueType = 1;
+	}
 	else if (0 == strcmp(szParamName, "ByteOrder"))
 	{
 		nErrCode = GetByteOrder(&nValue);
@@ -962,6 +986,10 @@ int CModbusTransModule::SetmoduParaHandle(IN const char* szParamName, IN const c
 	{
 		nErrCode = SetModbusControlPollInterval(atoi(pData));
 	}
+	else if (0 == strcmp(szParamName, "PipelineDepth"))
+	{
+		nErrCode = SetModbusPipelineDepth(atoi(pData));
+	}
 	else if (0 == strcmp(szParamName, "ByteOrder"))
 	{
 		nErrCode = SetByteOrder(atoi(pData));
@@ -80,6 +80,7 @@ private:
 	int SetModbusServerPort(int nPort);
 	int SetModbusSlaveId(int nSlaveId);
 	int SetModbusControlPollInterval(int nTimes);
+	int SetModbusPipelineDepth(int nDepth);
 	int SetByteOrderEnable(int nType);
 	int SetSpacer(int nSpacer);
 	int SetControlAddressSpaceType(int nType);
@@ -102,6 +103,7 @@ private:
 	int GetModbusServerPort(int* nPort);
 	int GetModbusSlaveId(int* nSlaveId);
 	int GetModbusControlPollInterval(int* nTimes);
+	int GetModbusPipelineDepth(int* nDepth);
 	int GetByteOrder(int *nType);
 	int GetMaxConnection(int *nCon);
 	int GetIdleTimeoutUsec(int *nUsec);
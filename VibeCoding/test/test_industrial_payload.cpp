@@ -0,0 +1,178 @@
+// Logic tests for the result payload helpers in industrial_protocol_payload.h.
+// Build and run from VibeCoding/:
+//
+//   g++ -std=c++11 -O2 -Wall -Wextra test/test_industrial_payload.cpp -o /tmp/industrial_payload_test
+//   /tmp/industrial_payload_test
+
+#include "../industrial_protocol_payload.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+namespace {
+
+void Expect(bool condition, const std::string &message) {
+  if (!condition) {
+    std::cerr << "[FAIL] " << message << std::endl;
+    std::exit(1);
+  }
+}
+
+uint32_t Bits(float value) {
+  uint32_t bits = 0;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+// Scans |text| as one number and checks the result against strtof, bit for
+// bit (so -0 keeps its sign), or against strtof's ERANGE.
+void ExpectScanMatchesStrtof(const std::string &text) {
+  const char *cursor = text.c_str();
+  float value = 0.0f;
+  const int ret = ind_proto_scan_float(&cursor, text.c_str() + text.size(), &value);
+
+  errno = 0;
+  const float expected = std::strtof(text.c_str(), nullptr);
+  if (errno == ERANGE) {
+    Expect(ret == IND_PROTO_PAYLOAD_ERR_RANGE, "out of range should be reported for " + text);
+    return;
+  }
+  Expect(ret == 1, "a number should be found in " + text);
+  Expect(cursor == text.c_str() + text.size(), "the whole number should be consumed in " + text);
+  Expect(Bits(value) == Bits(expected), "scan should match strtof for " + text);
+}
+
+void TestScanFloatEdgeCases() {
+  // Around 2^24, where the fast path hands over to strtof.
+  ExpectScanMatchesStrtof("16777215");
+  ExpectScanMatchesStrtof("16777216");
+  ExpectScanMatchesStrtof("16777217");
+  ExpectScanMatchesStrtof("1677721.7");
+  ExpectScanMatchesStrtof("-16777217");
+
+  // 10 fraction digits stay on the fast path, 11 go through strtof.
+  ExpectScanMatchesStrtof("0.1234567891");
+  ExpectScanMatchesStrtof("0.0000012345");
+  ExpectScanMatchesStrtof("0.12345678912");
+  ExpectScanMatchesStrtof("0.00000015839");  // 1e11 is not exact in float; one division would round wrong
+  ExpectScanMatchesStrtof("1.00000000001");
+
+  // 39 digits: FLT_MAX still fits, a larger value does not.
+  ExpectScanMatchesStrtof("340282346638528859811704183484516925440");
+  ExpectScanMatchesStrtof("999999999999999999999999999999999999999");
+  // 60 and more digits hit the bounded copy.
+  ExpectScanMatchesStrtof(std::string(60, '9'));
+  ExpectScanMatchesStrtof(std::string(70, '1'));
+  ExpectScanMatchesStrtof(std::string(70, '0') + "1.5");
+
+  ExpectScanMatchesStrtof("-0");
+  ExpectScanMatchesStrtof("-0.0");
+  ExpectScanMatchesStrtof("0");
+
+  // The grammar has no exponent: "1.e5" is the number 1, then the number 5.
+  const std::string text = "1.e5";
+  const char *cursor = text.c_str();
+  const char *end = cursor + text.size();
+  float value = 0.0f;
+  Expect(ind_proto_scan_float(&cursor, end, &value) == 1 && value == 1.0f, "1.e5 should start with 1");
+  Expect(ind_proto_scan_float(&cursor, end, &value) == 1 && value == 5.0f, "1.e5 should continue with 5");
+  Expect(ind_proto_scan_float(&cursor, end, &value) == 0, "1.e5 should hold two numbers");
+}
+
+void TestScanFloatSweep() {
+  // Short decimals as a camera prints them; all take the fast path.
+  char text[32];
+  for (uint32_t i = 0; i < 200000; ++i) {
+    const uint32_t digits = (i * 2654435761u) % 10000000u;
+    const int frac = static_cast<int>(i % 8);
+    std::snprintf(text, sizeof(text), "%s%u.%0*u", (i & 1) ? "-" : "", digits / 1000, frac + 1,
+                  digits % 1000);
+    ExpectScanMatchesStrtof(text);
+  }
+}
+
+void TestEncodeFloatsSkipsSeparators() {
+  const char text[] = "x=1.5;y=-2,ok";
+  uint16_t regs[8] = {0};
+  int count = 0;
+  Expect(ind_proto_encode_floats(text, sizeof(text) - 1, IND_PROTO_FLOAT_ORDER_ABCD, regs, 4, &count) == 0,
+         "encoding should succeed");
+  Expect(count == 2, "two numbers should be encoded");
+  Expect(regs[0] == 0x3FC0 && regs[1] == 0x0000, "1.5 should be encoded high word first");
+  Expect(regs[2] == 0xC000 && regs[3] == 0x0000, "-2 should be encoded high word first");
+}
+
+void TestPlanWritesCommitLast() {
+  ind_proto_write_chunk_t chunks[4];
+  Expect(ind_proto_plan_writes(10, 4, 5, chunks, 4) == 3, "10 registers should take 3 writes of 4");
+  Expect(chunks[0].offset == 0 && chunks[0].count == 4, "the first chunk should come first");
+  Expect(chunks[1].offset == 8 && chunks[1].count == 2, "the short tail chunk should come second");
+  Expect(chunks[2].offset == 4 && chunks[2].count == 4, "the chunk holding the commit register should be last");
+
+  Expect(ind_proto_plan_writes(10, 4, 99, chunks, 4) == 3, "a commit index past the image should not reorder");
+  Expect(chunks[0].offset == 0 && chunks[1].offset == 4 && chunks[2].offset == 8,
+         "chunks should stay in register order without a commit register");
+  Expect(ind_proto_plan_writes(10, 4, 0, chunks, 2) == -1, "too few chunks should be reported");
+  Expect(ind_proto_plan_writes(0, 4, 0, chunks, 4) == 0, "an empty image should need no write");
+}
+
+void TestMarkDirtyComparesShadow() {
+  const uint16_t image[4] = {1, 2, 3, 4};
+  const uint16_t shadow[4] = {1, 0, 3, 0};
+  uint8_t dirty[4] = {1, 1, 1, 1};
+  Expect(ind_proto_mark_dirty(image, shadow, 4, dirty) == 2, "two registers should differ from the shadow");
+  Expect(!dirty[0] && dirty[1] && !dirty[2] && dirty[3], "only the changed registers should be dirty");
+  Expect(ind_proto_mark_dirty(image, NULL, 4, dirty) == 4, "an unknown shadow should mark every register");
+  Expect(ind_proto_mark_dirty(image, image, 4, dirty) == 0, "an unchanged image should need no write");
+}
+
+void TestPlanDirtyWritesMergesGaps() {
+  uint8_t dirty[24] = {0};
+  ind_proto_write_chunk_t chunks[8];
+
+  // A gap of max_gap clean registers is written through; the far run is separate.
+  dirty[0] = dirty[1] = dirty[5] = dirty[20] = 1;
+  Expect(ind_proto_plan_dirty_writes(dirty, 24, 8, 3, 0, chunks, 8) == 2, "close runs should merge");
+  Expect(chunks[0].offset == 20 && chunks[0].count == 1, "the far run should be written first");
+  Expect(chunks[1].offset == 0 && chunks[1].count == 6, "the merged run holding the commit register should be last");
+
+  // One clean register more than max_gap splits the runs; trailing clean registers are not written.
+  std::memset(dirty, 0, sizeof(dirty));
+  dirty[0] = dirty[5] = 1;
+  Expect(ind_proto_plan_dirty_writes(dirty, 24, 8, 3, 5, chunks, 8) == 2, "distant runs should stay apart");
+  Expect(chunks[0].offset == 0 && chunks[0].count == 1, "the first run should not include the gap");
+  Expect(chunks[1].offset == 5 && chunks[1].count == 1, "the commit run should be last");
+
+  // A run longer than max_regs is split; the commit register is written even when clean.
+  std::memset(dirty, 0, sizeof(dirty));
+  std::memset(dirty, 1, 10);
+  Expect(ind_proto_plan_dirty_writes(dirty, 24, 4, 0, 2, chunks, 8) == 3, "a long run should be split");
+  Expect(chunks[0].offset == 4 && chunks[1].offset == 8 && chunks[1].count == 2,
+         "the split chunks should keep register order");
+  Expect(chunks[2].offset == 0 && chunks[2].count == 4, "the commit chunk should move to the end");
+
+  std::memset(dirty, 0, sizeof(dirty));
+  Expect(ind_proto_plan_dirty_writes(dirty, 24, 8, 3, 3, chunks, 8) == 1, "a clean image should still commit");
+  Expect(chunks[0].offset == 3 && chunks[0].count == 1, "only the commit register should be written");
+
+  std::memset(dirty, 1, sizeof(dirty));
+  Expect(ind_proto_plan_dirty_writes(dirty, 24, 4, 0, 0, chunks, 2) == -1, "too few chunks should be reported");
+}
+
+}  // namespace
+
+int main() {
+  TestScanFloatEdgeCases();
+  TestScanFloatSweep();
+  TestEncodeFloatsSkipsSeparators();
+  TestPlanWritesCommitLast();
+  TestMarkDirtyComparesShadow();
+  TestPlanDirtyWritesMergesGaps();
+  std::cout << "[PASS] industrial protocol payload tests" << std::endl;
+  return 0;
+}